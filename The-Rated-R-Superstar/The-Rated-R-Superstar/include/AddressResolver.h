@@ -0,0 +1,85 @@
+/**
+ * @file AddressResolver.h
+ * @brief Resolución de nombres con `getaddrinfo` fuera del hilo que conecta y caché con TTL.
+ *
+ * @details
+ * - Cada consulta se ejecuta en un hilo auxiliar; el hilo que conecta solo espera
+ *   el resultado con un tope de tiempo, de modo que un DNS colgado no lo bloquea.
+ * - Consultas simultáneas al mismo `host:puerto` comparten un único `getaddrinfo`.
+ * - Los resultados se guardan en una caché de proceso con TTL (positivo y negativo).
+ *
+ * @note `getaddrinfo` no expone el TTL de los registros DNS; se usa un TTL
+ *       configurable (30 s por defecto, 5 s para fallos).
+ */
+
+#pragma once
+#include "Prerequisites.h"
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <future>
+
+/**
+ * @class AddressResolver
+ * @brief Caché de direcciones compartida por todas las conexiones del proceso.
+ */
+class AddressResolver {
+public:
+    /// @brief Dirección resuelta lista para `connect`.
+    struct Endpoint {
+        sockaddr_storage addr;   ///< Dirección (IPv4 o IPv6).
+        int addrLen;             ///< Tamaño válido de @ref addr.
+        int family;              ///< AF_INET o AF_INET6.
+    };
+
+    /// @brief Instancia única del proceso.
+    static AddressResolver& Instance();
+
+    /**
+     * @brief Resuelve @p host con tope de espera.
+     * @param host Nombre o literal IPv4/IPv6.
+     * @param port Puerto TCP.
+     * @param timeout Tiempo máximo de espera del hilo llamador.
+     * @return Direcciones en el orden de `getaddrinfo`; vacío si falla o vence el tope.
+     */
+    std::vector<Endpoint> Resolve(const std::string& host, int port, std::chrono::milliseconds timeout);
+
+    /**
+     * @brief Inicia (o reutiliza) una resolución sin esperar su resultado.
+     * @param host Nombre o literal IPv4/IPv6.
+     * @param port Puerto TCP.
+     * @return Futuro compartido con las direcciones resueltas.
+     */
+    std::shared_future<std::vector<Endpoint>> ResolveAsync(const std::string& host, int port);
+
+    /**
+     * @brief Ajusta los TTL de la caché.
+     * @param positive Vigencia de una resolución con resultados.
+     * @param negative Vigencia de una resolución fallida.
+     */
+    void SetTTL(std::chrono::seconds positive, std::chrono::seconds negative);
+
+    /// @brief Vacía la caché.
+    void Clear();
+
+private:
+    /// @brief Entrada de caché con su vencimiento.
+    struct CacheEntry {
+        std::vector<Endpoint> endpoints;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    AddressResolver() = default;
+
+    /// @brief Llamada bloqueante a `getaddrinfo` (se ejecuta en el hilo auxiliar).
+    static std::vector<Endpoint> Lookup(const std::string& host, int port);
+
+    /// @brief Guarda el resultado y retira la consulta en curso.
+    void Complete(const std::string& key, const std::vector<Endpoint>& endpoints);
+
+private:
+    std::mutex m_mutex;                                   ///< Protege caché y consultas en curso.
+    std::unordered_map<std::string, CacheEntry> m_cache;  ///< host:puerto -> direcciones.
+    std::unordered_map<std::string, std::shared_future<std::vector<Endpoint>>> m_pending; ///< En curso.
+    std::chrono::seconds m_positiveTTL{ 30 };             ///< Vigencia de resultados válidos.
+    std::chrono::seconds m_negativeTTL{ 5 };              ///< Vigencia de fallos.
+};
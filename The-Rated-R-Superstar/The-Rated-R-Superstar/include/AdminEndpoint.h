@@ -0,0 +1,66 @@
+/**
+ * @file AdminEndpoint.h
+ * @brief Socket local de administración que sirve métricas por HTTP.
+ *
+ * @details
+ * Escucha solo en loopback (`127.0.0.1:<puerto>`) o en un socket AF_UNIX
+ * (`unix:<ruta>`) y responde a `GET /metrics` con el texto que genera el
+ * servidor en formato Prometheus. Atiende una consulta cada vez en su propio
+ * hilo: nunca toca el bucle de los shards, solo lee sus contadores.
+ *
+ * @code
+ *  curl http://127.0.0.1:9100/metrics
+ *  curl --unix-socket C:\temp\e2ee-admin.sock http://localhost/metrics
+ * @endcode
+ */
+
+#pragma once
+#include "NetworkHelper.h"
+#include "Prerequisites.h"
+#include <condition_variable>
+#include <functional>
+
+/**
+ * @class AdminEndpoint
+ * @brief Servidor HTTP mínimo de solo lectura para la observabilidad.
+ */
+class AdminEndpoint {
+public:
+    /// @brief Genera el cuerpo de `/metrics` (se llama desde el hilo del endpoint).
+    using Renderer = std::function<std::string()>;
+
+    AdminEndpoint() = default;
+
+    /// @brief Destructor: detiene el hilo y cierra el socket.
+    ~AdminEndpoint();
+
+    AdminEndpoint(const AdminEndpoint&) = delete;
+    AdminEndpoint& operator=(const AdminEndpoint&) = delete;
+
+    /**
+     * @brief Abre el socket y arranca el hilo que atiende consultas.
+     * @param address Puerto TCP (en loopback) o `unix:<ruta>`.
+     * @param render Genera las métricas en cada consulta.
+     * @return true si el socket quedó en escucha.
+     */
+    bool Start(const std::string& address, Renderer render);
+
+    /// @brief Detiene el hilo, lo espera y cierra el socket. Idempotente.
+    void Stop();
+
+private:
+    /// @brief Bucle del hilo: espera conexiones en @p listenSock hasta la parada.
+    void AcceptLoop(SOCKET listenSock);
+
+    /// @brief Lee la petición de un cliente y responde.
+    void Serve(SOCKET client);
+
+private:
+    NetworkHelper m_net;                             ///< Sockets AF_UNIX y envío completo.
+    std::atomic<SOCKET> m_listenSock{ INVALID_SOCKET }; ///< Socket de escucha (lo cierra Stop()).
+    std::atomic<bool> m_running{ false };            ///< Bandera del hilo.
+    std::mutex m_stopMutex;                          ///< Espera tras un error de accept.
+    std::condition_variable m_stopCv;                ///< Despierta esa espera al parar.
+    std::thread m_thread;                            ///< Hilo que atiende las consultas.
+    Renderer m_render;                               ///< Generador de métricas.
+};
@@ -0,0 +1,99 @@
+/**
+ * @file Benchmark.h
+ * @brief Mediciones en proceso de las rutas calientes del servidor.
+ *
+ * @details
+ * No abren sockets: ejecutan el código del shard o reproducen con sus mismas
+ * estructuras (@ref RoomDirectory, @ref Session, @ref FrameBuffer) el trabajo
+ * que cuesta cada operación, para comparar variantes sin el ruido de la red. La
+ * excepción es @ref Benchmark::RunPrimitives, que mide también el framing
+ * sobre un par de sockets de loopback, un socket AF_UNIX, memoria compartida
+ * y un @ref MemoryTransport.
+ */
+
+#pragma once
+#include "Prerequisites.h"
+
+/**
+ * @class Benchmark
+ * @brief Conjunto de benchmarks invocables desde `E2EE bench`.
+ */
+class Benchmark {
+public:
+    /**
+     * @brief Reparto de un mensaje a todos los miembros de una sala.
+     * @param roomSizes Tamaños de sala a medir (p.ej. 10, 1000, 50000).
+     *
+     * @details
+     * Compara el fan-out del relay (una serialización, un puntero por miembro
+     * en su cola de envío), medido sobre @ref ServerShard::RouteToRoom de un
+     * shard real, con la variante ingenua que cifra y serializa el mensaje una
+     * vez por miembro. Imprime mensajes/s, entregas/s y ns por miembro.
+     */
+    static void RunRoomFanOut(const std::vector<size_t>& roomSizes);
+
+    /**
+     * @brief Cambio de clave de una sala tras un alta o una baja.
+     * @param roomSizes Tamaños de sala a medir (p.ej. 10, 1000, 5000).
+     *
+     * @details
+     * Compara el esquema por pares (una clave nueva envuelta con la RSA de cada
+     * uno de los n - 1 miembros) con un commit del árbol de claves
+     * (@ref RatchetTree), que sella el secreto de cada nivel para la resolución
+     * del hermano: O(log n) operaciones X25519. Imprime rekeys/s, envolturas o
+     * sellados por rekey y el tamaño del commit.
+     */
+    static void RunRoomRekey(const std::vector<size_t>& roomSizes);
+
+    /**
+     * @brief Consultas concurrentes al directorio de usuarios.
+     * @param threadCounts Hilos lectores a medir (p.ej. 1, 4, 16, 32).
+     *
+     * @details
+     * Los lectores consultan ids al azar, como hace cada shard por frame
+     * enrutado, mientras un hilo escritor da de alta y de baja usuarios sin
+     * pausa. Compara @ref UserDirectory (lecturas sin bloqueo) con un mapa
+     * protegido por un único mutex. Imprime consultas/s totales y por hilo.
+     */
+    static void RunDirectoryContention(const std::vector<size_t>& threadCounts);
+
+    /**
+     * @brief Rearme de temporizadores con muchos temporizadores armados.
+     * @param timerCounts Temporizadores armados a medir (p.ej. 1000, 100000, 1000000).
+     *
+     * @details
+     * Cada operación cancela un temporizador al azar y programa otro, como una
+     * sesión que rearma su plazo; cada 100 operaciones el reloj avanza un tick
+     * y los vencidos se reprograman. Compara @ref TimerWheel con un
+     * `std::multimap` ordenado por vencimiento. Imprime operaciones/s.
+     */
+    static void RunTimerChurn(const std::vector<size_t>& timerCounts);
+
+    /**
+     * @brief Microbenchmarks de las primitivas de @ref CryptoHelper y @ref NetworkHelper.
+     * @param filter Solo los benchmarks cuyo nombre contiene @p filter (vacío: todos).
+     * @param jsonPath Si no está vacío, escribe ahí los resultados en JSON.
+     * @return false si no se pudo escribir @p jsonPath.
+     *
+     * @details
+     * Cada benchmark se calienta con una llamada y se repite hasta cubrir el
+     * tiempo mínimo; se informa por operación el tiempo real, el de CPU del
+     * hilo que mide y, si mueve datos, los bytes por segundo:
+     *  - `AESEncrypt/<n>` y `AESDecrypt/<n>`, de 16 B a 16 MB.
+     *  - `GenerateRSAKeys`, `EncryptAESKeyWithPeer` y `DecryptAESKey`.
+     *  - `PEMExport` (@ref CryptoHelper::GetPublicKeyString) y `PEMImport`
+     *    (@ref CryptoHelper::LoadPeerPublicKey).
+     *  - `FrameRoundTrip/<n>`: @ref NetworkHelper::SendFrame y
+     *    @ref NetworkHelper::ReceiveFrame de ida y vuelta por un par de sockets
+     *    de loopback, con un hilo que devuelve cada frame.
+     *  - `FrameRoundTrip/memory/<n>`: lo mismo sobre un @ref MemoryTransport;
+     *    la diferencia con la anterior es el coste de la pila de red.
+     *  - `FrameRoundTrip/unix/<n>` y `FrameRoundTrip/shm/<n>`: lo mismo sobre
+     *    los transportes locales `unix:` y `shm:` (@ref SharedMemoryTransport),
+     *    para comprobar su latencia de ida y vuelta frente al loopback TCP.
+     *
+     * El JSON sigue el esquema de Google Benchmark (`context` y `benchmarks`,
+     * tiempos en ns), así que su `compare.py` contrasta dos versiones.
+     */
+    static bool RunPrimitives(const std::string& filter, const std::string& jsonPath);
+};
@@ -1,37 +1,45 @@
 /**
  * @file Client.h
- * @brief Cliente TCP con handshake RSA y mensajera cifrada con AES.
+ * @brief Cliente TCP con handshake RSA y mensajería cifrada con AES.
  *
  * @details
- * Esta clase encapsula la lgica de un cliente que:
- *  - Establece conexin TCP con un servidor.
- *  - Intercambia claves pblicas (RSA) durante el arranque.
- *  - Enva la clave de sesin AES cifrada con la RSA del servidor.
- *  - Transmite y recibe mensajes usando cifrado simtrico (AES).
- *  - Ofrece bucles de envo/recepcin para chat simple.
+ * Esta clase encapsula la lógica de un cliente que:
+ *  - Establece conexión TCP con un servidor.
+ *  - Intercambia claves públicas (RSA) durante el arranque.
+ *  - Envía la clave de sesión AES cifrada con la RSA del servidor.
+ *  - Transmite y recibe mensajes usando cifrado simétrico (AES).
+ *  - Ofrece bucles de envío/recepción para chat simple.
+ *  - Mantiene un latido con el servidor (Ping/Pong) y corta la conexión si deja de responder.
  *
- * @note Codificacin sugerida: UTF-8 (sin BOM) para evitar problemas de caracteres en consola.
+ * @note Codificación sugerida: UTF-8 (sin BOM) para evitar problemas de caracteres en consola.
  */
 
 #pragma once
 #include "NetworkHelper.h"
 #include "CryptoHelper.h"
+#include "RatchetTree.h"
+#include "Heartbeat.h"
+#include "HdrHistogram.h"
+#include "Logger.h"
+#include "Trace.h"
 #include "Prerequisites.h"
+#include <condition_variable>
+#include <map>
 
  /**
   * @class Client
-  * @brief Cliente que se conecta por TCP, negocia claves y enva/recibe mensajes cifrados.
+  * @brief Cliente que se conecta por TCP, negocia claves y envía/recibe mensajes cifrados.
   *
-  * @par Flujo tpico de uso
+  * @par Flujo típico de uso
   * 1. Construir `Client(ip, port)`.
-  * 2. `Connect()` para establecer la conexin TCP.
+  * 2. `Connect()` para establecer la conexión TCP.
   * 3. `ExchangeKeys()` para intercambio de claves (recibir RSA del servidor y preparar AES).
   * 4. `SendAESKeyEncrypted()` para enviar la clave/IV AES cifrados con RSA del servidor.
   * 5. `StartReceiveLoop()` y/o `StartChatLoop()`/`SendEncryptedMessageLoop()` para chatear.
   * 6. Destruir el objeto para liberar recursos/sockets.
   *
   * @warning Las operaciones de red pueden ser bloqueantes si no se configuran timeouts
-  *          (ver implementacin de NetworkHelper).
+  *          (ver implementación de NetworkHelper).
   */
 class Client {
 public:
@@ -40,107 +48,409 @@ public:
 
 	/**
 	 * @brief Construye el cliente con destino y puerto.
-	 * @param ip Direccin del servidor (por ejemplo, "127.0.0.1").
+	 * @param ip Dirección del servidor (por ejemplo, "127.0.0.1").
 	 * @param port Puerto TCP del servidor (por ejemplo, 5000).
 	 *
-	 * @post El socket an no est conectado; se debe invocar @ref Connect().
+	 * @post El socket aún no está conectado; se debe invocar @ref Connect().
 	 */
 	Client(const std::string& ip, int port);
 
-	/// @brief Destructor: libera recursos y cierra socket si est abierto.
+	/// @brief Destructor: libera recursos y cierra socket si está abierto.
 	~Client();
 
 	/**
-	 * @brief Establece conexin con el servidor.
-	 * @return true si la conexin fue exitosa.
-	 * @return false si ocurri un error.
+	 * @brief Establece conexión con el servidor.
+	 * @return true si la conexión fue exitosa.
+	 * @return false si ocurrió un error.
 	 *
 	 * @post Si retorna true, el socket queda listo para el intercambio de claves.
-	 * @note Puede registrar mensajes de diagnstico a la consola.
+	 * @note Puede registrar mensajes de diagnóstico a la consola.
 	 */
 	bool Connect();
 
 	/**
-	 * @brief Intercambia claves pblicas con el servidor (handshake RSA).
+	 * @brief Envía la clave pública del cliente en el SYN (TCP Fast Open).
+	 * @param enabled true para activarlo.
+	 *
+	 * @details
+	 * El primer vuelo del handshake viaja con la conexión y @ref ExchangeKeys()
+	 * ya no lo reenvía. Si TFO no está disponible se conecta de forma normal.
+	 * @pre Llamar antes de @ref Connect().
+	 */
+	void EnableFastOpen(bool enabled = true);
+
+	/**
+	 * @brief Emula un enlace malo (retardo, ancho de banda, pérdidas, cortes).
+	 * @param conditions Condiciones del enlace; ver @ref NetworkConditions::Parse.
+	 * @pre Llamar antes de @ref Connect().
+	 */
+	void SetNetworkConditions(const NetworkConditions& conditions);
+
+	/**
+	 * @brief Graba la forma de los frames de la sesión (ver @ref TrafficCapture).
+	 * @param path Archivo de captura (se trunca).
+	 * @return false si no se pudo crear el archivo.
+	 * @pre Llamar antes de @ref Connect().
+	 */
+	bool StartCapture(const std::string& path);
+
+	/**
+	 * @brief Intercambia claves públicas con el servidor (handshake RSA).
 	 *
 	 * @details
 	 * Secuencia esperada:
-	 *  - Recibir la clave pblica RSA del servidor.
-	 *  - Opcionalmente enviar la clave pblica del cliente (si se usa RSA bilateral).
-	 *  - Preparar material de sesin (clave/IV) para AES.
+	 *  - Recibir la clave pública RSA del servidor.
+	 *  - Opcionalmente enviar la clave pública del cliente (si se usa RSA bilateral).
+	 *  - Preparar material de sesión (clave/IV) para AES.
 	 *
-	 * @pre Conexin TCP establecida mediante @ref Connect().
-	 * @post Tras completarse, el cliente est listo para @ref SendAESKeyEncrypted().
+	 * @pre Conexión TCP establecida mediante @ref Connect().
+	 * @post Tras completarse, el cliente está listo para @ref SendAESKeyEncrypted().
 	 */
 	void ExchangeKeys();
 
 	/**
-	 * @brief Cifra la clave AES con la pblica del servidor y la enva.
+	 * @brief Cifra la clave AES con la pública del servidor y la envía.
 	 *
 	 * @details
-	 * Serializa y enva el material de sesin (p.ej., clave AES e IV) protegido
-	 * con RSA (clave pblica del servidor). El servidor podr descifrarlo con su
-	 * clave privada y as establecer el canal simtrico.
+	 * Serializa y envía el material de sesión (p.ej., clave AES e IV) protegido
+	 * con RSA (clave pública del servidor). El servidor podrá descifrarlo con su
+	 * clave privada y así establecer el canal simétrico.
 	 *
 	 * @pre Debe haberse ejecutado @ref ExchangeKeys().
 	 */
 	void SendAESKeyEncrypted();
 
 	/**
-	 * @brief Cifra un mensaje con AES y lo enva al servidor.
+	 * @brief Cifra un mensaje con AES y lo envía al servidor.
 	 * @param message Texto plano a cifrar y enviar.
 	 *
-	 * @pre La sesin AES debe estar establecida (ver @ref SendAESKeyEncrypted()).
-	 * @note Usa @ref NetworkHelper para el envo con framing y @ref CryptoHelper para el cifrado.
+	 * @pre La sesión AES debe estar establecida (ver @ref SendAESKeyEncrypted()).
+	 * @note Usa @ref NetworkHelper para el envío con framing y @ref CryptoHelper para el cifrado.
 	 */
 	void SendEncryptedMessage(const std::string& message);
 
 	/**
-	 * @brief Bucle interactivo de envo de mensajes cifrados (lado cliente).
+	 * @brief Bucle interactivo de envío de mensajes cifrados (lado cliente).
 	 *
 	 * @details
-	 * Lee entradas del usuario (consola), las cifra con AES y las enva al servidor
+	 * Lee entradas del usuario (consola), las cifra con AES y las envía al servidor
 	 * hasta que se indique finalizar (p.ej. EOF o comando de salida).
 	 *
-	 * @warning Bloquea el hilo actual mientras est activo.
+	 * @warning Bloquea el hilo actual mientras está activo.
 	 */
 	void SendEncryptedMessageLoop();
 
 	/**
-	 * @brief Bucle de chat de alto nivel (envo/recepcin) segn la implementacin.
+	 * @brief Bucle de chat de alto nivel (envío/recepción) según la implementación.
 	 *
 	 * @details
-	 * Dependiendo de la implementacin, puede combinar lectura de consola,
-	 * envo cifrado y recepcin/impresin de respuestas del servidor.
+	 * Dependiendo de la implementación, puede combinar lectura de consola,
+	 * envío cifrado y recepción/impresión de respuestas del servidor.
 	 *
-	 * @note Si tambin se usa @ref StartReceiveLoop(), coordinar hilos/vida del socket.
+	 * @note Si también se usa @ref StartReceiveLoop(), coordinar hilos/vida del socket.
 	 */
 	void StartChatLoop();
 
 	/**
-	 * @brief Bucle de recepcin: recibe mensajes del servidor y los muestra.
+	 * @brief Bucle de recepción: recibe mensajes del servidor y los muestra.
 	 *
 	 * @details
-	 * Extrae frames de red, descifra el contenido con AES y los imprime en consola.
+	 * Extrae frames de red, descifra el contenido con AES y los pasa al @ref Logger:
+	 * este hilo nunca espera a la consola.
 	 * Finaliza si el socket se cierra o ocurre un error de red.
 	 *
 	 * @warning Puede ser bloqueante. Ejecutarlo idealmente en un hilo dedicado.
 	 */
 	void StartReceiveLoop();     // Recibir y mostrar mensajes del servidor
 
+	/**
+	 * @brief Activa el modo relay con el id de usuario indicado.
+	 * @param userId Id numérico (distinto de 0) con el que otros clientes nos escriben.
+	 * @post Tras el handshake hay que llamar a @ref RegisterUser().
+	 */
+	void EnableRelay(uint32_t userId);
+
+	/**
+	 * @brief Registra el id de usuario en el servidor.
+	 * @return true si el servidor aceptó el id.
+	 * @pre Handshake completo y sin hilo de recepción activo.
+	 */
+	bool RegisterUser();
+
+	/**
+	 * @brief Envía un mensaje cifrado extremo a extremo a otro usuario.
+	 * @param peerId Id del destinatario.
+	 * @param message Texto plano.
+	 * @return true si el frame se envió.
+	 *
+	 * @details
+	 * La primera vez consulta la clave pública del peer, genera una clave AES
+	 * propia para ese peer y se la envía envuelta con RSA. El servidor solo ve
+	 * la cabecera de ruta.
+	 */
+	bool SendToPeer(uint32_t peerId, const std::string& message);
+
+	/**
+	 * @brief Envía el mismo mensaje a varios usuarios cifrándolo una sola vez.
+	 * @param peerIds Ids de los destinatarios.
+	 * @param message Texto plano.
+	 * @return true si el sobre se envió.
+	 *
+	 * @details
+	 * Usa @ref CryptoHelper::SealEnvelope(): el cuerpo se cifra una vez con una
+	 * clave de contenido nueva y esa clave se envuelve con la RSA de cada peer.
+	 * El servidor entrega a cada uno solo su envoltura y el cuerpo compartido.
+	 */
+	bool SendToPeers(const std::vector<uint32_t>& peerIds, const std::string& message);
+
+	/**
+	 * @brief Entra en una sala del relay y espera la lista de miembros.
+	 * @param roomId Id de la sala (menor que 2^31).
+	 * @return true si el servidor respondió con los miembros.
+	 * @pre Usuario registrado y hilo de recepción activo.
+	 * @note Si la sala estaba vacía el cliente crea su árbol de claves; si no,
+	 *       la clave de grupo llega con el Welcome del miembro responsable.
+	 */
+	bool JoinRoom(uint32_t roomId);
+
+	/**
+	 * @brief Sale de una sala y olvida sus claves.
+	 * @param roomId Id de la sala.
+	 */
+	void LeaveRoom(uint32_t roomId);
+
+	/**
+	 * @brief Envía un mensaje cifrado extremo a extremo a todos los miembros de una sala.
+	 * @param roomId Id de la sala.
+	 * @param message Texto plano.
+	 * @return false si aún no hay clave de grupo o el frame no se envió.
+	 *
+	 * @details
+	 * El mensaje se cifra una vez con la clave de grupo de la época vigente
+	 * (@ref RatchetTree) y el servidor lo reparte sin descifrarlo. Altas y bajas
+	 * cambian la clave con un único commit de O(log n) sellados.
+	 */
+	bool SendToRoom(uint32_t roomId, const std::string& message);
+
+	/**
+	 * @brief Configura el latido con el servidor.
+	 * @param interval Silencio del servidor tras el que se le envía un Ping; cero lo desactiva.
+	 * @param maxMissed Pings seguidos sin respuesta antes de dar la conexión por caída.
+	 * @pre Llamar antes de @ref StartChatLoop().
+	 */
+	void SetHeartbeat(std::chrono::milliseconds interval, uint32_t maxMissed = 3);
+
+	/**
+	 * @brief RTT suavizado y jitter medidos con los Ping propios.
+	 * @param rtt RTT suavizado.
+	 * @param jitter Variación media del RTT.
+	 * @return false si aún no hay ninguna muestra.
+	 */
+	bool GetRtt(std::chrono::microseconds& rtt, std::chrono::microseconds& jitter);
+
+	/**
+	 * @brief Sella los mensajes enviados con secuencia e instante para medir su latencia.
+	 * @param enabled true para activarlo.
+	 *
+	 * @details
+	 * Quien recibe un mensaje sellado registra la latencia de un sentido (relojes
+	 * de pared de los dos equipos: solo es fiable si están sincronizados) y acusa
+	 * los mensajes directos. Con el acuse, o con el eco del servidor, el emisor
+	 * registra la de ida y vuelta con su propio reloj.
+	 */
+	void EnableLatencyStamps(bool enabled = true);
+
+	/**
+	 * @brief Publica las latencias medidas.
+	 * @param prefix Vacío: resumen (p50, p99, p99.9, máximo) en el registro. Si no,
+	 *        escribe `<prefix>-oneway.hgrm` y `<prefix>-rtt.hgrm` con la distribución
+	 *        completa en el formato de HdrHistogram.
+	 * @return false si no se pudo escribir algún archivo.
+	 */
+	bool ReportLatency(const std::string& prefix = "");
+
 private:
-	/** @brief Direccin IP o hostname del servidor de destino. */
+	/**
+	 * @brief Claves AES con un peer.
+	 * @details Cada extremo cifra con la clave que generó (`tx`) y descifra con la
+	 *          que recibió (`rx`), así dos inicios simultáneos no se pisan.
+	 */
+	struct PeerChannel {
+		std::unique_ptr<CryptoHelper> tx;   ///< Clave propia para enviar al peer.
+		std::unique_ptr<CryptoHelper> rx;   ///< Clave del peer para recibir.
+		std::unique_ptr<CryptoHelper> recipient; ///< Clave pública del peer para sobres.
+	};
+
+	/**
+	 * @brief Árbol de claves de una sala y cambios pendientes.
+	 * @details El responsable de un alta o baja la acumula en `pendingAdds` /
+	 *          `pendingRemoves` y emite un commit sobre una copia (`staged`), que
+	 *          solo sustituye a `tree` cuando el servidor devuelve el eco. Mientras
+	 *          tanto los cambios nuevos se agrupan para el commit siguiente.
+	 */
+	struct RoomChannel {
+		bool listed = false;                                            ///< Llegó la lista de miembros.
+		size_t others = 0;                                              ///< Otros miembros al entrar.
+		std::vector<unsigned char> leafSecret;                          ///< Secreto X25519 de la hoja propia.
+		std::unique_ptr<RatchetTree> tree;                              ///< Árbol vigente (nullptr hasta el Welcome).
+		std::unique_ptr<RatchetTree> staged;                            ///< Commit propio a la espera del eco.
+		std::vector<RatchetTree::Addition> stagedAdds;                  ///< Altas del commit propio (reciben Welcome).
+		std::vector<uint32_t> stagedRemoves;                            ///< Bajas del commit propio.
+		std::vector<RatchetTree::Addition> pendingAdds;                 ///< Altas para el próximo commit.
+		std::vector<uint32_t> pendingRemoves;                           ///< Bajas para el próximo commit.
+		std::map<uint32_t, std::vector<unsigned char>> futureCommits;   ///< Commits de épocas aún no alcanzadas.
+		uint32_t previousEpoch = 0;                                     ///< Época anterior (mensajes en vuelo).
+		std::vector<unsigned char> previousKey;                         ///< Clave de grupo de @ref previousEpoch.
+	};
+
+	/**
+	 * @brief Consulta en lote las claves públicas de varios usuarios.
+	 * @param ids Usuarios a consultar.
+	 * @param out PEM por usuario (vacía si no está conectado).
+	 * @return false si el servidor no respondió a tiempo.
+	 * @note Envía todas las consultas antes de esperar: un RTT para todo el lote.
+	 */
+	bool LookupPeerKeys(const std::vector<uint32_t>& ids, std::unordered_map<uint32_t, std::string>& out);
+
+	/// @brief Obtiene la clave del peer y le envía la clave de envío si aún no existe.
+	bool EnsurePeerChannel(uint32_t peerId);
+
+	/// @brief Envía un frame; serializa los envíos de los hilos de chat y de recepción.
+	bool SendFrame(const Frame& frame);
+
+	/// @brief Encola un frame para el hilo de envío.
+	/// @return false (descartado) si ese hilo no corre o la cola está llena.
+	bool QueueFrame(Frame frame);
+
+	/// @brief Hilo de envío: vacía la cola hasta que @ref StartChatLoop() termina.
+	void SendQueueLoop();
+
+	/// @brief Prepara un commit con los cambios pendientes si no hay otro a la espera.
+	/// @pre @ref m_peersMutex tomado; el commit se añade a @p outbox y se envía tras soltarlo.
+	void CommitPending(uint32_t roomId, RoomChannel& room, std::vector<Frame>& outbox);
+
+	/// @brief Aplica un commit de la sala (propio o ajeno) y los que esperaban por él.
+	/// @pre @ref m_peersMutex tomado; Welcome y commits resultantes van a @p outbox.
+	void ApplyRoomCommit(uint32_t roomId, RoomChannel& room, uint32_t committer,
+		const std::vector<unsigned char>& commit, std::vector<Frame>& outbox);
+
+	/// @brief Procesa la lista de miembros o un alta/baja de una sala.
+	void HandleRoomControl(const Frame& frame);
+
+	/// @brief Procesa un frame recibido (control, clave de peer o mensaje).
+	/// @return true si era un mensaje y se descifró y mostró.
+	bool HandleIncoming(const Frame& frame);
+
+	/// @brief Añade secuencia e instante de envío si el sellado está activo.
+	void StampFrame(Frame& frame);
+
+	/// @brief Registra la latencia de un mensaje sellado ya mostrado y encola su acuse si es directo.
+	void RecordLatency(const Frame& frame);
+
+	/**
+	 * @brief Hilo del latido: Ping al servidor si calla y corte tras varios sin respuesta.
+	 * @details El corte (@ref NetworkHelper::Shutdown) despierta al hilo de recepción,
+	 *          que termina como si el servidor hubiera cerrado.
+	 */
+	void HeartbeatLoop();
+
+	/// @brief Pide al hilo del latido que termine.
+	void StopHeartbeat();
+
+private:
+	/** @brief Dirección IP o hostname del servidor de destino. */
 	std::string m_ip;
 
-	/** @brief Puerto TCP de conexin. */
+	/** @brief Puerto TCP de conexión. */
 	int m_port;
 
-	/** @brief Socket conectado al servidor (vlido tras @ref Connect()). */
+	/** @brief Socket conectado al servidor (válido tras @ref Connect()). */
 	SOCKET m_serverSock;
 
-	/** @brief Utilidades de red (framing, timeouts, envo/recepcin). */
+	/** @brief Utilidades de red (framing, timeouts, envío/recepción). */
 	NetworkHelper m_net;
 
-	/** @brief Utilidades criptogrficas (RSA/AES). */
+	/** @brief Utilidades criptográficas (RSA/AES). */
 	CryptoHelper m_crypto;
+
+	/** @brief Enviar la clave pública con la conexión (TCP Fast Open). */
+	bool m_fastOpen = false;
+
+	/** @brief La clave pública del cliente ya se envió. */
+	bool m_publicKeySent = false;
+
+	/** @brief Traza del handshake de esta conexión (0: sin muestrear). */
+	uint64_t m_traceId = 0;
+
+	/** @brief Id de usuario en el relay (0: modo eco con el servidor). */
+	uint32_t m_userId = 0;
+
+	/** @brief Destinatarios actuales del bucle de chat (varios: sobre). */
+	std::vector<uint32_t> m_currentPeers;
+
+	/** @brief Sala actual del bucle de chat (0: ninguna). */
+	uint32_t m_currentRoom = 0;
+
+	/** @brief Protege @ref m_peers, @ref m_peerKeys y @ref m_rooms (hilos de envío y recepción). */
+	std::mutex m_peersMutex;
+
+	/** @brief Serializa los envíos al servidor (el hilo de recepción también emite commits). */
+	std::mutex m_sendMutex;
+
+	/** @brief Protege @ref m_sendQueue y @ref m_queueRunning. */
+	std::mutex m_queueMutex;
+
+	/** @brief Despierta al hilo de envío (frame nuevo o fin). */
+	std::condition_variable m_queueCv;
+
+	/** @brief Frames que el hilo de recepción delega en el de envío (acuses). */
+	std::deque<Frame> m_sendQueue;
+
+	/** @brief El hilo de envío acepta frames. */
+	bool m_queueRunning = false;
+
+	/** @brief Avisa de respuestas a consultas de clave. */
+	std::condition_variable m_peersCv;
+
+	/** @brief Claves extremo a extremo por usuario. */
+	std::unordered_map<uint32_t, PeerChannel> m_peers;
+
+	/** @brief PEM recibidas por consulta (vacía si el usuario no existe). */
+	std::unordered_map<uint32_t, std::string> m_peerKeys;
+
+	/** @brief Salas en las que está el cliente. */
+	std::unordered_map<uint32_t, RoomChannel> m_rooms;
+
+	/** @brief Latido con el servidor: última señal de vida y RTT. */
+	Heartbeat m_heartbeat;
+
+	/** @brief Protege @ref m_heartbeat y @ref m_heartbeatRunning. */
+	std::mutex m_heartbeatMutex;
+
+	/** @brief Despierta al hilo del latido al terminar. */
+	std::condition_variable m_heartbeatCv;
+
+	/** @brief El hilo del latido debe seguir. */
+	bool m_heartbeatRunning = false;
+
+	/** @brief Silencio del servidor antes de un Ping (0: sin latido). */
+	std::chrono::milliseconds m_heartbeatInterval{ 15000 };
+
+	/** @brief Pings sin respuesta antes de cortar la conexión. */
+	uint32_t m_maxMissedPings = 3;
+
+	/** @brief Sellar los mensajes enviados. */
+	bool m_stampMessages = false;
+
+	/** @brief Último número de secuencia sellado. */
+	std::atomic<uint32_t> m_sequence{ 0 };
+
+	/** @brief Protege @ref m_oneWay y @ref m_roundTrip (hilos de recepción y de chat). */
+	std::mutex m_latencyMutex;
+
+	/** @brief Latencia de un sentido de los mensajes recibidos (µs). */
+	HdrHistogram m_oneWay;
+
+	/** @brief Latencia de ida y vuelta de los mensajes propios (µs). */
+	HdrHistogram m_roundTrip;
 };
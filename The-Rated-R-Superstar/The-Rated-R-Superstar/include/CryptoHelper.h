@@ -1,15 +1,17 @@
 /**
  * @file CryptoHelper.h
- * @brief Utilidades criptogrficas para generacin de claves RSA y cifrado/descifrado AES.
+ * @brief Utilidades criptográficas para generación de claves RSA y cifrado/descifrado AES.
  *
  * @details
  * Esta clase encapsula las operaciones de cifrado necesarias para el sistema Cliente-Servidor:
- *  - Generacin de claves RSA (2048 bits) y exportacin/importacin en formato PEM.
- *  - Generacin de clave AES-256 aleatoria.
+ *  - Generación de claves RSA (2048 bits) y exportación/importación en formato PEM.
+ *  - Generación de clave AES-256 aleatoria.
  *  - Cifrado y descifrado de la clave AES usando RSA.
  *  - Cifrado y descifrado de mensajes con AES-256 en modo CBC.
+ *  - Sobres multi-destinatario: cuerpo cifrado una vez, clave envuelta por destinatario.
+ *  - Primitivas del árbol de claves de grupo: HKDF-SHA256 y sellado con X25519.
  *
- * @note La implementacin se basa en OpenSSL.
+ * @note La implementación se basa en OpenSSL.
  * @warning La clase administra memoria de claves RSA (punteros `RSA*`), por lo que el destructor debe liberar correctamente los recursos.
  */
 
@@ -18,21 +20,38 @@
 #include "openssl\rsa.h"
 #include "openssl\aes.h"
 
+class CryptoHelper;
+
+/**
+ * @struct Envelope
+ * @brief Mensaje cifrado una vez para varios destinatarios.
+ *
+ * @details
+ * El cuerpo se sella con una clave de contenido aleatoria (AES-256-GCM) y esa
+ * clave se envuelve con la RSA pública de cada destinatario. Cada peer solo
+ * necesita su envoltura y el cuerpo compartido; un cuerpo alterado no se abre.
+ */
+struct Envelope {
+    std::vector<unsigned char> iv;                    ///< Nonce GCM (12 bytes) completado con ceros hasta 16.
+    std::vector<unsigned char> body;                  ///< Cifrado | etiqueta (16), uno para todos.
+    std::vector<std::vector<unsigned char>> wraps;    ///< Clave de contenido envuelta, en el orden de los destinatarios.
+};
+
  /**
   * @class CryptoHelper
   * @brief Proporciona funciones para el manejo de claves y cifrado RSA/AES.
   *
   * @par Funcionalidades principales:
   *  - **RSA**:
-  *    - Generar par de claves (privada/pblica).
-  *    - Exportar clave pblica a string PEM.
-  *    - Cargar clave pblica de un peer desde string PEM.
-  *    - Cifrar y descifrar la clave AES de sesin usando RSA.
+  *    - Generar par de claves (privada/pública).
+  *    - Exportar clave pública a string PEM.
+  *    - Cargar clave pública de un peer desde string PEM.
+  *    - Cifrar y descifrar la clave AES de sesión usando RSA.
   *  - **AES**:
   *    - Generar clave AES-256 aleatoria (32 bytes).
   *    - Cifrar y descifrar mensajes con AES-256-CBC.
   *
-  * @note Todas las funciones asumen codificacin UTF-8 para strings.
+  * @note Todas las funciones asumen codificación UTF-8 para strings.
   */
 class CryptoHelper {
 public:
@@ -46,25 +65,39 @@ public:
     /**
      * @brief Genera un nuevo par de claves RSA de 2048 bits.
      *
-     * @post La clave privada y la clave pblica quedan almacenadas en @ref rsaKeyPair.
-     * @throws std::runtime_error si la generacin falla.
+     * @post La clave privada y la clave pública quedan almacenadas en @ref rsaKeyPair.
+     * @throws std::runtime_error si la generación falla.
      */
     void GenerateRSAKeys();
 
     /**
-     * @brief Devuelve la clave pblica en formato PEM.
-     * @return Clave pblica como string codificado en PEM.
+     * @brief Devuelve la clave pública en formato PEM.
+     * @return Clave pública como string codificado en PEM.
      * @pre Debe haberse generado el par de claves con @ref GenerateRSAKeys().
      */
     std::string GetPublicKeyString() const;
 
     /**
-     * @brief Carga la clave pblica del peer desde un string PEM.
-     * @param pemKey Clave pblica codificada en formato PEM.
+     * @brief Devuelve la clave pública del peer en formato PEM.
+     * @return PEM del peer, o cadena vacía si no se ha cargado ninguna.
+     */
+    std::string GetPeerPublicKeyString() const;
+
+    /**
+     * @brief Carga la clave pública del peer desde un string PEM.
+     * @param pemKey Clave pública codificada en formato PEM.
      * @throws std::runtime_error si el parseo del PEM falla.
      */
     void LoadPeerPublicKey(const std::string& pemKey);
 
+    /**
+     * @brief Comprueba que un string PEM contiene una clave pública RSA válida.
+     * @param pemKey Clave pública codificada en formato PEM.
+     * @return true si OpenSSL la puede cargar.
+     * @note No guarda nada: el servidor valida la PEM del cliente sin mantener su `RSA*`.
+     */
+    static bool IsValidPublicKey(const std::string& pemKey);
+
     //   AES
     /**
      * @brief Genera una clave AES-256 (32 bytes aleatorios).
@@ -73,9 +106,9 @@ public:
     void GenerateAESKey();
 
     /**
-     * @brief Cifra la clave AES con la clave pblica del peer usando RSA.
+     * @brief Cifra la clave AES con la clave pública del peer usando RSA.
      * @return Clave AES cifrada como vector de bytes.
-     * @pre Debe haberse cargado la clave pblica del peer con @ref LoadPeerPublicKey().
+     * @pre Debe haberse cargado la clave pública del peer con @ref LoadPeerPublicKey().
      */
     std::vector<unsigned char> EncryptAESKeyWithPeer();
 
@@ -87,10 +120,49 @@ public:
      */
     void DecryptAESKey(const std::vector<unsigned char>& encryptedKey);
 
+    /**
+     * @brief Descifra una clave AES con la clave privada propia sin almacenarla.
+     * @param encryptedKey Vector con la clave AES cifrada con RSA-OAEP.
+     * @return Los 32 bytes de la clave AES, o vector vacío si el descifrado falla.
+     * @note Lo usa el cliente para los canales con sus peers; el servidor
+     *       descifra con su @ref ServerIdentity compartida.
+     */
+    std::vector<unsigned char> UnwrapAESKey(const std::vector<unsigned char>& encryptedKey) const;
+
+    /**
+     * @brief Establece la clave AES de sesión a partir de bytes ya conocidos.
+     * @param key Vector de 32 bytes con la clave AES-256.
+     * @throws std::runtime_error si el tamaño no es 32 bytes.
+     */
+    void SetAESKey(const std::vector<unsigned char>& key);
+
+    /**
+     * @brief Devuelve una copia de la clave AES de sesión actual.
+     * @return Vector de 32 bytes con la clave AES-256.
+     */
+    std::vector<unsigned char> GetAESKey() const;
+
+    /**
+     * @brief Serializa el estado de sesión: clave AES y clave pública del peer.
+     * @param peerPem PEM del peer; las sesiones del servidor la guardan fuera del @ref CryptoHelper.
+     * @return Bytes opacos para @ref ImportSessionState().
+     * @note No incluye ningún par RSA; solo el material simétrico de la sesión y la PEM.
+     * @warning El resultado contiene la clave AES en claro; solo debe viajar por canales locales.
+     */
+    std::vector<unsigned char> ExportSessionState(const std::string& peerPem) const;
+
+    /**
+     * @brief Restaura un estado de sesión producido por @ref ExportSessionState().
+     * @param state Bytes serializados.
+     * @return PEM del peer incluida en el estado (vacía si no había).
+     * @throws std::runtime_error si el formato o la PEM son inválidos.
+     */
+    std::string ImportSessionState(const std::vector<unsigned char>& state);
+
     /**
      * @brief Cifra un mensaje usando AES-256 en modo CBC.
      * @param plaintext Texto plano a cifrar.
-     * @param outIV Vector donde se guardar el IV usado para el cifrado.
+     * @param outIV Vector donde se guardará el IV usado para el cifrado.
      * @return El texto cifrado como vector de bytes.
      * @pre La clave AES debe estar generada o cargada en @ref aesKey.
      * @note El IV es aleatorio en cada cifrado y se devuelve en @p outIV.
@@ -107,8 +179,82 @@ public:
     std::string AESDecrypt(const std::vector<unsigned char>& ciphertext,
         const std::vector<unsigned char>& iv);
 
+    //   Sobres
+    /**
+     * @brief Cifra una clave AES arbitraria con la clave pública del peer.
+     * @param key Clave de 32 bytes.
+     * @return La clave envuelta con RSA-OAEP.
+     * @throws std::runtime_error si no hay clave pública del peer cargada.
+     * @note No modifica el objeto: varios hilos pueden envolver a la vez con peers distintos.
+     */
+    std::vector<unsigned char> WrapKeyForPeer(const std::vector<unsigned char>& key) const;
+
+    /**
+     * @brief Cifra un mensaje una sola vez para varios destinatarios.
+     * @param plaintext Texto plano.
+     * @param recipients Un CryptoHelper por destinatario, con su clave pública cargada.
+     * @return Sobre con el cuerpo y una envoltura por destinatario.
+     * @throws std::runtime_error si a algún destinatario le falta la clave pública.
+     * @note Envuelve en el hilo llamante: una operación RSA pública por destinatario.
+     */
+    static Envelope SealEnvelope(const std::string& plaintext,
+        const std::vector<const CryptoHelper*>& recipients);
+
+    /**
+     * @brief Abre la parte de un sobre dirigida a este extremo.
+     * @param wrap Envoltura propia de la clave de contenido.
+     * @param body Cuerpo cifrado compartido.
+     * @param iv IV del cuerpo (nonce GCM).
+     * @param plaintext Salida: texto plano (vacío si falla).
+     * @return false si la envoltura no es para nuestra clave o el cuerpo no
+     *         supera la etiqueta GCM (alterado o truncado).
+     * @pre Debe haberse generado el par de claves con @ref GenerateRSAKeys().
+     */
+    bool OpenEnvelope(const std::vector<unsigned char>& wrap,
+        const std::vector<unsigned char>& body,
+        const std::vector<unsigned char>& iv,
+        std::string& plaintext) const;
+
+    //   Árbol de claves de grupo (ver RatchetTree.h)
+    /**
+     * @brief Deriva 32 bytes de un secreto con HKDF-SHA256.
+     * @param secret Material de entrada.
+     * @param label Etiqueta que separa usos (p.ej. "path", "node").
+     * @return Secreto derivado de 32 bytes.
+     */
+    static std::vector<unsigned char> DeriveSecret(const std::vector<unsigned char>& secret,
+        const std::string& label);
+
+    /**
+     * @brief Clave pública X25519 de un nodo a partir de su secreto.
+     * @param nodeSecret Clave privada X25519 (32 bytes).
+     * @return Clave pública (32 bytes).
+     * @throws std::runtime_error si OpenSSL no acepta la clave.
+     */
+    static std::vector<unsigned char> NodePublicKey(const std::vector<unsigned char>& nodeSecret);
+
+    /**
+     * @brief Cifra un secreto para el dueño de una clave pública X25519.
+     * @param nodePublic Clave pública del nodo destino.
+     * @param secret Secreto a proteger.
+     * @return `efímera (32) | iv (12) | cifrado | etiqueta (16)` (AES-256-GCM).
+     * @note Una operación X25519 por destinatario, frente al RSA de @ref WrapKeyForPeer().
+     */
+    static std::vector<unsigned char> SealToNode(const std::vector<unsigned char>& nodePublic,
+        const std::vector<unsigned char>& secret);
+
+    /**
+     * @brief Abre un secreto producido por @ref SealToNode().
+     * @param nodeSecret Clave privada X25519 del nodo destino.
+     * @param sealed Bytes sellados.
+     * @return El secreto, o vector vacío si los datos no son para esta clave o la
+     *         etiqueta GCM no es válida (datos alterados).
+     */
+    static std::vector<unsigned char> OpenFromNode(const std::vector<unsigned char>& nodeSecret,
+        const std::vector<unsigned char>& sealed);
+
 private:
-    RSA* rsaKeyPair;             ///< Par de claves RSA propio (privada/pblica).
-    RSA* peerPublicKey;          ///< Clave pblica RSA del peer (remoto).
+    RSA* rsaKeyPair;             ///< Par de claves RSA propio (privada/pública).
+    RSA* peerPublicKey;          ///< Clave pública RSA del peer (remoto).
     unsigned char aesKey[32];    ///< Clave AES-256 (32 bytes).
 };
@@ -0,0 +1,157 @@
+/**
+ * @file Frame.h
+ * @brief Formato de los frames intercambiados tras el handshake.
+ *
+ * @details
+ * Cabecera común: `IV (16) | longitud (4, big-endian)`. Los bits altos de la
+ * longitud son banderas; los 29 bits bajos, el tamaño del payload:
+ *  - **bit 31 (control)**: `IV[0]` indica el @ref Frame::ControlType y el payload
+ *    viaja en claro (identificadores y claves públicas, nunca mensajes), salvo
+ *    en los sobres, cuyo cuerpo y envolturas ya van cifrados.
+ *  - **bit 30 (sellado)**: tras la ruta (si la hay) van `secuencia (4) | envío (8)`,
+ *    el instante de envío en microsegundos del reloj de pared del emisor. El
+ *    receptor mide con él la latencia de un sentido y la de ida y vuelta; el
+ *    servidor lo reenvía intacto (y lo conserva en el eco y en los sobres).
+ *  - **bit 29 (enrutado)**: tras la longitud van `destino (4) | origen (4)`; el
+ *    servidor reenvía el frame al usuario destino sin descifrarlo. Si el bit alto
+ *    del destino está activo (@ref Frame::kRoomAddress) el destino es una sala y
+ *    el frame se reparte, serializado una sola vez, a todos sus miembros.
+ *  - Sin banderas: mensaje cifrado con la clave AES de la sesión con el servidor.
+ *
+ * @code
+ *  | IV (16) | flags+len (4) | [dst (4) | src (4)] | [seq (4) | envío (8)] | payload (len) |
+ * @endcode
+ *
+ * Payload de @ref Frame::Envelope (un mensaje cifrado una vez para varios peers):
+ * @code
+ *  cliente -> servidor:          | iv (16) | n (2) | n x [dst (4) | len (2) | envoltura] | cuerpo |
+ *  servidor -> peer (enrutado):  | iv (16) | len (2) | envoltura | cuerpo |
+ * @endcode
+ * El cuerpo es `cifrado | etiqueta (16)` en AES-256-GCM; el nonce son los 12
+ * primeros bytes de `iv`.
+ *
+ * Mensaje a una sala (enrutado a @ref Frame::kRoomAddress): el payload es
+ * `época (4) | cifrado` con la clave de grupo de esa época (@ref RatchetTree).
+ *
+ * Latido (@ref Frame::Ping / @ref Frame::Pong): frame de control de 28 bytes
+ * sin ruta; cualquiera de los dos extremos lo envía sobre una conexión inactiva.
+ *
+ * Acuse (@ref Frame::Receipt): el receptor de un mensaje sellado de un peer le
+ * devuelve `secuencia (4) | envío (8)` enrutado; el emisor obtiene la latencia
+ * de ida y vuelta con su propio reloj.
+ */
+
+#pragma once
+#include "Prerequisites.h"
+
+/**
+ * @struct FrameHeader
+ * @brief Campos de cabecera leídos sin copiar el payload.
+ */
+struct FrameHeader {
+    uint32_t flags = 0;        ///< Bits de bandera (ver @ref Frame).
+    uint32_t length = 0;       ///< Tamaño del payload.
+    uint32_t dst = 0;          ///< Usuario destino (solo frames enrutados).
+    uint32_t src = 0;          ///< Usuario origen (solo frames enrutados).
+    uint32_t sequence = 0;     ///< Número de mensaje del emisor (solo frames sellados).
+    uint64_t sentAtUs = 0;     ///< Instante de envío en µs (solo frames sellados).
+    size_t headerSize = 0;     ///< Bytes de cabecera (20 a 40).
+    size_t totalSize = 0;      ///< Cabecera + payload.
+};
+
+/**
+ * @struct Frame
+ * @brief Frame completo en memoria, con codificación y decodificación.
+ */
+struct Frame {
+    /// @brief Tipos de frame de control (`IV[0]`).
+    enum ControlType : unsigned char {
+        Register = 1,      ///< Cliente -> servidor: payload = id de usuario (4).
+        Registered = 2,    ///< Servidor -> cliente: payload = id aceptado (4), 0 si estaba ocupado.
+        Lookup = 3,        ///< Cliente -> servidor: payload = id del peer (4).
+        PeerKey = 4,       ///< Servidor -> cliente: payload = id (4) | PEM del peer (vacía si no existe).
+        KeyWrap = 5,       ///< Cliente -> peer (enrutado): clave AES cifrada con la RSA del peer.
+        JoinRoom = 6,      ///< Cliente -> servidor: payload = id de sala (4) | clave pública X25519 de la hoja (32).
+        LeaveRoom = 7,     ///< Cliente -> servidor: payload = id de sala (4).
+        RoomMembers = 8,   ///< Servidor -> cliente: payload = sala (4) | ids de los miembros (4 c/u).
+        RoomEvent = 9,     ///< Servidor -> miembros: payload = sala (4) | usuario (4) | 1 entra / 0 sale (1) | responsable (4) | [clave de hoja (32) si entra].
+        Envelope = 10,     ///< Sobre multi-destinatario (ver abajo).
+        RoomCommit = 11,   ///< Cliente -> sala (enrutado): commit del árbol de claves; el servidor lo reparte también al emisor.
+        RoomWelcome = 12,  ///< Cliente -> peer (enrutado): árbol y secreto para un miembro nuevo; `IV[1..4]` = sala.
+        Ping = 13,         ///< Cualquier sentido: latido; payload = reloj del emisor (8, ver @ref Heartbeat).
+        Pong = 14,         ///< Respuesta a @ref Ping con el mismo payload.
+        Receipt = 15       ///< Receptor -> emisor (enrutado): sello del mensaje recibido, seq (4) | envío (8).
+    };
+
+    static constexpr uint32_t kControlFlag = 0x80000000u;  ///< Bit 31: frame de control.
+    static constexpr uint32_t kStampedFlag = 0x40000000u;  ///< Bit 30: frame sellado.
+    static constexpr uint32_t kRoutedFlag = 0x20000000u;   ///< Bit 29: frame enrutado.
+    static constexpr uint32_t kLengthMask = 0x1FFFFFFFu;   ///< Bits de longitud.
+    static constexpr uint32_t kRoomAddress = 0x80000000u;  ///< Bit alto del destino: sala.
+    static constexpr size_t kIvSize = 16;                  ///< Tamaño del IV.
+    static constexpr size_t kHeaderSize = 20;              ///< IV + longitud.
+    static constexpr size_t kRouteSize = 8;                ///< Destino + origen.
+    static constexpr size_t kStampSize = 12;               ///< Secuencia + instante de envío.
+    static constexpr size_t kMaxHeaderSize = kHeaderSize + kRouteSize + kStampSize; ///< Cabecera más larga.
+    static constexpr uint32_t kMaxPayload = 16u * 1024u * 1024u + 16u; ///< Tope de payload aceptado.
+
+    std::vector<unsigned char> iv = std::vector<unsigned char>(kIvSize, 0); ///< IV (o tipo en control).
+    uint32_t flags = 0;                      ///< Banderas de la cabecera.
+    uint32_t dst = 0;                        ///< Usuario destino (enrutado).
+    uint32_t src = 0;                        ///< Usuario origen (enrutado; lo fija el servidor).
+    uint32_t sequence = 0;                   ///< Número de mensaje (sellado).
+    uint64_t sentAtUs = 0;                   ///< Instante de envío en µs (sellado).
+    std::vector<unsigned char> payload;      ///< Ciphertext o datos de control.
+
+    /// @brief Indica si es un frame de control.
+    bool IsControl() const { return (flags & kControlFlag) != 0; }
+
+    /// @brief Indica si es un frame enrutado.
+    bool IsRouted() const { return (flags & kRoutedFlag) != 0; }
+
+    /// @brief Indica si lleva secuencia e instante de envío.
+    bool IsStamped() const { return (flags & kStampedFlag) != 0; }
+
+    /// @brief Tipo de control (solo si @ref IsControl()).
+    ControlType Type() const { return static_cast<ControlType>(iv[0]); }
+
+    /**
+     * @brief Construye un frame de control.
+     * @param type Tipo de control.
+     * @param payload Datos en claro.
+     */
+    static Frame Control(ControlType type, std::vector<unsigned char> payload);
+
+    /**
+     * @brief Serializa el frame en un único buffer.
+     * @return Bytes listos para enviar.
+     */
+    std::vector<unsigned char> Encode() const;
+
+    /**
+     * @brief Lee la cabecera de un buffer sin copiar el payload.
+     * @param data Bytes recibidos.
+     * @param size Bytes disponibles.
+     * @param out Cabecera decodificada.
+     * @return true si la cabecera está completa (el payload puede no estarlo).
+     */
+    static bool ParseHeader(const unsigned char* data, size_t size, FrameHeader& out);
+
+    /// @brief Bytes de cabecera de un frame con las banderas @p flags.
+    static size_t HeaderSize(uint32_t flags);
+
+    /// @brief Instante actual del reloj de pared en µs, como el de los sellos.
+    static uint64_t NowMicros();
+
+    /// @brief Escribe un entero de 32 bits big-endian.
+    static void PutU32(unsigned char* out, uint32_t value);
+
+    /// @brief Lee un entero de 32 bits big-endian.
+    static uint32_t GetU32(const unsigned char* data);
+
+    /// @brief Escribe un entero de 64 bits big-endian.
+    static void PutU64(unsigned char* out, uint64_t value);
+
+    /// @brief Lee un entero de 64 bits big-endian.
+    static uint64_t GetU64(const unsigned char* data);
+};
@@ -0,0 +1,86 @@
+/**
+ * @file HdrHistogram.h
+ * @brief Histograma de latencias con precisión relativa constante (estilo HdrHistogram).
+ *
+ * @details
+ * Los valores (microsegundos) se agrupan en cubetas log-lineales: los 128
+ * primeros son exactos y, a partir de ahí, cada potencia de dos se divide en
+ * 64 sub-cubetas. El error relativo queda por debajo del 1,6 % desde 1 µs
+ * hasta unas 38 horas, con 2048 contadores fijos:
+ * @code
+ *  v < 128:   índice = v
+ *  v >= 128:  shift tal que v >> shift está en [64, 128)
+ *             índice = 128 + (shift - 1) * 64 + (v >> shift) - 64
+ * @endcode
+ *
+ * Registrar es O(1) sin asignaciones; los percentiles recorren los contadores
+ * al consultarlos. @ref WritePercentiles() escribe la distribución en el
+ * formato de texto de HdrHistogram, el que leen sus herramientas de gráficas.
+ *
+ * @note No es seguro para hilos: quien lo comparte lo protege.
+ */
+
+#pragma once
+#include "Prerequisites.h"
+
+/**
+ * @class HdrHistogram
+ * @brief Distribución de latencias con p50/p99/p99.9/máximo en memoria fija.
+ */
+class HdrHistogram {
+public:
+    static constexpr size_t kExactValues = 128;      ///< Valores con cubeta propia.
+    static constexpr size_t kSubBuckets = 64;        ///< Sub-cubetas por potencia de dos.
+    static constexpr size_t kLevels = 30;            ///< Potencias de dos por encima de las exactas.
+    static constexpr size_t kCounts = kExactValues + kLevels * kSubBuckets; ///< Contadores.
+
+    HdrHistogram();
+
+    /// @brief Registra un valor; los mayores que el rango cuentan en la última cubeta.
+    void Record(uint64_t value);
+
+    /// @brief Suma las muestras de @p other (p.ej. los histogramas de cada hilo).
+    void Add(const HdrHistogram& other);
+
+    /// @brief Descarta todas las muestras.
+    void Reset();
+
+    /// @brief Muestras registradas.
+    uint64_t Count() const { return m_count; }
+
+    /// @brief Valor máximo exacto (0 sin muestras).
+    uint64_t Max() const { return m_max; }
+
+    /// @brief Media exacta (0 sin muestras).
+    double Mean() const { return m_count ? static_cast<double>(m_sum) / m_count : 0.0; }
+
+    /**
+     * @brief Valor por debajo del cual queda el @p percentile % de las muestras.
+     * @param percentile De 0 a 100.
+     * @return Mayor valor equivalente de la cubeta (acotado por @ref Max()).
+     */
+    uint64_t ValueAtPercentile(double percentile) const;
+
+    /**
+     * @brief Escribe la distribución de percentiles en el formato de HdrHistogram.
+     * @param out Destino.
+     * @param unitDivisor Divisor de los valores al escribirlos (1000: µs a ms).
+     */
+    void WritePercentiles(std::ostream& out, double unitDivisor) const;
+
+private:
+    /// @brief Cubeta de @p value.
+    static size_t IndexOf(uint64_t value);
+
+    /// @brief Mayor valor que cae en la cubeta @p index.
+    static uint64_t HighestEquivalent(size_t index);
+
+    /// @brief Valor que se informa para la cubeta @p index (acotado por el máximo).
+    uint64_t ReportedValue(size_t index) const;
+
+private:
+    std::vector<uint64_t> m_counts;                  ///< Muestras por cubeta.
+    uint64_t m_count = 0;                            ///< Total de muestras.
+    uint64_t m_sum = 0;                              ///< Suma exacta (para la media).
+    uint64_t m_max = 0;                              ///< Máximo exacto.
+};
@@ -0,0 +1,91 @@
+/**
+ * @file Heartbeat.h
+ * @brief Latido de aplicación: RTT suavizado, jitter y pings sin respuesta de una conexión.
+ *
+ * @details
+ * El latido usa dos frames de control (@ref Frame::Ping y @ref Frame::Pong)
+ * con un payload opaco de 8 bytes: quien envía el Ping escribe su reloj en
+ * microsegundos y el otro extremo lo devuelve sin tocar en el Pong. Cada lado
+ * mide así el RTT con su propio reloj, sin sincronizarlos.
+ *
+ * Suavizado como el de TCP (RFC 6298):
+ * @code
+ *  jitter = 3/4 jitter + 1/4 |srtt - muestra|
+ *  srtt   = 7/8 srtt   + 1/8 muestra
+ * @endcode
+ *
+ * Solo se hace ping a una conexión que lleva un intervalo sin enviar nada:
+ * cualquier byte recibido cuenta como señal de vida y pone a cero los pings
+ * sin respuesta.
+ *
+ * @note No es seguro para hilos: cada conexión tiene el suyo y lo toca un solo
+ *       hilo (o quien lo use lo protege).
+ */
+
+#pragma once
+#include "Prerequisites.h"
+
+/**
+ * @class Heartbeat
+ * @brief Estado del latido de una conexión.
+ *
+ * @par Flujo típico de uso:
+ *  1. `OnHeard(now)` con cada lectura de la conexión.
+ *  2. Al vencer el intervalo, si `Silence(now)` lo supera: enviar `PingPayload(now)` y `OnPingSent()`.
+ *  3. `OnPong(payload, size, now)` al recibir el Pong.
+ *  4. Cerrar la conexión cuando `Missed()` alcance el máximo.
+ */
+class Heartbeat {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief Tamaño del payload de Ping y Pong (reloj del emisor en µs, big-endian).
+    static constexpr size_t kPayloadSize = 8;
+
+    /// @brief Crea el estado de una conexión que acaba de dar señales de vida.
+    explicit Heartbeat(Clock::time_point now = Clock::now()) : m_lastHeard(now) {}
+
+    /**
+     * @brief Payload de un Ping.
+     * @param now Reloj del emisor.
+     */
+    static std::vector<unsigned char> PingPayload(Clock::time_point now);
+
+    /// @brief Registra tráfico del peer: es la prueba de vida, no hace falta el Pong.
+    void OnHeard(Clock::time_point now) { m_lastHeard = now; m_missed = 0; }
+
+    /// @brief Cuenta un Ping enviado aún sin respuesta.
+    void OnPingSent() { m_missed++; }
+
+    /**
+     * @brief Incorpora la muestra de RTT de un Pong.
+     * @param payload Payload del Pong (el de nuestro Ping).
+     * @param size Bytes del payload.
+     * @param now Reloj de recepción.
+     * @return false si el payload no es un Ping nuestro plausible (se ignora).
+     */
+    bool OnPong(const unsigned char* payload, size_t size, Clock::time_point now);
+
+    /// @brief Tiempo desde la última señal de vida.
+    std::chrono::milliseconds Silence(Clock::time_point now) const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(now - m_lastHeard);
+    }
+
+    /// @brief Pings consecutivos sin tráfico de vuelta.
+    uint32_t Missed() const { return m_missed; }
+
+    /// @brief Indica si ya hay alguna muestra de RTT.
+    bool HasSample() const { return m_srttUs != 0; }
+
+    /// @brief RTT suavizado (cero sin muestras).
+    std::chrono::microseconds SmoothedRtt() const { return std::chrono::microseconds(m_srttUs); }
+
+    /// @brief Variación media del RTT (cero sin muestras).
+    std::chrono::microseconds Jitter() const { return std::chrono::microseconds(m_jitterUs); }
+
+private:
+    Clock::time_point m_lastHeard;                   ///< Último tráfico recibido.
+    uint32_t m_srttUs = 0;                           ///< RTT suavizado en µs.
+    uint32_t m_jitterUs = 0;                         ///< Variación del RTT en µs.
+    uint32_t m_missed = 0;                           ///< Pings sin respuesta.
+};
@@ -0,0 +1,105 @@
+/**
+ * @file LiveUpgrade.h
+ * @brief Traspaso en caliente de sockets y sesiones a un nuevo proceso servidor.
+ *
+ * @details
+ * Permite reiniciar el servidor sin cortar los chats activos:
+ *  - El proceso actual escucha en un socket AF_UNIX de actualización.
+ *  - El nuevo binario se conecta, envía su PID y recibe los listeners y
+ *    las sesiones duplicados con `WSADuplicateSocketW` (equivalente Winsock
+ *    de `SCM_RIGHTS`).
+ *  - Cada sesión viaja con su estado serializado: clave AES, clave pública
+ *    del peer, contadores de mensajes y bytes pendientes de recepción/envío.
+ *  - Las salas viajan con su época y la antigüedad de sus miembros, para que
+ *    los commits del árbol de claves sigan siendo válidos tras el traspaso.
+ *  - Al recibir la confirmación, el proceso anterior cierra sus copias y termina.
+ *
+ *  - También viaja la identidad RSA del servidor: las sesiones a medio
+ *    handshake ya recibieron su PEM pública y lo completan con el sucesor.
+ *
+ * @warning El canal transporta claves AES y la clave privada RSA en claro; la
+ *          ruta debe ser accesible solo para el usuario del servicio.
+ */
+
+#pragma once
+#include "NetworkHelper.h"
+#include "RoomDirectory.h"
+#include "Session.h"
+#include "Prerequisites.h"
+
+/**
+ * @class LiveUpgrade
+ * @brief Canal local entre el proceso servidor saliente y el entrante.
+ *
+ * @par Proceso saliente:
+ *  1. `Listen(path)`.
+ *  2. `WaitForSuccessor(pid)` devuelve el canal cuando el nuevo proceso se conecta.
+ *  3. `SendHandoff(...)` tras pausar los shards.
+ *
+ * @par Proceso entrante:
+ *  1. `ReceiveHandoff(path, handoff)` antes de arrancar sus shards.
+ */
+class LiveUpgrade {
+public:
+    /// @brief Sockets y sesiones recibidos por el proceso entrante.
+    struct Handoff {
+        std::vector<SOCKET> listeners;                  ///< Listeners duplicados.
+        std::vector<std::unique_ptr<Session>> sessions; ///< Sesiones (establecidas o en handshake).
+        std::vector<RoomState> rooms;                   ///< Época y antigüedad de cada sala.
+        std::vector<unsigned char> identity;            ///< Clave privada DER; vacía si el saliente no la envió.
+    };
+
+    /// @brief Constructor: sin socket de actualización abierto.
+    LiveUpgrade() = default;
+
+    /// @brief Destructor: cierra el socket de actualización si sigue abierto.
+    ~LiveUpgrade();
+
+    /**
+     * @brief Abre el socket AF_UNIX donde el sucesor se conectará.
+     * @param path Ruta del socket de actualización.
+     * @return true si quedó en escucha.
+     */
+    bool Listen(const std::string& path);
+
+    /**
+     * @brief Espera a que un proceso sucesor se conecte y se identifique.
+     * @param pid Salida: PID del proceso sucesor.
+     * @return Canal conectado, o INVALID_SOCKET si el socket se cerró, el saludo
+     *         es inválido o el peer no lo envió a tiempo.
+     * @warning Bloqueante hasta la conexión; @ref Close() desde otro hilo lo interrumpe.
+     */
+    SOCKET WaitForSuccessor(DWORD& pid);
+
+    /**
+     * @brief Duplica los sockets para @p pid y envía el estado de las sesiones.
+     * @param channel Canal devuelto por @ref WaitForSuccessor().
+     * @param pid PID del proceso sucesor.
+     * @param listeners Listeners a transferir.
+     * @param sessions Sesiones a transferir.
+     * @param rooms Estado de las salas (@ref RoomDirectory::Export).
+     * @param identity Clave privada del servidor (@ref ServerIdentity::ExportPrivateKey).
+     * @return true si el sucesor confirmó la recepción; el llamador debe entonces
+     *         cerrar sus propias copias de los sockets.
+     */
+    bool SendHandoff(SOCKET channel, DWORD pid,
+        const std::vector<SOCKET>& listeners,
+        const std::vector<std::unique_ptr<Session>>& sessions,
+        const std::vector<RoomState>& rooms,
+        const std::vector<unsigned char>& identity);
+
+    /**
+     * @brief Se conecta al proceso saliente y recibe sus sockets y sesiones.
+     * @param path Ruta del socket de actualización del proceso saliente.
+     * @param out Salida con listeners, sesiones, salas e identidad listos para adoptar.
+     * @return true si el traspaso fue completo y confirmado.
+     */
+    bool ReceiveHandoff(const std::string& path, Handoff& out);
+
+    /// @brief Cierra el socket de actualización (no borra la ruta: puede ser del sucesor).
+    void Close();
+
+private:
+    NetworkHelper m_net;                      ///< Envío/recepción exactos y AF_UNIX.
+    std::atomic<SOCKET> m_listenSock{ INVALID_SOCKET }; ///< Socket de actualización (lo cierra otro hilo).
+};
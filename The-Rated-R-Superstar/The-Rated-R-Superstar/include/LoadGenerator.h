@@ -0,0 +1,194 @@
+/**
+ * @file LoadGenerator.h
+ * @brief Generador de carga: muchas sesiones cifradas concurrentes contra un servidor.
+ *
+ * @details
+ * Pensado para dimensionar un servidor o un relay antes de desplegarlo:
+ *  1. Cada hilo abre sus sesiones con el mismo handshake que @ref Client
+ *     (PEM del servidor, PEM propia, clave AES envuelta con RSA). Todas
+ *     comparten un único par RSA del cliente: generar uno por sesión costaría
+ *     más que la propia prueba.
+ *  2. Cuando todas están abiertas, cada sesión envía mensajes sellados
+ *     (@ref Frame::kStampedFlag) al ritmo y con el patrón pedidos:
+ *     - `fixed`: intervalo constante.
+ *     - `bursty`: ráfagas seguidas con el mismo ritmo medio.
+ *     - `poisson`: llegadas independientes (intervalos exponenciales).
+ *  3. Sin relay mide la ida y vuelta con el eco del servidor. Con relay cada
+ *     sesión escribe a la siguiente; el receptor registra la latencia de un
+ *     sentido y, con `echo`, devuelve un acuse para medir la ida y vuelta.
+ *
+ * Cada hilo atiende sus sesiones con WSAPoll, sin un hilo por conexión. Al
+ * terminar se informa del ritmo de handshakes, el caudal y los percentiles de
+ * latencia (@ref HdrHistogram).
+ *
+ * Con @ref LoadOptions::storm se ejecuta en cambio una tormenta de handshakes
+ * (@ref RunStorm): simula la reconexión masiva tras un corte de red. Para cada
+ * nivel de concurrencia se lanzan todos los handshakes a la vez y cada uno
+ * que termina se reemplaza por otro nuevo durante @ref LoadOptions::duration.
+ * Se informa del ritmo sostenido (total y por núcleo del servidor), del tiempo
+ * que tarda en completarse la primera oleada y de los síntomas de una cola de
+ * accept desbordada: conexiones rechazadas y connects que necesitaron
+ * reintentar el SYN.
+ *
+ * Con @ref LoadOptions::replay se reproduce una captura (@ref TrafficCapture)
+ * con @ref RunReplay: una sesión por cada sesión capturada, con el mismo id de
+ * relay, y cada mensaje que el cliente envió, del mismo tamaño cifrado y al
+ * mismo instante (a 1x, Nx o sin esperas). Así dos builds del servidor se
+ * comparan con la misma entrada.
+ *
+ * @note La latencia se mide desde el envío real: si el generador se atrasa,
+ *       los mensajes que no llegó a enviar a tiempo no cuentan como espera.
+ */
+
+#pragma once
+#include "NetworkHelper.h"
+#include "CryptoHelper.h"
+#include "HdrHistogram.h"
+#include "TrafficCapture.h"
+#include "Logger.h"
+#include "Prerequisites.h"
+#include <atomic>
+#include <condition_variable>
+
+/// @brief Patrón de llegada de los mensajes de cada sesión.
+enum class LoadPattern {
+    Fixed,                                           ///< Intervalo constante.
+    Bursty,                                          ///< Ráfagas con el mismo ritmo medio.
+    Poisson                                          ///< Intervalos exponenciales.
+};
+
+/**
+ * @struct LoadOptions
+ * @brief Parámetros de una prueba de carga.
+ */
+struct LoadOptions {
+    std::string host = "127.0.0.1";                  ///< Servidor (IP, nombre o `unix:<ruta>`).
+    int port = 12345;                                ///< Puerto TCP.
+    size_t connections = 100;                        ///< Sesiones concurrentes.
+    size_t threads = 0;                              ///< Hilos del generador (0: uno por núcleo).
+    double rate = 1000.0;                            ///< Mensajes por segundo entre todas las sesiones.
+    LoadPattern pattern = LoadPattern::Fixed;        ///< Patrón de llegada.
+    size_t burst = 10;                               ///< Mensajes por ráfaga (patrón `bursty`).
+    size_t minSize = 256;                            ///< Tamaño mínimo del texto plano.
+    size_t maxSize = 256;                            ///< Tamaño máximo (uniforme entre ambos).
+    std::chrono::seconds duration{ 10 };             ///< Duración del envío.
+    bool relay = false;                              ///< Registrar usuarios y enrutar entre sesiones.
+    bool echo = false;                               ///< Con relay: el receptor acusa cada mensaje.
+    uint32_t userBase = 100000;                      ///< Primer id de usuario en el relay.
+    std::string histogramPrefix;                     ///< Si no está vacío: distribuciones en `<prefijo>-*.hgrm`.
+    std::vector<size_t> storm;                       ///< Si no está vacío: niveles de la tormenta de handshakes.
+    size_t serverCores = 0;                          ///< Núcleos del servidor para el ritmo por núcleo (0: los de esta máquina).
+    std::string replay;                              ///< Si no está vacío: captura a reproducir.
+    double speed = 1.0;                              ///< Reproducción: factor de velocidad (0: sin esperas).
+};
+
+/**
+ * @class LoadGenerator
+ * @brief Ejecuta una prueba de carga y publica sus resultados en el registro.
+ */
+class LoadGenerator {
+public:
+    explicit LoadGenerator(const LoadOptions& options);
+
+    /**
+     * @brief Abre las sesiones, envía durante @ref LoadOptions::duration e informa.
+     * @return false si no se pudo abrir ninguna sesión.
+     */
+    bool Run();
+
+    /**
+     * @brief Tormenta de handshakes: un nivel de concurrencia tras otro.
+     * @return false si ningún nivel completó un handshake.
+     * @pre Servidor TCP: sharded (eco) o, con @ref LoadOptions::relay, relay.
+     */
+    bool RunStorm();
+
+    /**
+     * @brief Reproduce la captura @ref LoadOptions::replay y mide como @ref Run().
+     * @return false si la captura no se pudo leer o no se pudo abrir ninguna sesión.
+     * @note Se reproducen los mensajes y el registro en el relay; el resto del
+     *       control (claves de peers, salas, sobres) necesita claves que la
+     *       captura no guarda y se omite. Los mensajes van siempre sellados.
+     */
+    bool RunReplay();
+
+    /// @brief Interpreta `fixed`, `bursty` o `poisson`.
+    static bool ParsePattern(const std::string& name, LoadPattern& pattern);
+
+private:
+    /// @brief Resultados de un hilo; se suman al terminar.
+    struct WorkerStats {
+        uint64_t established = 0;                    ///< Handshakes completados.
+        uint64_t failed = 0;                         ///< Handshakes fallidos.
+        uint64_t sent = 0;                           ///< Mensajes enviados.
+        uint64_t received = 0;                       ///< Mensajes (o ecos) recibidos.
+        uint64_t bytesSent = 0;                      ///< Bytes de texto plano enviados.
+        uint64_t disconnected = 0;                   ///< Sesiones cerradas por el servidor.
+        HdrHistogram handshake;                      ///< Latencia del handshake (µs).
+        HdrHistogram roundTrip;                      ///< Ida y vuelta (µs).
+        HdrHistogram oneWay;                         ///< Un sentido, solo con relay (µs).
+        std::chrono::steady_clock::time_point lastSend; ///< Reproducción: último envío del hilo.
+    };
+
+    /// @brief Reproducción: lo que una sesión capturada envió al servidor.
+    struct ReplayScript {
+        uint32_t userId = 0;                         ///< Id registrado en el relay (0: ninguno).
+        std::vector<CapturedFrame> frames;           ///< Mensajes, en orden.
+    };
+
+    /// @brief Resultados de un hilo en un nivel de la tormenta.
+    struct StormStats {
+        uint64_t completed = 0;                      ///< Handshakes completos.
+        uint64_t refused = 0;                        ///< Connects rechazados o fallidos.
+        uint64_t reset = 0;                          ///< Conexiones cortadas a medio handshake.
+        uint64_t rejected = 0;                       ///< Respuestas inválidas (PEM, registro).
+        uint64_t timedOut = 0;                       ///< Handshakes que superaron el tope.
+        uint64_t slowConnects = 0;                   ///< Connects con SYN reintentado.
+        HdrHistogram connect;                        ///< Duración del connect (µs).
+        HdrHistogram handshake;                      ///< Duración del handshake completo (µs).
+    };
+
+    /// @brief Comprueba que el destino sea un socket que WSAPoll pueda vigilar.
+    bool CheckHost() const;
+
+    /// @brief Hilos del generador para @ref LoadOptions::connections sesiones.
+    size_t WorkerCount() const;
+
+    /// @brief Lanza los hilos de sesiones, suma sus resultados e informa.
+    bool RunSessions();
+
+    /// @brief Cuerpo de cada hilo: sesiones [first, first + count).
+    void RunWorker(size_t worker, size_t first, size_t count, WorkerStats& stats);
+
+    /// @brief Espera a que todos los hilos hayan abierto sus sesiones.
+    void WaitForHandshakes();
+
+    /// @brief Cuerpo de cada hilo de la tormenta: @p count handshakes en vuelo hasta @p end.
+    void RunStormWorker(size_t count, size_t level, std::chrono::steady_clock::time_point end, StormStats& stats);
+
+    /// @brief Informe de un nivel de la tormenta.
+    void ReportStorm(size_t level, const StormStats& total, std::chrono::duration<double> elapsed);
+
+    /// @brief Informe final en el registro y, si se pidió, distribuciones a archivo.
+    void Report(const WorkerStats& total, std::chrono::duration<double> handshakeTime,
+        std::chrono::duration<double> sendTime);
+
+private:
+    LoadOptions m_options;                           ///< Parámetros de la prueba.
+    CryptoHelper m_identity;                         ///< Par RSA compartido por todas las sesiones.
+    std::string m_identityPem;                       ///< Su clave pública, serializada una vez.
+
+    std::mutex m_barrierMutex;                       ///< Protege @ref m_pendingWorkers.
+    std::condition_variable m_barrier;               ///< Avisa cuando todos terminaron sus handshakes.
+    size_t m_pendingWorkers = 0;                     ///< Hilos aún abriendo sesiones.
+    std::chrono::steady_clock::time_point m_sendStart; ///< Inicio común del envío.
+    std::chrono::steady_clock::time_point m_sendEnd; ///< Fin común del envío.
+
+    AddressResolver::Endpoint m_endpoint{};          ///< Tormenta: dirección resuelta una sola vez.
+    std::atomic<uint32_t> m_nextUser{ 0 };           ///< Tormenta con relay: ids sin repetir.
+    std::atomic<uint64_t> m_stormCompleted{ 0 };     ///< Handshakes completos del nivel en curso.
+    std::atomic<int64_t> m_stormWaveUs{ -1 };        ///< Duración de la primera oleada (-1: incompleta).
+
+    std::vector<ReplayScript> m_scripts;             ///< Reproducción: una entrada por sesión capturada.
+    uint64_t m_replayBase = 0;                       ///< Reproducción: instante del primer mensaje.
+};
@@ -0,0 +1,365 @@
+/**
+ * @file Logger.h
+ * @brief Registro asíncrono: anillos sin bloqueo por hilo y formato fuera del camino caliente.
+ *
+ * @details
+ * Quien registra no escribe en la consola: copia un registro binario en el
+ * anillo de su propio hilo y sigue. Un hilo del logger recorre los anillos,
+ * formatea y escribe en el destino (consola o archivo).
+ *
+ * Un registro es:
+ * @code
+ *  cabecera (tamaño, nivel, nº de argumentos, instante, formato) | argumentos
+ * @endcode
+ * El formato es un literal (se guarda el puntero) con `{}` por cada argumento;
+ * los argumentos van en binario: enteros y reales en 8 bytes, textos con su
+ * longitud. Así el hilo que registra no formatea ni reserva memoria.
+ *
+ * Cada anillo tiene un único escritor (su hilo) y un único lector (el hilo
+ * del logger): bastan dos índices atómicos, sin mutex. Si el anillo está
+ * lleno el registro se descarta y se cuenta; nunca se espera al lector.
+ *
+ * @code
+ *  Logger::Info("[Client] Registrado como usuario {}.\n", m_userId);
+ *  Logger::Warn("[Shard {}] Frame demasiado grande: {}\n", m_index, header.length);
+ * @endcode
+ *
+ * @note En consola el texto sale tal cual; en archivo cada registro es una
+ *       línea con instante, nivel e hilo.
+ * @note El texto del chat no es diagnóstico: va por @ref Logger::Print, sin
+ *       nivel, truncado ni descartes. Se encola para un hilo de consola
+ *       propio: quien imprime tampoco espera a la terminal.
+ */
+
+#pragma once
+#include "Metrics.h"
+#include "Prerequisites.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <string_view>
+#include <type_traits>
+
+/// @brief Gravedad de un registro; se descartan los inferiores al nivel configurado.
+enum class LogLevel : uint8_t {
+    Debug = 0,
+    Info,
+    Warn,
+    Error,
+    Off                                              ///< Solo como nivel configurado: nada se registra.
+};
+
+/// @brief Cabecera de cada registro en el anillo.
+struct LogRecordHeader {
+    uint32_t size;                                   ///< Bytes del registro, cabecera incluida (múltiplo de 8).
+    uint8_t level;                                   ///< @ref LogLevel.
+    uint8_t argCount;                                ///< Argumentos codificados tras la cabecera.
+    uint16_t reserved;                               ///< Relleno.
+    int64_t timeUs;                                  ///< Instante (reloj del sistema, µs desde la época).
+    const char* format;                              ///< Literal con un `{}` por argumento.
+};
+
+namespace LogDetail {
+    /// @brief Etiqueta de cada argumento codificado.
+    enum ArgType : uint8_t { kSigned = 1, kUnsigned, kReal, kText };
+
+    /// @brief Longitud máxima de un texto; lo demás se trunca.
+    constexpr size_t kMaxText = 16 * 1024;
+
+    /// @brief Bytes que ocupa @p value codificado.
+    template <typename T>
+    size_t EncodedSize(const T& value) {
+        if constexpr (std::is_arithmetic_v<T>) return 1 + 8;
+        else return 1 + 4 + std::min(std::string_view(value).size(), kMaxText);
+    }
+
+    /// @brief Codifica @p value en @p out y devuelve el final.
+    template <typename T>
+    unsigned char* Encode(unsigned char* out, const T& value) {
+        if constexpr (std::is_floating_point_v<T>) {
+            double real = static_cast<double>(value);
+            *out = kReal;
+            std::memcpy(out + 1, &real, 8);
+            return out + 9;
+        }
+        else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+            int64_t integer = static_cast<int64_t>(value);
+            *out = kSigned;
+            std::memcpy(out + 1, &integer, 8);
+            return out + 9;
+        }
+        else if constexpr (std::is_integral_v<T>) {
+            uint64_t integer = static_cast<uint64_t>(value);
+            *out = kUnsigned;
+            std::memcpy(out + 1, &integer, 8);
+            return out + 9;
+        }
+        else {
+            std::string_view text(value);
+            uint32_t length = static_cast<uint32_t>(std::min(text.size(), kMaxText));
+            *out = kText;
+            std::memcpy(out + 1, &length, 4);
+            std::memcpy(out + 5, text.data(), length);
+            return out + 5 + length;
+        }
+    }
+
+    /// @brief Añade @p value a @p out con el mismo texto que daría un registro, sin truncar.
+    template <typename T>
+    void Append(std::string& out, const T& value) {
+        if constexpr (std::is_floating_point_v<T>) {
+            char number[32];
+            std::snprintf(number, sizeof(number), "%g", static_cast<double>(value));
+            out += number;
+        }
+        else if constexpr (std::is_arithmetic_v<T>) {
+            out += std::to_string(value);
+        }
+        else {
+            out += std::string_view(value);
+        }
+    }
+}
+
+/**
+ * @class LogRing
+ * @brief Anillo de bytes de un productor y un consumidor para los registros de un hilo.
+ *
+ * @details
+ * Los índices crecen sin volver a cero y se reducen con una máscara. Un
+ * registro nunca se parte: si no cabe hasta el final del búfer se deja un
+ * relleno y se escribe desde el principio.
+ */
+class LogRing {
+public:
+    static constexpr size_t kCapacity = 64 * 1024;   ///< Bytes del búfer (potencia de dos).
+
+    /**
+     * @brief Reserva @p size bytes contiguos (productor).
+     * @return Destino del registro, o nullptr si el anillo está lleno.
+     */
+    unsigned char* Reserve(size_t size);
+
+    /// @brief Publica lo reservado en el último @ref Reserve (productor).
+    void Commit() { m_head.store(m_reservedHead, std::memory_order_release); }
+
+    /// @brief Cuenta un registro descartado por falta de espacio (productor).
+    void Drop() { m_dropped.store(m_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+
+    /// @brief Registro más antiguo sin leer, o nullptr (consumidor).
+    const unsigned char* Peek();
+
+    /// @brief Libera el registro devuelto por @ref Peek (consumidor).
+    void Release(size_t size) { m_tail.store(m_tail.load(std::memory_order_relaxed) + size, std::memory_order_release); }
+
+    /// @brief true si no quedan registros por leer.
+    bool IsEmpty() const { return m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_acquire); }
+
+    /// @brief Registros descartados desde la creación.
+    uint64_t GetDroppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    /// @brief Marca el anillo de un hilo que terminó; el logger lo retira al vaciarlo.
+    void Retire() { m_retired.store(true, std::memory_order_release); }
+
+    /// @brief true si su hilo ya terminó.
+    bool IsRetired() const { return m_retired.load(std::memory_order_acquire); }
+
+    uint32_t ordinal = 0;                            ///< Número del hilo en los registros de archivo.
+
+private:
+    alignas(kCacheLineSize) std::atomic<size_t> m_head{ 0 };  ///< Bytes publicados (productor).
+    size_t m_reservedHead = 0;                       ///< Cabeza tras la reserva en curso (productor).
+    std::atomic<uint64_t> m_dropped{ 0 };            ///< Registros descartados (productor).
+    alignas(kCacheLineSize) std::atomic<size_t> m_tail{ 0 };  ///< Bytes leídos (consumidor).
+    std::atomic<bool> m_retired{ false };            ///< El hilo dueño terminó.
+    alignas(kCacheLineSize) unsigned char m_data[kCapacity];  ///< Registros.
+};
+
+/**
+ * @class Logger
+ * @brief Registro asíncrono del proceso.
+ *
+ * @par Flujo típico de uso:
+ *  1. Opcional: `SetLevel(...)` y `OpenFile(ruta)` al arrancar.
+ *  2. `Logger::Info(...)`, `Logger::Warn(...)`, etc. desde cualquier hilo.
+ *  3. `Stop()` antes de salir para vaciar lo pendiente.
+ */
+class Logger {
+public:
+    /// @brief Instancia única; el hilo del logger arranca con el primer registro.
+    static Logger& Instance();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    /// @brief Nivel mínimo que se registra (por defecto Info).
+    void SetLevel(LogLevel level) { m_level.store(level, std::memory_order_relaxed); }
+
+    /// @brief true si un registro de @p level se guardaría.
+    bool IsEnabled(LogLevel level) const { return level >= m_level.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Interpreta `debug`, `info`, `warn`, `error` u `off`.
+     * @return false si @p name no es un nivel.
+     */
+    static bool ParseLevel(const std::string& name, LogLevel& level);
+
+    /**
+     * @brief Envía los registros a un archivo (añadiendo) en lugar de la consola.
+     * @return false si no se pudo abrir.
+     */
+    bool OpenFile(const std::string& path);
+
+    /// @brief Vacía los anillos y detiene el hilo; lo que se registre después se escribe directamente.
+    void Stop();
+
+    /// @brief Registros descartados por anillos llenos, sumando todos los hilos.
+    uint64_t GetDroppedCount();
+
+    template <size_t N, typename... Args>
+    static void Debug(const char (&format)[N], const Args&... args) { Instance().Write(LogLevel::Debug, format, args...); }
+
+    template <size_t N, typename... Args>
+    static void Info(const char (&format)[N], const Args&... args) { Instance().Write(LogLevel::Info, format, args...); }
+
+    template <size_t N, typename... Args>
+    static void Warn(const char (&format)[N], const Args&... args) { Instance().Write(LogLevel::Warn, format, args...); }
+
+    template <size_t N, typename... Args>
+    static void Error(const char (&format)[N], const Args&... args) { Instance().Write(LogLevel::Error, format, args...); }
+
+    /**
+     * @brief Encola texto para la consola, sin pasar por el anillo.
+     * @details Para lo que lee el usuario (mensajes del chat y su prompt): no
+     *          depende del nivel ni del archivo de registro, no se trunca y no
+     *          se descarta. El hilo de consola lo escribe y vacía; el llamante
+     *          solo toma el mutex de la cola. Mismo formato `{}` que los registros.
+     */
+    template <size_t N, typename... Args>
+    static void Print(const char (&format)[N], const Args&... args) {
+        std::string text;
+        const char* rest = format;
+        auto next = [&](const auto& value) {
+            const char* slot = std::strstr(rest, "{}");
+            if (!slot) return;
+            text.append(rest, slot);
+            LogDetail::Append(text, value);
+            rest = slot + 2;
+        };
+        (next(args), ...);
+        text += rest;
+        Instance().EnqueueConsole(std::move(text));
+    }
+
+    /**
+     * @brief Copia un registro en el anillo del hilo llamante.
+     * @param format Literal con un `{}` por argumento; debe vivir todo el proceso.
+     * @param args Enteros, reales o textos (`std::string`, `const char*`).
+     */
+    template <typename... Args>
+    void Write(LogLevel level, const char* format, const Args&... args);
+
+private:
+    Logger() = default;
+
+    /// @brief Destructor: vacía lo pendiente.
+    ~Logger();
+
+    /// @brief Anillo del hilo llamante; lo crea y registra la primera vez.
+    LogRing* ThreadRing();
+
+    /// @brief Despierta al hilo del logger si está esperando.
+    void Wake();
+
+    /// @brief Añade @p text a la cola de la consola; tras Stop() lo escribe directamente.
+    void EnqueueConsole(std::string text);
+
+    /// @brief Bucle del hilo de consola: escribe y vacía lo encolado por @ref Print.
+    void RunConsole();
+
+    /// @brief Escribe @p text en la consola y la vacía, sin mezclarse con un registro.
+    void WriteConsole(const std::string& text);
+
+    /// @brief Formatea y escribe un registro desde el hilo llamante (tras Stop()).
+    void WriteDirect(const unsigned char* record);
+
+    /// @brief Bucle del hilo del logger.
+    void Run();
+
+    /// @brief Formatea y escribe lo pendiente de todos los anillos; true si había algo.
+    bool Drain();
+
+    /// @brief Sustituye cada `{}` de la cabecera por su argumento.
+    static std::string Format(const LogRecordHeader& header, const unsigned char* args);
+
+    /// @brief Escribe un registro ya formateado en el destino.
+    void Emit(const LogRecordHeader& header, uint32_t thread, const std::string& text);
+
+private:
+    std::atomic<LogLevel> m_level{ LogLevel::Info };  ///< Nivel mínimo.
+    std::atomic<bool> m_running{ false };            ///< Hilo del logger activo.
+    std::atomic<bool> m_stopped{ false };            ///< Tras Stop(): escritura directa.
+    std::atomic<bool> m_idle{ false };               ///< El hilo del logger espera registros.
+
+    std::mutex m_ringsMutex;                         ///< Alta y baja de anillos (no en el camino caliente).
+    std::vector<std::shared_ptr<LogRing>> m_rings;   ///< Anillos de los hilos que han registrado.
+    uint32_t m_nextOrdinal = 0;                      ///< Número del próximo hilo.
+    std::thread m_thread;                            ///< Hilo que formatea y escribe.
+
+    std::mutex m_wakeMutex;                          ///< Espera del hilo del logger.
+    std::condition_variable m_wakeCv;                ///< Aviso de registros nuevos.
+
+    std::mutex m_consoleMutex;                       ///< Cola de la consola (solo encolar y recoger).
+    std::condition_variable m_consoleCv;             ///< Texto nuevo o parada.
+    std::vector<std::string> m_consoleQueue;         ///< Texto de @ref Print pendiente, en orden.
+    bool m_consoleStopping = false;                  ///< Stop() pidió terminar al hilo de consola.
+    std::thread m_consoleThread;                     ///< Hilo que escribe la cola en la consola.
+
+    std::mutex m_sinkMutex;                          ///< Destino (hilo del logger o escritura directa tras Stop()).
+    std::ofstream m_file;                            ///< Archivo de registro; cerrado: consola.
+    uint64_t m_reportedDrops = 0;                    ///< Descartes ya avisados.
+};
+
+template <typename... Args>
+void
+Logger::Write(LogLevel level, const char* format, const Args&... args) {
+    if (!IsEnabled(level)) return;
+
+    LogRecordHeader header{};
+    header.level = static_cast<uint8_t>(level);
+    header.argCount = static_cast<uint8_t>(sizeof...(Args));
+    header.timeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    header.format = format;
+    size_t size = sizeof(LogRecordHeader) + (size_t(0) + ... + LogDetail::EncodedSize(args));
+    header.size = static_cast<uint32_t>((size + 7) & ~size_t(7));
+
+    // Tras Stop() no hay hilo que lea el anillo: se escribe en el momento
+    std::vector<unsigned char> direct;
+    LogRing* ring = nullptr;
+    unsigned char* out = nullptr;
+    if (m_stopped.load(std::memory_order_acquire)) {
+        direct.resize(header.size);
+        out = direct.data();
+    }
+    else {
+        ring = ThreadRing();
+        out = ring->Reserve(header.size);
+        if (!out) {
+            ring->Drop();
+            return;
+        }
+    }
+    std::memcpy(out, &header, sizeof(header));
+    unsigned char* cursor = out + sizeof(header);
+    ((cursor = LogDetail::Encode(cursor, args)), ...);
+    (void)cursor;
+    if (ring) {
+        ring->Commit();
+        Wake();
+    }
+    else {
+        WriteDirect(out);
+    }
+}
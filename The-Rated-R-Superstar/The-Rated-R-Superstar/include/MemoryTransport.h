@@ -0,0 +1,103 @@
+/**
+ * @file MemoryTransport.h
+ * @brief Transporte dentro del mismo proceso sobre tuberías de bytes en memoria.
+ *
+ * @details
+ * Dos tuberías acotadas, una por sentido, protegidas por mutex y variable de
+ * condición. Permite ejecutar @ref Client y @ref Server en un solo proceso sin
+ * pasar por la pila de red del sistema: las pruebas son reproducibles y los
+ * benchmarks miden el coste del protocolo y del cifrado, no el del kernel.
+ *
+ * Se selecciona con la dirección `mem:<nombre>` en @ref NetworkHelper: el
+ * servidor publica un @ref MemoryListener con ese nombre y cada
+ * `ConnectToServer("mem:<nombre>")` le entrega un extremo nuevo. A diferencia
+ * de `shm:`, un mismo nombre admite cualquier número de conexiones.
+ *
+ * @note Solo sirve dentro del proceso: los nombres no son visibles desde fuera.
+ */
+
+#pragma once
+#include "Transport.h"
+#include "Prerequisites.h"
+#include <condition_variable>
+#include <deque>
+
+/**
+ * @class MemoryTransport
+ * @brief Extremo de una conexión en memoria.
+ */
+class MemoryTransport : public Transport {
+public:
+    static constexpr size_t kDefaultCapacity = 256 * 1024; ///< Bytes en vuelo por sentido.
+
+    /**
+     * @brief Crea los dos extremos de una conexión.
+     * @param capacity Bytes que admite cada sentido antes de bloquear al emisor.
+     * @return Par de extremos conectados entre sí.
+     */
+    static std::pair<std::shared_ptr<MemoryTransport>, std::shared_ptr<MemoryTransport>>
+        CreatePair(size_t capacity = kDefaultCapacity);
+
+    /**
+     * @brief Conecta con el @ref MemoryListener publicado con @p name.
+     * @return Extremo del cliente, o nullptr si no hay nadie escuchando.
+     */
+    static std::shared_ptr<MemoryTransport> Connect(const std::string& name);
+
+    /// @brief Destructor: cierra ambos sentidos.
+    ~MemoryTransport() override;
+
+    int Send(const unsigned char* data, int len) override;
+    int Receive(unsigned char* out, int len) override;
+    void Close() override;
+
+private:
+    struct Pipe;
+
+    /// @brief Construye un extremo que escribe en @p tx y lee de @p rx.
+    MemoryTransport(std::shared_ptr<Pipe> tx, std::shared_ptr<Pipe> rx);
+
+private:
+    std::shared_ptr<Pipe> m_tx;      ///< Tubería donde este extremo escribe.
+    std::shared_ptr<Pipe> m_rx;      ///< Tubería de la que este extremo lee.
+};
+
+/**
+ * @class MemoryListener
+ * @brief Nombre publicado en el proceso que acepta conexiones en memoria.
+ */
+class MemoryListener {
+public:
+    /**
+     * @brief Publica @p name.
+     * @return Listener, o nullptr si el nombre ya está en uso.
+     */
+    static std::shared_ptr<MemoryListener> Create(const std::string& name);
+
+    /// @brief Destructor: retira el nombre y cierra las conexiones sin aceptar.
+    ~MemoryListener();
+
+    /**
+     * @brief Bloquea hasta que llegue una conexión.
+     * @return Extremo del servidor, o nullptr si el listener se cerró.
+     */
+    std::shared_ptr<MemoryTransport> Accept();
+
+    /// @brief Retira el nombre y despierta a quien espere en @ref Accept().
+    void Close();
+
+private:
+    friend class MemoryTransport;
+
+    explicit MemoryListener(const std::string& name);
+
+    /// @brief Encola el extremo del servidor de una conexión nueva.
+    bool Enqueue(std::shared_ptr<MemoryTransport> server);
+
+private:
+    std::string m_name;                                      ///< Nombre publicado.
+    std::mutex m_mutex;                                      ///< Protege la cola y el cierre.
+    std::condition_variable m_ready;                         ///< Avisa de conexiones nuevas o del cierre.
+    std::deque<std::shared_ptr<MemoryTransport>> m_pending;  ///< Conexiones sin aceptar.
+    bool m_closed = false;                                   ///< Close() ya ejecutado.
+};
@@ -0,0 +1,143 @@
+/**
+ * @file Metrics.h
+ * @brief Contadores, indicadores e histogramas por hilo y su exportación en formato Prometheus.
+ *
+ * @details
+ * Cada hilo que mide (un @ref ServerShard) es dueño de su bloque @ref ShardMetrics:
+ *  - Un solo escritor: incrementar es `load` + `store` relajados, sin la
+ *    instrucción atómica con lock de un `fetch_add`.
+ *  - El bloque está alineado a línea de caché, así que el hilo que escribe
+ *    nunca comparte línea con otro shard.
+ *  - El hilo de administración solo lee (relajado) al servir una consulta;
+ *    los totales se suman en ese momento, fuera del camino caliente.
+ *
+ * @ref PrometheusText escribe las muestras en el formato de texto 0.0.4
+ * (`# HELP`, `# TYPE`, `nombre{etiquetas} valor`).
+ *
+ * @note El formato exige UTF-8 y los fuentes son Latin-1: los textos de ayuda
+ *       se escriben solo con ASCII.
+ */
+
+#pragma once
+#include "Prerequisites.h"
+
+/// @brief Tamaño de línea de caché supuesto para separar los datos de cada hilo.
+constexpr size_t kCacheLineSize = 64;
+
+/**
+ * @class MetricCounter
+ * @brief Contador monótono con un único hilo escritor.
+ */
+class MetricCounter {
+public:
+    /// @brief Suma @p n. Solo desde el hilo dueño.
+    void Add(uint64_t n = 1) {
+        m_value.store(m_value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    /// @brief Valor actual (desde cualquier hilo).
+    uint64_t Value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> m_value{ 0 };              ///< Total acumulado.
+};
+
+/**
+ * @class MetricGauge
+ * @brief Valor que sube y baja (p.ej. profundidad de cola) con un único hilo escritor.
+ */
+class MetricGauge {
+public:
+    /// @brief Suma @p delta (puede ser negativo). Solo desde el hilo dueño.
+    void Add(int64_t delta) {
+        m_value.store(m_value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    /// @brief Valor actual (desde cualquier hilo).
+    int64_t Value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> m_value{ 0 };               ///< Valor vigente.
+};
+
+/**
+ * @class LatencyHistogram
+ * @brief Histograma de duraciones con cubetas en potencias de dos de microsegundo.
+ *
+ * @details
+ * Cubeta `i` (salvo la última): duraciones de hasta `2^i` µs, de 1 µs a unos
+ * 4 s; la última recoge el resto (`+Inf`). Registrar una muestra cuesta unas
+ * pocas instrucciones y ninguna asignación.
+ */
+class LatencyHistogram {
+public:
+    static constexpr size_t kBuckets = 24;           ///< Cubetas, incluida `+Inf`.
+
+    /// @brief Registra una duración. Solo desde el hilo dueño.
+    void Observe(std::chrono::nanoseconds duration);
+
+    /// @brief Muestras de la cubeta @p index (no acumuladas).
+    uint64_t Bucket(size_t index) const { return m_buckets[index].load(std::memory_order_relaxed); }
+
+    /// @brief Suma de todas las duraciones, en nanosegundos.
+    uint64_t SumNanoseconds() const { return m_sumNs.load(std::memory_order_relaxed); }
+
+    /// @brief Límite superior de la cubeta @p index en segundos (infinito en la última).
+    static double UpperBound(size_t index);
+
+private:
+    std::atomic<uint64_t> m_buckets[kBuckets] = {};  ///< Muestras por cubeta.
+    std::atomic<uint64_t> m_sumNs{ 0 };              ///< Suma de duraciones.
+};
+
+/**
+ * @struct ShardMetrics
+ * @brief Métricas del camino caliente de un shard; las escribe solo su hilo.
+ */
+struct alignas(kCacheLineSize) ShardMetrics {
+    MetricCounter bytesIn;                           ///< Bytes leídos de los sockets de clientes.
+    MetricCounter bytesOut;                          ///< Bytes escritos en los sockets de clientes.
+    MetricCounter messagesOut;                       ///< Mensajes encolados hacia clientes (eco, enrutados y repartos).
+    MetricCounter handshakes;                        ///< Handshakes completados.
+    MetricGauge queuedEntries;                       ///< Buffers en las colas de envío.
+    MetricGauge queuedBytes;                         ///< Bytes de esos buffers.
+    LatencyHistogram handshakeLatency;               ///< Desde el accept hasta el canal AES listo.
+    LatencyHistogram encryptTime;                    ///< Duración de cada AESEncrypt.
+    LatencyHistogram decryptTime;                    ///< Duración de cada AESDecrypt.
+    LatencyHistogram clientToShard;                  ///< Desde el sello de envío del cliente hasta su lectura.
+};
+
+/**
+ * @class PrometheusText
+ * @brief Acumula métricas en el formato de texto de Prometheus.
+ *
+ * @par Uso:
+ *  1. `Family(nombre, tipo, ayuda)` una vez por métrica.
+ *  2. `Sample(...)` o `Histogram(...)` por cada juego de etiquetas.
+ *  3. `Str()` para obtener el cuerpo de la respuesta.
+ */
+class PrometheusText {
+public:
+    /**
+     * @brief Abre una familia de métricas.
+     * @param name Nombre (p.ej. `e2ee_bytes_received_total`).
+     * @param type `counter`, `gauge` o `histogram`.
+     * @param help Descripción de una línea.
+     */
+    void Family(const char* name, const char* type, const char* help);
+
+    /// @brief Muestra entera; @p labels sin llaves (p.ej. `shard="0"`), vacío si no hay.
+    void Sample(const char* name, const std::string& labels, uint64_t value);
+
+    /// @brief Muestra real (segundos, medias).
+    void Sample(const char* name, const std::string& labels, double value);
+
+    /// @brief Cubetas acumuladas, suma (en segundos) y número de muestras de un histograma.
+    void Histogram(const char* name, const std::string& labels, const LatencyHistogram& histogram);
+
+    /// @brief Texto acumulado.
+    std::string Str() const { return m_out.str(); }
+
+private:
+    std::ostringstream m_out;                        ///< Salida en construcción.
+};
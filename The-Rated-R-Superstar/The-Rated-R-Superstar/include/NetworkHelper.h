@@ -4,26 +4,36 @@
  *
  * @details
  * Esta clase encapsula operaciones de red sobre Winsock2 para simplificar:
- *  - Creacin y configuracin de sockets.
- *  - Inicio de un servidor TCP y aceptacin de clientes.
- *  - Conexin a un servidor TCP remoto.
- *  - Envo y recepcin de datos en formato texto y binario.
- *  - Envo/recepcin garantizando tamao exacto.
+ *  - Creación y configuración de sockets.
+ *  - Inicio de un servidor TCP y aceptación de clientes.
+ *  - Conexión a un servidor TCP remoto.
+ *  - Envío y recepción de datos en formato texto y binario.
+ *  - Envío/recepción garantizando tamaño exacto.
  *  - Cierre seguro de sockets.
  *
- * @note Requiere la inicializacin de Winsock (`WSAStartup`) previa en la aplicacin.
- * @warning Las funciones son bloqueantes a menos que el socket est configurado como no bloqueante.
+ * @note Requiere la inicialización de Winsock (`WSAStartup`) previa en la aplicación.
+ * @warning Las funciones son bloqueantes a menos que el socket esté configurado como no bloqueante.
  */
 
 #pragma once
 #include "Prerequisites.h"
+#include "Transport.h"
+#include "ShapedTransport.h"
+#include "TrafficCapture.h"
+#include "AddressResolver.h"
+#include "Frame.h"
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#include <afunix.h>
+#include <mswsock.h>
 #pragma comment(lib, "Ws2_32.lib")
 
+class SharedMemoryTransport;
+class MemoryListener;
+
  /**
   * @class NetworkHelper
-  * @brief Abstraccin para operaciones de red TCP en cliente y servidor.
+  * @brief Abstracción para operaciones de red TCP en cliente y servidor.
   *
   * @par Funcionalidades principales:
   *  - **Servidor**:
@@ -31,10 +41,15 @@
   *    - Aceptar cliente (`AcceptClient`).
   *  - **Cliente**:
   *    - Conectar a servidor (`ConnectToServer`).
-  *  - **Comunicacin**:
+  *  - **Direcciones**:
+  *    - nombre de host o IP + puerto: TCP sobre IPv4/IPv6 (Happy Eyeballs).
+  *    - `unix:<ruta>`: socket AF_UNIX en el mismo equipo.
+  *    - `shm:<nombre>`: anillos en memoria compartida (@ref SharedMemoryTransport).
+  *    - `mem:<nombre>`: tuberías en memoria del mismo proceso (@ref MemoryTransport).
+  *  - **Comunicación**:
   *    - Enviar datos como texto o binario.
   *    - Recibir datos como texto o binario.
-  *    - Funciones para envo y recepcin exacta de N bytes.
+  *    - Funciones para envío y recepción exacta de N bytes.
   */
 class NetworkHelper {
 public:
@@ -47,12 +62,33 @@ public:
     //   Servidor
     /**
      * @brief Inicia un socket servidor en el puerto indicado y lo deja en modo escucha.
-     * @param port Puerto TCP que se usar para escuchar conexiones entrantes.
+     * @param port Puerto TCP que se usará para escuchar conexiones entrantes.
+     * @param reusePort Si es true, activa `SO_REUSEPORT` (cuando la plataforma lo soporta)
+     *        para que varios sockets de escucha compartan el mismo puerto.
      * @return true Si el servidor se inicia correctamente.
      * @return false Si ocurre un error en cualquier paso.
      * @post El socket de escucha se almacena en @ref m_serverSocket.
      */
-    bool StartServer(int port);
+    bool StartServer(int port, bool reusePort = false);
+
+    /**
+     * @brief Indica si la plataforma reparte conexiones entre listeners con `SO_REUSEPORT`.
+     * @return true en Linux/BSD; false en Winsock, donde los shards comparten un único listener.
+     */
+    static bool SupportsReusePort();
+
+    /**
+     * @brief Inicia el servidor en una dirección con esquema.
+     * @param address `unix:<ruta>`, `shm:<nombre>`, `mem:<nombre>` o un número de puerto TCP.
+     * @return true si quedó a la espera de clientes.
+     */
+    bool StartServer(const std::string& address);
+
+    /**
+     * @brief Indica si una dirección usa un transporte local (`unix:`, `shm:` o `mem:`).
+     * @param address Dirección tal como la escribe el usuario.
+     */
+    static bool IsLocalAddress(const std::string& address);
 
     /**
      * @brief Espera y acepta un cliente entrante.
@@ -64,25 +100,74 @@ public:
     //   Cliente
     /**
      * @brief Conecta al servidor especificado por IP y puerto.
-     * @param ip Direccin IP del servidor.
-     * @param port Puerto del servidor.
-     * @return true Si la conexin fue exitosa.
-     * @return false Si fall la conexin.
+     * @param ip Nombre de host, IPv4 o IPv6 del servidor, o `unix:<ruta>` / `shm:<nombre>` / `mem:<nombre>`.
+     * @param port Puerto del servidor (ignorado con transportes locales).
+     * @return true Si la conexión fue exitosa.
+     * @return false Si falló la conexión o venció el tope de @ref SetConnectTimeout().
+     * @details La resolución usa @ref AddressResolver (caché con TTL). Con varias
+     *          direcciones se intenta primero IPv6 y, cada 250 ms o ante un fallo,
+     *          la siguiente dirección; gana la primera conexión establecida.
      */
     bool ConnectToServer(const std::string& ip, int port);
 
-    //   Envo y recepcin
     /**
-     * @brief Enva una cadena de texto por el socket.
-     * @param socket Descriptor de socket vlido.
+     * @brief Conecta y entrega @p earlyData como primeros bytes de la conexión.
+     * @param ip Igual que en @ref ConnectToServer(const std::string&, int).
+     * @param port Puerto del servidor.
+     * @param earlyData Primer envío del cliente (p.ej. su clave pública).
+     * @return true si conectó y los datos quedaron enviados.
+     * @details Con @ref EnableFastOpen() los datos viajan en el SYN (TCP Fast Open
+     *          mediante `ConnectEx`). Si el sistema no lo soporta o el intento falla,
+     *          se conecta de forma normal y se envían a continuación.
+     */
+    bool ConnectToServer(const std::string& ip, int port, const std::vector<unsigned char>& earlyData);
+
+    /**
+     * @brief Activa TCP Fast Open en @ref StartServer() y en la conexión con datos iniciales.
+     * @param enabled true para activarlo.
+     * @note Sin cookie TFO previa, el primer intento usa el handshake normal.
+     */
+    void EnableFastOpen(bool enabled = true);
+
+    /**
+     * @brief Ajusta el tope total (resolución + conexión) de @ref ConnectToServer().
+     * @param timeout Tiempo máximo; 10 s por defecto.
+     */
+    void SetConnectTimeout(std::chrono::milliseconds timeout);
+
+    /**
+     * @brief Emula un enlace con retardo, ancho de banda limitado, pérdidas o cortes.
+     * @param conditions Condiciones (ver @ref ShapedTransport); sin ninguna activa, enlace directo.
+     * @details Se aplica a las conexiones siguientes de @ref ConnectToServer() y
+     *          @ref AcceptClient(), en ambos sentidos. Con condiciones activas los
+     *          datos iniciales no viajan en el SYN: pasan también por el enlace emulado.
+     */
+    void SetNetworkConditions(const NetworkConditions& conditions);
+
+    /**
+     * @brief Graba instante, banderas y tamaño de cada frame de @ref SendFrame() y @ref ReceiveFrame().
+     * @param path Archivo de captura (se trunca); ver @ref TrafficCapture.
+     * @param role Extremo que captura.
+     * @return false si no se pudo crear el archivo.
+     * @pre Sin envíos ni recepciones en curso.
+     */
+    bool StartCapture(const std::string& path, TrafficCapture::Role role = TrafficCapture::Role::Client);
+
+    /// @brief Cierra la captura en curso (también al destruir el objeto).
+    void StopCapture();
+
+    //   Envío y recepción
+    /**
+     * @brief Envía una cadena de texto por el socket.
+     * @param socket Descriptor de socket válido.
      * @param data Texto a enviar.
      * @return true si se enviaron todos los datos, false si hubo error.
      */
     bool SendData(SOCKET socket, const std::string& data);
 
     /**
-     * @brief Enva datos binarios (ej. claves AES, RSA) por el socket.
-     * @param socket Descriptor de socket vlido.
+     * @brief Envía datos binarios (ej. claves AES, RSA) por el socket.
+     * @param socket Descriptor de socket válido.
      * @param data Datos binarios a enviar.
      * @return true si se enviaron todos los datos, false en error.
      */
@@ -90,19 +175,45 @@ public:
 
     /**
      * @brief Recibe una cadena de texto del socket.
-     * @param socket Descriptor de socket vlido.
-     * @return Cadena recibida; puede estar vaca si el socket se cerr o hubo error.
+     * @param socket Descriptor de socket válido.
+     * @return Cadena recibida; puede estar vacía si el socket se cerró o hubo error.
      */
     std::string ReceiveData(SOCKET socket);
 
     /**
      * @brief Recibe datos binarios del socket.
-     * @param socket Descriptor de socket vlido.
-     * @param size Nmero exacto de bytes a recibir (0 para recibir hasta cierre).
+     * @param socket Descriptor de socket válido.
+     * @param size Número exacto de bytes a recibir (0 para recibir hasta cierre).
      * @return Vector con los bytes recibidos.
      */
     std::vector<unsigned char> ReceiveDataBinary(SOCKET socket, int size = 0);
 
+    /**
+     * @brief Serializa y envía un frame completo en una sola escritura.
+     * @param socket Descriptor de socket válido.
+     * @param frame Frame a enviar (ver @ref Frame).
+     * @return true si se enviaron todos los bytes.
+     */
+    bool SendFrame(SOCKET socket, const Frame& frame);
+
+    /**
+     * @brief Recibe un frame completo (cabecera, ruta opcional y payload).
+     * @param socket Descriptor de socket válido.
+     * @param out Frame recibido.
+     * @return false si la conexión se cerró, hubo error o el tamaño excede @ref Frame::kMaxPayload.
+     */
+    bool ReceiveFrame(SOCKET socket, Frame& out);
+
+    /**
+     * @brief Recibe hasta encontrar un delimitador, sin consumir bytes posteriores.
+     * @param socket Descriptor de socket válido.
+     * @param delimiter Secuencia que cierra el bloque (incluida en el resultado).
+     * @param maxLen Tamaño máximo aceptado.
+     * @return Bytes hasta el delimitador inclusive; vacío si se cerró, hubo error o se superó @p maxLen.
+     * @note Evita que la clave pública y la clave AES cifrada se mezclen en un mismo `recv`.
+     */
+    std::string ReceiveUntil(SOCKET socket, const std::string& delimiter, size_t maxLen = 4096);
+
     /**
      * @brief Cierra un socket de forma segura.
      * @param socket Descriptor de socket a cerrar.
@@ -110,26 +221,128 @@ public:
     void close(SOCKET socket);
 
     /**
-     * @brief Enva todos los bytes de un buffer.
-     * @param s Socket vlido.
+     * @brief Corta la conexión sin liberar el socket.
+     * @param socket Socket o handle de transporte.
+     * @note Desbloquea a otro hilo que esté esperando en una recepción; el
+     *       socket se sigue cerrando con @ref close().
+     */
+    void Shutdown(SOCKET socket);
+
+    /**
+     * @brief Envía todos los bytes de un buffer.
+     * @param s Socket válido.
      * @param data Puntero al buffer.
-     * @param len Nmero de bytes a enviar.
+     * @param len Número de bytes a enviar.
      * @return true si se enviaron todos; false si hubo error.
-     * @note til para asegurar que no se pierda parte del mensaje.
+     * @note Útil para asegurar que no se pierda parte del mensaje.
      */
     bool SendAll(SOCKET s, const unsigned char* data, int len);
 
     /**
      * @brief Recibe exactamente len bytes del socket.
-     * @param s Socket vlido.
+     * @param s Socket válido.
      * @param out Puntero al buffer de destino.
-     * @param len Nmero de bytes a recibir.
+     * @param len Número de bytes a recibir.
      * @return true si se recibieron todos; false si hubo error o cierre.
      */
     bool ReceiveExact(SOCKET s, unsigned char* out, int len);
 
+    /**
+     * @brief Cambia el modo bloqueante de un socket.
+     * @param s Socket válido.
+     * @param enabled true para modo no bloqueante, false para volver a bloqueante.
+     * @return true si la operación tuvo éxito.
+     */
+    bool SetNonBlocking(SOCKET s, bool enabled = true);
+
+    /**
+     * @brief Crea un par de sockets TCP conectados entre sí por loopback.
+     * @param a Primer extremo (salida).
+     * @param b Segundo extremo (salida).
+     * @return true si ambos extremos quedaron conectados.
+     * @note Winsock no ofrece `socketpair`; se emula con un listener efímero en 127.0.0.1.
+     *       Se usa para despertar bucles de eventos desde otros hilos.
+     */
+    bool CreateSocketPair(SOCKET& a, SOCKET& b);
+
+    //   Sockets locales (AF_UNIX)
+    /**
+     * @brief Crea un socket AF_UNIX en modo escucha en la ruta indicada.
+     * @param path Ruta del socket en el sistema de archivos (se reemplaza si existe).
+     * @return Socket de escucha o INVALID_SOCKET si falla.
+     * @note Requiere Windows 10 1803 o posterior (`afunix.h`).
+     */
+    SOCKET ListenUnix(const std::string& path);
+
+    /**
+     * @brief Conecta a un socket AF_UNIX en la ruta indicada.
+     * @param path Ruta del socket en el sistema de archivos.
+     * @return Socket conectado o INVALID_SOCKET si falla.
+     */
+    SOCKET ConnectUnix(const std::string& path);
+
+    //   Transportes alternativos
+    /**
+     * @brief Asocia un transporte a un handle nuevo con el que operan Send/Receive/close.
+     * @param transport Transporte ya conectado.
+     * @return Handle único (reserva un socket sin conectar para que el valor no colisione).
+     */
+    static SOCKET RegisterTransport(std::shared_ptr<Transport> transport);
+
+    /**
+     * @brief Busca el transporte asociado a un handle.
+     * @param s Handle devuelto por @ref RegisterTransport() o socket normal.
+     * @return Transporte, o nullptr si @p s es un socket del sistema.
+     * @note Sin transportes registrados no toma ningún lock.
+     */
+    static std::shared_ptr<Transport> FindTransport(SOCKET s);
+
+    /**
+     * @brief Pasa una conexión ya establecida por un @ref ShapedTransport.
+     * @param s Socket conectado o handle de otro transporte; deja de ser válido.
+     * @param conditions Condiciones del enlace.
+     * @return Handle nuevo, o INVALID_SOCKET si falla (la conexión queda cerrada).
+     */
+    static SOCKET Shape(SOCKET s, const NetworkConditions& conditions);
+
 public:
     SOCKET m_serverSocket = -1;  ///< Socket del servidor (modo escucha).
+private:
+    /// @brief Elimina la asociación handle/transporte y devuelve el transporte.
+    static std::shared_ptr<Transport> UnregisterTransport(SOCKET s);
+
+    /// @brief @ref AcceptClient() sin emulación de red.
+    SOCKET AcceptDirect();
+
+    /// @brief @ref ConnectToServer() sin emulación de red.
+    bool ConnectDirect(const std::string& ip, int port, const std::vector<unsigned char>& earlyData);
+
+    /**
+     * @brief Conecta a la primera dirección que responda (RFC 8305).
+     * @param endpoints Direcciones resueltas.
+     * @param deadline Instante límite para todos los intentos.
+     * @return Socket conectado en modo bloqueante, o INVALID_SOCKET.
+     */
+    SOCKET ConnectHappyEyeballs(const std::vector<AddressResolver::Endpoint>& endpoints,
+                                std::chrono::steady_clock::time_point deadline);
+
+    /**
+     * @brief Conecta con `ConnectEx` y TCP Fast Open enviando @p earlyData en el SYN.
+     * @param endpoint Dirección de destino.
+     * @param earlyData Datos iniciales (se envían completos aunque no quepan en el SYN).
+     * @param deadline Instante límite del intento.
+     * @return Socket conectado, o INVALID_SOCKET si TFO no está disponible o falló.
+     */
+    SOCKET ConnectFastOpen(const AddressResolver::Endpoint& endpoint,
+                           const std::vector<unsigned char>& earlyData,
+                           std::chrono::steady_clock::time_point deadline);
+
 private:
     bool m_initialized;          ///< Indica si Winsock fue inicializado correctamente.
+    std::shared_ptr<SharedMemoryTransport> m_shmListener; ///< Región `shm:` a la espera de cliente.
+    std::shared_ptr<MemoryListener> m_memListener;        ///< Nombre `mem:` publicado en el proceso.
+    std::chrono::milliseconds m_connectTimeout{ 10000 };  ///< Tope de ConnectToServer().
+    bool m_fastOpen = false;                              ///< TCP Fast Open activado.
+    NetworkConditions m_conditions;                       ///< Enlace emulado de las conexiones nuevas.
+    std::shared_ptr<TrafficRecorder> m_capture;           ///< Captura de frames en curso.
 };
@@ -6,4 +6,12 @@
 #include <iostream>
 #include <cstring>
 #include <limits>
-#include <thread>
\ No newline at end of file
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <stdexcept>
+#include <sstream>
\ No newline at end of file
@@ -0,0 +1,149 @@
+/**
+ * @file RatchetTree.h
+ * @brief Árbol de claves de una sala (estilo TreeKEM/MLS) para renovar la clave en O(log n).
+ *
+ * @details
+ * Cada miembro ocupa una hoja de un árbol binario completo guardado en un
+ * vector (índices MLS: hojas en posiciones pares, raíz en `hojas - 1`). Cada
+ * nodo no vacío tiene un par X25519; un miembro conoce los secretos de los
+ * nodos de su camino a la raíz y, con el de la raíz, la clave de la época.
+ *
+ * Un *commit* aplica altas y bajas y renueva el camino de quien lo emite:
+ * por cada nivel sella el secreto del padre para la resolución del nodo
+ * hermano (un nodo si el árbol está lleno), así que cuesta O(log n)
+ * operaciones X25519 y un único mensaje para toda la sala. Altas y bajas
+ * dejan en blanco el camino afectado; los commits siguientes lo rellenan.
+ *
+ * @note No es seguro para hilos: cada sala del cliente tiene su propia copia.
+ */
+
+#pragma once
+#include "Prerequisites.h"
+
+/**
+ * @class RatchetTree
+ * @brief Vista de un miembro sobre el árbol de claves de su sala.
+ *
+ * @par Flujo típico de uso:
+ *  1. El primer miembro llama a `Create()`; el resto espera un `Welcome()`.
+ *  2. El miembro designado por el servidor emite `Commit()` con las altas y bajas.
+ *  3. Los demás aplican el commit con `ApplyCommit()`; los nuevos, `ApplyWelcome()`.
+ *  4. `GroupKey()` da la clave AES de la época vigente.
+ */
+class RatchetTree {
+public:
+    /// @brief Alta incluida en un commit.
+    struct Addition {
+        uint32_t userId = 0;                     ///< Usuario que entra.
+        std::vector<unsigned char> leafKey;      ///< Clave pública X25519 de su hoja.
+    };
+
+    /// @brief Genera el secreto de hoja con el que un usuario entra en una sala.
+    static std::vector<unsigned char> NewLeafSecret();
+
+    /**
+     * @brief Crea un árbol con un solo miembro (época 0).
+     * @param userId Usuario propio.
+     * @param leafSecret Secreto de hoja (ver @ref NewLeafSecret()).
+     */
+    void Create(uint32_t userId, const std::vector<unsigned char>& leafSecret);
+
+    /**
+     * @brief Aplica altas y bajas, renueva el camino propio y avanza la época.
+     * @param adds Usuarios que entran (los ya presentes se ignoran).
+     * @param removes Usuarios que salen (los ausentes se ignoran).
+     * @return Commit serializado para el resto de la sala.
+     * @note Modifica el árbol: para esperar la confirmación del servidor, llamar sobre una copia.
+     */
+    std::vector<unsigned char> Commit(const std::vector<Addition>& adds, const std::vector<uint32_t>& removes);
+
+    /**
+     * @brief Aplica el commit de otro miembro.
+     * @param commit Bytes producidos por @ref Commit().
+     * @return false si el commit no es de esta época, está malformado o no se puede descifrar.
+     * @post Si el propio usuario fue dado de baja, @ref Contains() devuelve false.
+     */
+    bool ApplyCommit(const std::vector<unsigned char>& commit);
+
+    /**
+     * @brief Mensaje de bienvenida para un usuario añadido en el último commit propio.
+     * @param userId Usuario añadido.
+     * @return Árbol público, época y el secreto del ancestro común sellado para su hoja
+     *         (vacío si el usuario no está en el árbol).
+     */
+    std::vector<unsigned char> Welcome(uint32_t userId) const;
+
+    /**
+     * @brief Entra en la sala a partir de un @ref Welcome().
+     * @param welcome Bytes recibidos.
+     * @param userId Usuario propio.
+     * @param leafSecret Secreto de hoja enviado al entrar.
+     * @return false si el mensaje no corresponde a esta hoja.
+     */
+    bool ApplyWelcome(const std::vector<unsigned char>& welcome, uint32_t userId,
+        const std::vector<unsigned char>& leafSecret);
+
+    /// @brief Indica si el usuario ocupa una hoja.
+    bool Contains(uint32_t userId) const;
+
+    /// @brief Época vigente (número de commits aplicados).
+    uint32_t Epoch() const { return m_epoch; }
+
+    /// @brief Época sobre la que se emitió un commit serializado (0 si es demasiado corto).
+    static uint32_t CommitEpoch(const std::vector<unsigned char>& commit);
+
+    /// @brief Clave AES-256 de la época vigente (vacía antes de entrar).
+    const std::vector<unsigned char>& GroupKey() const { return m_groupKey; }
+
+    /// @brief Número de miembros con hoja.
+    size_t MemberCount() const;
+
+    /// @brief Secretos sellados por el último commit propio (coste del rekey).
+    size_t LastCommitSeals() const { return m_lastSeals; }
+
+private:
+    friend class Benchmark;  ///< Construye árboles completos sin simular n commits.
+
+    /// @brief Nodo del árbol; sin clave pública está en blanco.
+    struct Node {
+        std::vector<unsigned char> publicKey;    ///< Clave pública X25519.
+        std::vector<unsigned char> secret;       ///< Clave privada (solo nodos del camino propio).
+        std::vector<unsigned char> pathSecret;   ///< Secreto de camino del que deriva @ref secret.
+        uint32_t userId = 0;                     ///< Usuario (solo hojas).
+    };
+
+    uint32_t Root() const { return m_leafCount - 1; }
+    static uint32_t Level(uint32_t node);
+    uint32_t Parent(uint32_t node) const;
+    static uint32_t Left(uint32_t node);
+    static uint32_t Right(uint32_t node);
+    uint32_t Sibling(uint32_t node) const;
+    static bool InSubtree(uint32_t node, uint32_t leafNode);
+    std::vector<uint32_t> DirectPath(uint32_t leafNode) const;
+    void Resolution(uint32_t node, std::vector<uint32_t>& out) const;
+    uint32_t FindLeaf(uint32_t userId) const;
+
+    /// @brief Vacía un nodo y todo su camino a la raíz.
+    void BlankPath(uint32_t leafNode);
+
+    /// @brief Duplica el número de hojas hasta alcanzar @p leafCount.
+    void Extend(uint32_t leafCount);
+
+    /// @brief Fija el secreto de camino de un nodo y deriva su par X25519.
+    /// @return false si ya tenía una clave pública distinta de la derivada.
+    bool SetPathSecret(uint32_t node, const std::vector<unsigned char>& pathSecret);
+
+    /// @brief Deriva los secretos desde @p node hasta la raíz.
+    bool DeriveUp(uint32_t node, std::vector<unsigned char> pathSecret);
+
+    /// @brief Calcula la clave de grupo de la época vigente.
+    void FinishEpoch();
+
+private:
+    std::vector<Node> m_nodes;                   ///< Nodos (2 * hojas - 1).
+    uint32_t m_leafCount = 0;                    ///< Hojas (potencia de dos).
+    uint32_t m_userId = 0;                       ///< Usuario propio.
+    uint32_t m_epoch = 0;                        ///< Época vigente.
+    std::vector<unsigned char> m_groupKey;       ///< Clave AES de la época.
+    size_t m_lastSeals = 0;                      ///< Sellados del último commit propio.
+};
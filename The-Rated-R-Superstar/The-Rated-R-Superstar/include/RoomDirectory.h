@@ -0,0 +1,123 @@
+/**
+ * @file RoomDirectory.h
+ * @brief Salas del relay: id de sala -> miembros (usuario, shard y sesión).
+ *
+ * @details
+ * Un mensaje a una sala se serializa una sola vez y cada miembro recibe un
+ * puntero al mismo @ref FrameBuffer. Para que el reparto no tome el mutex por
+ * miembro, el shard obtiene una instantánea inmutable de la lista de miembros
+ * (@ref RoomSnapshot) que se reconstruye solo tras un alta o una baja.
+ *
+ * Para el árbol de claves de la sala (@ref RatchetTree) el directorio designa
+ * al miembro más antiguo como responsable de cada cambio y ordena los commits
+ * por época: solo se reparte un commit del responsable emitido sobre la época
+ * vigente. La época y la antigüedad sobreviven a un traspaso en caliente
+ * (@ref Export / @ref Restore).
+ *
+ * @note Compartido por todos los shards; protegido por un mutex.
+ */
+
+#pragma once
+#include "Prerequisites.h"
+
+/**
+ * @struct RoomMember
+ * @brief Miembro de una sala y dónde entregarle los frames.
+ */
+struct RoomMember {
+    uint32_t userId = 0;       ///< Usuario registrado.
+    int shard = -1;            ///< Shard dueño de la sesión.
+    uint64_t sessionId = 0;    ///< Sesión dentro del shard.
+    uint64_t since = 0;        ///< Orden de llegada a la sala (lo fija @ref RoomDirectory::Join).
+};
+
+/// @brief Lista de miembros inmutable; válida aunque la sala cambie después.
+using RoomSnapshot = std::shared_ptr<const std::vector<RoomMember>>;
+
+/**
+ * @struct RoomState
+ * @brief Estado de una sala que debe sobrevivir a un traspaso en caliente.
+ */
+struct RoomState {
+    uint32_t roomId = 0;                             ///< Id de la sala.
+    uint32_t epoch = 0;                              ///< Época vigente del árbol de claves.
+    std::vector<uint32_t> members;                   ///< Usuarios, del más antiguo al más reciente.
+};
+
+/**
+ * @class RoomDirectory
+ * @brief Registro concurrente de salas y sus miembros.
+ */
+class RoomDirectory {
+public:
+    /**
+     * @brief Añade un miembro a una sala (la crea si no existe).
+     * @param roomId Id de la sala.
+     * @param member Usuario, shard y sesión.
+     * @return false si el usuario ya estaba en la sala.
+     */
+    bool Join(uint32_t roomId, const RoomMember& member);
+
+    /**
+     * @brief Quita un usuario de una sala (la elimina si queda vacía).
+     * @param roomId Id de la sala.
+     * @param userId Usuario que sale.
+     * @return false si el usuario no estaba en la sala.
+     */
+    bool Leave(uint32_t roomId, uint32_t userId);
+
+    /**
+     * @brief Instantánea de los miembros de una sala.
+     * @param roomId Id de la sala.
+     * @return Lista compartida, o nullptr si la sala no existe.
+     * @note O(1) salvo la primera llamada tras un cambio, que copia la lista.
+     */
+    RoomSnapshot Members(uint32_t roomId) const;
+
+    /**
+     * @brief Miembro más antiguo de la sala, salvo @p exceptUser.
+     * @return Id de usuario, o 0 si no queda ningún otro miembro.
+     * @note El responsable de emitir el commit de un alta o una baja.
+     */
+    uint32_t Sponsor(uint32_t roomId, uint32_t exceptUser) const;
+
+    /**
+     * @brief Admite un commit del árbol de claves emitido sobre la época @p epoch.
+     * @param roomId Id de la sala.
+     * @param committer Usuario que emite el commit.
+     * @param epoch Época sobre la que se emitió.
+     * @return true si @p committer es el responsable y @p epoch es la vigente (la
+     *         sala pasa a la siguiente); false si otro commit ya la consumió, la
+     *         época no corresponde, el emisor no es el responsable o la sala no existe.
+     */
+    bool AdvanceEpoch(uint32_t roomId, uint32_t committer, uint32_t epoch);
+
+    /// @brief Época y antigüedad de cada sala, para el traspaso en caliente.
+    std::vector<RoomState> Export() const;
+
+    /**
+     * @brief Repone la época y la antigüedad de una sala ya reconstruida.
+     * @param state Estado exportado por el proceso anterior.
+     * @note Se llama después de volver a unir a los miembros; si la sala no existe no hace nada.
+     */
+    void Restore(const RoomState& state);
+
+    /// @brief Número de salas con al menos un miembro.
+    size_t Size() const;
+
+private:
+    /// @brief Estado interno de una sala.
+    struct Room {
+        std::vector<RoomMember> members;                 ///< Miembros (orden arbitrario).
+        std::unordered_map<uint32_t, size_t> index;      ///< Usuario -> posición en @ref members.
+        mutable RoomSnapshot snapshot;                   ///< Copia vigente (nullptr tras un cambio).
+        uint64_t joins = 0;                              ///< Altas totales (orden de llegada).
+        uint32_t epoch = 0;                              ///< Época del árbol de claves.
+    };
+
+    /// @brief Miembro más antiguo de @p room salvo @p exceptUser (nullptr si no hay).
+    static const RoomMember* Oldest(const Room& room, uint32_t exceptUser);
+
+    mutable std::mutex m_mutex;                          ///< Protege @ref m_rooms.
+    std::unordered_map<uint32_t, Room> m_rooms;          ///< Salas activas.
+};
@@ -1,35 +1,62 @@
 /**
  * @file Server.h
- * @brief Servidor TCP con handshake RSA y comunicacin cifrada AES.
+ * @brief Servidor TCP con handshake RSA y comunicación cifrada AES.
  *
  * @details
  * Esta clase implementa un servidor TCP que:
- *  - Escucha conexiones entrantes en un puerto especfico.
- *  - Acepta un cliente y realiza el intercambio de claves pblicas (RSA).
- *  - Establece una clave de sesin AES cifrada con RSA.
- *  - Recibe y enva mensajes cifrados con AES.
- *  - Ofrece bucles de envo y recepcin para implementar un chat simple.
+ *  - Escucha conexiones entrantes en un puerto específico.
+ *  - Acepta un cliente y realiza el intercambio de claves públicas (RSA).
+ *  - Establece una clave de sesión AES cifrada con RSA.
+ *  - Recibe y envía mensajes cifrados con AES.
+ *  - Ofrece bucles de envío y recepción para implementar un chat simple.
  *
- * @note Utiliza @ref NetworkHelper para la comunicacin y @ref CryptoHelper para las operaciones criptogrficas.
+ * @note Utiliza @ref NetworkHelper para la comunicación y @ref CryptoHelper para el cifrado AES;
+ *       el par RSA es una única @ref ServerIdentity compartida con los shards.
  */
 
 #pragma once
 #include "NetworkHelper.h"
 #include "CryptoHelper.h"
+#include "ServerShard.h"
+#include "LiveUpgrade.h"
+#include "AdminEndpoint.h"
+#include "Logger.h"
+#include "Trace.h"
 #include "Prerequisites.h"
+#include <condition_variable>
 
  /**
   * @class Server
-  * @brief Servidor TCP que negocia claves RSA/AES y mantiene comunicacin cifrada.
+  * @brief Servidor TCP que negocia claves RSA/AES y mantiene comunicación cifrada.
   *
-  * @par Flujo tpico de uso:
+  * @par Flujo típico de uso:
   *  1. Construir `Server(port)`.
   *  2. `Start()` para iniciar la escucha en el puerto.
   *  3. `WaitForClient()` para aceptar un cliente y hacer el handshake RSA.
   *  4. `StartReceiveLoop()` y/o `SendEncryptedMessageLoop()` para intercambiar mensajes.
   *  5. Finalizar con cierre limpio de sockets y hilos.
   *
-  * @warning Las funciones de bucle son bloqueantes y deberan ejecutarse en hilos separados si se requiere envo y recepcin simultnea.
+  * @par Modo sharded (varios clientes):
+  *  1. `StartSharded(n)` lanza un @ref ServerShard por hilo, cada uno con su listener y sus sesiones.
+  *  2. `RunSharded()` atiende la consola (`/stats`, `/exit`) mientras los shards trabajan.
+  *
+  * @par Relay extremo a extremo:
+  *  - Los clientes se registran con un id y negocian claves AES entre ellos.
+  *  - Los shards reenvían frames enrutados leyendo solo la cabecera (ver @ref Frame).
+  *  - Salas (@ref RoomDirectory): un mensaje se serializa una vez y cada miembro
+  *    recibe un puntero al mismo buffer en su cola de envío.
+  *
+  * @par Actualización sin cortes:
+  *  - El proceso en servicio llama a `EnableLiveUpgrade(path)`.
+  *  - El nuevo binario llama a `StartSharded(n, path)`: hereda listeners, sesiones
+  *    (también en handshake) e identidad RSA, y el proceso anterior termina sin
+  *    que los clientes reconecten.
+  *
+  * @par Observabilidad:
+  *  - `EnableAdmin(address)` publica en loopback (o AF_UNIX) las métricas de los
+  *    shards en formato Prometheus; cada shard las lleva en su propio bloque.
+  *
+  * @warning Las funciones de bucle son bloqueantes y deberían ejecutarse en hilos separados si se requiere envío y recepción simultánea.
   */
 class Server {
 public:
@@ -38,28 +65,79 @@ public:
 
     /**
      * @brief Construye el servidor con un puerto de escucha.
-     * @param port Puerto TCP en el que se escucharn conexiones entrantes.
+     * @param port Puerto TCP en el que se escucharán conexiones entrantes.
      */
     Server(int port);
 
+    /**
+     * @brief Construye el servidor sobre una dirección con esquema.
+     * @param address `unix:<ruta>` o `shm:<nombre>` para clientes del mismo equipo;
+     *        `mem:<nombre>` para un @ref Client del mismo proceso (pruebas y benchmarks).
+     * @note Solo aplica al modo interactivo (@ref Start() / @ref WaitForClient()).
+     */
+    Server(const std::string& address);
+
     /// @brief Destructor: libera recursos, cierra sockets y detiene hilos.
     ~Server();
 
     /**
      * @brief Inicia el servidor en el puerto especificado.
-     * @return true si el servidor se inicializ correctamente.
-     * @return false si hubo un error en la configuracin.
+     * @return true si el servidor se inicializó correctamente.
+     * @return false si hubo un error en la configuración.
      * @post El servidor queda a la espera de clientes hasta llamar a @ref WaitForClient().
      */
     bool Start();
 
     /**
-     * @brief Espera a que un cliente se conecte e intercambia claves pblicas.
+     * @brief Activa TCP Fast Open en los listeners TCP.
+     * @param enabled true para activarlo.
+     * @pre Llamar antes de @ref Start() o @ref StartSharded().
+     * @note Los clientes con cookie envían su clave pública en el SYN.
+     */
+    void EnableFastOpen(bool enabled = true);
+
+    /**
+     * @brief Modo relay puro: el servidor no descifra ningún mensaje.
+     * @param enabled true para descartar frames sin enrutar en lugar de responder con eco.
+     * @pre Llamar antes de @ref StartSharded().
+     * @note Los frames enrutados se reenvían siempre, con o sin este modo.
+     */
+    void EnableRelayOnly(bool enabled = true);
+
+    /**
+     * @brief Tiempo sin tráfico tras el que los shards hibernan una sesión.
+     * @param idle Inactividad mínima; cero desactiva la hibernación.
+     * @pre Llamar antes de @ref StartSharded().
+     * @note Una sesión hibernada ocupa unos cientos de bytes y se reconstruye al recibir tráfico.
+     */
+    void SetHibernateAfter(std::chrono::milliseconds idle);
+
+    /**
+     * @brief Latido de aplicación de los shards.
+     * @param interval Silencio de un cliente tras el que se le envía un Ping; cero lo desactiva.
+     * @param maxMissed Pings seguidos sin respuesta antes de cerrar la sesión.
+     * @pre Llamar antes de @ref StartSharded().
+     * @note `/stats` muestra el RTT y el jitter medios por shard y las sesiones cerradas.
+     */
+    void SetHeartbeat(std::chrono::milliseconds interval, uint32_t maxMissed = 3);
+
+    /**
+     * @brief Graba la forma del tráfico que reciben los shards (ver @ref TrafficCapture).
+     * @param path Archivo de captura (se trunca).
+     * @return false si no se pudo crear el archivo.
+     * @pre Llamar antes de @ref StartSharded().
+     * @note Solo instante, banderas, tamaño y destino de cada frame, nunca su contenido;
+     *       `E2EE loadgen --replay` lo reproduce contra otro build.
+     */
+    bool EnableCapture(const std::string& path);
+
+    /**
+     * @brief Espera a que un cliente se conecte e intercambia claves públicas.
      *
      * @details
      * Secuencia:
      *  - Aceptar un cliente entrante.
-     *  - Enviar clave pblica RSA del servidor.
+     *  - Enviar clave pública RSA del servidor.
      *  - Recibir clave AES cifrada con la RSA del servidor.
      * @pre El servidor debe estar iniciado con @ref Start().
      */
@@ -68,44 +146,136 @@ public:
     /**
      * @brief Recibe un mensaje cifrado del cliente, lo descifra y lo imprime.
      *
-     * @pre La sesin AES debe estar establecida tras @ref WaitForClient().
-     * @note La impresin es directa en consola; para uso en GUI, procesar el texto devuelto.
+     * @pre La sesión AES debe estar establecida tras @ref WaitForClient().
+     * @note La impresión pasa por el @ref Logger asíncrono.
      */
     void ReceiveEncryptedMessage();
 
     /**
-     * @brief Bucle de recepcin continua de mensajes cifrados.
+     * @brief Bucle de recepción continua de mensajes cifrados.
      *
      * @details
      * Ejecuta lectura desde el socket del cliente, descifra con AES y
      * muestra el resultado hasta que se detenga la bandera @ref m_running o el socket se cierre.
-     * @warning Bloquea el hilo actual mientras est activo.
+     * @warning Bloquea el hilo actual mientras está activo.
      */
     void StartReceiveLoop();
 
     /**
-     * @brief Bucle de envo de mensajes cifrados al cliente.
+     * @brief Bucle de envío de mensajes cifrados al cliente.
      *
      * @details
-     * Lee entradas desde consola, las cifra con AES y las enva al cliente hasta
-     * que se detenga la comunicacin.
+     * Lee entradas desde consola, las cifra con AES y las envía al cliente hasta
+     * que se detenga la comunicación.
      */
     void SendEncryptedMessageLoop();
 
     /**
-     * @brief Bucle de chat combinado (envo y recepcin) segn implementacin.
+     * @brief Bucle de chat combinado (envío y recepción) según implementación.
      *
      * @details
-     * Puede crear hilos internos para recibir y enviar simultneamente, usando
+     * Puede crear hilos internos para recibir y enviar simultáneamente, usando
      * @ref StartReceiveLoop() y @ref SendEncryptedMessageLoop().
      */
     void StartChatLoop();
 
+    /**
+     * @brief Inicia el modo sharded: un reactor por núcleo sin estado compartido.
+     * @param shards Número de shards; 0 usa `std::thread::hardware_concurrency()`.
+     * @return true si todos los listeners quedaron en escucha y los hilos arrancaron.
+     *
+     * @details
+     * Con `SO_REUSEPORT` cada shard abre su propio listener y el kernel reparte
+     * las conexiones. En Winsock los shards comparten el listener del shard 0 y
+     * equilibran la aceptación según el número de sesiones de cada uno.
+     *
+     * @param takeoverPath Si no está vacío, socket de actualización del proceso
+     *        anterior del que se heredan listeners y sesiones (ver @ref LiveUpgrade).
+     */
+    bool StartSharded(int shards, const std::string& takeoverPath = "");
+
+    /**
+     * @brief Permite que un proceso sucesor herede este servidor sin cortes.
+     * @param path Ruta del socket AF_UNIX donde esperar al sucesor.
+     * @return true si el socket de actualización quedó en escucha.
+     * @post Al completarse un traspaso, @ref RunSharded() retorna.
+     */
+    bool EnableLiveUpgrade(const std::string& path);
+
+    /**
+     * @brief Abre el endpoint de métricas (`GET /metrics`, formato Prometheus).
+     * @param address Puerto TCP (solo en 127.0.0.1) o `unix:<ruta>`.
+     * @return true si el endpoint quedó en escucha.
+     * @pre @ref StartSharded() debe haber retornado true.
+     */
+    bool EnableAdmin(const std::string& address);
+
+    /**
+     * @brief Atiende la consola del modo sharded hasta `/exit` o un traspaso completado.
+     * @details `/stats` imprime sesiones, conexiones aceptadas y mensajes por shard.
+     * @pre @ref StartSharded() debe haber retornado true.
+     */
+    void RunSharded();
+
+    /**
+     * @brief Modo daemon: sirve sin consola hasta una señal de parada o un traspaso completado.
+     * @details No lee la entrada estándar. Ctrl+C, Ctrl+Break, el cierre de la
+     *          consola o el apagado del sistema (lo que envían los supervisores en
+     *          Windows) detienen los shards de forma ordenada; una segunda señal
+     *          durante la parada termina el proceso.
+     * @pre @ref StartSharded() debe haber retornado true.
+     */
+    void RunDaemon();
+
+    /// @brief Detiene los shards y espera a que terminen sus hilos.
+    void StopSharded();
+
+private:
+    /// @brief Imprime el reparto de carga entre shards.
+    void PrintShardStats();
+
+    /// @brief Métricas de todos los shards en formato de texto de Prometheus.
+    std::string RenderMetrics();
+
+    /// @brief Lanza un hilo de bucle por shard.
+    void LaunchShardThreads();
+
+    /// @brief Pausa los shards y transfiere listeners y sesiones al proceso @p pid.
+    bool HandOff(SOCKET channel, DWORD pid);
+
+    /// @brief Marca el fin del modo sharded y despierta a @ref RunSharded().
+    void RequestStop();
+
+    /// @brief Espera a @ref RequestStop() y detiene los shards.
+    void WaitForStop();
+
+    /// @brief Manejador de señales de consola del modo daemon (hilo del sistema).
+    static BOOL WINAPI OnConsoleSignal(DWORD signal);
+
 private:
     int m_port;                       ///< Puerto TCP en el que escucha el servidor.
+    std::string m_address;             ///< Dirección local (`unix:`/`shm:`/`mem:`); vacía para TCP.
+    bool m_fastOpen = false;           ///< TCP Fast Open en los listeners.
+    bool m_relayOnly = false;          ///< Shards sin eco cifrado (solo enrutado).
+    std::chrono::milliseconds m_hibernateAfter{ 30000 }; ///< Inactividad antes de hibernar (0: nunca).
+    std::chrono::milliseconds m_heartbeatInterval{ 15000 }; ///< Silencio antes de un Ping (0: sin latido).
+    uint32_t m_maxMissedPings = 3;     ///< Pings sin respuesta antes de cerrar una sesión.
+    std::shared_ptr<TrafficRecorder> m_capture; ///< Captura compartida por los shards (opcional).
+    UserDirectory m_directory;         ///< Usuarios registrados en el relay (todos los shards).
+    RoomDirectory m_rooms;             ///< Salas del relay (todos los shards).
     SOCKET m_clientSock;               ///< Socket del cliente conectado.
-    NetworkHelper m_net;               ///< Utilidad de red para envo/recepcin.
-    CryptoHelper m_crypto;             ///< Utilidad criptogrfica para RSA/AES.
-    std::thread m_rxThread;            ///< Hilo de recepcin de mensajes.
+    NetworkHelper m_net;               ///< Utilidad de red para envío/recepción.
+    std::shared_ptr<const ServerIdentity> m_identity; ///< Par RSA del servidor (compartido con los shards).
+    CryptoHelper m_crypto;             ///< Clave AES de la sesión del modo de un cliente.
+    std::thread m_rxThread;            ///< Hilo de recepción de mensajes.
+    std::mutex m_sendMutex;            ///< Serializa los envíos de la consola y los Pong del hilo de recepción.
     std::atomic<bool> m_running{ false };///< Bandera de control para bucles activos.
+    std::vector<std::unique_ptr<ServerShard>> m_shards; ///< Reactores del modo sharded.
+    std::vector<std::thread> m_shardThreads;           ///< Un hilo por shard.
+    std::mutex m_shardsMutex;                          ///< Protege m_shards frente a consola y traspaso.
+    std::mutex m_stateMutex;                           ///< Acompaña a m_stateCv.
+    std::condition_variable m_stateCv;                 ///< Señala la parada del modo sharded.
+    LiveUpgrade m_upgrade;                             ///< Canal de actualización en caliente.
+    std::thread m_upgradeThread;                       ///< Espera al proceso sucesor.
+    AdminEndpoint m_admin;                             ///< Endpoint de métricas.
 };
@@ -0,0 +1,73 @@
+/**
+ * @file ServerIdentity.h
+ * @brief Par RSA de identidad del servidor, único e inmutable, compartido por todas las sesiones.
+ *
+ * @details
+ * El servidor tiene una sola clave privada: el @ref Server y todos sus
+ * @ref ServerShard comparten la misma instancia (`std::shared_ptr<const ServerIdentity>`).
+ * Al construirla se genera el par, se serializa la PEM pública una vez y se
+ * ejecuta una operación privada de prueba, de modo que los contextos de
+ * Montgomery y el blinding de OpenSSL quedan calculados antes de que la usen
+ * varios hilos. A partir de ahí el objeto solo se lee.
+ *
+ * Las sesiones no guardan ninguna clave RSA: su @ref CryptoHelper contiene
+ * solo la clave AES negociada.
+ *
+ * @note Seguro para hilos: todos los métodos públicos son `const`.
+ */
+
+#pragma once
+#include "Prerequisites.h"
+#include "openssl\rsa.h"
+
+/**
+ * @class ServerIdentity
+ * @brief Clave privada del servidor con sus contextos precalculados.
+ */
+class ServerIdentity {
+public:
+    /**
+     * @brief Genera el par RSA-2048 y precalcula la PEM y los contextos privados.
+     * @throw std::runtime_error si OpenSSL no puede generar o usar la clave.
+     */
+    ServerIdentity();
+
+    /**
+     * @brief Reconstruye una identidad exportada con @ref ExportPrivateKey().
+     * @param privateKeyDer Clave privada RSA en DER (PKCS#1).
+     * @throw std::runtime_error si la clave no es válida.
+     * @note Lo usa el sucesor de un traspaso en caliente: los clientes a medio
+     *       handshake ya recibieron la PEM pública del proceso anterior.
+     */
+    explicit ServerIdentity(const std::vector<unsigned char>& privateKeyDer);
+
+    /// @brief Destructor: libera el par RSA.
+    ~ServerIdentity();
+
+    ServerIdentity(const ServerIdentity&) = delete;
+    ServerIdentity& operator=(const ServerIdentity&) = delete;
+
+    /// @brief Clave pública en PEM, tal como se envía al cliente en el handshake.
+    const std::string& GetPublicKeyString() const { return m_publicPem; }
+
+    /**
+     * @brief Descifra con la clave privada una clave AES envuelta por un cliente.
+     * @param encryptedKey Clave AES cifrada con RSA-OAEP (256 bytes).
+     * @return Clave AES de 32 bytes, o vacío si el bloque no es válido.
+     * @note Puede llamarse desde varios hilos a la vez.
+     */
+    std::vector<unsigned char> UnwrapAESKey(const std::vector<unsigned char>& encryptedKey) const;
+
+    /**
+     * @brief Clave privada en DER (PKCS#1), para transferirla al proceso sucesor.
+     * @warning Contiene la clave privada en claro.
+     */
+    std::vector<unsigned char> ExportPrivateKey() const;
+
+private:
+    /// @brief Serializa la PEM pública y ejecuta la operación privada de prueba.
+    void Prepare();
+
+    RSA* m_keyPair = nullptr;                        ///< Par RSA (solo lectura tras el constructor).
+    std::string m_publicPem;                         ///< PEM pública serializada una vez.
+};
@@ -0,0 +1,429 @@
+/**
+ * @file ServerShard.h
+ * @brief Reactor de un solo hilo que acepta y atiende su propio subconjunto de sesiones.
+ *
+ * @details
+ * En modo "sharded" el servidor lanza un @ref ServerShard por núcleo. Cada shard:
+ *  - Posee su propio listener (`SO_REUSEPORT`) o comparte el del shard 0 en Winsock.
+ *  - Ejecuta su propio bucle de eventos con `WSAPoll` sobre sockets no bloqueantes.
+ *  - Es dueño exclusivo de sus sesiones: no hay traspaso entre hilos en el camino caliente.
+ *  - Descifra el handshake con la @ref ServerIdentity del servidor, compartida e inmutable.
+ *
+ * @note Los mensajes descifrados se devuelven cifrados al mismo cliente (eco),
+ *       lo que permite medir el servidor con varios clientes concurrentes.
+ *       Los frames enrutados (ver @ref Frame) se reenvían sin descifrar al
+ *       usuario destino, en este shard o en otro a través de su buzón; los
+ *       dirigidos a una sala se serializan una vez y se reparten por puntero.
+ *       Las sesiones establecidas sin tráfico se hibernan (ver @ref HibernatedSession)
+ *       y se reconstruyen al recibir datos o un frame para ellas.
+ *       Plazos de handshake e inactividad: @ref TimerWheel del propio shard.
+ *       Las sesiones calladas reciben un Ping (@ref Heartbeat); las que no
+ *       responden a varios seguidos se cierran y liberan socket y buffers.
+ */
+
+#pragma once
+#include "NetworkHelper.h"
+#include "CryptoHelper.h"
+#include "ServerIdentity.h"
+#include "Session.h"
+#include "TimerWheel.h"
+#include "Metrics.h"
+#include "Logger.h"
+#include "UserDirectory.h"
+#include "RoomDirectory.h"
+#include "Prerequisites.h"
+
+/**
+ * @class ServerShard
+ * @brief Bucle de eventos con listener y sesiones propias.
+ *
+ * @par Flujo típico de uso:
+ *  1. Construir `ServerShard(index, port, identity)`.
+ *  2. `Listen()` para abrir el listener propio, o `ShareListener()` para usar uno existente.
+ *  3. `Run()` en un hilo dedicado.
+ *  4. `Stop()` desde otro hilo para despertar y terminar el bucle.
+ */
+class ServerShard {
+public:
+    /**
+     * @brief Construye el shard.
+     * @param index Índice del shard (0..N-1).
+     * @param port Puerto TCP en el que escucha el servidor.
+     * @param identity Par RSA del servidor, el mismo para todos los shards.
+     */
+    ServerShard(int index, int port, std::shared_ptr<const ServerIdentity> identity);
+
+    /// @brief Destructor: cierra las sesiones abiertas y los sockets de despertar.
+    ~ServerShard();
+
+    /**
+     * @brief Abre un listener propio con `SO_REUSEPORT`.
+     * @param fastOpen Activa TCP Fast Open: la clave pública del cliente puede llegar en el SYN.
+     * @return true si el listener quedó en modo escucha.
+     */
+    bool Listen(bool fastOpen = false);
+
+    /**
+     * @brief Abre un listener propio en una dirección local en lugar del puerto.
+     * @param address `unix:<ruta>`; los transportes sin socket (`shm:`, `mem:`)
+     *        no sirven al bucle de WSAPoll.
+     * @return true si el listener quedó en modo escucha.
+     * @note Un socket AF_UNIX no admite `SO_REUSEPORT`: los demás shards lo comparten.
+     */
+    bool ListenLocal(const std::string& address);
+
+    /**
+     * @brief Usa un listener creado por otro shard (modo Winsock sin `SO_REUSEPORT`).
+     * @param listener Socket en modo escucha; el shard no lo cierra.
+     */
+    void ShareListener(SOCKET listener);
+
+    /**
+     * @brief Toma posesión de un listener heredado de otro proceso (actualización en caliente).
+     * @param listener Socket en modo escucha; el shard lo cerrará al destruirse.
+     */
+    void AdoptListener(SOCKET listener);
+
+    /// @brief Indica si el shard es dueño de su listener (lo cierra al destruirse).
+    bool OwnsListener() const { return m_net.m_serverSocket != INVALID_SOCKET; }
+
+    /**
+     * @brief Incorpora una sesión heredada de otro proceso.
+     * @param session Sesión con socket, estado criptográfico y buffers pendientes.
+     *        Si sigue en handshake, lo completa con la identidad del shard en un plazo nuevo.
+     * @pre El bucle del shard no debe estar en ejecución.
+     */
+    void AdoptSession(std::unique_ptr<Session> session);
+
+    /**
+     * @brief Extrae las sesiones abiertas, también las que siguen en handshake.
+     * @param out Vector al que se añaden las sesiones extraídas.
+     * @pre El bucle del shard debe haberse detenido con @ref Stop().
+     */
+    void ExtractSessions(std::vector<std::unique_ptr<Session>>& out);
+
+    /// @brief Rearma la bandera del bucle tras un @ref Stop() (p.ej. si un traspaso falla).
+    void Resume() { m_running = true; }
+
+    /**
+     * @brief Listener que atiende este shard.
+     * @return Socket de escucha o INVALID_SOCKET.
+     */
+    SOCKET GetListener() const { return m_listenSock; }
+
+    /**
+     * @brief Registra el conjunto de shards para equilibrar aceptaciones.
+     * @param shards Vector con todos los shards del servidor (incluido este).
+     * @note Con un listener compartido, un shard cede la aceptación si tiene
+     *       más sesiones que el shard menos cargado.
+     */
+    void SetPeers(const std::vector<std::unique_ptr<ServerShard>>* shards) { m_peers = shards; }
+
+    /**
+     * @brief Asocia el directorio de usuarios compartido por todos los shards.
+     * @param directory Directorio del servidor (debe vivir más que el shard).
+     */
+    void SetDirectory(UserDirectory* directory) { m_directory = directory; }
+
+    /**
+     * @brief Asocia el registro de salas compartido por todos los shards.
+     * @param rooms Salas del servidor (debe vivir más que el shard).
+     */
+    void SetRooms(RoomDirectory* rooms) { m_rooms = rooms; }
+
+    /**
+     * @brief Modo relay: descarta los frames sin enrutar en lugar de descifrarlos.
+     * @param enabled true para que el shard nunca use AES en el camino de mensajes.
+     */
+    void SetRelayOnly(bool enabled) { m_relayOnly = enabled; }
+
+    /**
+     * @brief Graba la forma de cada frame recibido de los clientes.
+     * @param capture Grabador compartido entre shards; nullptr para no capturar.
+     * @pre Llamar antes de @ref Run().
+     */
+    void SetCapture(std::shared_ptr<TrafficRecorder> capture) { m_capture = std::move(capture); }
+
+    /**
+     * @brief Tiempo sin tráfico tras el que una sesión establecida se hiberna.
+     * @param idle Inactividad mínima; cero desactiva la hibernación.
+     * @pre Llamar antes de @ref Run().
+     */
+    void SetHibernateAfter(std::chrono::milliseconds idle) { m_hibernateAfter = idle; }
+
+    /**
+     * @brief Latido de aplicación con las sesiones establecidas.
+     * @param interval Silencio del cliente tras el que se le envía un Ping; cero lo desactiva.
+     * @param maxMissed Pings seguidos sin tráfico de vuelta antes de cerrar la sesión.
+     * @pre Llamar antes de @ref Run().
+     * @note Las sesiones hibernadas también reciben Ping, sin reconstruirlas.
+     */
+    void SetHeartbeat(std::chrono::milliseconds interval, uint32_t maxMissed) {
+        m_heartbeatInterval = interval;
+        m_maxMissedPings = maxMissed;
+    }
+
+    /**
+     * @brief Entrega un frame a una sesión de este shard desde otro hilo.
+     * @param sessionId Sesión destino.
+     * @param frame Frame serializado (compartido, no se copia).
+     * @param tail Resto del frame en otro buffer compartido (p.ej. el cuerpo de un sobre), o nullptr.
+     * @note Seguro desde cualquier hilo: encola en el buzón y despierta el bucle.
+     */
+    void Deliver(uint64_t sessionId, FrameBuffer frame, FrameBuffer tail = nullptr);
+
+    /**
+     * @brief Entrega el mismo frame a varias sesiones de este shard desde otro hilo.
+     * @param sessionIds Sesiones destino.
+     * @param frame Frame serializado, compartido por todas las sesiones.
+     * @param tail Resto del frame en otro buffer compartido, o nullptr.
+     * @note Un solo bloqueo del buzón y un solo despertar para todo el lote.
+     */
+    void DeliverBatch(std::vector<uint64_t> sessionIds, FrameBuffer frame, FrameBuffer tail = nullptr);
+
+    /**
+     * @brief Bucle de eventos del shard.
+     * @warning Bloquea el hilo actual hasta @ref Stop().
+     */
+    void Run();
+
+    /// @brief Solicita la parada del bucle y lo despierta. Seguro desde cualquier hilo.
+    void Stop();
+
+    /// @brief Índice del shard.
+    int GetIndex() const { return m_index; }
+
+    /// @brief Sesiones abiertas actualmente en este shard.
+    size_t GetSessionCount() const { return m_sessionCount.load(std::memory_order_relaxed); }
+
+    /// @brief Total de conexiones aceptadas por este shard.
+    uint64_t GetAcceptedCount() const { return m_accepted.load(std::memory_order_relaxed); }
+
+    /// @brief Total de frames recibidos por este shard.
+    uint64_t GetMessageCount() const { return m_messages.load(std::memory_order_relaxed); }
+
+    /// @brief Total de frames reenviados sin descifrar.
+    uint64_t GetRoutedCount() const { return m_routed.load(std::memory_order_relaxed); }
+
+    /// @brief Total de entregas a miembros de salas originadas en este shard.
+    uint64_t GetFanOutCount() const { return m_fanOut.load(std::memory_order_relaxed); }
+
+    /// @brief Total de entregas de sobres (una por destinatario) originadas en este shard.
+    uint64_t GetEnvelopeCount() const { return m_envelopes.load(std::memory_order_relaxed); }
+
+    /// @brief Total de commits del árbol de claves admitidos y repartidos por este shard.
+    uint64_t GetCommitCount() const { return m_commits.load(std::memory_order_relaxed); }
+
+    /// @brief Sesiones hibernadas actualmente (incluidas en @ref GetSessionCount()).
+    size_t GetHibernatedCount() const { return m_hibernatedCount.load(std::memory_order_relaxed); }
+
+    /// @brief Sesiones (activas o hibernadas) con al menos una muestra de RTT.
+    size_t GetRttSessionCount() const { return m_rttSessions.load(std::memory_order_relaxed); }
+
+    /// @brief Media del RTT suavizado de las sesiones con muestra.
+    std::chrono::microseconds GetMeanRtt() const;
+
+    /// @brief Media del jitter de las sesiones con muestra.
+    std::chrono::microseconds GetMeanJitter() const;
+
+    /// @brief Total de sesiones cerradas por no responder al latido.
+    uint64_t GetReapedCount() const { return m_reaped.load(std::memory_order_relaxed); }
+
+    /// @brief Contadores e histogramas del hilo del shard (lectura desde cualquier hilo).
+    const ShardMetrics& GetMetrics() const { return m_metrics; }
+
+private:
+    friend class Benchmark;  ///< Mide RouteToRoom y FanOut con sesiones sin socket.
+
+    /// @brief Acepta todas las conexiones pendientes del listener.
+    void AcceptPending();
+
+    /// @brief Indica si este shard debe ceder la aceptación a otro menos cargado.
+    bool ShouldYieldAccept() const;
+
+    /// @brief Lee del socket y procesa handshake o frames.
+    void OnReadable(Session& session);
+
+    /// @brief Vacía la cola de envío tanto como permita el socket.
+    void OnWritable(Session& session);
+
+    /// @brief Avanza el handshake con los bytes disponibles en @p session.rx.
+    void ProcessHandshake(Session& session);
+
+    /// @brief Extrae frames IV/len/cipher completos de @p session.rx.
+    void ProcessFrames(Session& session);
+
+    /// @brief Reenvía un frame enrutado al shard y sesión del destino.
+    void RouteFrame(Session& session, const unsigned char* frame, const FrameHeader& header);
+
+    /**
+     * @brief Reparte un frame dirigido a una sala entre sus miembros.
+     * @details Un @ref Frame::RoomCommit solo se reparte si es el primero sobre la
+     *          época vigente (@ref RoomDirectory::AdvanceEpoch) y llega también
+     *          al emisor, que así sabe que su commit ganó.
+     */
+    void RouteToRoom(Session& session, const unsigned char* frame, const FrameHeader& header);
+
+    /**
+     * @brief Encola el mismo frame en todos los miembros salvo @p exceptUser.
+     * @details Miembros locales: un puntero más en su cola de envío. Miembros de
+     *          otros shards: se agrupan en un lote por shard (@ref DeliverBatch).
+     */
+    void FanOut(const std::vector<RoomMember>& members, const FrameBuffer& frame, uint32_t exceptUser);
+
+    /**
+     * @brief Reparte un sobre: a cada destinatario su envoltura y el cuerpo compartido.
+     * @details El cuerpo se copia una vez a un @ref FrameBuffer; por destinatario
+     *          solo se construye la cabecera con su envoltura (unos 300 bytes),
+     *          que conserva el sello de envío si el sobre lo trae.
+     */
+    void RouteEnvelope(Session& session, const unsigned char* payload, const FrameHeader& header);
+
+    /// @brief Atiende un frame de control (registro, claves, salas y sobres).
+    void HandleControl(Session& session, const unsigned char* frame, const FrameHeader& header);
+
+    /// @brief Une la sesión a una sala y avisa a los demás miembros con su clave de hoja.
+    void JoinRoom(Session& session, uint32_t roomId, const unsigned char* leafKey, size_t leafKeySize);
+
+    /// @brief Saca la sesión de una sala y, si @p notify, avisa a los que quedan.
+    void LeaveRoom(Session& session, uint32_t roomId, bool notify);
+
+    /**
+     * @brief Avisa a los miembros de una sala de un alta o una baja.
+     * @details El aviso nombra al responsable (@ref RoomDirectory::Sponsor) de
+     *          emitir el commit que añade o quita la hoja del usuario.
+     */
+    void NotifyRoom(uint32_t roomId, uint32_t userId, bool joined,
+        const unsigned char* leafKey = nullptr, size_t leafKeySize = 0);
+
+    /// @brief Quita la sesión de su usuario y de sus salas (cierre o traspaso).
+    void Unregister(Session& session, bool notify);
+
+    /// @brief Procesa los frames entregados por otros shards.
+    void DrainInbox();
+
+    /// @brief Encola un frame (y su @p tail, si lo hay) en una sesión propia si sigue establecida.
+    void DeliverLocal(uint64_t sessionId, FrameBuffer frame, FrameBuffer tail = nullptr);
+
+    /// @brief Serializa y encola un frame.
+    void QueueFrame(Session& session, const Frame& frame);
+
+    /// @brief Encola un Ping o Pong sin contarlo como actividad (no retrasa la hibernación).
+    void QueueHeartbeat(Session& session, const Frame& frame);
+
+    /// @brief Cifra @p plaintext y encola el eco con el sello de envío de @p request, si lo trae.
+    void QueueEncrypted(Session& session, const std::string& plaintext, const FrameHeader& request);
+
+    /// @brief Encola un buffer ya serializado y, contiguo a él, su @p tail opcional.
+    void Queue(Session& session, FrameBuffer frame, FrameBuffer tail = nullptr);
+
+    /// @brief Registra una sesión nueva o heredada en el shard.
+    Session& AddSession(std::unique_ptr<Session> session);
+
+    /// @brief Cierra el socket y elimina la sesión.
+    void CloseSession(uint64_t id);
+
+    /// @brief Descuenta de las métricas de cola lo que aún espera en la sesión (cierre o traspaso).
+    void ForgetQueue(const Session& session);
+
+    /// @brief Tipos de temporizador del shard (el dueño es siempre el id de sesión).
+    enum TimerKind : uint32_t {
+        HandshakeTimer,                            ///< Plazo para completar el handshake.
+        IdleTimer,                                 ///< Revisión de inactividad (hibernación).
+        HeartbeatTimer                             ///< Revisión del latido (activa o hibernada).
+    };
+
+    /**
+     * @brief Atiende un temporizador vencido.
+     * @details Los temporizadores no se cancelan al cerrar o hibernar: si la
+     *          sesión ya no está activa el vencimiento se ignora.
+     */
+    void OnTimer(const TimerWheel::Expired& timer);
+
+    /// @brief Programa la revisión de inactividad de una sesión establecida.
+    void ArmIdleTimer(const Session& session, std::chrono::milliseconds delay);
+
+    /// @brief Programa la próxima revisión del latido de la sesión @p id.
+    void ArmHeartbeat(uint64_t id, std::chrono::milliseconds delay);
+
+    /**
+     * @brief Revisa el latido de una sesión activa o hibernada.
+     * @details Con tráfico reciente solo se reprograma; si no, envía un Ping o,
+     *          tras @ref m_maxMissedPings sin respuesta, cierra la sesión. Un
+     *          Ping que no cabe en el socket de una sesión hibernada se reintenta pronto.
+     */
+    void OnHeartbeat(uint64_t id);
+
+    /// @brief Añade una muestra de RTT a @p heartbeat y a las medias del shard.
+    void SampleRtt(Heartbeat& heartbeat, const unsigned char* payload, size_t size);
+
+    /// @brief Quita de las medias del shard una sesión que deja el shard.
+    void ForgetRtt(const Heartbeat& heartbeat);
+
+    /**
+     * @brief Compacta una sesión en un @ref HibernatedSession y libera el resto.
+     * @details Mantiene el id: directorio y salas siguen apuntando a ella.
+     */
+    void Hibernate(std::unique_ptr<Session> session);
+
+    /**
+     * @brief Reconstruye una sesión hibernada.
+     * @return La sesión activa, o nullptr si @p id no está hibernada.
+     */
+    Session* Wake(uint64_t id);
+
+    /**
+     * @brief Lee de una sesión hibernada con datos pendientes.
+     * @details Si solo llegan Ping/Pong completos se atienden sobre el registro
+     *          compacto; cualquier otra cosa la reconstruye con esos bytes en @ref Session::rx.
+     * @return La sesión reconstruida, o nullptr si no hace falta.
+     */
+    Session* ReadHibernated(uint64_t id);
+
+private:
+    int m_index;                                   ///< Índice del shard.
+    int m_port;                                    ///< Puerto de escucha.
+    NetworkHelper m_net;                           ///< Red del shard (dueño del listener propio).
+    SOCKET m_listenSock = INVALID_SOCKET;          ///< Listener propio o compartido.
+    SOCKET m_wakeRecv = INVALID_SOCKET;            ///< Extremo que vigila el bucle.
+    SOCKET m_wakeSend = INVALID_SOCKET;            ///< Extremo que escribe Stop().
+    std::shared_ptr<const ServerIdentity> m_identity; ///< Par RSA compartido del servidor.
+    FrameBuffer m_identityPem;                     ///< Clave pública PEM lista para encolar.
+    std::unordered_map<uint64_t, std::unique_ptr<Session>> m_sessions; ///< Sesiones propias.
+    std::unordered_map<uint64_t, HibernatedSession> m_hibernated; ///< Sesiones propias sin tráfico.
+    std::chrono::milliseconds m_hibernateAfter{ 30000 }; ///< Inactividad antes de hibernar (0: nunca).
+    std::chrono::milliseconds m_heartbeatInterval{ 15000 }; ///< Silencio antes de un Ping (0: sin latido).
+    uint32_t m_maxMissedPings = 3;                 ///< Pings sin respuesta antes de cerrar.
+    std::chrono::steady_clock::time_point m_now;   ///< Reloj del bucle (una lectura por iteración).
+    TimerWheel m_timers;                           ///< Plazos de las sesiones del shard.
+    std::vector<TimerWheel::Expired> m_expired;    ///< Vencidos de la iteración (se reutiliza).
+    const std::vector<std::unique_ptr<ServerShard>>* m_peers = nullptr; ///< Todos los shards.
+    uint64_t m_nextSessionId;                      ///< Próximo id (índice en los bits altos).
+    std::atomic<bool> m_running{ false };          ///< Bandera del bucle.
+    std::atomic<size_t> m_sessionCount{ 0 };       ///< Sesiones abiertas (lectura externa).
+    std::atomic<uint64_t> m_accepted{ 0 };         ///< Conexiones aceptadas.
+    std::atomic<uint64_t> m_messages{ 0 };         ///< Mensajes procesados.
+    std::atomic<uint64_t> m_routed{ 0 };           ///< Frames reenviados.
+    std::atomic<uint64_t> m_fanOut{ 0 };           ///< Entregas a miembros de salas.
+    std::atomic<uint64_t> m_envelopes{ 0 };        ///< Entregas de sobres.
+    std::atomic<uint64_t> m_commits{ 0 };          ///< Commits de salas admitidos.
+    std::atomic<size_t> m_hibernatedCount{ 0 };    ///< Sesiones hibernadas (lectura externa).
+    std::atomic<size_t> m_rttSessions{ 0 };        ///< Sesiones con muestra de RTT.
+    std::atomic<uint64_t> m_rttSumUs{ 0 };         ///< Suma de sus RTT suavizados (µs).
+    std::atomic<uint64_t> m_jitterSumUs{ 0 };      ///< Suma de sus jitter (µs).
+    std::atomic<uint64_t> m_reaped{ 0 };           ///< Sesiones cerradas por el latido.
+    ShardMetrics m_metrics;                        ///< Métricas del hilo (línea de caché propia).
+    UserDirectory* m_directory = nullptr;          ///< Directorio compartido de usuarios.
+    RoomDirectory* m_rooms = nullptr;              ///< Salas compartidas.
+    bool m_relayOnly = false;                      ///< Descartar frames sin enrutar.
+    std::shared_ptr<TrafficRecorder> m_capture;    ///< Captura de los frames recibidos (opcional).
+
+    /// @brief Frame de otro shard y las sesiones locales que lo reciben.
+    struct InboxBatch {
+        std::vector<uint64_t> sessionIds;          ///< Sesiones destino.
+        FrameBuffer frame;                         ///< Frame compartido.
+        FrameBuffer tail;                          ///< Resto del frame (opcional).
+    };
+    std::mutex m_inboxMutex;                       ///< Protege @ref m_inbox.
+    std::vector<InboxBatch> m_inbox;               ///< Frames de otros shards.
+};
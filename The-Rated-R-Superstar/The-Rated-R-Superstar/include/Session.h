@@ -0,0 +1,85 @@
+/**
+ * @file Session.h
+ * @brief Estado de una conexión de cliente gestionada por un shard del servidor.
+ *
+ * @details
+ * Cada sesión pertenece a un único @ref ServerShard y solo es tocada por el hilo
+ * de ese shard, por lo que no requiere sincronización. Contiene:
+ *  - El socket no bloqueante del cliente.
+ *  - El estado del handshake RSA/AES.
+ *  - El @ref CryptoHelper con la clave AES de la sesión (solo estado simétrico:
+ *    la clave privada es la @ref ServerIdentity compartida del servidor).
+ *  - La PEM del cliente, compartida con el @ref UserDirectory al registrarse.
+ *  - El buffer de recepción pendiente de procesar.
+ *  - La cola de envío con frames inmutables compartibles.
+ *  - El @ref Heartbeat: RTT suavizado, jitter y pings sin respuesta.
+ *
+ * Una sesión establecida que pasa un tiempo sin tráfico se compacta en un
+ * @ref HibernatedSession (socket, clave AES, contadores y salas) y se libera
+ * todo lo demás; el shard la reconstruye cuando vuelve a haber tráfico. Los
+ * latidos no cuentan como tráfico: se atienden sin reconstruirla.
+ */
+
+#pragma once
+#include "NetworkHelper.h"
+#include "CryptoHelper.h"
+#include "Heartbeat.h"
+#include "Trace.h"
+#include "Prerequisites.h"
+
+/**
+ * @enum SessionState
+ * @brief Fases del handshake y vida de una sesión.
+ */
+enum class SessionState {
+    AwaitingPeerKey,   ///< Clave pública del servidor enviada; esperando la PEM del cliente.
+    AwaitingAESKey,    ///< Esperando la clave AES cifrada con RSA (256 bytes).
+    Established,       ///< Canal AES listo; se intercambian frames IV/len/cipher.
+    Closing            ///< Marcada para cierre al final de la iteración del bucle.
+};
+
+/// @brief Frame ya serializado, inmutable y compartible entre colas de envío.
+using FrameBuffer = std::shared_ptr<const std::vector<unsigned char>>;
+
+/**
+ * @struct Session
+ * @brief Conexión de un cliente dentro de un shard.
+ */
+struct Session {
+    uint64_t id = 0;                              ///< Identificador único dentro del proceso.
+    SOCKET sock = INVALID_SOCKET;                 ///< Socket no bloqueante del cliente.
+    SessionState state = SessionState::AwaitingPeerKey; ///< Fase actual.
+    CryptoHelper crypto;                          ///< Clave AES de la sesión (sin claves RSA).
+    std::shared_ptr<const std::string> peerPem;   ///< Clave pública del cliente, validada en el handshake.
+    std::vector<unsigned char> rx;                ///< Bytes recibidos aún sin procesar.
+    std::deque<FrameBuffer> txQueue;              ///< Frames pendientes de enviar.
+    size_t txOffset = 0;                          ///< Bytes ya enviados del primer frame.
+    uint64_t messagesIn = 0;                      ///< Frames recibidos.
+    uint64_t messagesOut = 0;                     ///< Mensajes encolados hacia el cliente.
+    uint32_t userId = 0;                          ///< Usuario registrado en el relay (0: ninguno).
+    std::vector<uint32_t> rooms;                  ///< Salas del relay a las que pertenece.
+    std::chrono::steady_clock::time_point acceptedAt; ///< Aceptación (latencia del handshake).
+    uint64_t traceId = 0;                         ///< Traza del handshake (0: sin muestrear).
+    std::chrono::steady_clock::time_point lastActivity = std::chrono::steady_clock::now(); ///< Último tráfico (sin contar latidos).
+    Heartbeat heartbeat;                          ///< Latido: última señal de vida y RTT.
+};
+
+/**
+ * @struct HibernatedSession
+ * @brief Registro mínimo de una sesión establecida sin tráfico.
+ *
+ * @details
+ * Conserva solo lo necesario para reconstruir la @ref Session: no hay
+ * @ref CryptoHelper, ni buffers, ni cola de envío. La PEM del peer es el
+ * mismo buffer que la sesión compartía con el @ref UserDirectory.
+ */
+struct HibernatedSession {
+    SOCKET sock = INVALID_SOCKET;                 ///< Socket del cliente (sigue vigilado por WSAPoll).
+    uint32_t userId = 0;                          ///< Usuario registrado en el relay (0: ninguno).
+    unsigned char aesKey[32] = {};                ///< Clave AES-256 de la sesión.
+    uint64_t messagesIn = 0;                      ///< Frames recibidos.
+    uint64_t messagesOut = 0;                     ///< Mensajes encolados hacia el cliente.
+    std::shared_ptr<const std::string> peerPem;   ///< Clave pública del peer (compartida).
+    std::vector<uint32_t> rooms;                  ///< Salas (capacidad ajustada al tamaño).
+    Heartbeat heartbeat;                          ///< Latido: sigue activo mientras hiberna.
+};
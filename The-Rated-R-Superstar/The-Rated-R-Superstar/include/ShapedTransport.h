@@ -0,0 +1,154 @@
+/**
+ * @file ShapedTransport.h
+ * @brief Emulador de condiciones de red: retardo, jitter, ancho de banda, pérdidas y cortes.
+ *
+ * @details
+ * @ref ShapedTransport envuelve otro @ref Transport (o un socket) y altera su
+ * comportamiento como lo haría un enlace malo, sin hardware de WAN:
+ *  - **Retardo y jitter**: cada tramo se entrega tras `delay ± jitter`, sin
+ *    reordenar bytes (como en TCP, un tramo nunca adelanta al anterior).
+ *  - **Ancho de banda**: los tramos se serializan a `bandwidth` bytes/s antes
+ *    del retardo de propagación, en cada sentido por separado.
+ *  - **Pérdidas**: TCP no pierde bytes, los retransmite; una pérdida se emula
+ *    como una espera de retransmisión que retiene ese tramo y los siguientes.
+ *  - **Escrituras parciales y lecturas cortas**: `Send` acepta y `Receive`
+ *    devuelve como mucho un número al azar de bytes, para ejercitar los bucles
+ *    de @ref NetworkHelper::SendAll y @ref NetworkHelper::ReceiveExact.
+ *  - **Cortes**: con cierta probabilidad por operación, o tras un número de
+ *    bytes, la conexión se corta con RST y ambos sentidos fallan.
+ *
+ * Se activa con @ref NetworkHelper::SetNetworkConditions (o `--netem` en el
+ * cliente) y se aplica en el extremo local a ambos sentidos: el servidor no
+ * necesita cambios.
+ *
+ * @note Las condiciones se describen con @ref NetworkConditions::Parse, p.ej.
+ *       `delay=80ms,jitter=20ms,bw=2mbit,loss=0.01,write=512,read=100`.
+ */
+
+#pragma once
+#include "Transport.h"
+#include "Prerequisites.h"
+#include <condition_variable>
+#include <deque>
+#include <random>
+#include <winsock2.h>
+
+/**
+ * @struct NetworkConditions
+ * @brief Parámetros del enlace emulado (los valores a cero no alteran nada).
+ */
+struct NetworkConditions {
+    std::chrono::microseconds delay{ 0 };            ///< Retardo de un sentido.
+    std::chrono::microseconds jitter{ 0 };           ///< Variación uniforme ± sobre @ref delay.
+    uint64_t bandwidth = 0;                          ///< Bytes/s por sentido (0: sin límite).
+    double loss = 0;                                 ///< Probabilidad de retransmitir un tramo.
+    size_t maxWrite = 0;                             ///< Bytes máximos aceptados por Send (0: todos).
+    size_t maxRead = 0;                              ///< Bytes máximos devueltos por Receive (0: los disponibles).
+    double resetChance = 0;                          ///< Probabilidad de corte por operación.
+    uint64_t resetAfter = 0;                         ///< Corte tras estos bytes en total (0: nunca).
+    uint32_t seed = 1;                               ///< Semilla: la misma da la misma secuencia.
+
+    /// @brief Indica si alguna condición altera el enlace.
+    bool Active() const;
+
+    /**
+     * @brief Interpreta `clave=valor` separados por comas, o un perfil.
+     * @param spec Claves: `delay`, `jitter` (`us`, `ms`, `s`), `bw` (`kbit`,
+     *        `mbit`, `kB`, `MB` o bytes/s), `loss`, `write`, `read`, `reset`,
+     *        `reset-after`, `seed`. Perfiles: `3g`, `edge`.
+     * @param out Condiciones resultantes.
+     * @return false si alguna clave o valor no es válido.
+     */
+    static bool Parse(const std::string& spec, NetworkConditions& out);
+};
+
+/**
+ * @class ShapedTransport
+ * @brief Transporte que aplica @ref NetworkConditions sobre otro.
+ */
+class ShapedTransport : public Transport {
+public:
+    /**
+     * @brief Envuelve @p inner, que pasa a pertenecer a este transporte.
+     * @param inner Transporte real ya conectado.
+     * @param conditions Condiciones del enlace.
+     */
+    ShapedTransport(std::shared_ptr<Transport> inner, const NetworkConditions& conditions);
+
+    /**
+     * @brief Envuelve un socket conectado, que pasa a pertenecer al transporte.
+     * @param socket Socket del sistema.
+     * @param conditions Condiciones del enlace.
+     */
+    static std::shared_ptr<ShapedTransport> ForSocket(SOCKET socket, const NetworkConditions& conditions);
+
+    /// @brief Destructor: entrega lo pendiente de enviar dentro del plazo de cierre,
+    ///        cierra el transporte real y espera a los hilos.
+    ~ShapedTransport() override;
+
+    int Send(const unsigned char* data, int len) override;
+    int Receive(unsigned char* out, int len) override;
+
+    /// @brief No admite más envíos; lo encolado que no salga en el plazo de cierre se descarta.
+    void Close() override;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief Tramo en vuelo; vacío marca el fin de flujo.
+    struct Chunk {
+        Clock::time_point release;                   ///< Instante de entrega.
+        std::vector<unsigned char> bytes;            ///< Datos.
+    };
+
+    /// @brief Cola de un sentido del enlace.
+    struct Direction {
+        std::mutex mutex;                            ///< Protege la cola y los relojes.
+        std::condition_variable changed;             ///< Avisa de tramos, espacio o cierre.
+        std::deque<Chunk> queue;                     ///< Tramos en vuelo, en orden.
+        size_t offset = 0;                           ///< Bytes ya leídos del primer tramo.
+        size_t queued = 0;                           ///< Bytes en la cola.
+        Clock::time_point linkFree;                  ///< Fin de la serialización en curso.
+        Clock::time_point lastRelease;               ///< Entrega del último tramo (sin reordenar).
+    };
+
+    /// @brief Constructor común; @p socket solo se usa para cortar con RST.
+    ShapedTransport(std::shared_ptr<Transport> inner, SOCKET socket, const NetworkConditions& conditions);
+
+    /// @brief Instante de entrega de @p bytes: ancho de banda, retardo, jitter y pérdidas.
+    Clock::time_point Schedule(Direction& direction, size_t bytes);
+
+    /// @brief Hilo de subida: escribe en el transporte real cada tramo a su hora.
+    void PumpUp();
+
+    /// @brief Hilo de bajada: lee del transporte real y encola con su hora de entrega.
+    void PumpDown();
+
+    /// @brief Cuenta @p bytes y decide si toca cortar la conexión.
+    bool ShouldReset(size_t bytes);
+
+    /// @brief Corta la conexión: RST si es un socket y error en ambos sentidos.
+    void Reset();
+
+    /// @brief Número al azar en [0, 1).
+    double Chance();
+
+    /// @brief Número al azar en [1, @p limit].
+    size_t Limit(size_t limit);
+
+private:
+    std::shared_ptr<Transport> m_inner;              ///< Transporte real.
+    SOCKET m_socket = INVALID_SOCKET;                ///< Socket real si lo hay (para el RST).
+    NetworkConditions m_conditions;                  ///< Condiciones del enlace.
+    std::mutex m_rngMutex;                           ///< Protege @ref m_rng.
+    std::mt19937_64 m_rng;                           ///< Sorteos reproducibles.
+    Direction m_up;                                  ///< Local -> remoto.
+    Direction m_down;                                ///< Remoto -> local.
+    std::atomic<uint64_t> m_transferred{ 0 };        ///< Bytes en ambos sentidos.
+    std::atomic<bool> m_closing{ false };            ///< Close() local: no se aceptan más envíos.
+    std::atomic<bool> m_reset{ false };              ///< Conexión cortada.
+    Clock::time_point m_lingerUntil;                 ///< Fin del plazo de cierre (con @ref m_up.mutex).
+    bool m_upDone = false;                           ///< El hilo de subida terminó (con @ref m_up.mutex).
+    std::thread m_upPump;                            ///< Ver @ref PumpUp.
+    std::thread m_downPump;                          ///< Ver @ref PumpDown.
+};
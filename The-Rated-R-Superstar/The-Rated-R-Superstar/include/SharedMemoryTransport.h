@@ -0,0 +1,78 @@
+/**
+ * @file SharedMemoryTransport.h
+ * @brief Transporte entre procesos del mismo equipo sobre anillos SPSC en memoria compartida.
+ *
+ * @details
+ * Una región con nombre (`Local\e2ee-shm-<nombre>`) contiene dos anillos de un
+ * solo productor y un solo consumidor, uno por sentido. Cada extremo:
+ *  - Escribe bytes y publica la nueva cabeza con semántica release.
+ *  - Lee hasta la cabeza publicada y avanza la cola.
+ *  - Espera activamente unos microsegundos antes de dormir en un evento, de modo
+ *    que el caso caliente no hace llamadas al sistema.
+ *
+ * Se selecciona con la dirección `shm:<nombre>` en @ref NetworkHelper.
+ *
+ * @note Cada nombre admite una única conexión (un servidor y un cliente).
+ */
+
+#pragma once
+#include "Transport.h"
+#include "Prerequisites.h"
+#include <windows.h>
+
+/**
+ * @class SharedMemoryTransport
+ * @brief Extremo de una conexión por memoria compartida.
+ */
+class SharedMemoryTransport : public Transport {
+public:
+    /**
+     * @brief Crea la región compartida como servidor.
+     * @param name Nombre lógico (sin prefijo).
+     * @return Transporte a la espera del cliente, o nullptr si falla.
+     */
+    static std::shared_ptr<SharedMemoryTransport> Create(const std::string& name);
+
+    /**
+     * @brief Abre una región creada por un servidor y se anuncia como cliente.
+     * @param name Nombre lógico (sin prefijo).
+     * @return Transporte conectado, o nullptr si no existe o ya está ocupada.
+     */
+    static std::shared_ptr<SharedMemoryTransport> Open(const std::string& name);
+
+    /// @brief Destructor: cierra y libera la vista, la región y los eventos.
+    ~SharedMemoryTransport() override;
+
+    /**
+     * @brief Bloquea hasta que un cliente abra la región (solo servidor).
+     * @return true si el cliente se conectó; false si el transporte se cerró.
+     */
+    bool WaitForPeer();
+
+    int Send(const unsigned char* data, int len) override;
+    int Receive(unsigned char* out, int len) override;
+    void Close() override;
+
+private:
+    struct Ring;
+    struct Layout;
+
+    /// @brief Construye un extremo sin recursos (ver @ref Create / @ref Open).
+    explicit SharedMemoryTransport(bool isServer);
+
+    /// @brief Abre o crea la región y los eventos con nombre.
+    bool Map(const std::string& name, bool create);
+
+    /// @brief Indica si el peer cerró su extremo.
+    bool PeerClosed() const;
+
+private:
+    bool m_isServer;                 ///< true si creó la región.
+    HANDLE m_mapping = nullptr;      ///< Objeto de mapeo de archivo.
+    Layout* m_layout = nullptr;      ///< Vista de la región compartida.
+    Ring* m_tx = nullptr;            ///< Anillo donde este extremo escribe.
+    Ring* m_rx = nullptr;            ///< Anillo del que este extremo lee.
+    HANDLE m_txEvent = nullptr;      ///< Evento que despierta al lector del anillo de salida.
+    HANDLE m_rxEvent = nullptr;      ///< Evento en el que este extremo duerme al leer.
+    std::atomic<bool> m_closed{ false }; ///< Close() ya ejecutado.
+};
@@ -0,0 +1,130 @@
+/**
+ * @file TimerWheel.h
+ * @brief Rueda de temporizadores jerárquica para el bucle de eventos de un shard.
+ *
+ * @details
+ * Cuatro niveles de 64 casillas: el nivel 0 cubre 64 ticks, el 1 cubre
+ * 64² y así sucesivamente (con ticks de 10 ms, unas 46 horas por vuelta;
+ * un vencimiento más lejano espera en el último nivel y se recoloca al pasar).
+ * Programar y cancelar son O(1): el temporizador se enlaza en la casilla de
+ * su nivel. Al avanzar, cada vez que un nivel da la vuelta la casilla
+ * siguiente del nivel superior se redistribuye hacia abajo, de modo que cada
+ * temporizador se mueve como mucho una vez por nivel.
+ *
+ * Los nodos viven en un vector con lista libre y se enlazan por índice: con
+ * 100k temporizadores armados no hay una asignación por temporizador ni
+ * recorridos de la colección completa.
+ *
+ * Un temporizador no lleva callback: guarda un dueño (p.ej. el id de sesión)
+ * y un tipo, y @ref Advance() devuelve los vencidos para que el bucle decida.
+ *
+ * @note No es seguro para hilos: cada shard tiene su propia rueda.
+ */
+
+#pragma once
+#include "Prerequisites.h"
+
+/**
+ * @class TimerWheel
+ * @brief Temporizadores de un solo hilo con coste O(1) por operación.
+ *
+ * @par Flujo típico de uso:
+ *  1. `Schedule(delay, owner, kind)` al aceptar una sesión o al enviar un ping.
+ *  2. `NextTimeout()` para acotar la espera de `WSAPoll`.
+ *  3. `Advance(now, expired)` tras cada espera y atender los vencidos.
+ */
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief Identificador de un temporizador armado (índice y generación).
+    using TimerId = uint64_t;
+
+    /// @brief Id nulo: ningún temporizador.
+    static constexpr TimerId kNone = 0;
+
+    /// @brief Temporizador vencido.
+    struct Expired {
+        uint64_t owner;                          ///< Dueño indicado al programar.
+        uint32_t kind;                           ///< Tipo indicado al programar.
+    };
+
+    /**
+     * @brief Crea una rueda vacía.
+     * @param tick Resolución: los vencimientos se redondean hacia arriba a este paso.
+     * @param start Instante del tick 0.
+     */
+    explicit TimerWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(10),
+        Clock::time_point start = Clock::now());
+
+    /**
+     * @brief Arma un temporizador.
+     * @param delay Tiempo hasta el vencimiento, contado desde el último @ref Advance().
+     * @param owner Dueño (p.ej. id de sesión).
+     * @param kind Tipo definido por quien lo usa.
+     * @return Id para @ref Cancel().
+     */
+    TimerId Schedule(std::chrono::milliseconds delay, uint64_t owner, uint32_t kind);
+
+    /**
+     * @brief Desarma un temporizador.
+     * @return false si ya había vencido o el id no es válido.
+     */
+    bool Cancel(TimerId id);
+
+    /**
+     * @brief Avanza hasta @p now y recoge los temporizadores vencidos.
+     * @param now Instante actual.
+     * @param out Vector al que se añaden los vencidos, en orden de vencimiento por tick.
+     */
+    void Advance(Clock::time_point now, std::vector<Expired>& out);
+
+    /**
+     * @brief Espera máxima antes del próximo tick con trabajo.
+     * @param now Instante actual.
+     * @param limit Espera máxima a devolver.
+     * @return Entre 0 y @p limit; @p limit si no hay temporizadores.
+     * @note Con temporizadores en niveles superiores la espera no pasa de la
+     *       vuelta del nivel 0, para redistribuirlos a tiempo.
+     */
+    std::chrono::milliseconds NextTimeout(Clock::time_point now, std::chrono::milliseconds limit) const;
+
+    /// @brief Temporizadores armados.
+    size_t Size() const { return m_size; }
+
+private:
+    static constexpr int kLevels = 4;            ///< Niveles de la jerarquía.
+    static constexpr int kSlotBits = 6;          ///< log2 de las casillas por nivel.
+    static constexpr uint32_t kSlots = 1u << kSlotBits; ///< Casillas por nivel.
+    static constexpr uint32_t kNil = ~0u;        ///< Enlace vacío.
+
+    /// @brief Temporizador; libre si @ref slot es kNil.
+    struct Node {
+        uint64_t expires = 0;                    ///< Tick de vencimiento.
+        uint64_t owner = 0;                      ///< Dueño.
+        uint32_t kind = 0;                       ///< Tipo.
+        uint32_t generation = 0;                 ///< Distingue reutilizaciones del nodo.
+        uint32_t prev = kNil;                    ///< Anterior en la casilla.
+        uint32_t next = kNil;                    ///< Siguiente en la casilla (o en la lista libre).
+        uint32_t slot = kNil;                    ///< Casilla global (nivel * kSlots + índice).
+    };
+
+    /// @brief Enlaza un nodo en la casilla que corresponde a su vencimiento (o al máximo representable).
+    void Place(uint32_t index);
+
+    /// @brief Desenlaza un nodo de su casilla.
+    void Unlink(uint32_t index);
+
+    /// @brief Redistribuye la casilla actual del nivel @p level hacia niveles inferiores.
+    void Cascade(int level);
+
+private:
+    std::chrono::milliseconds m_tick;            ///< Resolución.
+    Clock::time_point m_start;                   ///< Instante del tick 0.
+    uint64_t m_current = 0;                      ///< Último tick procesado.
+    std::vector<Node> m_nodes;                   ///< Temporizadores (armados y libres).
+    uint32_t m_free = kNil;                      ///< Primer nodo libre.
+    uint32_t m_heads[kLevels * kSlots];          ///< Primer nodo de cada casilla.
+    uint64_t m_level0Mask = 0;                   ///< Casillas no vacías del nivel 0.
+    size_t m_size = 0;                           ///< Temporizadores armados.
+};
@@ -0,0 +1,105 @@
+/**
+ * @file Trace.h
+ * @brief Trazas de las fases del handshake exportables como eventos de Chrome (chrome://tracing, Perfetto).
+ *
+ * @details
+ * Cada conexión muestreada recibe un id de traza (@ref Tracer::BeginTrace) y
+ * cada fase se mide con un @ref TraceSpan en la pila:
+ * @code
+ *  uint64_t trace = Tracer::Instance().BeginTrace();
+ *  {
+ *      TraceSpan span(trace, "rsa_unwrap");
+ *      key = identity.UnwrapAESKey(wrapped);
+ *  }
+ * @endcode
+ * Con el trazador apagado o la conexión sin muestrear (id 0) un span no lee
+ * el reloj ni toma el mutex. Los eventos van a un anillo fijo que pisa los
+ * más antiguos; @ref Tracer::Dump() lo escribe como JSON de eventos completos
+ * (`"ph":"X"`), uno por fase, con el id de la conexión en `args`.
+ */
+
+#pragma once
+#include "Prerequisites.h"
+
+/**
+ * @struct TraceEvent
+ * @brief Una fase medida.
+ */
+struct TraceEvent {
+    const char* name = nullptr;                      ///< Literal con el nombre de la fase.
+    uint64_t traceId = 0;                            ///< Conexión a la que pertenece.
+    uint64_t startUs = 0;                            ///< Inicio, en µs desde el arranque del trazador.
+    uint64_t durationUs = 0;                         ///< Duración en µs.
+    uint32_t thread = 0;                             ///< Ordinal del hilo que la midió.
+};
+
+/**
+ * @class Tracer
+ * @brief Anillo de eventos de traza del proceso.
+ */
+class Tracer {
+public:
+    static constexpr size_t kCapacity = 8192;        ///< Eventos que se conservan.
+
+    /// @brief Trazador del proceso.
+    static Tracer& Instance();
+
+    /**
+     * @brief Activa el trazado.
+     * @param processName Nombre del proceso en el visor.
+     * @param sampleEvery Traza una de cada @p sampleEvery conexiones (0: ninguna).
+     */
+    void Enable(const std::string& processName, uint32_t sampleEvery = 1);
+
+    /// @brief Id de traza de una conexión nueva; 0 si no se muestrea.
+    uint64_t BeginTrace();
+
+    /// @brief Guarda un evento, pisando el más antiguo si el anillo está lleno.
+    void Record(const TraceEvent& event);
+
+    /// @brief Microsegundos de @p time desde el arranque del trazador.
+    uint64_t ToMicros(std::chrono::steady_clock::time_point time) const;
+
+    /// @brief Ordinal del hilo que llama (estable durante su vida).
+    static uint32_t ThreadOrdinal();
+
+    /**
+     * @brief Escribe los eventos guardados en el formato JSON de Chrome.
+     * @return false si no se pudo abrir @p path.
+     */
+    bool Dump(const std::string& path);
+
+    /// @brief Escribe los eventos guardados en @p out.
+    void WriteChromeJson(std::ostream& out);
+
+private:
+    Tracer();
+
+private:
+    std::chrono::steady_clock::time_point m_epoch;   ///< Origen de los instantes.
+    std::atomic<uint32_t> m_sampleEvery{ 0 };        ///< Tasa de muestreo (0: apagado).
+    std::atomic<uint64_t> m_connections{ 0 };        ///< Conexiones vistas (muestreo e ids).
+    std::mutex m_mutex;                              ///< Protege el anillo y el nombre.
+    std::string m_processName;                       ///< Nombre en el visor.
+    std::vector<TraceEvent> m_ring;                  ///< Eventos (capacidad fija).
+    uint64_t m_recorded = 0;                         ///< Eventos guardados en total.
+};
+
+/**
+ * @class TraceSpan
+ * @brief Mide el ámbito en el que vive y lo guarda al destruirse.
+ */
+class TraceSpan {
+public:
+    /// @param traceId Conexión (0: el span no hace nada). @param name Literal con la fase.
+    TraceSpan(uint64_t traceId, const char* name);
+    ~TraceSpan();
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    uint64_t m_traceId;                              ///< Conexión medida.
+    const char* m_name;                              ///< Fase.
+    std::chrono::steady_clock::time_point m_start;   ///< Inicio (solo si se mide).
+};
@@ -0,0 +1,177 @@
+/**
+ * @file TrafficCapture.h
+ * @brief Captura compacta del tráfico de sesiones y su lectura para reproducirla.
+ *
+ * @details
+ * Para comparar dos builds del servidor con la misma entrada hace falta la
+ * forma del tráfico real (ráfagas, mezcla de tamaños, qué se enruta), no su
+ * contenido: el ciphertext no sirve con otras claves de sesión y no debe
+ * acabar en un archivo. @ref TrafficRecorder guarda por cada frame solo su
+ * instante, sesión, banderas, tipo y tamaño; @ref LoadGenerator::RunReplay
+ * abre sesiones nuevas y envía frames del mismo tamaño con el mismo calendario.
+ *
+ * Formato (enteros `varint`: 7 bits por byte, el bit alto indica que sigue otro):
+ * @code
+ *  cabecera: | "E2CAP" (5) | versión (1) | rol (1: 0 cliente, 1 servidor) |
+ *  registro: | Δt µs (varint) | sesión (varint) | tipo (1) | longitud (varint) |
+ *            | [destino (4) si enrutado] | [id (varint) si es Register] |
+ *  tipo:     bit 7 entrante, bit 6 control, bit 5 sellado, bit 4 enrutado,
+ *            bits 0-3 tipo de control (@ref Frame::ControlType)
+ * @endcode
+ *
+ * Un frame típico ocupa 5 o 6 bytes. Las sesiones se numeran por orden de
+ * aparición; el rol indica qué sentido va hacia el servidor.
+ *
+ * Cada hilo (cada shard) acumula sus registros en su propio buffer; un hilo
+ * del grabador los mezcla por instante y los escribe cada segundo, o antes si
+ * un buffer se llena. Si el proceso muere se pierde como mucho ese último
+ * segundo, y el lector descarta el registro que quedara a medias.
+ */
+
+#pragma once
+#include "Frame.h"
+#include "Prerequisites.h"
+#include <condition_variable>
+#include <fstream>
+
+/**
+ * @struct CapturedFrame
+ * @brief Un frame de la captura, sin su contenido.
+ */
+struct CapturedFrame {
+    uint64_t atUs = 0;                               ///< Instante desde el primer frame capturado.
+    uint32_t session = 0;                            ///< Sesión (orden de aparición).
+    bool incoming = false;                           ///< Recibido por quien capturó.
+    uint32_t flags = 0;                              ///< Banderas de @ref Frame (sin la longitud).
+    unsigned char type = 0;                          ///< Tipo de control (solo con @ref Frame::kControlFlag).
+    uint32_t length = 0;                             ///< Tamaño del payload.
+    uint32_t dst = 0;                                ///< Destino (solo enrutados).
+    uint32_t userId = 0;                             ///< Id pedido (solo @ref Frame::Register).
+};
+
+/**
+ * @struct TrafficCapture
+ * @brief Captura leída de un archivo.
+ */
+struct TrafficCapture {
+    /// @brief Extremo que capturó el tráfico.
+    enum class Role : unsigned char {
+        Client = 0,                                  ///< Cliente: sus envíos van al servidor.
+        Server = 1                                   ///< Servidor: lo recibido viene de los clientes.
+    };
+
+    Role role = Role::Client;                        ///< Quién capturó.
+    size_t sessions = 0;                             ///< Sesiones distintas.
+    std::vector<CapturedFrame> frames;               ///< Frames en orden de captura.
+
+    /// @brief Indica si @p frame viajó del cliente al servidor.
+    bool ToServer(const CapturedFrame& frame) const {
+        return (role == Role::Client) != frame.incoming;
+    }
+
+    /**
+     * @brief Lee una captura.
+     * @param path Archivo escrito por @ref TrafficRecorder.
+     * @param out Captura leída.
+     * @return false si no existe o no es una captura. Un último registro
+     *         incompleto (proceso cortado al escribir) se descarta sin error.
+     */
+    static bool Load(const std::string& path, TrafficCapture& out);
+};
+
+/**
+ * @class TrafficRecorder
+ * @brief Escribe la captura; seguro entre hilos y compartible entre shards.
+ *
+ * @details
+ * @ref Record solo toma el mutex del buffer del hilo llamante, que disputa
+ * únicamente el volcado periódico: los shards no se serializan entre sí.
+ */
+class TrafficRecorder {
+public:
+    static constexpr unsigned char kVersion = 1;     ///< Versión del formato.
+
+    /**
+     * @brief Crea (o trunca) el archivo de captura.
+     * @param path Ruta del archivo.
+     * @param role Extremo que captura.
+     * @return Grabador, o nullptr si no se pudo abrir el archivo.
+     */
+    static std::shared_ptr<TrafficRecorder> Create(const std::string& path, TrafficCapture::Role role);
+
+    /// @brief Destructor: detiene el volcado periódico y escribe lo pendiente.
+    ~TrafficRecorder();
+
+    /**
+     * @brief Añade un frame a la captura.
+     * @param session Identificador de la conexión (socket o id de sesión).
+     * @param incoming true si se recibió, false si se envió.
+     * @param header Cabecera del frame.
+     * @param type Primer byte del IV (tipo de control).
+     * @param payload Payload completo (solo se lee el id de un Register).
+     */
+    void Record(uint64_t session, bool incoming, const FrameHeader& header,
+        unsigned char type, const unsigned char* payload);
+
+    /// @brief Olvida @p session: si su identificador se reutiliza, será una sesión nueva.
+    void Forget(uint64_t session);
+
+    /// @brief Escribe ya lo acumulado por todos los hilos y vacía el archivo.
+    void Flush();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief Frame (u olvido de una conexión) pendiente de escribir.
+    struct Pending {
+        Clock::time_point at;                        ///< Instante del registro.
+        uint64_t session = 0;                        ///< Conexión.
+        uint32_t length = 0;                         ///< Tamaño del payload.
+        uint32_t dst = 0;                            ///< Destino (solo enrutados).
+        uint32_t userId = 0;                         ///< Id pedido (solo Register).
+        unsigned char bits = 0;                      ///< Byte de tipo ya codificado.
+        bool registers = false;                      ///< Lleva el id de un Register.
+        bool forget = false;                         ///< Olvido de @ref session, no un frame.
+    };
+
+    /// @brief Registros de un hilo; su mutex solo lo disputa el volcado.
+    struct Buffer {
+        std::mutex mutex;                            ///< Hilo dueño frente al volcado.
+        std::vector<Pending> records;                ///< Pendientes, en orden de llegada.
+    };
+
+    TrafficRecorder() = default;
+
+    /// @brief Buffer del hilo llamante; lo crea y registra la primera vez.
+    Buffer& ThreadBuffer();
+
+    /// @brief Añade @p record al buffer del hilo y despierta al volcado si se llenó.
+    void Append(const Pending& record);
+
+    /// @brief Bucle del hilo de volcado.
+    void Run();
+
+    /// @brief Escribe @p record con el delta y la numeración de sesión.
+    void Write(const Pending& record);
+
+    /// @brief Escribe @p value como varint.
+    void PutVarint(uint64_t value);
+
+private:
+    uint64_t m_id = 0;                               ///< Identificador del grabador (buffers por hilo).
+    std::mutex m_buffersMutex;                       ///< Alta de buffers.
+    std::vector<std::shared_ptr<Buffer>> m_buffers;  ///< Un buffer por hilo que ha registrado.
+
+    std::mutex m_writeMutex;                         ///< Serializa los volcados.
+    std::ofstream m_out;                             ///< Archivo de captura.
+    bool m_failed = false;                           ///< Error de escritura: se deja de grabar.
+    Clock::time_point m_last;                        ///< Instante del registro anterior.
+    bool m_started = false;                          ///< Ya hay algún registro.
+    std::unordered_map<uint64_t, uint32_t> m_sessions; ///< Conexión -> número de sesión.
+    uint32_t m_nextSession = 0;                      ///< Próximo número de sesión.
+
+    std::mutex m_wakeMutex;                          ///< Espera del hilo de volcado.
+    std::condition_variable m_wakeCv;                ///< Plazo, buffer lleno o parada.
+    bool m_stopping = false;                         ///< El destructor pidió parar.
+    std::thread m_thread;                            ///< Hilo de volcado periódico.
+};
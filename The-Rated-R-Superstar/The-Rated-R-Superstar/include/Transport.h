@@ -0,0 +1,44 @@
+/**
+ * @file Transport.h
+ * @brief Interfaz de transporte de bytes alternativo a un socket TCP.
+ *
+ * @details
+ * @ref NetworkHelper identifica cada conexión con un `SOCKET`. Cuando la conexión
+ * no es un socket del sistema (p.ej. memoria compartida), se registra un
+ * @ref Transport asociado a un handle y todas las operaciones de envío/recepción
+ * sobre ese handle se redirigen a él. Así `Client` y `Server` no cambian.
+ */
+
+#pragma once
+#include "Prerequisites.h"
+
+/**
+ * @class Transport
+ * @brief Flujo bidireccional de bytes con semántica de `send`/`recv` bloqueantes.
+ */
+class Transport {
+public:
+    /// @brief Destructor virtual.
+    virtual ~Transport() = default;
+
+    /**
+     * @brief Envía hasta @p len bytes.
+     * @param data Buffer de origen.
+     * @param len Número de bytes a enviar.
+     * @return Bytes enviados (>0), o -1 si la conexión se cerró o hubo error.
+     * @note Puede bloquear mientras no haya espacio.
+     */
+    virtual int Send(const unsigned char* data, int len) = 0;
+
+    /**
+     * @brief Recibe hasta @p len bytes.
+     * @param out Buffer de destino.
+     * @param len Capacidad del buffer.
+     * @return Bytes recibidos (>0), 0 si el peer cerró, o -1 en error.
+     * @note Bloquea hasta que haya al menos un byte disponible.
+     */
+    virtual int Receive(unsigned char* out, int len) = 0;
+
+    /// @brief Cierra el transporte; el peer observará fin de flujo.
+    virtual void Close() = 0;
+};
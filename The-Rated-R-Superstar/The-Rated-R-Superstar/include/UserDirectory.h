@@ -0,0 +1,91 @@
+/**
+ * @file UserDirectory.h
+ * @brief Directorio de usuarios del relay: id de usuario -> shard, sesión y clave pública.
+ *
+ * @details
+ * Los clientes se registran con un id numérico. Al recibir un frame enrutado,
+ * el shard consulta aquí en qué shard y sesión vive el destino; si es otro
+ * shard, le entrega el frame a través de su buzón.
+ *
+ * Cada frame enrutado hace una consulta, así que las lecturas no toman ningún
+ * mutex: el directorio se reparte en @ref UserDirectory::kShardCount tablas
+ * hash cuyos nodos son inmutables una vez publicados. Las escrituras (altas y
+ * bajas, mucho más raras) toman solo el mutex de su tabla, enlazan o
+ * desenlazan el nodo y lo retiran por lotes; la memoria se libera cuando
+ * ningún lector puede seguir viéndola (reclamación por épocas).
+ *
+ * @note Compartido por todos los shards. Lecturas sin bloqueo; escrituras por tabla.
+ */
+
+#pragma once
+#include "Prerequisites.h"
+
+/**
+ * @struct UserRoute
+ * @brief Ubicación de un usuario registrado.
+ */
+struct UserRoute {
+    int shard = -1;                                  ///< Índice del shard dueño de la sesión.
+    uint64_t sessionId = 0;                          ///< Sesión dentro del shard.
+    std::shared_ptr<const std::string> publicKey;    ///< PEM RSA del usuario (para sus peers).
+};
+
+/**
+ * @class UserDirectory
+ * @brief Registro concurrente de usuarios conectados.
+ */
+class UserDirectory {
+public:
+    /// @brief Número de tablas independientes (potencia de dos).
+    static constexpr size_t kShardCount = 64;
+
+    UserDirectory();
+    ~UserDirectory();
+    UserDirectory(const UserDirectory&) = delete;
+    UserDirectory& operator=(const UserDirectory&) = delete;
+
+    /**
+     * @brief Registra un usuario.
+     * @param userId Id elegido por el cliente (distinto de 0).
+     * @param route Shard, sesión y clave pública.
+     * @return false si el id es 0 o ya está en uso por otra sesión.
+     */
+    bool Register(uint32_t userId, const UserRoute& route);
+
+    /**
+     * @brief Elimina un usuario si sigue asociado a @p sessionId.
+     * @param userId Id registrado.
+     * @param sessionId Sesión que se cierra (evita borrar un registro posterior).
+     */
+    void Unregister(uint32_t userId, uint64_t sessionId);
+
+    /**
+     * @brief Busca un usuario.
+     * @param userId Id a buscar.
+     * @param out Ruta encontrada.
+     * @return true si el usuario está conectado.
+     * @note Sin bloqueo: no toma ningún mutex ni espera a los escritores.
+     */
+    bool Lookup(uint32_t userId, UserRoute& out) const;
+
+    /// @brief Número de usuarios registrados.
+    size_t Size() const;
+
+private:
+    struct Node;
+    struct Table;
+    struct Shard;
+    struct Batch;
+
+    /// @brief Tabla que contiene a @p userId.
+    Shard& ShardFor(uint32_t userId) const;
+
+    /// @brief Sustituye la tabla de buckets por otra del doble de tamaño.
+    /// @param batch Recibe la tabla anterior y sus nodos para retirarlos sin el mutex.
+    /// @pre Mutex de @p shard tomado.
+    static void Grow(Shard& shard, Batch& batch);
+
+private:
+    std::unique_ptr<Shard[]> m_shards;               ///< Tablas independientes.
+    std::atomic<size_t> m_size{ 0 };                 ///< Usuarios registrados.
+};
@@ -0,0 +1,114 @@
+/**
+ * @file AddressResolver.cpp
+ * @brief Implementación de la resolución asíncrona con caché.
+ */
+
+#include "AddressResolver.h"
+
+AddressResolver&
+AddressResolver::Instance() {
+	static AddressResolver instance;
+	return instance;
+}
+
+std::vector<AddressResolver::Endpoint>
+AddressResolver::Resolve(const std::string& host, int port, std::chrono::milliseconds timeout) {
+	std::shared_future<std::vector<Endpoint>> result = ResolveAsync(host, port);
+	if (result.wait_for(timeout) != std::future_status::ready) {
+		std::cerr << "DNS timeout resolving " << host << std::endl;
+		return {};
+	}
+	return result.get();
+}
+
+std::shared_future<std::vector<AddressResolver::Endpoint>>
+AddressResolver::ResolveAsync(const std::string& host, int port) {
+	std::string key = host + ":" + std::to_string(port);
+	auto now = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// 1) Caché vigente
+	auto cached = m_cache.find(key);
+	if (cached != m_cache.end()) {
+		if (cached->second.expires > now) {
+			std::promise<std::vector<Endpoint>> ready;
+			ready.set_value(cached->second.endpoints);
+			return ready.get_future().share();
+		}
+		m_cache.erase(cached);
+	}
+
+	// 2) Consulta ya en curso para la misma clave
+	auto pending = m_pending.find(key);
+	if (pending != m_pending.end()) {
+		return pending->second;
+	}
+
+	// 3) Nueva consulta en un hilo desacoplado: si el llamador abandona la espera,
+	//    el hilo termina por su cuenta y deja el resultado en la caché
+	auto promise = std::make_shared<std::promise<std::vector<Endpoint>>>();
+	std::shared_future<std::vector<Endpoint>> future = promise->get_future().share();
+	m_pending[key] = future;
+
+	std::thread([this, host, port, key, promise]() {
+		std::vector<Endpoint> endpoints = Lookup(host, port);
+		Complete(key, endpoints);
+		promise->set_value(std::move(endpoints));
+		}).detach();
+
+	return future;
+}
+
+std::vector<AddressResolver::Endpoint>
+AddressResolver::Lookup(const std::string& host, int port) {
+	addrinfo hints{};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	hints.ai_flags = AI_ADDRCONFIG;
+
+	addrinfo* list = nullptr;
+	std::string service = std::to_string(port);
+	int rc = getaddrinfo(host.c_str(), service.c_str(), &hints, &list);
+	if (rc != 0) {
+		std::cerr << "getaddrinfo(" << host << ") failed: " << rc << std::endl;
+		return {};
+	}
+
+	std::vector<Endpoint> endpoints;
+	for (addrinfo* ai = list; ai; ai = ai->ai_next) {
+		if (ai->ai_family != AF_INET && ai->ai_family != AF_INET6) continue;
+		Endpoint ep{};
+		std::memcpy(&ep.addr, ai->ai_addr, ai->ai_addrlen);
+		ep.addrLen = static_cast<int>(ai->ai_addrlen);
+		ep.family = ai->ai_family;
+		endpoints.push_back(ep);
+	}
+	freeaddrinfo(list);
+	return endpoints;
+}
+
+void
+AddressResolver::Complete(const std::string& key, const std::vector<Endpoint>& endpoints) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	CacheEntry entry;
+	entry.endpoints = endpoints;
+	entry.expires = std::chrono::steady_clock::now() +
+		(endpoints.empty() ? m_negativeTTL : m_positiveTTL);
+	m_cache[key] = std::move(entry);
+	m_pending.erase(key);
+}
+
+void
+AddressResolver::SetTTL(std::chrono::seconds positive, std::chrono::seconds negative) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_positiveTTL = positive;
+	m_negativeTTL = negative;
+}
+
+void
+AddressResolver::Clear() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_cache.clear();
+}
@@ -0,0 +1,126 @@
+/**
+ * @file AdminEndpoint.cpp
+ * @brief Implementación del endpoint HTTP de métricas.
+ */
+
+#include "AdminEndpoint.h"
+#include "Logger.h"
+#include <algorithm>
+
+namespace {
+	/// Prefijo de dirección para un socket AF_UNIX.
+	const char kUnixScheme[] = "unix:";
+	/// Tamaño máximo de la petición (línea de petición y cabeceras).
+	const size_t kMaxRequestSize = 8192;
+	/// Espera máxima de la petición: un cliente lento no retiene el endpoint.
+	const DWORD kRequestTimeoutMs = 2000;
+	/// Espera máxima de WSAPoll: acota lo que tarda el hilo en ver la parada.
+	const int kAcceptPollMs = 200;
+	/// Espera tras un error de accept, doblándose hasta el máximo.
+	const std::chrono::milliseconds kAcceptRetryMin(10);
+	const std::chrono::milliseconds kAcceptRetryMax(1000);
+
+	std::string Response(const char* status, const char* contentType, const std::string& body) {
+		std::ostringstream out;
+		out << "HTTP/1.1 " << status << "\r\n"
+			<< "Content-Type: " << contentType << "\r\n"
+			<< "Content-Length: " << body.size() << "\r\n"
+			<< "Connection: close\r\n\r\n"
+			<< body;
+		return out.str();
+	}
+}
+
+AdminEndpoint::~AdminEndpoint() {
+	Stop();
+}
+
+bool
+AdminEndpoint::Start(const std::string& address, Renderer render) {
+	SOCKET listenSock = INVALID_SOCKET;
+	if (address.compare(0, sizeof(kUnixScheme) - 1, kUnixScheme) == 0) {
+		listenSock = m_net.ListenUnix(address.substr(sizeof(kUnixScheme) - 1));
+	}
+	else {
+		// Solo loopback: las métricas no se publican fuera del equipo
+		listenSock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (listenSock == INVALID_SOCKET) return false;
+		sockaddr_in addr{};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = htons(static_cast<u_short>(std::stoi(address)));
+		if (bind(listenSock, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+			listen(listenSock, SOMAXCONN) == SOCKET_ERROR) {
+			Logger::Error("[Admin] No se pudo escuchar en 127.0.0.1:{}: {}\n", address, WSAGetLastError());
+			closesocket(listenSock);
+			listenSock = INVALID_SOCKET;
+		}
+	}
+	if (listenSock == INVALID_SOCKET) return false;
+
+	m_listenSock = listenSock;
+	m_render = std::move(render);
+	m_running = true;
+	m_thread = std::thread([this, listenSock]() { AcceptLoop(listenSock); });
+	return true;
+}
+
+void
+AdminEndpoint::Stop() {
+	{
+		std::lock_guard<std::mutex> lock(m_stopMutex);
+		m_running = false;
+	}
+	m_stopCv.notify_all();
+	// El socket se cierra tras el join: el hilo nunca espera en un handle ya cerrado
+	if (m_thread.joinable()) m_thread.join();
+	SOCKET listenSock = m_listenSock.exchange(INVALID_SOCKET);
+	if (listenSock != INVALID_SOCKET) m_net.close(listenSock);
+}
+
+void
+AdminEndpoint::AcceptLoop(SOCKET listenSock) {
+	std::chrono::milliseconds backoff = kAcceptRetryMin;
+	while (m_running) {
+		WSAPOLLFD fd{};
+		fd.fd = listenSock;
+		fd.events = POLLRDNORM;
+		int ready = WSAPoll(&fd, 1, kAcceptPollMs);
+		if (ready == 0) continue;
+		SOCKET client = ready > 0 ? accept(listenSock, nullptr, nullptr) : INVALID_SOCKET;
+		if (client == INVALID_SOCKET) {
+			// Sin descriptores o red caída: esperar en vez de girar, sin retrasar la parada
+			Logger::Warn("[Admin] Error al aceptar: {}\n", WSAGetLastError());
+			std::unique_lock<std::mutex> lock(m_stopMutex);
+			if (m_stopCv.wait_for(lock, backoff, [this]() { return !m_running; })) break;
+			backoff = std::min(backoff * 2, kAcceptRetryMax);
+			continue;
+		}
+		backoff = kAcceptRetryMin;
+		Serve(client);
+		m_net.close(client);
+	}
+}
+
+void
+AdminEndpoint::Serve(SOCKET client) {
+	DWORD timeout = kRequestTimeoutMs;
+	setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+
+	std::string request;
+	char buffer[1024];
+	while (request.find("\r\n\r\n") == std::string::npos && request.size() < kMaxRequestSize) {
+		int n = recv(client, buffer, sizeof(buffer), 0);
+		if (n <= 0) return;
+		request.append(buffer, n);
+	}
+
+	std::string response;
+	if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0) {
+		response = Response("200 OK", "text/plain; version=0.0.4; charset=utf-8", m_render());
+	}
+	else {
+		response = Response("404 Not Found", "text/plain; charset=utf-8", "Solo GET /metrics.\n");
+	}
+	m_net.SendData(client, response);
+}
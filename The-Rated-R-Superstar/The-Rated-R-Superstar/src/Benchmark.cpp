@@ -0,0 +1,559 @@
+/**
+ * @file Benchmark.cpp
+ * @brief Implementación de los benchmarks en proceso.
+ *
+ * @details
+ * El fan-out recorre el @ref ServerShard real (RouteToRoom, FanOut,
+ * DeliverLocal y Queue) con sesiones sin socket. Las escrituras al socket
+ * quedan fuera de la medición en ambas variantes: cada sesión tiene un frame
+ * pendiente por delante, como con el socket lleno, así que Queue no llama a
+ * send; cada entrega se retira enseguida, como haría @ref ServerShard::OnWritable.
+ *
+ * El rekey mide solo el trabajo del miembro que cambia la clave; el reparto
+ * del resultado es el fan-out ya medido por @ref Benchmark::RunRoomFanOut.
+ */
+
+#include "Benchmark.h"
+#include "RatchetTree.h"
+#include "RoomDirectory.h"
+#include "UserDirectory.h"
+#include "Session.h"
+#include "ServerShard.h"
+#include "ServerIdentity.h"
+#include "TimerWheel.h"
+#include "Frame.h"
+#include "NetworkHelper.h"
+#include "MemoryTransport.h"
+#include "SharedMemoryTransport.h"
+#include "openssl/opensslv.h"
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <random>
+
+namespace {
+	/// Tamaño del texto plano de cada mensaje.
+	const size_t kMessageSize = 256;
+	/// Tiempo mínimo de medición por variante.
+	const std::chrono::milliseconds kMinDuration(300);
+	/// Sala usada en las mediciones.
+	const uint32_t kRoomId = 1;
+	/// Usuarios registrados durante la medición del directorio.
+	const uint32_t kDirectoryUsers = 100000;
+	/// Resolución de los temporizadores (la del shard).
+	const std::chrono::milliseconds kTimerTick(10);
+	/// Plazos al azar entre 1 tick y un minuto.
+	const uint32_t kMaxTimerTicks = 6000;
+	/// Operaciones de rearme entre dos ticks del reloj simulado.
+	const uint64_t kOpsPerTick = 100;
+	/// Tamaños de texto plano de los benchmarks de AES (de 16 B a 16 MB).
+	const size_t kAesSizes[] = { 16, 256, 4096, 65536, 1 << 20, 16 << 20 };
+	/// Tamaños de payload de los frames por loopback.
+	const size_t kFrameSizes[] = { 16, 256, 4096, 65536 };
+
+	/// Resultado de un microbenchmark, por operación.
+	struct PrimitiveResult {
+		std::string name;
+		uint64_t iterations = 0;
+		double realNs = 0;
+		double cpuNs = 0;
+		double bytesPerSecond = 0; ///< 0: no mueve datos.
+	};
+
+	/// Directorio de referencia: un mapa y un único mutex para todo.
+	class LockedDirectory {
+	public:
+		bool Register(uint32_t userId, const UserRoute& route) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_users.emplace(userId, route).second;
+		}
+		void Unregister(uint32_t userId, uint64_t) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_users.erase(userId);
+		}
+		bool Lookup(uint32_t userId, UserRoute& out) const {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto it = m_users.find(userId);
+			if (it == m_users.end()) return false;
+			out = it->second;
+			return true;
+		}
+	private:
+		mutable std::mutex m_mutex;
+		std::unordered_map<uint32_t, UserRoute> m_users;
+	};
+
+	/**
+	 * @brief Lectores y un escritor contra @p directory durante @ref kMinDuration.
+	 * @return Consultas por segundo sumando todos los lectores.
+	 */
+	template <typename Directory>
+	double MeasureLookups(Directory& directory, size_t readers) {
+		std::atomic<bool> stop{ false };
+		std::atomic<uint64_t> lookups{ 0 };
+
+		// Escritor: altas y bajas continuas por encima del rango consultado
+		std::thread writer([&]() {
+			uint32_t next = kDirectoryUsers + 1;
+			UserRoute route;
+			while (!stop.load(std::memory_order_relaxed)) {
+				route.sessionId = next;
+				directory.Register(next, route);
+				directory.Unregister(next, next);
+				next = next == 0xFFFFFFFFu ? kDirectoryUsers + 1 : next + 1;
+			}
+		});
+
+		std::vector<std::thread> threads;
+		for (size_t t = 0; t < readers; ++t) {
+			threads.emplace_back([&, t]() {
+				std::mt19937 rng(static_cast<uint32_t>(t + 1));
+				std::uniform_int_distribution<uint32_t> pick(1, kDirectoryUsers);
+				UserRoute route;
+				uint64_t local = 0;
+				while (!stop.load(std::memory_order_relaxed)) {
+					for (int i = 0; i < 256; ++i) local += directory.Lookup(pick(rng), route) ? 1 : 0;
+				}
+				lookups.fetch_add(local, std::memory_order_relaxed);
+			});
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		std::this_thread::sleep_for(kMinDuration);
+		stop.store(true);
+		for (auto& thread : threads) thread.join();
+		writer.join();
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		return lookups.load() / elapsed.count();
+	}
+
+	/**
+	 * @brief Ejecuta @p body hasta cubrir @ref kMinDuration.
+	 * @return Iteraciones por segundo.
+	 */
+	template <typename Body>
+	double MeasureRate(Body body) {
+		auto start = std::chrono::steady_clock::now();
+		uint64_t iterations = 0;
+		std::chrono::duration<double> elapsed{};
+		do {
+			body();
+			iterations++;
+			elapsed = std::chrono::steady_clock::now() - start;
+		} while (elapsed < kMinDuration);
+		return iterations / elapsed.count();
+	}
+
+	/// Tiempo de CPU (usuario y núcleo) consumido por el hilo que llama, en ns.
+	double ThreadCpuNanoseconds() {
+		FILETIME creation, exit, kernel, user;
+		if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) return 0;
+		auto ticks = [](const FILETIME& time) {
+			return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+		};
+		return (ticks(kernel) + ticks(user)) * 100.0; // unidades de 100 ns
+	}
+
+	/**
+	 * @brief Calienta @p body con una llamada y lo repite hasta cubrir @ref kMinDuration.
+	 * @param bytesPerOp Bytes que mueve cada llamada (0: sin caudal).
+	 */
+	template <typename Body>
+	PrimitiveResult MeasurePrimitive(const std::string& name, size_t bytesPerOp, Body body) {
+		body();
+		PrimitiveResult result;
+		result.name = name;
+		double cpuStart = ThreadCpuNanoseconds();
+		auto start = std::chrono::steady_clock::now();
+		std::chrono::duration<double> elapsed{};
+		do {
+			body();
+			result.iterations++;
+			elapsed = std::chrono::steady_clock::now() - start;
+		} while (elapsed < kMinDuration);
+		result.realNs = elapsed.count() * 1e9 / result.iterations;
+		result.cpuNs = (ThreadCpuNanoseconds() - cpuStart) / result.iterations;
+		result.bytesPerSecond = bytesPerOp * result.iterations / elapsed.count();
+		return result;
+	}
+
+	/// Resultados en el esquema JSON de Google Benchmark.
+	void WriteBenchmarkJson(std::ostream& out, const std::vector<PrimitiveResult>& results) {
+		char date[32] = "";
+		std::time_t now = std::time(nullptr);
+		std::tm local{};
+		if (localtime_s(&local, &now) == 0) std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &local);
+#ifdef NDEBUG
+		const char* buildType = "release";
+#else
+		const char* buildType = "debug";
+#endif
+		out << "{\n  \"context\": {\n"
+			<< "    \"date\": \"" << date << "\",\n"
+			<< "    \"executable\": \"E2EE bench crypto\",\n"
+			<< "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+			<< "    \"library_build_type\": \"" << buildType << "\",\n"
+			<< "    \"openssl_version\": \"" << OPENSSL_VERSION_TEXT << "\"\n"
+			<< "  },\n  \"benchmarks\": [";
+		out << std::setprecision(6) << std::fixed;
+		for (size_t i = 0; i < results.size(); ++i) {
+			const PrimitiveResult& r = results[i];
+			out << (i ? "," : "") << "\n    {\"name\": \"" << r.name << "\", \"run_name\": \"" << r.name
+				<< "\", \"run_type\": \"iteration\", \"repetitions\": 1, \"repetition_index\": 0, \"threads\": 1"
+				<< ", \"iterations\": " << r.iterations
+				<< ", \"real_time\": " << r.realNs << ", \"cpu_time\": " << r.cpuNs << ", \"time_unit\": \"ns\"";
+			if (r.bytesPerSecond > 0) out << ", \"bytes_per_second\": " << r.bytesPerSecond;
+			out << "}";
+		}
+		out << "\n  ]\n}\n";
+	}
+}
+
+void
+Benchmark::RunRoomFanOut(const std::vector<size_t>& roomSizes) {
+	const std::string plaintext(kMessageSize, 'x');
+
+	// El shard solo la usa para su PEM: una para todos los tamaños
+	auto identity = std::make_shared<const ServerIdentity>();
+	// Frame pendiente al frente de cada cola: Queue() no intenta escribir
+	FrameBuffer stalled = std::make_shared<const std::vector<unsigned char>>(1, 0);
+
+	std::cout << "[Bench] Fan-out de salas (" << kMessageSize << " bytes por mensaje)\n";
+	for (size_t size : roomSizes) {
+		// Shard sin bucle ni sockets: sus sesiones, su directorio de salas y su reparto
+		RoomDirectory rooms;
+		ServerShard shard(0, 0, identity);
+		shard.SetRooms(&rooms);
+		std::vector<Session*> receivers;
+		receivers.reserve(size);
+		Session* sender = nullptr;
+		for (size_t i = 0; i <= size; ++i) {
+			auto session = std::make_unique<Session>();
+			session->userId = static_cast<uint32_t>(i + 1);
+			session->state = SessionState::Established;
+			session->crypto.GenerateAESKey();
+			session->rooms.push_back(kRoomId);
+			session->txQueue.push_back(stalled);
+			Session& ref = shard.AddSession(std::move(session));
+			rooms.Join(kRoomId, RoomMember{ ref.userId, 0, ref.id });
+			if (i == 0) sender = &ref;
+			else receivers.push_back(&ref);
+		}
+
+		// Frame del emisor tal como llega al relay (cifrado extremo a extremo)
+		CryptoHelper crypto;
+		crypto.GenerateAESKey();
+		Frame routed;
+		routed.flags = Frame::kRoutedFlag;
+		routed.dst = kRoomId | Frame::kRoomAddress;
+		routed.payload = crypto.AESEncrypt(plaintext, routed.iv);
+		const std::vector<unsigned char> wire = routed.Encode();
+		FrameHeader header;
+		Frame::ParseHeader(wire.data(), wire.size(), header);
+
+		// 1) Relay: una copia del frame y un puntero por miembro
+		double fanOut = MeasureRate([&]() {
+			shard.RouteToRoom(*sender, wire.data(), header);
+			for (Session* target : receivers) target->txQueue.pop_back();
+		});
+
+		// 2) Ingenuo: AESEncrypt + serialización por miembro
+		double naive = MeasureRate([&]() {
+			for (Session* target : receivers) {
+				Frame frame;
+				frame.payload = target->crypto.AESEncrypt(plaintext, frame.iv);
+				shard.QueueFrame(*target, frame);
+				target->txQueue.pop_back();
+			}
+		});
+
+		std::cout << std::fixed << std::setprecision(1)
+			<< "[Bench] sala=" << size
+			<< " | fan-out: " << fanOut << " msg/s, " << fanOut * size << " entregas/s, "
+			<< 1e9 / (fanOut * size) << " ns/miembro"
+			<< " | ingenuo: " << naive << " msg/s, " << 1e9 / (naive * size) << " ns/miembro"
+			<< " | x" << fanOut / naive << "\n";
+	}
+}
+
+void
+Benchmark::RunRoomRekey(const std::vector<size_t>& roomSizes) {
+	// Un solo par RSA para todos los miembros: el coste de envolver no depende de la clave
+	CryptoHelper member;
+	member.GenerateRSAKeys();
+	CryptoHelper recipient;
+	recipient.LoadPeerPublicKey(member.GetPublicKeyString());
+
+	std::cout << "[Bench] Rekey de salas tras un alta o una baja\n";
+	for (size_t size : roomSizes) {
+		if (size < 2) continue;
+
+		// 1) Por pares: clave nueva envuelta con la RSA de cada uno de los demás
+		double pairwise = MeasureRate([&]() {
+			CryptoHelper fresh;
+			fresh.GenerateAESKey();
+			std::vector<unsigned char> key = fresh.GetAESKey();
+			for (size_t i = 1; i < size; ++i) {
+				std::vector<unsigned char> wrap = recipient.WrapKeyForPeer(key);
+			}
+		});
+
+		// 2) Árbol completo tal como queda tras un commit de cada miembro
+		RatchetTree tree;
+		tree.m_userId = 1;
+		tree.m_leafCount = 1;
+		while (tree.m_leafCount < size) tree.m_leafCount *= 2;
+		tree.m_nodes.resize(2 * static_cast<size_t>(tree.m_leafCount) - 1);
+		for (uint32_t node = 0; node < tree.m_nodes.size(); ++node) {
+			uint32_t span = (1u << RatchetTree::Level(node)) - 1;
+			if (node - span >= 2 * size) continue; // subárbol sin miembros: en blanco
+			tree.m_nodes[node].publicKey = CryptoHelper::NodePublicKey(RatchetTree::NewLeafSecret());
+			if (node % 2 == 0) tree.m_nodes[node].userId = node / 2 + 1;
+		}
+		tree.m_nodes[tree.Root()].pathSecret = RatchetTree::NewLeafSecret();
+		tree.FinishEpoch();
+
+		// Baja y nueva alta del último miembro, alternadas: cada commit es un rekey
+		RatchetTree::Addition last{ static_cast<uint32_t>(size),
+			tree.m_nodes[2 * (size - 1)].publicKey };
+		bool present = true;
+		size_t seals = 0, bytes = 0;
+		uint64_t commits = 0;
+		double treeRate = MeasureRate([&]() {
+			std::vector<unsigned char> commit = present
+				? tree.Commit({}, { last.userId })
+				: tree.Commit({ last }, {});
+			present = !present;
+			seals += tree.LastCommitSeals();
+			bytes += commit.size();
+			commits++;
+		});
+
+		std::cout << std::fixed << std::setprecision(1)
+			<< "[Bench] sala=" << size
+			<< " | por pares: " << pairwise << " rekeys/s, " << size - 1 << " envolturas RSA"
+			<< " | árbol: " << treeRate << " rekeys/s, " << double(seals) / commits << " sellados, "
+			<< bytes / commits << " bytes por commit"
+			<< " | x" << treeRate / pairwise << "\n";
+	}
+}
+
+void
+Benchmark::RunDirectoryContention(const std::vector<size_t>& threadCounts) {
+	// Mismas rutas en ambos directorios; la clave pública se comparte como en el shard
+	UserDirectory sharded;
+	LockedDirectory locked;
+	UserRoute route;
+	route.shard = 0;
+	route.publicKey = std::make_shared<const std::string>("-----BEGIN RSA PUBLIC KEY-----");
+	for (uint32_t userId = 1; userId <= kDirectoryUsers; ++userId) {
+		route.sessionId = userId;
+		sharded.Register(userId, route);
+		locked.Register(userId, route);
+	}
+
+	std::cout << "[Bench] Directorio de usuarios (" << kDirectoryUsers
+		<< " usuarios, un escritor con altas y bajas continuas)\n";
+	for (size_t threads : threadCounts) {
+		if (threads == 0) continue;
+		double lockFree = MeasureLookups(sharded, threads);
+		double mutex = MeasureLookups(locked, threads);
+		std::cout << std::fixed << std::setprecision(1)
+			<< "[Bench] hilos=" << threads
+			<< " | sin bloqueo: " << lockFree / 1e6 << " M consultas/s, " << lockFree / threads / 1e6 << " M/hilo"
+			<< " | mutex global: " << mutex / 1e6 << " M consultas/s, " << mutex / threads / 1e6 << " M/hilo"
+			<< " | x" << lockFree / mutex << "\n";
+	}
+}
+
+void
+Benchmark::RunTimerChurn(const std::vector<size_t>& timerCounts) {
+	std::cout << "[Bench] Temporizadores (plazos de 10 ms a 60 s, un tick cada "
+		<< kOpsPerTick << " rearmes)\n";
+	for (size_t count : timerCounts) {
+		if (count == 0) continue;
+
+		// 1) Rueda jerárquica: reloj simulado para no depender de la duración real
+		auto start = TimerWheel::Clock::now();
+		TimerWheel wheel(kTimerTick, start);
+		std::vector<TimerWheel::TimerId> ids(count);
+		std::mt19937 rng(1);
+		auto delay = [&]() { return kTimerTick * static_cast<int64_t>(1 + rng() % kMaxTimerTicks); };
+		for (size_t i = 0; i < count; ++i) ids[i] = wheel.Schedule(delay(), i, 0);
+		std::vector<TimerWheel::Expired> expired;
+		uint64_t ops = 0, ticks = 0;
+		double wheelRate = MeasureRate([&]() {
+			size_t owner = rng() % count;
+			wheel.Cancel(ids[owner]);
+			ids[owner] = wheel.Schedule(delay(), owner, 0);
+			if (++ops % kOpsPerTick == 0) {
+				expired.clear();
+				wheel.Advance(start + kTimerTick * static_cast<int64_t>(++ticks), expired);
+				for (const TimerWheel::Expired& timer : expired) {
+					ids[timer.owner] = wheel.Schedule(delay(), timer.owner, 0);
+				}
+			}
+		});
+
+		// 2) Árbol ordenado por vencimiento: O(log n) por operación
+		std::multimap<uint64_t, size_t> ordered;
+		std::vector<std::multimap<uint64_t, size_t>::iterator> handles(count);
+		uint64_t now = 0;
+		auto ticksAhead = [&]() { return now + 1 + rng() % kMaxTimerTicks; };
+		for (size_t i = 0; i < count; ++i) handles[i] = ordered.emplace(ticksAhead(), i);
+		ops = 0;
+		double mapRate = MeasureRate([&]() {
+			size_t owner = rng() % count;
+			ordered.erase(handles[owner]);
+			handles[owner] = ordered.emplace(ticksAhead(), owner);
+			if (++ops % kOpsPerTick == 0) {
+				now++;
+				while (!ordered.empty() && ordered.begin()->first <= now) {
+					size_t due = ordered.begin()->second;
+					ordered.erase(ordered.begin());
+					handles[due] = ordered.emplace(ticksAhead(), due);
+				}
+			}
+		});
+
+		std::cout << std::fixed << std::setprecision(1)
+			<< "[Bench] temporizadores=" << count
+			<< " | rueda: " << wheelRate / 1e6 << " M rearmes/s"
+			<< " | multimap: " << mapRate / 1e6 << " M rearmes/s"
+			<< " | x" << wheelRate / mapRate << "\n";
+	}
+}
+
+bool
+Benchmark::RunPrimitives(const std::string& filter, const std::string& jsonPath) {
+	std::vector<PrimitiveResult> results;
+	auto selected = [&](const std::string& name) {
+		return filter.empty() || name.find(filter) != std::string::npos;
+	};
+	auto report = [&](const PrimitiveResult& r) {
+		std::cout << std::fixed << std::setprecision(1)
+			<< "[Bench] " << std::left << std::setw(28) << r.name << std::right
+			<< " | " << std::setw(14) << r.realNs << " ns | cpu " << std::setw(14) << r.cpuNs << " ns"
+			<< " | " << std::setw(9) << r.iterations << " iter";
+		if (r.bytesPerSecond > 0) std::cout << " | " << r.bytesPerSecond / (1 << 20) << " MiB/s";
+		std::cout << "\n";
+		results.push_back(r);
+	};
+
+	std::cout << "[Bench] Primitivas de CryptoHelper y NetworkHelper (tiempo por operación)\n";
+
+	// AES-256-CBC sobre textos de 16 B a 16 MB
+	CryptoHelper aes;
+	aes.GenerateAESKey();
+	for (size_t size : kAesSizes) {
+		const std::string plaintext(size, 'x');
+		std::vector<unsigned char> iv;
+		std::string name = "AESEncrypt/" + std::to_string(size);
+		if (selected(name)) {
+			report(MeasurePrimitive(name, size, [&]() { aes.AESEncrypt(plaintext, iv); }));
+		}
+		name = "AESDecrypt/" + std::to_string(size);
+		if (selected(name)) {
+			const std::vector<unsigned char> cipher = aes.AESEncrypt(plaintext, iv);
+			report(MeasurePrimitive(name, size, [&]() { aes.AESDecrypt(cipher, iv); }));
+		}
+	}
+
+	// RSA: par nuevo, envoltura de la clave AES y su apertura, PEM de ida y vuelta
+	if (selected("GenerateRSAKeys")) {
+		report(MeasurePrimitive("GenerateRSAKeys", 0, []() {
+			CryptoHelper keys;
+			keys.GenerateRSAKeys();
+		}));
+	}
+	CryptoHelper server;
+	server.GenerateRSAKeys();
+	const std::string pem = server.GetPublicKeyString();
+	CryptoHelper client;
+	client.GenerateAESKey();
+	client.LoadPeerPublicKey(pem);
+	if (selected("EncryptAESKeyWithPeer")) {
+		report(MeasurePrimitive("EncryptAESKeyWithPeer", 0, [&]() { client.EncryptAESKeyWithPeer(); }));
+	}
+	if (selected("DecryptAESKey")) {
+		const std::vector<unsigned char> wrapped = client.EncryptAESKeyWithPeer();
+		report(MeasurePrimitive("DecryptAESKey", 0, [&]() { server.DecryptAESKey(wrapped); }));
+	}
+	if (selected("PEMExport")) {
+		report(MeasurePrimitive("PEMExport", pem.size(), [&]() { server.GetPublicKeyString(); }));
+	}
+	if (selected("PEMImport")) {
+		report(MeasurePrimitive("PEMImport", pem.size(), [&]() { client.LoadPeerPublicKey(pem); }));
+	}
+
+	// Framing: ida y vuelta por loopback; un hilo devuelve cada frame tal cual.
+	// La variante en memoria da el coste del framing sin la pila de red del sistema.
+	NetworkHelper net;
+	auto roundTrips = [&](const std::string& prefix, SOCKET local, SOCKET remote) {
+		std::thread echo([&]() {
+			Frame frame;
+			while (net.ReceiveFrame(remote, frame) && net.SendFrame(remote, frame)) {}
+		});
+		for (size_t size : kFrameSizes) {
+			std::string name = prefix + std::to_string(size);
+			if (!selected(name)) continue;
+			Frame request;
+			request.iv.assign(Frame::kIvSize, 0);
+			request.payload.assign(size, 0x5A);
+			Frame reply;
+			report(MeasurePrimitive(name, 2 * size, [&]() {
+				net.SendFrame(local, request);
+				net.ReceiveFrame(local, reply);
+			}));
+		}
+		// Cerrar el extremo local hace que ReceiveFrame falle en el hilo de eco
+		net.Shutdown(local);
+		net.close(local);
+		echo.join();
+		net.close(remote);
+	};
+	auto anySelected = [&](const std::string& prefix) {
+		for (size_t size : kFrameSizes) if (selected(prefix + std::to_string(size))) return true;
+		return false;
+	};
+
+	if (anySelected("FrameRoundTrip/")) {
+		SOCKET local = INVALID_SOCKET, remote = INVALID_SOCKET;
+		if (net.CreateSocketPair(local, remote)) roundTrips("FrameRoundTrip/", local, remote);
+		else std::cerr << "[Bench] No se pudo crear el par de sockets de loopback.\n";
+	}
+	if (anySelected("FrameRoundTrip/memory/")) {
+		auto pair = MemoryTransport::CreatePair();
+		SOCKET local = NetworkHelper::RegisterTransport(pair.first);
+		SOCKET remote = NetworkHelper::RegisterTransport(pair.second);
+		if (local != INVALID_SOCKET && remote != INVALID_SOCKET) roundTrips("FrameRoundTrip/memory/", local, remote);
+	}
+	// Transportes locales entre procesos (unix:, shm:), aquí con ambos extremos en este
+	if (anySelected("FrameRoundTrip/unix/")) {
+		std::string path = "e2ee-bench-" + std::to_string(GetCurrentProcessId()) + ".sock";
+		SOCKET listener = net.ListenUnix(path);
+		SOCKET local = (listener != INVALID_SOCKET) ? net.ConnectUnix(path) : INVALID_SOCKET;
+		SOCKET remote = (local != INVALID_SOCKET) ? accept(listener, nullptr, nullptr) : INVALID_SOCKET;
+		if (listener != INVALID_SOCKET) net.close(listener);
+		std::remove(path.c_str());
+		if (remote != INVALID_SOCKET) roundTrips("FrameRoundTrip/unix/", local, remote);
+		else std::cerr << "[Bench] No se pudo abrir el socket AF_UNIX " << path << ".\n";
+	}
+	if (anySelected("FrameRoundTrip/shm/")) {
+		std::string name = "e2ee-bench-" + std::to_string(GetCurrentProcessId());
+		auto shmServer = SharedMemoryTransport::Create(name);
+		auto shmClient = shmServer ? SharedMemoryTransport::Open(name) : nullptr;
+		if (shmClient && shmServer->WaitForPeer()) {
+			roundTrips("FrameRoundTrip/shm/", NetworkHelper::RegisterTransport(shmClient), NetworkHelper::RegisterTransport(shmServer));
+		}
+		else std::cerr << "[Bench] No se pudo crear la región compartida " << name << ".\n";
+	}
+
+	if (jsonPath.empty()) return true;
+	std::ofstream out(jsonPath, std::ios::out | std::ios::trunc);
+	if (!out) return false;
+	WriteBenchmarkJson(out, results);
+	std::cout << "[Bench] Resultados en " << jsonPath << "\n";
+	return static_cast<bool>(out);
+}
@@ -1,23 +1,53 @@
 /**
  * @file Client.cpp
- * @brief Implementacin del cliente TCP con cifrado hbrido RSA/AES.
+ * @brief Implementación del cliente TCP con cifrado híbrido RSA/AES.
  *
  * @details
- * Este mdulo gestiona:
- *  - Conexin al servidor mediante TCP.
- *  - Intercambio de claves pblicas RSA.
- *  - Envo de clave AES cifrada con la RSA del servidor.
- *  - Envo y recepcin de mensajes cifrados con AES-256-CBC.
- *  - Bucle de chat con hilos para envo y recepcin simultnea.
+ * Este módulo gestiona:
+ *  - Conexión al servidor mediante TCP.
+ *  - Intercambio de claves públicas RSA.
+ *  - Envío de clave AES cifrada con la RSA del servidor.
+ *  - Envío y recepción de mensajes cifrados con AES-256-CBC.
+ *  - Bucle de chat con hilos para envío y recepción simultánea.
+ *  - Modo relay: registro con id de usuario y claves AES extremo a extremo por peer.
+ *  - Latido: Ping al servidor callado, RTT suavizado y corte si no responde.
  */
 
 #include "Client.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+
+namespace {
+	/// Fin del PEM de una clave pública RSA (delimita el primer bloque del handshake).
+	const char kPemEnd[] = "-----END RSA PUBLIC KEY-----\n";
+	/// Espera máxima de la respuesta del servidor a una consulta de clave.
+	const std::chrono::seconds kLookupTimeout(5);
+	/// Frames en espera del hilo de envío: con el socket atascado se descartan acuses, no se acumulan.
+	const size_t kMaxQueuedFrames = 1024;
+
+	std::vector<unsigned char> EncodeUserId(uint32_t userId) {
+		std::vector<unsigned char> out(4);
+		Frame::PutU32(out.data(), userId);
+		return out;
+	}
+
+	/// Id de usuario o de sala escrito en la consola: decimal, de 32 bits y distinto de 0.
+	bool ParseId(const std::string& text, uint32_t& id) {
+		if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) return false;
+		std::istringstream in(text);
+		uint64_t value = 0;
+		if (!(in >> value) || in.peek() != EOF || value == 0 || value > 0xFFFFFFFFull) return false;
+		id = static_cast<uint32_t>(value);
+		return true;
+	}
+}
 
 Client::Client(const std::string& ip, int port)
 	: m_ip(ip), m_port(port), m_serverSock(INVALID_SOCKET) {
 	// Genera par de claves RSA al instanciar
 	m_crypto.GenerateRSAKeys();
-	// Genera la clave AES que se usar para cifrar mensajes
+	// Genera la clave AES que se usará para cifrar mensajes
 	m_crypto.GenerateAESKey();
 }
 
@@ -29,122 +59,882 @@ Client::~Client() {
 
 bool 
 Client::Connect() {
-	std::cout << "[Client] Conectando al servidor " << m_ip << ":" << m_port << "...\n";
-	bool connected = m_net.ConnectToServer(m_ip, m_port);
+	Logger::Info("[Client] Conectando al servidor {}:{}...\n", m_ip, m_port);
+	m_traceId = Tracer::Instance().BeginTrace();
+	TraceSpan span(m_traceId, "connect");
+	bool connected = false;
+	if (m_fastOpen) {
+		// La clave pública del cliente viaja con el SYN (o justo tras conectar)
+		std::string pem;
+		{
+			TraceSpan serialize(m_traceId, "serialize_client_pem");
+			pem = m_crypto.GetPublicKeyString();
+		}
+		m_net.EnableFastOpen(true);
+		connected = m_net.ConnectToServer(m_ip, m_port, std::vector<unsigned char>(pem.begin(), pem.end()));
+		m_publicKeySent = connected;
+	}
+	else {
+		connected = m_net.ConnectToServer(m_ip, m_port);
+	}
 	if (connected) {
 		m_serverSock = m_net.m_serverSocket; // Guardar el socket una vez conectado
-		std::cout << "[Client] Conexin establecida.\n";
+		Logger::Info("[Client] Conexión establecida.\n");
 	}
 	else {
-		std::cerr << "[Client] Error al conectar.\n";
+		Logger::Warn("[Client] Error al conectar.\n");
 	}
 	return connected;
 }
 
+void
+Client::EnableFastOpen(bool enabled) {
+	m_fastOpen = enabled;
+}
+
+void
+Client::SetNetworkConditions(const NetworkConditions& conditions) {
+	m_net.SetNetworkConditions(conditions);
+}
+
+bool
+Client::StartCapture(const std::string& path) {
+	return m_net.StartCapture(path, TrafficCapture::Role::Client);
+}
+
 void
 Client::ExchangeKeys() {
-	// 1. Recibe la clave pblica del servidor
-	std::string serverPubKey = m_net.ReceiveData(m_serverSock);
-	m_crypto.LoadPeerPublicKey(serverPubKey);
-	std::cout << "[Client] Clave pblica del servidor recibida.\n";
+	TraceSpan span(m_traceId, "exchange_keys");
 
-	// 2. Enva la clave pblica del cliente
-	std::string clientPubKey = m_crypto.GetPublicKeyString();
-	m_net.SendData(m_serverSock, clientPubKey);
-	std::cout << "[Client] Clave pblica del cliente enviada.\n";
+	// 1. Recibe la clave pública del servidor
+	std::string serverPubKey;
+	{
+		TraceSpan wait(m_traceId, "recv_server_pem");
+		serverPubKey = m_net.ReceiveUntil(m_serverSock, kPemEnd);
+	}
+	{
+		TraceSpan parse(m_traceId, "parse_server_pem");
+		m_crypto.LoadPeerPublicKey(serverPubKey);
+	}
+	Logger::Info("[Client] Clave pública del servidor recibida.\n");
+
+	// 2. Envía la clave pública del cliente (ya enviada con TCP Fast Open)
+	if (!m_publicKeySent) {
+		std::string clientPubKey;
+		{
+			TraceSpan serialize(m_traceId, "serialize_client_pem");
+			clientPubKey = m_crypto.GetPublicKeyString();
+		}
+		TraceSpan send(m_traceId, "send_client_pem");
+		m_net.SendData(m_serverSock, clientPubKey);
+		m_publicKeySent = true;
+	}
+	Logger::Info("[Client] Clave pública del cliente enviada.\n");
 }
 
 void 
 Client::SendAESKeyEncrypted() {
-	std::vector<unsigned char> encryptedAES = m_crypto.EncryptAESKeyWithPeer();
+	TraceSpan span(m_traceId, "send_aes_key");
+	std::vector<unsigned char> encryptedAES;
+	{
+		TraceSpan wrap(m_traceId, "rsa_wrap_aes_key");
+		encryptedAES = m_crypto.EncryptAESKeyWithPeer();
+	}
 	m_net.SendData(m_serverSock, encryptedAES);
-	std::cout << "[Client] Clave AES cifrada y enviada al servidor.\n";
+	Logger::Info("[Client] Clave AES cifrada y enviada al servidor.\n");
 }
 
 void 
 Client::SendEncryptedMessage(const std::string& message) {
-	std::vector<unsigned char> iv;
-	auto cipher = m_crypto.AESEncrypt(message, iv);
+	// IV (16) | tamaño (4, network byte order) | ciphertext
+	Frame frame;
+	StampFrame(frame);
+	frame.payload = m_crypto.AESEncrypt(message, frame.iv);
+	SendFrame(frame);
+}
+
+void
+Client::EnableRelay(uint32_t userId) {
+	m_userId = userId;
+}
+
+bool
+Client::RegisterUser() {
+	SendFrame(Frame::Control(Frame::Register, EncodeUserId(m_userId)));
+
+	// El hilo de recepción aún no existe: la respuesta se lee aquí
+	Frame reply;
+	if (!m_net.ReceiveFrame(m_serverSock, reply) || !reply.IsControl() ||
+		reply.Type() != Frame::Registered || reply.payload.size() != 4) {
+		Logger::Warn("[Client] Respuesta de registro inválida.\n");
+		return false;
+	}
+	if (Frame::GetU32(reply.payload.data()) != m_userId) {
+		Logger::Warn("[Client] El usuario {} ya está en uso.\n", m_userId);
+		return false;
+	}
+	Logger::Info("[Client] Registrado como usuario {}.\n", m_userId);
+	return true;
+}
+
+bool
+Client::LookupPeerKeys(const std::vector<uint32_t>& ids, std::unordered_map<uint32_t, std::string>& out) {
+	{
+		std::lock_guard<std::mutex> lock(m_peersMutex);
+		for (uint32_t id : ids) m_peerKeys.erase(id);
+	}
+
+	// Todas las consultas salen antes de esperar; las respuestas llegan al hilo de recepción
+	for (uint32_t id : ids) {
+		SendFrame(Frame::Control(Frame::Lookup, EncodeUserId(id)));
+	}
+	std::unique_lock<std::mutex> lock(m_peersMutex);
+	bool answered = m_peersCv.wait_for(lock, kLookupTimeout, [&]() {
+		for (uint32_t id : ids) {
+			if (m_peerKeys.count(id) == 0) return false;
+		}
+		return true;
+	});
+	if (!answered) {
+		Logger::Warn("[Client] Sin respuesta a la consulta de claves públicas.\n");
+		return false;
+	}
+	for (uint32_t id : ids) out[id] = m_peerKeys[id];
+	return true;
+}
+
+bool
+Client::EnsurePeerChannel(uint32_t peerId) {
+	{
+		std::lock_guard<std::mutex> lock(m_peersMutex);
+		auto it = m_peers.find(peerId);
+		if (it != m_peers.end() && it->second.tx) return true;
+	}
+
+	// 1. Pedir la clave pública del peer
+	std::unordered_map<uint32_t, std::string> keys;
+	if (!LookupPeerKeys({ peerId }, keys)) return false;
+	const std::string& pem = keys[peerId];
+	if (pem.empty()) {
+		Logger::Warn("[Client] El usuario {} no está conectado.\n", peerId);
+		return false;
+	}
+
+	// 2. Clave AES propia para este peer, envuelta con su RSA y enrutada hasta él
+	auto tx = std::make_unique<CryptoHelper>();
+	try {
+		tx->LoadPeerPublicKey(pem);
+	}
+	catch (const std::exception& e) {
+		Logger::Warn("[Client] {}\n", e.what());
+		return false;
+	}
+	tx->GenerateAESKey();
+	Frame wrap = Frame::Control(Frame::KeyWrap, tx->EncryptAESKeyWithPeer());
+	wrap.flags |= Frame::kRoutedFlag;
+	wrap.dst = peerId;
+	SendFrame(wrap);
+
+	std::lock_guard<std::mutex> lock(m_peersMutex);
+	m_peers[peerId].tx = std::move(tx);
+	Logger::Info("[Client] Clave extremo a extremo enviada al usuario {}.\n", peerId);
+	return true;
+}
+
+bool
+Client::SendToPeer(uint32_t peerId, const std::string& message) {
+	if (!EnsurePeerChannel(peerId)) return false;
+
+	Frame frame;
+	frame.flags = Frame::kRoutedFlag;
+	frame.dst = peerId;
+	StampFrame(frame);
+	{
+		// Cifrado con la clave de envío hacia este peer: el servidor no la conoce
+		std::lock_guard<std::mutex> lock(m_peersMutex);
+		frame.payload = m_peers[peerId].tx->AESEncrypt(message, frame.iv);
+	}
+	return SendFrame(frame);
+}
+
+bool
+Client::SendToPeers(const std::vector<uint32_t>& peerIds, const std::string& message) {
+	// 1. Claves públicas de los destinatarios que aún no conocemos (una ronda para todos)
+	std::vector<uint32_t> missing;
+	{
+		std::lock_guard<std::mutex> lock(m_peersMutex);
+		for (uint32_t peerId : peerIds) {
+			auto it = m_peers.find(peerId);
+			if (it == m_peers.end() || !it->second.recipient) missing.push_back(peerId);
+		}
+	}
+	if (!missing.empty()) {
+		std::unordered_map<uint32_t, std::string> keys;
+		if (!LookupPeerKeys(missing, keys)) return false;
+		for (uint32_t peerId : missing) {
+			if (keys[peerId].empty()) {
+				Logger::Warn("[Client] El usuario {} no está conectado.\n", peerId);
+				continue;
+			}
+			auto recipient = std::make_unique<CryptoHelper>();
+			try {
+				recipient->LoadPeerPublicKey(keys[peerId]);
+			}
+			catch (const std::exception& e) {
+				Logger::Warn("[Client] {}\n", e.what());
+				continue;
+			}
+			std::lock_guard<std::mutex> lock(m_peersMutex);
+			m_peers[peerId].recipient = std::move(recipient);
+		}
+	}
+
+	// 2. Cuerpo cifrado una vez; una envoltura RSA por destinatario
+	//    (solo este hilo reemplaza `recipient`: los punteros siguen válidos sin el mutex)
+	std::vector<uint32_t> ids;
+	std::vector<const CryptoHelper*> recipients;
+	{
+		std::lock_guard<std::mutex> lock(m_peersMutex);
+		for (uint32_t peerId : peerIds) {
+			auto it = m_peers.find(peerId);
+			if (it == m_peers.end() || !it->second.recipient) continue;
+			ids.push_back(peerId);
+			recipients.push_back(it->second.recipient.get());
+		}
+	}
+	if (ids.empty() || ids.size() > 0xFFFF) return false;
+	Frame frame = Frame::Control(Frame::Envelope, {});
+	StampFrame(frame);
+	Envelope envelope = CryptoHelper::SealEnvelope(message, recipients);
+
+	// 3. iv | n | n x [dst | len | envoltura] | cuerpo: el servidor reparte sin descifrar
+	std::vector<unsigned char> payload(envelope.iv);
+	payload.push_back(static_cast<unsigned char>(ids.size() >> 8));
+	payload.push_back(static_cast<unsigned char>(ids.size()));
+	for (size_t i = 0; i < ids.size(); ++i) {
+		const std::vector<unsigned char>& wrap = envelope.wraps[i];
+		unsigned char entry[6];
+		Frame::PutU32(entry, ids[i]);
+		entry[4] = static_cast<unsigned char>(wrap.size() >> 8);
+		entry[5] = static_cast<unsigned char>(wrap.size());
+		payload.insert(payload.end(), entry, entry + 6);
+		payload.insert(payload.end(), wrap.begin(), wrap.end());
+	}
+	payload.insert(payload.end(), envelope.body.begin(), envelope.body.end());
+	frame.payload = std::move(payload);
+	return SendFrame(frame);
+}
+
+bool
+Client::SendFrame(const Frame& frame) {
+	std::lock_guard<std::mutex> lock(m_sendMutex);
+	return m_net.SendFrame(m_serverSock, frame);
+}
+
+bool
+Client::JoinRoom(uint32_t roomId) {
+	if (m_userId == 0 || roomId == 0 || (roomId & Frame::kRoomAddress)) return false;
+
+	// Hoja propia del árbol: la clave pública viaja con el alta hasta el responsable
+	std::vector<unsigned char> leafSecret = RatchetTree::NewLeafSecret();
+	std::vector<unsigned char> payload = EncodeUserId(roomId);
+	std::vector<unsigned char> leafKey = CryptoHelper::NodePublicKey(leafSecret);
+	payload.insert(payload.end(), leafKey.begin(), leafKey.end());
+	{
+		std::lock_guard<std::mutex> lock(m_peersMutex);
+		m_rooms[roomId] = RoomChannel();
+		m_rooms[roomId].leafSecret = std::move(leafSecret);
+	}
+	SendFrame(Frame::Control(Frame::JoinRoom, std::move(payload)));
 
-	// 1) IV (16)
-	m_net.SendData(m_serverSock, iv);
+	// La lista de miembros llega al hilo de recepción
+	std::unique_lock<std::mutex> lock(m_peersMutex);
+	if (!m_peersCv.wait_for(lock, kLookupTimeout, [&]() {
+		auto it = m_rooms.find(roomId);
+		return it != m_rooms.end() && it->second.listed;
+	})) {
+		Logger::Warn("[Client] Sin respuesta al entrar en la sala {}.\n", roomId);
+		m_rooms.erase(roomId);
+		return false;
+	}
+	Logger::Info("[Client] En la sala {} con {} miembros más.\n", roomId, m_rooms[roomId].others);
+	return true;
+}
+
+void
+Client::LeaveRoom(uint32_t roomId) {
+	SendFrame(Frame::Control(Frame::LeaveRoom, EncodeUserId(roomId)));
+	std::lock_guard<std::mutex> lock(m_peersMutex);
+	m_rooms.erase(roomId);
+}
+
+void
+Client::CommitPending(uint32_t roomId, RoomChannel& room, std::vector<Frame>& outbox) {
+	if (!room.tree || room.staged || (room.pendingAdds.empty() && room.pendingRemoves.empty())) return;
+
+	// El commit se prepara sobre una copia: si otro gana la época se descarta
+	room.staged = std::make_unique<RatchetTree>(*room.tree);
+	room.stagedAdds.swap(room.pendingAdds);
+	room.stagedRemoves.swap(room.pendingRemoves);
+	room.pendingAdds.clear();
+	room.pendingRemoves.clear();
+	Frame commit = Frame::Control(Frame::RoomCommit, room.staged->Commit(room.stagedAdds, room.stagedRemoves));
+	commit.flags |= Frame::kRoutedFlag;
+	commit.dst = roomId | Frame::kRoomAddress;
+	outbox.push_back(std::move(commit));
+}
 
-	// 2) Tamao (uint32_t) en network byte order
-	uint32_t clen = static_cast<uint32_t>(cipher.size());
-	uint32_t nlen = htonl(clen);
-	std::vector<unsigned char> len4(reinterpret_cast<unsigned char*>(&nlen),
-		reinterpret_cast<unsigned char*>(&nlen) + 4);
-	m_net.SendData(m_serverSock, len4);
+void
+Client::ApplyRoomCommit(uint32_t roomId, RoomChannel& room, uint32_t committer,
+	const std::vector<unsigned char>& commit, std::vector<Frame>& outbox) {
+	uint32_t epoch = RatchetTree::CommitEpoch(commit);
+	// Sin árbol (esperando el Welcome) o de una época futura: se guarda para después
+	if (!room.tree || epoch > room.tree->Epoch()) {
+		room.futureCommits[epoch] = commit;
+		return;
+	}
+	if (epoch < room.tree->Epoch()) return;
 
-	// 3) Ciphertext
-	m_net.SendData(m_serverSock, cipher);
+	uint32_t previousEpoch = room.tree->Epoch();
+	std::vector<unsigned char> previousKey = room.tree->GroupKey();
+	if (committer == m_userId && room.staged) {
+		// Eco de nuestro commit: los nuevos miembros reciben el árbol y su secreto
+		room.tree = std::move(room.staged);
+		for (const RatchetTree::Addition& add : room.stagedAdds) {
+			Frame welcome = Frame::Control(Frame::RoomWelcome, room.tree->Welcome(add.userId));
+			Frame::PutU32(welcome.iv.data() + 1, roomId);
+			welcome.flags |= Frame::kRoutedFlag;
+			welcome.dst = add.userId;
+			outbox.push_back(std::move(welcome));
+		}
+	}
+	else {
+		if (!room.tree->ApplyCommit(commit)) {
+			Logger::Warn("\n[Client] Commit inválido del usuario {} en la sala {}.\n", committer, roomId);
+			return;
+		}
+		if (room.staged) {
+			// Otro commit ganó la época: nuestros cambios vuelven a la cola
+			room.pendingAdds.insert(room.pendingAdds.end(), room.stagedAdds.begin(), room.stagedAdds.end());
+			room.pendingRemoves.insert(room.pendingRemoves.end(), room.stagedRemoves.begin(), room.stagedRemoves.end());
+			room.staged.reset();
+		}
+	}
+	room.stagedAdds.clear();
+	room.stagedRemoves.clear();
+	room.previousEpoch = previousEpoch;
+	room.previousKey = std::move(previousKey);
+
+	// Commits que llegaron antes de tiempo (nunca propios: solo se emite sobre la época vigente)
+	auto next = room.futureCommits.find(room.tree->Epoch());
+	if (next != room.futureCommits.end()) {
+		std::vector<unsigned char> pending = std::move(next->second);
+		room.futureCommits.erase(room.futureCommits.begin(), std::next(next));
+		ApplyRoomCommit(roomId, room, 0, pending, outbox);
+		return;
+	}
+	CommitPending(roomId, room, outbox);
+}
+
+bool
+Client::SendToRoom(uint32_t roomId, const std::string& message) {
+	Frame frame;
+	frame.flags = Frame::kRoutedFlag;
+	frame.dst = roomId | Frame::kRoomAddress;
+	StampFrame(frame);
+	{
+		// Una sola cifra con la clave de grupo; la época indica con qué clave descifrar
+		std::lock_guard<std::mutex> lock(m_peersMutex);
+		auto it = m_rooms.find(roomId);
+		if (it == m_rooms.end() || !it->second.tree || it->second.tree->GroupKey().empty()) {
+			Logger::Warn("[Client] Aún sin clave de grupo en la sala {}.\n", roomId);
+			return false;
+		}
+		CryptoHelper group;
+		group.SetAESKey(it->second.tree->GroupKey());
+		frame.payload = EncodeUserId(it->second.tree->Epoch());
+		std::vector<unsigned char> cipher = group.AESEncrypt(message, frame.iv);
+		frame.payload.insert(frame.payload.end(), cipher.begin(), cipher.end());
+	}
+	return SendFrame(frame);
 }
 
 void 
 Client::SendEncryptedMessageLoop() {
 	std::string msg;
 	while (true) {
-		std::cout << "Cliente: ";
+		Logger::Print("Cliente: ");
 		std::getline(std::cin, msg);
 		if (msg == "/exit") break;
 
-		std::vector<unsigned char> iv;
-		auto cipher = m_crypto.AESEncrypt(msg, iv);
+		// "/latency": resumen; "/latency <prefijo>": distribuciones completas en archivos
+		if (msg == "/latency" || msg.compare(0, 9, "/latency ") == 0) {
+			std::string prefix = msg.size() > 9 ? msg.substr(9) : "";
+			if (!ReportLatency(prefix)) Logger::Warn("[Client] No se pudo escribir {}-*.hgrm.\n", prefix);
+			continue;
+		}
+
+		if (msg == "/rtt") {
+			std::chrono::microseconds rtt, jitter;
+			if (GetRtt(rtt, jitter)) {
+				Logger::Info("[Client] RTT {} ms, jitter {} ms.\n", rtt.count() / 1000.0, jitter.count() / 1000.0);
+			}
+			else {
+				Logger::Info("[Client] Aún no hay muestras de RTT.\n");
+			}
+			continue;
+		}
 
-		m_net.SendData(m_serverSock, iv);
+		if (m_userId == 0) {
+			SendEncryptedMessage(msg);
+			continue;
+		}
+
+		// Salas: "/join <sala>" y "/leave <sala>"
+		if (msg.compare(0, 6, "/join ") == 0 || msg.compare(0, 7, "/leave ") == 0) {
+			std::istringstream in(msg.substr(msg.find(' ') + 1));
+			uint32_t roomId = 0;
+			in >> roomId;
+			if (msg[1] == 'j') {
+				if (JoinRoom(roomId)) { m_currentRoom = roomId; m_currentPeers.clear(); }
+			}
+			else {
+				LeaveRoom(roomId);
+				if (m_currentRoom == roomId) m_currentRoom = 0;
+			}
+			continue;
+		}
 
-		uint32_t clen = static_cast<uint32_t>(cipher.size());
-		uint32_t nlen = htonl(clen);
-		std::vector<unsigned char> len4(reinterpret_cast<unsigned char*>(&nlen),
-			reinterpret_cast<unsigned char*>(&nlen) + 4);
-		m_net.SendData(m_serverSock, len4);
+		// Relay: "/to <id>[,<id>...] <texto>" o "/room <sala> <texto>" eligen el
+		// destino; las líneas siguientes van al mismo
+		if (msg.compare(0, 4, "/to ") == 0 || msg.compare(0, 6, "/room ") == 0) {
+			bool room = msg[1] == 'r';
+			std::istringstream in(msg.substr(room ? 6 : 4));
+			std::string targets;
+			in >> targets;
+			msg.clear();
+			std::getline(in >> std::ws, msg);
 
-		m_net.SendData(m_serverSock, cipher);
+			std::vector<uint32_t> ids;
+			std::istringstream list(targets);
+			bool valid = true;
+			for (std::string text; valid && std::getline(list, text, ',');) {
+				uint32_t id = 0;
+				if (text.empty()) continue;
+				if (!ParseId(text, id)) {
+					Logger::Warn("[Client] Destino no válido: {}.\n", text);
+					valid = false;
+				}
+				ids.push_back(id);
+			}
+			if (!valid) continue;
+			m_currentPeers = room ? std::vector<uint32_t>() : ids;
+			m_currentRoom = (room && !ids.empty()) ? ids[0] : 0;
+		}
+		if (m_currentPeers.empty() && m_currentRoom == 0) {
+			Logger::Info("[Client] Usa /to <id>[,<id>...] <mensaje> o /room <sala> <mensaje> para elegir destino.\n");
+			continue;
+		}
+		if (msg.empty()) continue;
+		if (m_currentRoom != 0) SendToRoom(m_currentRoom, msg);
+		else if (m_currentPeers.size() == 1) SendToPeer(m_currentPeers[0], msg);
+		else SendToPeers(m_currentPeers, msg);
 	}
 }
 
 void 
 Client::StartReceiveLoop() {
 	while (true) {
-		// 1) IV (16 bytes)
-		auto iv = m_net.ReceiveDataBinary(m_serverSock, 16);
-		if (iv.empty()) {
-			std::cout << "\n[Client] Conexin cerrada por el servidor.\n";
+		// IV (16) | tamaño (4, network/big-endian) | [ruta] | payload
+		Frame frame;
+		if (!m_net.ReceiveFrame(m_serverSock, frame)) {
+			Logger::Print("\n[Client] Conexión cerrada por el servidor.\n");
 			break;
 		}
+		{
+			std::lock_guard<std::mutex> lock(m_heartbeatMutex);
+			m_heartbeat.OnHeard(Heartbeat::Clock::now());
+		}
+		// Solo cuenta la latencia de lo que se pudo leer: un descarte no es una entrega
+		if (HandleIncoming(frame) && frame.IsStamped()) RecordLatency(frame);
+	}
+	StopHeartbeat();
+	Logger::Info("[Client] ReceiveLoop terminado.\n");
+}
 
-		// 2) Tamao (4 bytes, network/big-endian)
-		auto len4 = m_net.ReceiveDataBinary(m_serverSock, 4);
-		if (len4.size() != 4) {
-			std::cout << "[Client] Error al recibir tamao.\n";
-			break;
+bool
+Client::HandleIncoming(const Frame& frame) {
+	// Respuesta a una consulta de clave pública
+	if (frame.IsControl() && !frame.IsRouted()) {
+		if (frame.Type() == Frame::Ping) {
+			// Eco del payload: el servidor mide el RTT con su propio reloj
+			SendFrame(Frame::Control(Frame::Pong, frame.payload));
 		}
-		uint32_t nlen = 0;
-		std::memcpy(&nlen, len4.data(), 4);
-		uint32_t clen = ntohl(nlen);
+		else if (frame.Type() == Frame::Pong) {
+			std::lock_guard<std::mutex> lock(m_heartbeatMutex);
+			m_heartbeat.OnPong(frame.payload.data(), frame.payload.size(), Heartbeat::Clock::now());
+		}
+		else if (frame.Type() == Frame::PeerKey && frame.payload.size() >= 4) {
+			uint32_t peerId = Frame::GetU32(frame.payload.data());
+			std::lock_guard<std::mutex> lock(m_peersMutex);
+			m_peerKeys[peerId].assign(frame.payload.begin() + 4, frame.payload.end());
+			m_peersCv.notify_all();
+		}
+		else {
+			HandleRoomControl(frame);
+		}
+		return false;
+	}
 
-		// 3) Ciphertext (clen bytes)
-		auto cipher = m_net.ReceiveDataBinary(m_serverSock, static_cast<int>(clen));
-		if (cipher.empty()) {
-			std::cout << "[Client] Error al recibir datos.\n";
-			break;
+	// Acuse de un mensaje propio: ida y vuelta con nuestro reloj
+	if (frame.IsControl() && frame.Type() == Frame::Receipt) {
+		uint64_t now = Frame::NowMicros();
+		if (frame.payload.size() != Frame::kStampSize) return false;
+		uint64_t sentAt = Frame::GetU64(frame.payload.data() + 4);
+		if (sentAt > now) return false;
+		std::lock_guard<std::mutex> lock(m_latencyMutex);
+		m_roundTrip.Record(now - sentAt);
+		return false;
+	}
+
+	// Sobre: nuestra envoltura de la clave de contenido y el cuerpo compartido
+	if (frame.IsControl() && frame.Type() == Frame::Envelope) {
+		const std::vector<unsigned char>& p = frame.payload;
+		if (p.size() < Frame::kIvSize + 2) return false;
+		size_t wrapSize = (size_t(p[Frame::kIvSize]) << 8) | p[Frame::kIvSize + 1];
+		auto wrapBegin = p.begin() + Frame::kIvSize + 2;
+		if (static_cast<size_t>(p.end() - wrapBegin) < wrapSize) return false;
+		std::string plain;
+		if (!m_crypto.OpenEnvelope(
+			std::vector<unsigned char>(wrapBegin, wrapBegin + wrapSize),
+			std::vector<unsigned char>(wrapBegin + wrapSize, p.end()),
+			std::vector<unsigned char>(p.begin(), p.begin() + Frame::kIvSize), plain)) {
+			Logger::Warn("\n[Client] Sobre del usuario {} ilegible (envoltura ajena o cuerpo alterado); descartado.\n", frame.src);
+			return false;
+		}
+		Logger::Print("\n[Usuario {}]: {}\nCliente: ", frame.src, plain);
+		return true;
+	}
+
+	// Clave AES del peer para descifrar lo que él nos envíe
+	if (frame.IsControl() && frame.Type() == Frame::KeyWrap) {
+		std::vector<unsigned char> key = m_crypto.UnwrapAESKey(frame.payload);
+		if (key.size() != 32) {
+			Logger::Warn("\n[Client] Clave inválida del usuario {}.\n", frame.src);
+			return false;
+		}
+		auto rx = std::make_unique<CryptoHelper>();
+		rx->SetAESKey(key);
+		std::lock_guard<std::mutex> lock(m_peersMutex);
+		m_peers[frame.src].rx = std::move(rx);
+		return false;
+	}
+
+	// Árbol de claves de una sala: commit repartido por el servidor o Welcome del responsable
+	if (frame.IsControl() && (frame.Type() == Frame::RoomCommit || frame.Type() == Frame::RoomWelcome)) {
+		bool welcome = frame.Type() == Frame::RoomWelcome;
+		uint32_t roomId = welcome ? Frame::GetU32(frame.iv.data() + 1) : frame.dst & ~Frame::kRoomAddress;
+		// Los frames resultantes se envían sin el mutex: un envío lento no frena al hilo de chat
+		std::vector<Frame> outbox;
+		{
+			std::lock_guard<std::mutex> lock(m_peersMutex);
+			auto it = m_rooms.find(roomId);
+			if (it == m_rooms.end()) return false;
+			RoomChannel& room = it->second;
+			if (!welcome) {
+				ApplyRoomCommit(roomId, room, frame.src, frame.payload, outbox);
+			}
+			else {
+				if (room.tree) return false;
+				auto tree = std::make_unique<RatchetTree>();
+				if (!tree->ApplyWelcome(frame.payload, m_userId, room.leafSecret)) {
+					Logger::Warn("\n[Client] Welcome inválido del usuario {} en la sala {}.\n", frame.src, roomId);
+					return false;
+				}
+				room.tree = std::move(tree);
+				Logger::Print("\n[Sala {}] Clave de grupo recibida (época {}, {} miembros).\nCliente: ", roomId, room.tree->Epoch(), room.tree->MemberCount());
+
+				// Commits posteriores que llegaron antes que el Welcome
+				auto next = room.futureCommits.find(room.tree->Epoch());
+				room.futureCommits.erase(room.futureCommits.begin(), next);
+				if (next != room.futureCommits.end()) {
+					std::vector<unsigned char> pending = std::move(next->second);
+					room.futureCommits.erase(next);
+					ApplyRoomCommit(roomId, room, 0, pending, outbox);
+				}
+				else {
+					CommitPending(roomId, room, outbox);
+				}
+			}
 		}
+		for (const Frame& out : outbox) SendFrame(out);
+		return false;
+	}
 
-		// 4) Descifrar y mostrar
-		std::string plain = m_crypto.AESDecrypt(cipher, iv);
-		std::cout << "\n[Servidor]: " << plain << "\nCliente: ";
-		std::cout.flush();
+	std::string plain;
+	std::string from = "Servidor";
+	if (frame.IsRouted() && (frame.dst & Frame::kRoomAddress)) {
+		// Sala: época (4) | cifrado con la clave de grupo de esa época
+		uint32_t roomId = frame.dst & ~Frame::kRoomAddress;
+		std::lock_guard<std::mutex> lock(m_peersMutex);
+		auto room = m_rooms.find(roomId);
+		if (room == m_rooms.end() || frame.payload.size() < 4) return false;
+		uint32_t epoch = Frame::GetU32(frame.payload.data());
+		const RoomChannel& channel = room->second;
+		const std::vector<unsigned char>* key = nullptr;
+		if (channel.tree && channel.tree->Epoch() == epoch) key = &channel.tree->GroupKey();
+		else if (!channel.previousKey.empty() && channel.previousEpoch == epoch) key = &channel.previousKey;
+		if (!key || key->empty()) {
+			Logger::Warn("\n[Client] Mensaje del usuario {} en la sala {} de la época {} sin clave; descartado.\n", frame.src, roomId, epoch);
+			return false;
+		}
+		CryptoHelper group;
+		group.SetAESKey(*key);
+		plain = group.AESDecrypt(std::vector<unsigned char>(frame.payload.begin() + 4, frame.payload.end()), frame.iv);
+		from = "Sala " + std::to_string(roomId) + " | Usuario " + std::to_string(frame.src);
+	}
+	else if (frame.IsRouted()) {
+		std::lock_guard<std::mutex> lock(m_peersMutex);
+		auto it = m_peers.find(frame.src);
+		if (it == m_peers.end() || !it->second.rx) {
+			Logger::Warn("\n[Client] Mensaje del usuario {} sin clave; descartado.\n", frame.src);
+			return false;
+		}
+		plain = it->second.rx->AESDecrypt(frame.payload, frame.iv);
+		from = "Usuario " + std::to_string(frame.src);
+	}
+	else {
+		plain = m_crypto.AESDecrypt(frame.payload, frame.iv);
 	}
-	std::cout << "[Client] ReceiveLoop terminado.\n";
+	if (plain.empty()) {
+		// AESDecrypt devuelve vacío si el padding no cuadra; el bucle de chat nunca envía mensajes vacíos
+		Logger::Warn("\n[Client] Mensaje de {} ilegible; descartado.\n", from);
+		return false;
+	}
+	Logger::Print("\n[{}]: {}\nCliente: ", from, plain);
+	return true;
+}
+
+void
+Client::HandleRoomControl(const Frame& frame) {
+	const std::vector<unsigned char>& p = frame.payload;
+	std::unique_lock<std::mutex> lock(m_peersMutex);
+
+	// Respuesta a JoinRoom: sala (4) | miembros (4 c/u)
+	if (frame.Type() == Frame::RoomMembers && p.size() >= 4 && p.size() % 4 == 0) {
+		auto it = m_rooms.find(Frame::GetU32(p.data()));
+		if (it == m_rooms.end()) return;
+		RoomChannel& room = it->second;
+		room.listed = true;
+		room.others = p.size() / 4 - 1;
+		// Sala vacía: el primer miembro crea el árbol; el resto espera su Welcome
+		if (room.others == 0 && !room.tree) {
+			room.tree = std::make_unique<RatchetTree>();
+			room.tree->Create(m_userId, room.leafSecret);
+		}
+		m_peersCv.notify_all();
+		return;
+	}
+
+	// Alta o baja: sala (4) | usuario (4) | 1/0 (1) | responsable (4) | [clave de hoja (32)]
+	if (frame.Type() != Frame::RoomEvent || p.size() < 13) return;
+	uint32_t roomId = Frame::GetU32(p.data());
+	uint32_t userId = Frame::GetU32(p.data() + 4);
+	uint32_t sponsor = Frame::GetU32(p.data() + 9);
+	auto it = m_rooms.find(roomId);
+	if (it == m_rooms.end()) return;
+	RoomChannel& room = it->second;
+	if (p[8]) {
+		Logger::Print("\n[Sala {}] Entra el usuario {}.\nCliente: ", roomId, userId);
+		if (sponsor == m_userId && p.size() == 13 + 32) {
+			room.pendingAdds.push_back(RatchetTree::Addition{ userId, std::vector<unsigned char>(p.begin() + 13, p.end()) });
+		}
+	}
+	else {
+		// Quien sale no debe poder leer lo siguiente: su hoja sale en el próximo commit
+		Logger::Print("\n[Sala {}] Sale el usuario {}.\nCliente: ", roomId, userId);
+		auto added = std::find_if(room.pendingAdds.begin(), room.pendingAdds.end(),
+			[&](const RatchetTree::Addition& add) { return add.userId == userId; });
+		if (added != room.pendingAdds.end()) room.pendingAdds.erase(added);
+		else if (sponsor == m_userId) room.pendingRemoves.push_back(userId);
+	}
+	std::vector<Frame> outbox;
+	CommitPending(roomId, room, outbox);
+	lock.unlock();
+	for (const Frame& out : outbox) SendFrame(out);
 }
 
 void Client::StartChatLoop() {
+	{
+		std::lock_guard<std::mutex> lock(m_heartbeatMutex);
+		m_heartbeat.OnHeard(Heartbeat::Clock::now());
+		m_heartbeatRunning = m_heartbeatInterval.count() > 0;
+	}
+	std::thread heartbeatThread([&]() {
+		HeartbeatLoop();
+		});
+
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_queueRunning = true;
+	}
+	std::thread sendThread([&]() {
+		SendQueueLoop();
+		});
+
 	std::thread recvThread([&]() {
 		StartReceiveLoop();
 		});
 
 	SendEncryptedMessageLoop();
 
+	StopHeartbeat();
+	if (heartbeatThread.joinable())
+		heartbeatThread.join();
 	if (recvThread.joinable())
 		recvThread.join();
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_queueRunning = false;
+	}
+	m_queueCv.notify_all();
+	if (sendThread.joinable())
+		sendThread.join();
+}
+
+bool
+Client::QueueFrame(Frame frame) {
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		if (!m_queueRunning || m_sendQueue.size() >= kMaxQueuedFrames) return false;
+		m_sendQueue.push_back(std::move(frame));
+	}
+	m_queueCv.notify_one();
+	return true;
+}
+
+void
+Client::SendQueueLoop() {
+	std::unique_lock<std::mutex> lock(m_queueMutex);
+	while (true) {
+		m_queueCv.wait(lock, [this] { return !m_queueRunning || !m_sendQueue.empty(); });
+		if (m_sendQueue.empty()) break;
+		Frame frame = std::move(m_sendQueue.front());
+		m_sendQueue.pop_front();
+		lock.unlock();
+		SendFrame(frame);
+		lock.lock();
+	}
+}
+
+void
+Client::SetHeartbeat(std::chrono::milliseconds interval, uint32_t maxMissed) {
+	m_heartbeatInterval = interval;
+	m_maxMissedPings = maxMissed;
+}
+
+bool
+Client::GetRtt(std::chrono::microseconds& rtt, std::chrono::microseconds& jitter) {
+	std::lock_guard<std::mutex> lock(m_heartbeatMutex);
+	if (!m_heartbeat.HasSample()) return false;
+	rtt = m_heartbeat.SmoothedRtt();
+	jitter = m_heartbeat.Jitter();
+	return true;
+}
+
+void
+Client::HeartbeatLoop() {
+	std::unique_lock<std::mutex> lock(m_heartbeatMutex);
+	while (m_heartbeatRunning) {
+		auto now = Heartbeat::Clock::now();
+		// El servidor habló dentro del intervalo: basta con esperar a que se cumpla
+		std::chrono::milliseconds silence = m_heartbeat.Silence(now);
+		if (silence < m_heartbeatInterval) {
+			m_heartbeatCv.wait_for(lock, m_heartbeatInterval - silence, [this] { return !m_heartbeatRunning; });
+			continue;
+		}
+		if (m_heartbeat.Missed() >= m_maxMissedPings) {
+			Logger::Warn("\n[Client] El servidor no responde a {} pings; se cierra la conexión.\n", m_maxMissedPings);
+			m_heartbeatRunning = false;
+			m_net.Shutdown(m_serverSock);
+			break;
+		}
+		m_heartbeat.OnPingSent();
+		lock.unlock();
+		SendFrame(Frame::Control(Frame::Ping, Heartbeat::PingPayload(now)));
+		lock.lock();
+		m_heartbeatCv.wait_for(lock, m_heartbeatInterval, [this] { return !m_heartbeatRunning; });
+	}
+}
+
+void
+Client::StopHeartbeat() {
+	std::lock_guard<std::mutex> lock(m_heartbeatMutex);
+	m_heartbeatRunning = false;
+	m_heartbeatCv.notify_all();
+}
+
+void
+Client::EnableLatencyStamps(bool enabled) {
+	m_stampMessages = enabled;
+}
+
+void
+Client::StampFrame(Frame& frame) {
+	if (!m_stampMessages) return;
+	frame.flags |= Frame::kStampedFlag;
+	frame.sequence = ++m_sequence;
+	frame.sentAtUs = Frame::NowMicros();
+}
+
+void
+Client::RecordLatency(const Frame& frame) {
+	uint64_t now = Frame::NowMicros();
+	// Sin ruta: eco del servidor de un mensaje propio
+	if (!frame.IsRouted()) {
+		if (frame.sentAtUs > now) return;
+		std::lock_guard<std::mutex> lock(m_latencyMutex);
+		m_roundTrip.Record(now - frame.sentAtUs);
+		return;
+	}
+
+	// Un reloj de pared adelantado respecto al nuestro daría latencias negativas
+	if (frame.sentAtUs <= now) {
+		std::lock_guard<std::mutex> lock(m_latencyMutex);
+		m_oneWay.Record(now - frame.sentAtUs);
+	}
+
+	// Acuse solo a los mensajes directos: en una sala serían uno por miembro
+	if ((frame.dst & Frame::kRoomAddress) || frame.src == 0) return;
+	std::vector<unsigned char> stamp(Frame::kStampSize);
+	Frame::PutU32(stamp.data(), frame.sequence);
+	Frame::PutU64(stamp.data() + 4, frame.sentAtUs);
+	Frame receipt = Frame::Control(Frame::Receipt, std::move(stamp));
+	receipt.flags |= Frame::kRoutedFlag;
+	receipt.dst = frame.src;
+	// El hilo de recepción no espera al socket: un envío lento retrasaría las medidas siguientes
+	QueueFrame(std::move(receipt));
+}
+
+bool
+Client::ReportLatency(const std::string& prefix) {
+	std::lock_guard<std::mutex> lock(m_latencyMutex);
+	if (!prefix.empty()) {
+		std::ofstream oneWay(prefix + "-oneway.hgrm");
+		std::ofstream roundTrip(prefix + "-rtt.hgrm");
+		if (!oneWay || !roundTrip) return false;
+		m_oneWay.WritePercentiles(oneWay, 1000.0);
+		m_roundTrip.WritePercentiles(roundTrip, 1000.0);
+		Logger::Info("[Client] Latencias escritas en {}-oneway.hgrm y {}-rtt.hgrm (ms).\n", prefix, prefix);
+		return true;
+	}
+	const std::pair<const char*, const HdrHistogram*> histograms[] = {
+		{ "Un sentido", &m_oneWay }, { "Ida y vuelta", &m_roundTrip } };
+	for (const auto& entry : histograms) {
+		const HdrHistogram& h = *entry.second;
+		Logger::Info("[Client] {}: {} muestras, p50 {} ms, p99 {} ms, p99.9 {} ms, máx {} ms.\n", entry.first, h.Count(),
+			h.ValueAtPercentile(50) / 1000.0, h.ValueAtPercentile(99) / 1000.0,
+			h.ValueAtPercentile(99.9) / 1000.0, h.Max() / 1000.0);
+	}
+	return true;
 }
@@ -1,16 +1,18 @@
 /**
  * @file CryptoHelper.cpp
- * @brief Implementacin de utilidades criptogrficas con OpenSSL.
+ * @brief Implementación de utilidades criptográficas con OpenSSL.
  *
  * @details
  * Esta unidad implementa las funciones declaradas en CryptoHelper.h para:
  *  - Generar y manejar pares de claves RSA (2048 bits).
- *  - Exportar e importar claves pblicas en formato PEM.
- *  - Generar una clave AES-256 aleatoria para cifrado de sesin.
+ *  - Exportar e importar claves públicas en formato PEM.
+ *  - Generar una clave AES-256 aleatoria para cifrado de sesión.
  *  - Cifrar y descifrar la clave AES usando RSA con padding OAEP.
  *  - Cifrar y descifrar mensajes con AES-256 en modo CBC.
+ *  - Sellar y abrir sobres multi-destinatario (cuerpo AES-256-GCM y una envoltura RSA por destinatario).
+ *  - Derivar secretos (HKDF) y sellarlos (AES-256-GCM) para claves X25519 del árbol de grupo.
  *
- * @note Requiere la librera OpenSSL y su inicializacin previa si aplica.
+ * @note Requiere la librería OpenSSL y su inicialización previa si aplica.
  */
 
 #include "CryptoHelper.h"
@@ -18,6 +20,92 @@
 #include "openssl/rand.h"
 #include "openssl/err.h"
 #include "openssl/evp.h"
+#include "openssl/kdf.h"
+#include <algorithm>
+
+namespace {
+	/// Tamaño de claves X25519 y de los secretos del árbol.
+	const size_t kNodeKeySize = 32;
+	/// IV y etiqueta de AES-256-GCM.
+	const size_t kGcmIvSize = 12;
+	const size_t kGcmTagSize = 16;
+
+	/// Cifra con AES-256-GCM y añade `iv (12) | cifrado | etiqueta (16)` a @p out.
+	void GcmSeal(const unsigned char* key, const unsigned char* data, size_t size,
+		std::vector<unsigned char>& out) {
+		size_t start = out.size();
+		out.resize(start + kGcmIvSize + size + kGcmTagSize);
+		unsigned char* iv = out.data() + start;
+		unsigned char* cipher = iv + kGcmIvSize;
+		RAND_bytes(iv, static_cast<int>(kGcmIvSize));
+
+		EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+		int outlen1 = 0, outlen2 = 0;
+		bool ok = ctx && EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, key, iv) == 1 &&
+			EVP_EncryptUpdate(ctx, cipher, &outlen1, data, static_cast<int>(size)) == 1 &&
+			EVP_EncryptFinal_ex(ctx, cipher + outlen1, &outlen2) == 1 &&
+			EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, static_cast<int>(kGcmTagSize), cipher + size) == 1;
+		EVP_CIPHER_CTX_free(ctx);
+		if (!ok) {
+			throw std::runtime_error("AES-GCM encryption failed.");
+		}
+	}
+
+	/// Abre `iv | cifrado | etiqueta`; false si la etiqueta no cuadra (clave errónea o datos alterados).
+	bool GcmOpen(const unsigned char* key, const unsigned char* sealed, size_t size,
+		std::vector<unsigned char>& out) {
+		if (size < kGcmIvSize + kGcmTagSize) return false;
+		const unsigned char* iv = sealed;
+		const unsigned char* cipher = sealed + kGcmIvSize;
+		size_t cipherSize = size - kGcmIvSize - kGcmTagSize;
+		std::vector<unsigned char> tag(cipher + cipherSize, cipher + cipherSize + kGcmTagSize);
+		out.resize(cipherSize);
+
+		EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+		int outlen1 = 0, outlen2 = 0;
+		bool ok = ctx && EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, key, iv) == 1 &&
+			EVP_DecryptUpdate(ctx, out.data(), &outlen1, cipher, static_cast<int>(cipherSize)) == 1 &&
+			EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, static_cast<int>(kGcmTagSize), tag.data()) == 1 &&
+			EVP_DecryptFinal_ex(ctx, out.data() + outlen1, &outlen2) == 1;
+		EVP_CIPHER_CTX_free(ctx);
+		if (!ok) {
+			OPENSSL_cleanse(out.data(), out.size());
+			out.clear();
+		}
+		return ok;
+	}
+
+	/// Clave X25519 desde sus 32 bytes privados (nullptr si no es válida).
+	EVP_PKEY* LoadNodeSecret(const std::vector<unsigned char>& nodeSecret) {
+		if (nodeSecret.size() != kNodeKeySize) return nullptr;
+		return EVP_PKEY_new_raw_private_key(EVP_PKEY_X25519, nullptr, nodeSecret.data(), nodeSecret.size());
+	}
+
+	/// Secreto compartido X25519 entre una clave privada y una pública.
+	std::vector<unsigned char> NodeAgreement(EVP_PKEY* own, const unsigned char* peerPublic) {
+		std::vector<unsigned char> shared;
+		EVP_PKEY* peer = EVP_PKEY_new_raw_public_key(EVP_PKEY_X25519, nullptr, peerPublic, kNodeKeySize);
+		EVP_PKEY_CTX* ctx = peer ? EVP_PKEY_CTX_new(own, nullptr) : nullptr;
+		size_t length = kNodeKeySize;
+		shared.resize(length);
+		if (!ctx || EVP_PKEY_derive_init(ctx) <= 0 || EVP_PKEY_derive_set_peer(ctx, peer) <= 0 ||
+			EVP_PKEY_derive(ctx, shared.data(), &length) <= 0) {
+			shared.clear();
+		}
+		EVP_PKEY_CTX_free(ctx);
+		EVP_PKEY_free(peer);
+		return shared;
+	}
+
+	/// Clave AES del sellado: HKDF(dh | efímera | destino).
+	std::vector<unsigned char> SealKey(const std::vector<unsigned char>& shared,
+		const unsigned char* ephemeral, const unsigned char* target) {
+		std::vector<unsigned char> ikm(shared);
+		ikm.insert(ikm.end(), ephemeral, ephemeral + kNodeKeySize);
+		ikm.insert(ikm.end(), target, target + kNodeKeySize);
+		return CryptoHelper::DeriveSecret(ikm, "seal");
+	}
+}
 
 
 CryptoHelper::CryptoHelper() :rsaKeyPair(nullptr), peerPublicKey(nullptr) {
@@ -53,15 +141,40 @@ CryptoHelper::GetPublicKeyString() const {
 	return publicKey;
 }
 
+std::string
+CryptoHelper::GetPeerPublicKeyString() const {
+	if (!peerPublicKey) return {};
+	BIO* bio = BIO_new(BIO_s_mem());
+	PEM_write_bio_RSAPublicKey(bio, peerPublicKey);
+	char* buffer = nullptr;
+	size_t length = BIO_get_mem_data(bio, &buffer);
+	std::string pem(buffer, length);
+	BIO_free(bio);
+	return pem;
+}
+
 void 
 CryptoHelper::LoadPeerPublicKey(const std::string& pemKey) {
 	BIO* bio = BIO_new_mem_buf(pemKey.data(), static_cast<int>(pemKey.size()));
-	peerPublicKey = PEM_read_bio_RSAPublicKey(bio, nullptr, nullptr, nullptr);
+	RSA* key = PEM_read_bio_RSAPublicKey(bio, nullptr, nullptr, nullptr);
 	BIO_free(bio);
-	if (!peerPublicKey) {
+	if (!key) {
 		throw std::runtime_error("Failed to load peer public key: " 
 			+ std::string(ERR_error_string(ERR_get_error(), nullptr)));
 	}
+	// Recargar la clave del peer no debe perder la anterior
+	if (peerPublicKey) RSA_free(peerPublicKey);
+	peerPublicKey = key;
+}
+
+bool
+CryptoHelper::IsValidPublicKey(const std::string& pemKey) {
+	BIO* bio = BIO_new_mem_buf(pemKey.data(), static_cast<int>(pemKey.size()));
+	RSA* key = PEM_read_bio_RSAPublicKey(bio, nullptr, nullptr, nullptr);
+	BIO_free(bio);
+	if (!key) return false;
+	RSA_free(key);
+	return true;
 }
 
 void 
@@ -94,6 +207,73 @@ CryptoHelper::DecryptAESKey(const std::vector<unsigned char>& encryptedKey) {
 											RSA_PKCS1_OAEP_PADDING);
 }
 
+std::vector<unsigned char>
+CryptoHelper::UnwrapAESKey(const std::vector<unsigned char>& encryptedKey) const {
+	if (!rsaKeyPair) {
+		throw std::runtime_error("RSA key pair is not generated.");
+	}
+	// RSA_private_decrypt necesita un buffer del tamaño del módulo
+	std::vector<unsigned char> key(RSA_size(rsaKeyPair));
+	int result = RSA_private_decrypt(static_cast<int>(encryptedKey.size()),
+																	 encryptedKey.data(),
+																	 key.data(),
+																	 rsaKeyPair,
+																	 RSA_PKCS1_OAEP_PADDING);
+	if (result != static_cast<int>(sizeof(aesKey))) {
+		return {};
+	}
+	key.resize(result);
+	return key;
+}
+
+void
+CryptoHelper::SetAESKey(const std::vector<unsigned char>& key) {
+	if (key.size() != sizeof(aesKey)) {
+		throw std::runtime_error("Invalid AES key size.");
+	}
+	std::memcpy(aesKey, key.data(), sizeof(aesKey));
+}
+
+std::vector<unsigned char>
+CryptoHelper::GetAESKey() const {
+	return std::vector<unsigned char>(aesKey, aesKey + sizeof(aesKey));
+}
+
+std::vector<unsigned char>
+CryptoHelper::ExportSessionState(const std::string& peerPem) const {
+	// Formato: versión (1) | clave AES (32) | tamaño PEM del peer (4, big-endian) | PEM
+	std::vector<unsigned char> state;
+	state.reserve(1 + sizeof(aesKey) + 4 + peerPem.size());
+	state.push_back(1);
+	state.insert(state.end(), aesKey, aesKey + sizeof(aesKey));
+	uint32_t pemLen = static_cast<uint32_t>(peerPem.size());
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		state.push_back(static_cast<unsigned char>(pemLen >> shift));
+	}
+	state.insert(state.end(), peerPem.begin(), peerPem.end());
+	return state;
+}
+
+std::string
+CryptoHelper::ImportSessionState(const std::vector<unsigned char>& state) {
+	const size_t header = 1 + sizeof(aesKey) + 4;
+	if (state.size() < header || state[0] != 1) {
+		throw std::runtime_error("Invalid session state.");
+	}
+	std::memcpy(aesKey, state.data() + 1, sizeof(aesKey));
+
+	const unsigned char* p = state.data() + 1 + sizeof(aesKey);
+	uint32_t pemLen = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+	if (state.size() - header != pemLen) {
+		throw std::runtime_error("Invalid session state.");
+	}
+	std::string peerPem(reinterpret_cast<const char*>(state.data() + header), pemLen);
+	if (!peerPem.empty() && !IsValidPublicKey(peerPem)) {
+		throw std::runtime_error("Invalid peer public key in session state.");
+	}
+	return peerPem;
+}
+
 std::vector<unsigned char>
 CryptoHelper::AESEncrypt(const std::string& plaintext,
 	std::vector<unsigned char>& outIV) {
@@ -140,4 +320,157 @@ CryptoHelper::AESDecrypt(const std::vector<unsigned char>& ciphertext,
 	out.resize(outlen1 + outlen2);
 	EVP_CIPHER_CTX_free(ctx);
 	return std::string(reinterpret_cast<char*>(out.data()), out.size());
-}
\ No newline at end of file
+}
+
+std::vector<unsigned char>
+CryptoHelper::WrapKeyForPeer(const std::vector<unsigned char>& key) const {
+	if (!peerPublicKey) {
+		throw std::runtime_error("Peer public key is not loaded.");
+	}
+	std::vector<unsigned char> wrapped(RSA_size(peerPublicKey));
+	int result = RSA_public_encrypt(static_cast<int>(key.size()),
+																	key.data(),
+																	wrapped.data(),
+																	peerPublicKey,
+																	RSA_PKCS1_OAEP_PADDING);
+	if (result < 0) {
+		throw std::runtime_error("Failed to wrap key: "
+			+ std::string(ERR_error_string(ERR_get_error(), nullptr)));
+	}
+	wrapped.resize(result);
+	return wrapped;
+}
+
+Envelope
+CryptoHelper::SealEnvelope(const std::string& plaintext,
+	const std::vector<const CryptoHelper*>& recipients) {
+	for (const CryptoHelper* recipient : recipients) {
+		if (!recipient || !recipient->peerPublicKey) {
+			throw std::runtime_error("Peer public key is not loaded.");
+		}
+	}
+
+	// 1. Cuerpo sellado una sola vez (AES-256-GCM) con una clave de contenido nueva:
+	//    el nonce va en el campo IV del sobre y el cuerpo es cifrado | etiqueta
+	Envelope envelope;
+	CryptoHelper content;
+	content.GenerateAESKey();
+	std::vector<unsigned char> key = content.GetAESKey();
+	std::vector<unsigned char> sealed;
+	GcmSeal(key.data(), reinterpret_cast<const unsigned char*>(plaintext.data()), plaintext.size(), sealed);
+	envelope.iv.assign(sealed.begin(), sealed.begin() + kGcmIvSize);
+	envelope.iv.resize(AES_BLOCK_SIZE, 0);
+	envelope.body.assign(sealed.begin() + kGcmIvSize, sealed.end());
+
+	// 2. Una envoltura RSA por destinatario: una operación pública por peer, en este hilo
+	envelope.wraps.reserve(recipients.size());
+	try {
+		for (const CryptoHelper* recipient : recipients) {
+			envelope.wraps.push_back(recipient->WrapKeyForPeer(key));
+		}
+	}
+	catch (...) {
+		OPENSSL_cleanse(key.data(), key.size());
+		throw;
+	}
+	OPENSSL_cleanse(key.data(), key.size());
+	return envelope;
+}
+
+bool
+CryptoHelper::OpenEnvelope(const std::vector<unsigned char>& wrap,
+	const std::vector<unsigned char>& body,
+	const std::vector<unsigned char>& iv,
+	std::string& plaintext) const {
+	plaintext.clear();
+	if (iv.size() < kGcmIvSize) return false;
+	std::vector<unsigned char> key = UnwrapAESKey(wrap);
+	if (key.size() != sizeof(aesKey)) return false;
+
+	std::vector<unsigned char> sealed(iv.begin(), iv.begin() + kGcmIvSize);
+	sealed.insert(sealed.end(), body.begin(), body.end());
+	std::vector<unsigned char> plain;
+	bool ok = GcmOpen(key.data(), sealed.data(), sealed.size(), plain);
+	OPENSSL_cleanse(key.data(), key.size());
+	if (!ok) return false;
+	plaintext.assign(plain.begin(), plain.end());
+	OPENSSL_cleanse(plain.data(), plain.size());
+	return true;
+}
+
+std::vector<unsigned char>
+CryptoHelper::DeriveSecret(const std::vector<unsigned char>& secret, const std::string& label) {
+	std::vector<unsigned char> out(kNodeKeySize);
+	size_t length = out.size();
+	EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr);
+	bool ok = ctx && EVP_PKEY_derive_init(ctx) > 0 &&
+		EVP_PKEY_CTX_set_hkdf_md(ctx, EVP_sha256()) > 0 &&
+		EVP_PKEY_CTX_set1_hkdf_key(ctx, secret.data(), static_cast<int>(secret.size())) > 0 &&
+		EVP_PKEY_CTX_add1_hkdf_info(ctx, reinterpret_cast<const unsigned char*>(label.data()),
+			static_cast<int>(label.size())) > 0 &&
+		EVP_PKEY_derive(ctx, out.data(), &length) > 0;
+	EVP_PKEY_CTX_free(ctx);
+	if (!ok) {
+		throw std::runtime_error("HKDF failed: " + std::string(ERR_error_string(ERR_get_error(), nullptr)));
+	}
+	return out;
+}
+
+std::vector<unsigned char>
+CryptoHelper::NodePublicKey(const std::vector<unsigned char>& nodeSecret) {
+	EVP_PKEY* key = LoadNodeSecret(nodeSecret);
+	std::vector<unsigned char> pub(kNodeKeySize);
+	size_t length = pub.size();
+	bool ok = key && EVP_PKEY_get_raw_public_key(key, pub.data(), &length) > 0;
+	EVP_PKEY_free(key);
+	if (!ok) {
+		throw std::runtime_error("Invalid X25519 node secret.");
+	}
+	return pub;
+}
+
+std::vector<unsigned char>
+CryptoHelper::SealToNode(const std::vector<unsigned char>& nodePublic,
+	const std::vector<unsigned char>& secret) {
+	if (nodePublic.size() != kNodeKeySize) {
+		throw std::runtime_error("Invalid X25519 node public key.");
+	}
+	// 1. Clave efímera y acuerdo X25519 con el nodo destino
+	std::vector<unsigned char> ephemeralSecret(kNodeKeySize);
+	RAND_bytes(ephemeralSecret.data(), static_cast<int>(ephemeralSecret.size()));
+	std::vector<unsigned char> ephemeralPublic = NodePublicKey(ephemeralSecret);
+	EVP_PKEY* ephemeral = LoadNodeSecret(ephemeralSecret);
+	std::vector<unsigned char> shared = NodeAgreement(ephemeral, nodePublic.data());
+	EVP_PKEY_free(ephemeral);
+	OPENSSL_cleanse(ephemeralSecret.data(), ephemeralSecret.size());
+	if (shared.empty()) {
+		throw std::runtime_error("X25519 agreement failed.");
+	}
+
+	// 2. AES-GCM con la clave derivada: efímera | iv | cifrado | etiqueta
+	std::vector<unsigned char> key = SealKey(shared, ephemeralPublic.data(), nodePublic.data());
+	std::vector<unsigned char> sealed(ephemeralPublic);
+	GcmSeal(key.data(), secret.data(), secret.size(), sealed);
+	OPENSSL_cleanse(key.data(), key.size());
+	OPENSSL_cleanse(shared.data(), shared.size());
+	return sealed;
+}
+
+std::vector<unsigned char>
+CryptoHelper::OpenFromNode(const std::vector<unsigned char>& nodeSecret,
+	const std::vector<unsigned char>& sealed) {
+	if (sealed.size() < kNodeKeySize + kGcmIvSize + kGcmTagSize) return {};
+	EVP_PKEY* own = LoadNodeSecret(nodeSecret);
+	if (!own) return {};
+	std::vector<unsigned char> shared = NodeAgreement(own, sealed.data());
+	EVP_PKEY_free(own);
+	if (shared.empty()) return {};
+
+	std::vector<unsigned char> target = NodePublicKey(nodeSecret);
+	std::vector<unsigned char> key = SealKey(shared, sealed.data(), target.data());
+	std::vector<unsigned char> secret;
+	GcmOpen(key.data(), sealed.data() + kNodeKeySize, sealed.size() - kNodeKeySize, secret);
+	OPENSSL_cleanse(key.data(), key.size());
+	OPENSSL_cleanse(shared.data(), shared.size());
+	return secret;
+}
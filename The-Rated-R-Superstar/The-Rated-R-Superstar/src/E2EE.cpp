@@ -1,61 +1,337 @@
 /**
  * @file main.cpp
- * @brief Punto de entrada para la aplicacin de chat cifrado RSA/AES.
+ * @brief Punto de entrada para la aplicación de chat cifrado RSA/AES.
  *
  * @details
- * Permite iniciar la aplicacin en modo servidor o cliente:
+ * Permite iniciar la aplicación en modo servidor o cliente:
  *  - **Servidor**:
  *    - Inicia un servidor TCP en el puerto especificado.
  *    - Acepta un cliente, intercambia claves RSA y recibe la clave AES cifrada.
- *    - Inicia el bucle de chat con envo y recepcin simultnea.
+ *    - Inicia el bucle de chat con envío y recepción simultánea.
  *  - **Cliente**:
  *    - Conecta al servidor en la IP y puerto indicados.
- *    - Intercambia claves RSA y enva la clave AES cifrada.
- *    - Inicia el bucle de chat con envo y recepcin simultnea.
+ *    - Intercambia claves RSA y envía la clave AES cifrada.
+ *    - Inicia el bucle de chat con envío y recepción simultánea.
  *
- * @note Usa las clases Server y Client para manejar la lgica de red y cifrado.
+ * @note Usa las clases Server y Client para manejar la lógica de red y cifrado.
  */
 
 #include "Prerequisites.h"
 #include "Server.h"
 #include "Client.h"
-static void runServer(int port) {
-  Server s(port);
+#include "Benchmark.h"
+#include "LoadGenerator.h"
+#include <algorithm>
+#include <fstream>
+
+// Archivo de configuración del servidor: una opción por línea, "clave = valor"
+// o solo "clave" para las que no llevan valor; '#' al inicio de la línea o tras
+// un espacio comenta el resto (dentro de un valor, como "sala#1", se conserva).
+// Se traduce a las mismas opciones de la línea de comandos (sin el "--").
+static bool loadConfig(const std::string& path, std::vector<std::string>& flags) {
+  std::ifstream in(path);
+  if (!in) return false;
+  auto trim = [](const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) return std::string();
+    return text.substr(begin, text.find_last_not_of(" \t\r") - begin + 1);
+  };
+  for (std::string line; std::getline(in, line);) {
+    for (size_t hash = line.find('#'); hash != std::string::npos; hash = line.find('#', hash + 1)) {
+      if (hash == 0 || line[hash - 1] == ' ' || line[hash - 1] == '\t') {
+        line.erase(hash);
+        break;
+      }
+    }
+    size_t eq = line.find('=');
+    std::string key = trim(line.substr(0, eq));
+    if (key.empty()) continue;
+    std::string value = (eq == std::string::npos) ? "true" : trim(line.substr(eq + 1));
+    if (value == "false") continue;
+    flags.push_back("--" + key);
+    if (value != "true") flags.push_back(value);
+  }
+  return true;
+}
+
+// std::stoi/std::stoul que además rechazan texto sobrante ("12345x") y, sin
+// signo, un '-'; lanzan std::invalid_argument o std::out_of_range como ellas.
+static int parseInt(const std::string& text) {
+  size_t used = 0;
+  int value = std::stoi(text, &used);
+  if (used != text.size()) throw std::invalid_argument(text);
+  return value;
+}
+
+static uint32_t parseU32(const std::string& text) {
+  size_t used = 0;
+  if (text.find('-') != std::string::npos) throw std::invalid_argument(text);
+  unsigned long long value = std::stoull(text, &used);
+  if (used != text.size()) throw std::invalid_argument(text);
+  if (value > 0xFFFFFFFFull) throw std::out_of_range(text);
+  return static_cast<uint32_t>(value);
+}
+
+static void runServer(Server& s) {
   if (!s.Start()) {
-    std::cerr << "[Main] No se pudo iniciar el servidor.\n";
+    Logger::Error("[Main] No se pudo iniciar el servidor.\n");
     return;
   }
   s.WaitForClient(); // Intercambio de claves
-  s.StartChatLoop(); // Ahora recibe y enva en paralelo
+  s.StartChatLoop(); // Ahora recibe y envía en paralelo
 }
 
-static void runClient(const std::string& ip, int port) {
+static void runShardedServer(int port, const std::string& address, int shards,
+                             const std::string& upgradePath,
+                             const std::string& takeoverPath,
+                             const std::string& adminAddress,
+                             bool fastOpen, bool relayOnly, int hibernateSeconds,
+                             int heartbeatSeconds, bool daemon,
+                             const std::string& capturePath) {
+  // unix:<ruta> sustituye al puerto; StartSharded rechaza las direcciones sin socket
+  std::unique_ptr<Server> server = address.empty() ? std::make_unique<Server>(port) : std::make_unique<Server>(address);
+  Server& s = *server;
+  s.EnableFastOpen(fastOpen);
+  s.EnableRelayOnly(relayOnly);
+  if (!capturePath.empty() && !s.EnableCapture(capturePath)) {
+    Logger::Error("[Main] No se pudo abrir la captura de tráfico.\n");
+    return;
+  }
+  if (hibernateSeconds >= 0) s.SetHibernateAfter(std::chrono::seconds(hibernateSeconds));
+  if (heartbeatSeconds >= 0) s.SetHeartbeat(std::chrono::seconds(heartbeatSeconds));
+  if (!s.StartSharded(shards, takeoverPath)) {
+    Logger::Error("[Main] No se pudo iniciar el servidor en modo sharded.\n");
+    return;
+  }
+  if (!upgradePath.empty() && !s.EnableLiveUpgrade(upgradePath)) {
+    Logger::Error("[Main] No se pudo habilitar la actualización en caliente.\n");
+  }
+  if (!adminAddress.empty() && !s.EnableAdmin(adminAddress)) {
+    Logger::Error("[Main] No se pudo abrir el endpoint de métricas.\n");
+  }
+  if (daemon) s.RunDaemon(); // Sin consola: termina con una señal o tras un traspaso
+  else s.RunSharded(); // Consola: /stats y /exit; termina también tras un traspaso
+}
+
+static void runClient(const std::string& ip, int port, bool fastOpen, uint32_t userId, int heartbeatSeconds, bool stamp,
+                      const NetworkConditions& netem, const std::string& capturePath) {
   Client c(ip, port);
-  if (!c.Connect()) { std::cerr << "[Main] No se pudo conectar.\n"; return; }
+  c.EnableFastOpen(fastOpen);
+  c.SetNetworkConditions(netem);
+  if (!capturePath.empty() && !c.StartCapture(capturePath)) return;
+  if (heartbeatSeconds >= 0) c.SetHeartbeat(std::chrono::seconds(heartbeatSeconds));
+  c.EnableLatencyStamps(stamp);
+  auto start = std::chrono::steady_clock::now();
+  if (!c.Connect()) { Logger::Error("[Main] No se pudo conectar.\n"); return; }
 
   c.ExchangeKeys();
   c.SendAESKeyEncrypted();
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+  Logger::Info("[Main] Conexión y handshake en {} ms.\n", elapsed.count());
+
+  // Relay: registrar el usuario antes de arrancar el hilo de recepción
+  if (userId != 0) {
+    c.EnableRelay(userId);
+    if (!c.RegisterUser()) return;
+  }
 
-  // ahora s, chat en paralelo:
+  // ahora sí, chat en paralelo:
   c.StartChatLoop();
 }
 
 int main(int argc, char** argv) {
   std::string mode, ip;
   int port = 0;
+  std::string address; // unix:<ruta> o shm:<nombre> en lugar de puerto
+  int shards = -1; // -1: modo interactivo de un solo cliente
+  std::string upgradePath, takeoverPath;
+  std::string adminAddress; // --admin <puerto>|unix:<ruta>: métricas Prometheus
+  bool fastOpen = false; // --tfo: TCP Fast Open
+  bool relayOnly = false; // --relay: el servidor solo enruta
+  bool daemon = false; // --daemon: sin consola, parada por señal
+  bool stamp = false; // --stamp: sellar los mensajes para medir su latencia
+  int hibernateSeconds = -1; // --hibernate <seg>: inactividad antes de hibernar (0: nunca)
+  int heartbeatSeconds = -1; // --heartbeat <seg>: silencio antes de un Ping (0: sin latido)
+  uint32_t userId = 0;    // --user <id>: cliente del relay
+  NetworkConditions netem; // --netem <spec>: enlace emulado del cliente
+  std::string capturePath; // --capture <ruta>: forma del tráfico para reproducirla con loadgen --replay
+  std::string logLevel, logFile; // --log-level <nivel>, --log-file <ruta>: registro asíncrono
+  std::string tracePath;  // --trace <ruta>: fases del handshake en JSON de Chrome al terminar
+  uint32_t traceSample = 1; // --trace-sample <n>: traza una de cada n conexiones
+  LoadOptions load;       // loadgen: parámetros de la prueba de carga
 
   if (argc >= 2) {
     mode = argv[1];
     if (mode == "server") {
-      port = (argc >= 3) ? std::stoi(argv[2]) : 12345;
+      int first = 2;
+      port = 12345;
+      if (argc >= 3 && NetworkHelper::IsLocalAddress(argv[2])) { address = argv[2]; first = 3; }
+      else if (argc >= 3 && argv[2][0] != '-') first = 3;
+      // server [<port>] [--port <n>] [--shards <n>] [--upgrade <ruta>] [--takeover <ruta>] [--tfo] [--relay] [--hibernate <seg>] [--heartbeat <seg>]
+      //        [--admin <puerto>|unix:<ruta>] [--log-level <nivel>] [--log-file <ruta>] [--daemon] [--config <ruta>]
+      //        [--trace <ruta>] [--trace-sample <n>] [--capture <ruta>]
+      std::vector<std::string> flags(argv + first, argv + argc);
+      // Las opciones del archivo van delante: la línea de comandos las sobrescribe
+      auto config = std::find(flags.begin(), flags.end(), "--config");
+      if (config != flags.end() && config + 1 != flags.end()) {
+        std::vector<std::string> fromFile;
+        if (!loadConfig(*(config + 1), fromFile)) { std::cerr << "No se pudo leer " << *(config + 1) << "\n"; return 1; }
+        flags.insert(flags.begin(), fromFile.begin(), fromFile.end());
+      }
+      if (first == 3 && address.empty()) flags.insert(flags.end(), { "--port", argv[2] });
+      for (size_t i = 0; i < flags.size(); ++i) {
+        const std::string& flag = flags[i];
+        if (flag == "--tfo") { fastOpen = true; continue; }
+        if (flag == "--relay") { relayOnly = true; continue; }
+        if (flag == "--daemon") { daemon = true; continue; }
+        if (i + 1 >= flags.size()) { std::cerr << "Falta el valor de " << flag << "\n"; return 1; }
+        // Un valor erróneo (también del archivo de configuración) termina con un mensaje, no con abort()
+        try {
+          if (flag == "--config") {} // ya leído
+          else if (flag == "--port") port = parseInt(flags[i + 1]);
+          else if (flag == "--shards") shards = parseInt(flags[i + 1]); // 0: un shard por núcleo
+          else if (flag == "--upgrade") upgradePath = flags[i + 1];
+          else if (flag == "--takeover") takeoverPath = flags[i + 1];
+          else if (flag == "--hibernate") hibernateSeconds = parseInt(flags[i + 1]);
+          else if (flag == "--heartbeat") heartbeatSeconds = parseInt(flags[i + 1]);
+          else if (flag == "--admin") adminAddress = flags[i + 1];
+          else if (flag == "--log-level") logLevel = flags[i + 1];
+          else if (flag == "--log-file") logFile = flags[i + 1];
+          else if (flag == "--trace") tracePath = flags[i + 1];
+          else if (flag == "--trace-sample") traceSample = parseU32(flags[i + 1]);
+          else if (flag == "--capture") capturePath = flags[i + 1];
+          else { std::cerr << "Opción no reconocida: " << flag << "\n"; return 1; }
+        }
+        catch (const std::exception&) {
+          std::cerr << "Valor no válido para " << flag << ": " << flags[i + 1] << "\n";
+          return 1;
+        }
+        ++i;
+      }
+      // La actualización en caliente, el relay, la hibernación, el latido, las métricas, la captura y el daemon solo existen en modo sharded
+      if (shards < 0 && (relayOnly || daemon || !upgradePath.empty() || !takeoverPath.empty() || hibernateSeconds >= 0 ||
+                         heartbeatSeconds >= 0 || !adminAddress.empty() || !capturePath.empty())) shards = 0;
     }
     else if (mode == "client") {
-      if (argc < 4) { std::cerr << "Uso: E2EE client <ip> <port>\n"; return 1; }
-      ip = argv[2];
-      port = std::stoi(argv[3]);
+      if (argc >= 3 && NetworkHelper::IsLocalAddress(argv[2])) {
+        ip = argv[2]; // unix:<ruta> o shm:<nombre>: sin puerto
+      }
+      else {
+        if (argc < 4) { std::cerr << "Uso: E2EE client <ip> <port> [--tfo] [--user <id>] [--heartbeat <seg>] [--stamp] [--netem <spec>] [--capture <ruta>] | client unix:<ruta> | client shm:<nombre>\n"; return 1; }
+        ip = argv[2];
+        port = std::stoi(argv[3]);
+      }
+      // Opciones tras la dirección: [--tfo] [--user <id>] [--heartbeat <seg>] [--stamp] [--netem <spec>] [--capture <ruta>] [--log-level <nivel>] [--log-file <ruta>] [--trace <ruta>]
+      for (int i = (port == 0) ? 3 : 4; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (flag == "--tfo") fastOpen = true;
+        else if (flag == "--stamp") stamp = true;
+        else if (flag == "--user" && i + 1 < argc) userId = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (flag == "--heartbeat" && i + 1 < argc) heartbeatSeconds = std::stoi(argv[++i]);
+        else if (flag == "--netem" && i + 1 < argc) {
+          if (!NetworkConditions::Parse(argv[++i], netem)) { std::cerr << "Condiciones de red no válidas: " << argv[i] << "\n"; return 1; }
+        }
+        else if (flag == "--capture" && i + 1 < argc) capturePath = argv[++i];
+        else if (flag == "--log-level" && i + 1 < argc) logLevel = argv[++i];
+        else if (flag == "--log-file" && i + 1 < argc) logFile = argv[++i];
+        else if (flag == "--trace" && i + 1 < argc) tracePath = argv[++i];
+        else { std::cerr << "Opción no reconocida: " << flag << "\n"; return 1; }
+      }
+    }
+    else if (mode == "loadgen") {
+      if (argc >= 3 && NetworkHelper::IsLocalAddress(argv[2])) {
+        load.host = argv[2];
+        load.port = 0;
+      }
+      else {
+        if (argc < 4) { std::cerr << "Uso: E2EE loadgen <ip> <port> [--connections <n>] [--rate <msg/s>] [--duration <seg>] ... | loadgen unix:<ruta>\n"; return 1; }
+        load.host = argv[2];
+        load.port = std::stoi(argv[3]);
+      }
+      // Opciones tras la dirección: [--connections <n>] [--threads <n>] [--rate <msg/s>] [--pattern fixed|bursty|poisson] [--burst <n>]
+      //   [--size <n>|<min>-<max>] [--duration <seg>] [--relay] [--echo] [--user-base <id>] [--hgrm <prefijo>] [--log-level <nivel>] [--log-file <ruta>]
+      //   [--storm <n>,<n>,...] [--server-cores <n>]: tormenta de handshakes en lugar de mensajes
+      //   [--replay <captura>] [--speed <factor>|max]: reproduce una captura en lugar de generar mensajes
+      for (int i = (load.port == 0) ? 3 : 4; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (flag == "--relay") { load.relay = true; continue; }
+        if (flag == "--echo") { load.echo = true; continue; }
+        if (i + 1 >= argc) { std::cerr << "Falta el valor de " << flag << "\n"; return 1; }
+        std::string value = argv[++i];
+        if (flag == "--connections") load.connections = static_cast<size_t>(std::stoul(value));
+        else if (flag == "--threads") load.threads = static_cast<size_t>(std::stoul(value));
+        else if (flag == "--rate") load.rate = std::stod(value);
+        else if (flag == "--burst") load.burst = std::max<size_t>(1, static_cast<size_t>(std::stoul(value)));
+        else if (flag == "--duration") load.duration = std::chrono::seconds(std::stoi(value));
+        else if (flag == "--user-base") load.userBase = static_cast<uint32_t>(std::stoul(value));
+        else if (flag == "--hgrm") load.histogramPrefix = value;
+        else if (flag == "--server-cores") load.serverCores = static_cast<size_t>(std::stoul(value));
+        else if (flag == "--replay") load.replay = value;
+        else if (flag == "--speed") load.speed = (value == "max") ? 0.0 : std::stod(value);
+        else if (flag == "--storm") {
+          std::stringstream levels(value);
+          for (std::string level; std::getline(levels, level, ',');) load.storm.push_back(static_cast<size_t>(std::stoul(level)));
+        }
+        else if (flag == "--log-level") logLevel = value;
+        else if (flag == "--log-file") logFile = value;
+        else if (flag == "--pattern") {
+          if (!LoadGenerator::ParsePattern(value, load.pattern)) { std::cerr << "Patrón no reconocido: " << value << "\n"; return 1; }
+        }
+        else if (flag == "--size") {
+          size_t dash = value.find('-');
+          load.minSize = static_cast<size_t>(std::stoul(value.substr(0, dash)));
+          load.maxSize = (dash == std::string::npos) ? load.minSize : static_cast<size_t>(std::stoul(value.substr(dash + 1)));
+          if (load.maxSize < load.minSize) std::swap(load.minSize, load.maxSize);
+        }
+        else { std::cerr << "Opción no reconocida: " << flag << "\n"; return 1; }
+      }
+    }
+    else if (mode == "bench") {
+      // bench rooms|rekey|directory|timers [tamaños o hilos...] | bench crypto [filtro] [--json <ruta>]
+      std::string suite = (argc >= 3) ? argv[2] : "rooms";
+      if (suite == "crypto") {
+        std::string filter, jsonPath;
+        for (int i = 3; i < argc; ++i) {
+          std::string arg = argv[i];
+          if (arg == "--json" && i + 1 < argc) jsonPath = argv[++i];
+          else filter = arg;
+        }
+        if (!Benchmark::RunPrimitives(filter, jsonPath)) { std::cerr << "No se pudo escribir " << jsonPath << "\n"; return 1; }
+        return 0;
+      }
+      if (suite != "rooms" && suite != "rekey" && suite != "directory" && suite != "timers") { std::cerr << "Benchmark no reconocido: " << suite << "\n"; return 1; }
+      std::vector<size_t> sizes;
+      for (int i = 3; i < argc; ++i) sizes.push_back(static_cast<size_t>(std::stoul(argv[i])));
+      if (suite == "rooms") {
+        if (sizes.empty()) sizes = { 10, 1000, 50000 };
+        Benchmark::RunRoomFanOut(sizes);
+      }
+      else if (suite == "rekey") {
+        if (sizes.empty()) sizes = { 10, 1000, 5000 };
+        Benchmark::RunRoomRekey(sizes);
+      }
+      else if (suite == "directory") {
+        if (sizes.empty()) sizes = { 1, 4, 16, 32 };
+        Benchmark::RunDirectoryContention(sizes);
+      }
+      else {
+        if (sizes.empty()) sizes = { 1000, 100000, 1000000 };
+        Benchmark::RunTimerChurn(sizes);
+      }
+      return 0;
     }
     else {
-      std::cerr << "Modo no reconocido. Usa: server | client\n";
+      std::cerr << "Modo no reconocido. Usa: server | client | loadgen | bench\n";
+      return 1;
+    }
+    // mem:<nombre> solo conecta extremos del mismo proceso: desde la línea de comandos nadie respondería
+    if (address.compare(0, 4, "mem:") == 0 || ip.compare(0, 4, "mem:") == 0) {
+      std::cerr << "mem:<nombre> solo existe dentro de un proceso (pruebas y benchmarks).\n";
+      return 1;
+    }
+    // Los shards vigilan sockets con WSAPoll: shm:<nombre> (una sola conexión, sin socket) no encaja
+    if (mode == "server" && shards >= 0 && address.compare(0, 4, "shm:") == 0) {
+      std::cerr << "shm:<nombre> no admite --shards, --relay, --daemon, --upgrade ni las demás opciones del modo sharded.\n";
       return 1;
     }
   }
@@ -79,8 +355,29 @@ int main(int argc, char** argv) {
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
   }
 
-  if (mode == "server") runServer(port);
-  else runClient(ip, port);
+  // El receptor nunca escribe en la consola: registra y el hilo del logger imprime
+  Logger& logger = Logger::Instance();
+  LogLevel level;
+  if (!logLevel.empty()) {
+    if (!Logger::ParseLevel(logLevel, level)) { std::cerr << "Nivel de registro no reconocido: " << logLevel << "\n"; return 1; }
+    logger.SetLevel(level);
+  }
+  if (!logFile.empty() && !logger.OpenFile(logFile)) { std::cerr << "No se pudo abrir " << logFile << "\n"; return 1; }
+  if (!tracePath.empty()) Tracer::Instance().Enable("E2EE " + mode, traceSample);
+
+  int exitCode = 0;
+
+  if (mode == "server" && shards >= 0) runShardedServer(port, address, shards, upgradePath, takeoverPath, adminAddress, fastOpen, relayOnly, hibernateSeconds, heartbeatSeconds, daemon, capturePath);
+  else if (mode == "server" && !address.empty()) { Server s(address); runServer(s); }
+  else if (mode == "server") { Server s(port); s.EnableFastOpen(fastOpen); runServer(s); }
+  else if (mode == "loadgen") {
+    LoadGenerator generator(load);
+    bool ok = !load.replay.empty() ? generator.RunReplay() : !load.storm.empty() ? generator.RunStorm() : generator.Run();
+    if (!ok) exitCode = 1;
+  }
+  else runClient(ip, port, fastOpen, userId, heartbeatSeconds, stamp, netem, capturePath);
 
-  return 0;
+  if (!tracePath.empty() && !Tracer::Instance().Dump(tracePath)) Logger::Error("[Main] No se pudo escribir la traza en {}\n", tracePath);
+  logger.Stop();
+  return exitCode;
 }
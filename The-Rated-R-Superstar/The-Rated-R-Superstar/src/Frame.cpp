@@ -0,0 +1,96 @@
+/**
+ * @file Frame.cpp
+ * @brief Codificación y decodificación de frames.
+ */
+
+#include "Frame.h"
+
+Frame
+Frame::Control(ControlType type, std::vector<unsigned char> payload) {
+	Frame frame;
+	frame.flags = kControlFlag;
+	frame.iv[0] = type;
+	frame.payload = std::move(payload);
+	return frame;
+}
+
+std::vector<unsigned char>
+Frame::Encode() const {
+	std::vector<unsigned char> out(HeaderSize(flags) + payload.size());
+	std::memcpy(out.data(), iv.data(), kIvSize);
+	PutU32(out.data() + kIvSize, flags | static_cast<uint32_t>(payload.size()));
+
+	size_t offset = kHeaderSize;
+	if (IsRouted()) {
+		PutU32(out.data() + offset, dst);
+		PutU32(out.data() + offset + 4, src);
+		offset += kRouteSize;
+	}
+	if (IsStamped()) {
+		PutU32(out.data() + offset, sequence);
+		PutU64(out.data() + offset + 4, sentAtUs);
+		offset += kStampSize;
+	}
+	if (!payload.empty()) {
+		std::memcpy(out.data() + offset, payload.data(), payload.size());
+	}
+	return out;
+}
+
+bool
+Frame::ParseHeader(const unsigned char* data, size_t size, FrameHeader& out) {
+	if (size < kHeaderSize) return false;
+
+	uint32_t raw = GetU32(data + kIvSize);
+	out.flags = raw & ~kLengthMask;
+	out.length = raw & kLengthMask;
+	out.headerSize = HeaderSize(out.flags);
+	if (size < out.headerSize) return false;
+	size_t offset = kHeaderSize;
+	if (out.flags & kRoutedFlag) {
+		out.dst = GetU32(data + offset);
+		out.src = GetU32(data + offset + 4);
+		offset += kRouteSize;
+	}
+	if (out.flags & kStampedFlag) {
+		out.sequence = GetU32(data + offset);
+		out.sentAtUs = GetU64(data + offset + 4);
+	}
+	out.totalSize = out.headerSize + out.length;
+	return true;
+}
+
+size_t
+Frame::HeaderSize(uint32_t flags) {
+	return kHeaderSize + ((flags & kRoutedFlag) ? kRouteSize : 0) + ((flags & kStampedFlag) ? kStampSize : 0);
+}
+
+uint64_t
+Frame::NowMicros() {
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+void
+Frame::PutU32(unsigned char* out, uint32_t value) {
+	out[0] = static_cast<unsigned char>(value >> 24);
+	out[1] = static_cast<unsigned char>(value >> 16);
+	out[2] = static_cast<unsigned char>(value >> 8);
+	out[3] = static_cast<unsigned char>(value);
+}
+
+uint32_t
+Frame::GetU32(const unsigned char* data) {
+	return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | uint32_t(data[3]);
+}
+
+void
+Frame::PutU64(unsigned char* out, uint64_t value) {
+	PutU32(out, static_cast<uint32_t>(value >> 32));
+	PutU32(out + 4, static_cast<uint32_t>(value));
+}
+
+uint64_t
+Frame::GetU64(const unsigned char* data) {
+	return (uint64_t(GetU32(data)) << 32) | GetU32(data + 4);
+}
@@ -0,0 +1,127 @@
+/**
+ * @file HdrHistogram.cpp
+ * @brief Implementación del histograma log-lineal de latencias.
+ */
+
+#include "HdrHistogram.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+namespace {
+	/// Marcas por cada mitad de la distancia restante al 100 % (como HdrHistogram).
+	const int kTicksPerHalfDistance = 5;
+}
+
+HdrHistogram::HdrHistogram()
+	: m_counts(kCounts, 0) {
+}
+
+size_t
+HdrHistogram::IndexOf(uint64_t value) {
+	if (value < kExactValues) return static_cast<size_t>(value);
+	size_t shift = 1;
+	while ((value >> shift) >= kExactValues) ++shift;
+	if (shift > kLevels) return kCounts - 1;
+	return kExactValues + (shift - 1) * kSubBuckets + static_cast<size_t>(value >> shift) - kSubBuckets;
+}
+
+uint64_t
+HdrHistogram::HighestEquivalent(size_t index) {
+	if (index < kExactValues) return index;
+	size_t shift = (index - kExactValues) / kSubBuckets + 1;
+	uint64_t sub = (index - kExactValues) % kSubBuckets + kSubBuckets;
+	return ((sub + 1) << shift) - 1;
+}
+
+uint64_t
+HdrHistogram::ReportedValue(size_t index) const {
+	// La última cubeta recoge todo lo que excede el rango: solo el máximo es fiable
+	if (index == kCounts - 1) return m_max;
+	return std::min(HighestEquivalent(index), m_max);
+}
+
+void
+HdrHistogram::Record(uint64_t value) {
+	m_counts[IndexOf(value)]++;
+	m_count++;
+	m_sum += value;
+	m_max = std::max(m_max, value);
+}
+
+void
+HdrHistogram::Add(const HdrHistogram& other) {
+	for (size_t i = 0; i < kCounts; ++i) m_counts[i] += other.m_counts[i];
+	m_count += other.m_count;
+	m_sum += other.m_sum;
+	m_max = std::max(m_max, other.m_max);
+}
+
+void
+HdrHistogram::Reset() {
+	std::fill(m_counts.begin(), m_counts.end(), 0);
+	m_count = 0;
+	m_sum = 0;
+	m_max = 0;
+}
+
+uint64_t
+HdrHistogram::ValueAtPercentile(double percentile) const {
+	if (m_count == 0) return 0;
+	double clamped = std::min(std::max(percentile, 0.0), 100.0);
+	uint64_t target = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(clamped / 100.0 * m_count)), 1);
+	uint64_t cumulative = 0;
+	for (size_t i = 0; i < kCounts; ++i) {
+		cumulative += m_counts[i];
+		if (cumulative >= target) return ReportedValue(i);
+	}
+	return m_max;
+}
+
+void
+HdrHistogram::WritePercentiles(std::ostream& out, double unitDivisor) const {
+	out << std::setw(12) << "Value" << " " << std::setw(14) << "Percentile" << " "
+		<< std::setw(10) << "TotalCount" << " " << std::setw(14) << "1/(1-Percentile)" << "\n\n";
+	out << std::fixed;
+
+	// Marcas cada vez más densas hacia la cola: 5 por cada mitad de lo que falta hasta el 100 %
+	size_t index = 0;
+	uint64_t cumulative = 0;
+	for (int half = 0; m_count > 0; ++half) {
+		double from = 100.0 * (1.0 - std::pow(0.5, half));
+		double step = 100.0 * std::pow(0.5, half + 1) / kTicksPerHalfDistance;
+		bool done = false;
+		for (int tick = 0; tick < kTicksPerHalfDistance && !done; ++tick) {
+			double percentile = from + tick * step;
+			uint64_t target = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(percentile / 100.0 * m_count)), 1);
+			while (cumulative < target && index < kCounts) cumulative += m_counts[index++];
+			uint64_t value = ReportedValue(index - 1);
+			out << std::setprecision(3) << std::setw(12) << value / unitDivisor << " "
+				<< std::setprecision(12) << std::setw(14) << percentile / 100.0 << " "
+				<< std::setw(10) << cumulative << " "
+				<< std::setprecision(2) << std::setw(14) << 1.0 / (1.0 - percentile / 100.0) << "\n";
+			done = cumulative >= m_count;
+		}
+		if (done) break;
+	}
+	out << std::setprecision(3) << std::setw(12) << m_max / unitDivisor << " "
+		<< std::setprecision(12) << std::setw(14) << 1.0 << " " << std::setw(10) << m_count << "\n";
+
+	// Desviación típica aproximada con el valor de cada cubeta
+	double mean = Mean();
+	double variance = 0;
+	for (size_t i = 0; i < kCounts && m_count > 0; ++i) {
+		if (!m_counts[i]) continue;
+		double deviation = static_cast<double>(ReportedValue(i)) - mean;
+		variance += deviation * deviation * m_counts[i];
+	}
+	double stdDeviation = m_count ? std::sqrt(variance / m_count) : 0.0;
+	out << std::setprecision(3)
+		<< "#[Mean    = " << std::setw(12) << mean / unitDivisor
+		<< ", StdDeviation   = " << std::setw(12) << stdDeviation / unitDivisor << "]\n"
+		<< "#[Max     = " << std::setw(12) << m_max / unitDivisor
+		<< ", Total count    = " << std::setw(12) << m_count << "]\n"
+		<< "#[Buckets = " << std::setw(12) << kLevels + 1
+		<< ", SubBuckets     = " << std::setw(12) << kExactValues << "]\n";
+	out.unsetf(std::ios::floatfield);
+}
@@ -0,0 +1,49 @@
+/**
+ * @file Heartbeat.cpp
+ * @brief Implementación del RTT suavizado del latido de aplicación.
+ */
+
+#include "Heartbeat.h"
+#include <algorithm>
+
+namespace {
+	/// Muestras por encima de este RTT se descartan (payload ajeno o reloj de otro proceso).
+	const std::chrono::microseconds kMaxSample(std::chrono::seconds(60));
+}
+
+std::vector<unsigned char>
+Heartbeat::PingPayload(Clock::time_point now) {
+	uint64_t stamp = static_cast<uint64_t>(
+		std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count());
+	std::vector<unsigned char> payload(kPayloadSize);
+	for (size_t i = 0; i < kPayloadSize; ++i) {
+		payload[i] = static_cast<unsigned char>(stamp >> (8 * (kPayloadSize - 1 - i)));
+	}
+	return payload;
+}
+
+bool
+Heartbeat::OnPong(const unsigned char* payload, size_t size, Clock::time_point now) {
+	if (size != kPayloadSize) return false;
+	uint64_t stamp = 0;
+	for (size_t i = 0; i < kPayloadSize; ++i) {
+		stamp = (stamp << 8) | payload[i];
+	}
+	int64_t sent = static_cast<int64_t>(stamp);
+	int64_t received = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
+	if (sent > received || received - sent > kMaxSample.count()) return false;
+
+	// Al menos 1 µs: cero indica "sin muestras"
+	uint32_t sample = static_cast<uint32_t>(std::max<int64_t>(received - sent, 1));
+	if (m_srttUs == 0) {
+		m_srttUs = sample;
+		m_jitterUs = sample / 2;
+	}
+	else {
+		uint32_t delta = m_srttUs > sample ? m_srttUs - sample : sample - m_srttUs;
+		m_jitterUs = m_jitterUs - m_jitterUs / 4 + delta / 4;
+		m_srttUs = std::max<uint32_t>(m_srttUs - m_srttUs / 8 + sample / 8, 1);
+	}
+	OnHeard(now);
+	return true;
+}
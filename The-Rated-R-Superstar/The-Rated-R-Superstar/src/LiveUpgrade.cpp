@@ -0,0 +1,371 @@
+/**
+ * @file LiveUpgrade.cpp
+ * @brief Implementación del traspaso de sockets y sesiones entre procesos.
+ *
+ * @details
+ * Protocolo sobre el socket AF_UNIX (enteros en big-endian):
+ *  1. Sucesor -> saliente: "E2UP" | pid (4).
+ *  2. Saliente -> sucesor: "E2H3" | nListeners (4) | nSesiones (4).
+ *  3. Por cada listener: WSAPROTOCOL_INFOW.
+ *  4. Por cada sesión: WSAPROTOCOL_INFOW | tamaño (4) | registro serializado.
+ *  5. nSalas (4) | por sala: id (4) | época (4) | nMiembros (4) | usuarios (4 c/u).
+ *  6. Identidad RSA: tamaño (4) | clave privada DER.
+ *  7. Sucesor -> saliente: "E2OK".
+ *
+ * Registro de sesión: mensajes entrantes (8) | salientes (8) |
+ * estado CryptoHelper (4 + n) | rx pendiente (4 + n) | tx pendiente (4 + n) |
+ * usuario del relay (4) | salas (4 + 4 c/u) | fase del handshake (4).
+ *
+ * Cada recepción del canal tiene un plazo: un peer mudo no bloquea el traspaso.
+ */
+
+#include "LiveUpgrade.h"
+#include "Logger.h"
+#include "openssl/crypto.h"
+
+namespace {
+	const unsigned char kHello[4] = { 'E', '2', 'U', 'P' };
+	const unsigned char kHandoff[4] = { 'E', '2', 'H', '3' };
+	/// Límite de salas y de miembros por sala en el bloque de salas.
+	const uint32_t kMaxRoomEntries = 1u << 20;
+	const unsigned char kAck[4] = { 'E', '2', 'O', 'K' };
+	/// Límite de un registro de sesión (rx/tx pendientes incluidos).
+	const uint32_t kMaxRecordSize = 64u * 1024u * 1024u;
+	/// Límite de la clave privada DER.
+	const uint32_t kMaxIdentitySize = 16u * 1024u;
+	/// Plazo de cada recepción y envío en el canal de actualización (ms).
+	const DWORD kChannelTimeoutMs = 10000;
+
+	/// Aplica @ref kChannelTimeoutMs al canal: ReceiveExact/SendAll fallan al vencer.
+	void SetChannelTimeout(SOCKET channel) {
+		DWORD timeout = kChannelTimeoutMs;
+		setsockopt(channel, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+		setsockopt(channel, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+	}
+
+	void PutU32(std::vector<unsigned char>& out, uint32_t v) {
+		for (int shift = 24; shift >= 0; shift -= 8) out.push_back(static_cast<unsigned char>(v >> shift));
+	}
+
+	void PutU64(std::vector<unsigned char>& out, uint64_t v) {
+		for (int shift = 56; shift >= 0; shift -= 8) out.push_back(static_cast<unsigned char>(v >> shift));
+	}
+
+	void PutBlob(std::vector<unsigned char>& out, const unsigned char* data, size_t len) {
+		PutU32(out, static_cast<uint32_t>(len));
+		out.insert(out.end(), data, data + len);
+	}
+
+	uint32_t GetU32(const unsigned char* p) {
+		return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+	}
+
+	/// Lector secuencial con comprobación de límites.
+	struct Reader {
+		const std::vector<unsigned char>& buf;
+		size_t pos = 0;
+
+		bool U64(uint64_t& v) {
+			if (buf.size() - pos < 8) return false;
+			v = 0;
+			for (int i = 0; i < 8; ++i) v = (v << 8) | buf[pos + i];
+			pos += 8;
+			return true;
+		}
+
+		bool U32(uint32_t& v) {
+			if (buf.size() - pos < 4) return false;
+			v = GetU32(buf.data() + pos);
+			pos += 4;
+			return true;
+		}
+
+		bool AtEnd() const { return pos == buf.size(); }
+
+		bool Blob(std::vector<unsigned char>& out) {
+			if (buf.size() - pos < 4) return false;
+			uint32_t len = GetU32(buf.data() + pos);
+			pos += 4;
+			if (buf.size() - pos < len) return false;
+			out.assign(buf.begin() + pos, buf.begin() + pos + len);
+			pos += len;
+			return true;
+		}
+	};
+}
+
+LiveUpgrade::~LiveUpgrade() {
+	Close();
+}
+
+bool
+LiveUpgrade::Listen(const std::string& path) {
+	SOCKET listener = m_net.ListenUnix(path);
+	if (listener == INVALID_SOCKET) return false;
+	m_listenSock = listener;
+	return true;
+}
+
+void
+LiveUpgrade::Close() {
+	// Solo un hilo se queda con el socket: Close() concurrentes no lo cierran dos veces
+	SOCKET listener = m_listenSock.exchange(INVALID_SOCKET);
+	if (listener != INVALID_SOCKET) {
+		// shutdown despierta un accept bloqueado en otro hilo
+		shutdown(listener, SD_BOTH);
+		m_net.close(listener);
+	}
+}
+
+SOCKET
+LiveUpgrade::WaitForSuccessor(DWORD& pid) {
+	SOCKET listener = m_listenSock.load();
+	if (listener == INVALID_SOCKET) return INVALID_SOCKET;
+
+	SOCKET channel = accept(listener, nullptr, nullptr);
+	if (channel == INVALID_SOCKET) return INVALID_SOCKET;
+	SetChannelTimeout(channel);
+
+	unsigned char hello[8];
+	if (!m_net.ReceiveExact(channel, hello, sizeof(hello)) ||
+		std::memcmp(hello, kHello, sizeof(kHello)) != 0) {
+		Logger::Warn("[Upgrade] Saludo inválido del sucesor.\n");
+		m_net.close(channel);
+		return INVALID_SOCKET;
+	}
+	pid = static_cast<DWORD>(GetU32(hello + 4));
+	return channel;
+}
+
+bool
+LiveUpgrade::SendHandoff(SOCKET channel, DWORD pid,
+	const std::vector<SOCKET>& listeners,
+	const std::vector<std::unique_ptr<Session>>& sessions,
+	const std::vector<RoomState>& rooms,
+	const std::vector<unsigned char>& identity) {
+	std::vector<unsigned char> header(kHandoff, kHandoff + 4);
+	PutU32(header, static_cast<uint32_t>(listeners.size()));
+	PutU32(header, static_cast<uint32_t>(sessions.size()));
+	if (!m_net.SendData(channel, header)) return false;
+
+	// 1) Listeners: solo el descriptor duplicado
+	for (SOCKET listener : listeners) {
+		WSAPROTOCOL_INFOW info{};
+		if (WSADuplicateSocketW(listener, pid, &info) == SOCKET_ERROR) {
+			Logger::Error("[Upgrade] WSADuplicateSocketW (listener) falló: {}\n", WSAGetLastError());
+			return false;
+		}
+		if (!m_net.SendAll(channel, reinterpret_cast<const unsigned char*>(&info), sizeof(info))) return false;
+	}
+
+	// 2) Sesiones: descriptor + estado serializado
+	for (const auto& session : sessions) {
+		WSAPROTOCOL_INFOW info{};
+		if (WSADuplicateSocketW(session->sock, pid, &info) == SOCKET_ERROR) {
+			Logger::Error("[Upgrade] WSADuplicateSocketW (sesión) falló: {}\n", WSAGetLastError());
+			return false;
+		}
+
+		std::vector<unsigned char> record;
+		PutU64(record, session->messagesIn);
+		PutU64(record, session->messagesOut);
+		std::vector<unsigned char> crypto = session->crypto.ExportSessionState(
+			session->peerPem ? *session->peerPem : std::string());
+		PutBlob(record, crypto.data(), crypto.size());
+		PutBlob(record, session->rx.data(), session->rx.size());
+
+		// Bytes aún no enviados, aplanados en un solo bloque
+		std::vector<unsigned char> tx;
+		size_t offset = session->txOffset;
+		for (const auto& frame : session->txQueue) {
+			tx.insert(tx.end(), frame->begin() + offset, frame->end());
+			offset = 0;
+		}
+		PutBlob(record, tx.data(), tx.size());
+		PutU32(record, session->userId);
+		PutU32(record, static_cast<uint32_t>(session->rooms.size()));
+		for (uint32_t roomId : session->rooms) PutU32(record, roomId);
+		PutU32(record, static_cast<uint32_t>(session->state));
+
+		std::vector<unsigned char> len4;
+		PutU32(len4, static_cast<uint32_t>(record.size()));
+		if (!m_net.SendAll(channel, reinterpret_cast<const unsigned char*>(&info), sizeof(info)) ||
+			!m_net.SendData(channel, len4) ||
+			!m_net.SendData(channel, record)) {
+			return false;
+		}
+	}
+
+	// 3) Salas: época y miembros por antigüedad
+	std::vector<unsigned char> block;
+	PutU32(block, static_cast<uint32_t>(rooms.size()));
+	for (const RoomState& room : rooms) {
+		PutU32(block, room.roomId);
+		PutU32(block, room.epoch);
+		PutU32(block, static_cast<uint32_t>(room.members.size()));
+		for (uint32_t userId : room.members) PutU32(block, userId);
+	}
+	// 4) Identidad: el sucesor atiende los handshakes a medias con la misma clave
+	PutBlob(block, identity.data(), identity.size());
+	if (!m_net.SendData(channel, block)) return false;
+
+	// 5) Confirmación del sucesor
+	unsigned char ack[4];
+	if (!m_net.ReceiveExact(channel, ack, sizeof(ack)) || std::memcmp(ack, kAck, sizeof(kAck)) != 0) {
+		Logger::Error("[Upgrade] El sucesor no confirmó el traspaso.\n");
+		return false;
+	}
+	return true;
+}
+
+bool
+LiveUpgrade::ReceiveHandoff(const std::string& path, Handoff& out) {
+	SOCKET channel = m_net.ConnectUnix(path);
+	if (channel == INVALID_SOCKET) return false;
+	SetChannelTimeout(channel);
+
+	std::vector<unsigned char> hello(kHello, kHello + 4);
+	PutU32(hello, static_cast<uint32_t>(GetCurrentProcessId()));
+
+	unsigned char header[12];
+	if (!m_net.SendData(channel, hello) ||
+		!m_net.ReceiveExact(channel, header, sizeof(header)) ||
+		std::memcmp(header, kHandoff, sizeof(kHandoff)) != 0) {
+		Logger::Error("[Upgrade] El proceso anterior no inició el traspaso.\n");
+		m_net.close(channel);
+		return false;
+	}
+	uint32_t listenerCount = GetU32(header + 4);
+	uint32_t sessionCount = GetU32(header + 8);
+
+	bool ok = true;
+	for (uint32_t i = 0; ok && i < listenerCount; ++i) {
+		WSAPROTOCOL_INFOW info{};
+		ok = m_net.ReceiveExact(channel, reinterpret_cast<unsigned char*>(&info), sizeof(info));
+		if (!ok) break;
+		SOCKET s = WSASocketW(FROM_PROTOCOL_INFO, FROM_PROTOCOL_INFO, FROM_PROTOCOL_INFO,
+			&info, 0, WSA_FLAG_OVERLAPPED);
+		if (s == INVALID_SOCKET) {
+			Logger::Error("[Upgrade] WSASocketW (listener) falló: {}\n", WSAGetLastError());
+			ok = false;
+			break;
+		}
+		out.listeners.push_back(s);
+	}
+
+	for (uint32_t i = 0; ok && i < sessionCount; ++i) {
+		WSAPROTOCOL_INFOW info{};
+		unsigned char len4[4];
+		ok = m_net.ReceiveExact(channel, reinterpret_cast<unsigned char*>(&info), sizeof(info)) &&
+			m_net.ReceiveExact(channel, len4, sizeof(len4));
+		if (!ok) break;
+		uint32_t recordLen = GetU32(len4);
+		if (recordLen > kMaxRecordSize) {
+			ok = false;
+			break;
+		}
+		std::vector<unsigned char> record = m_net.ReceiveDataBinary(channel, static_cast<int>(recordLen));
+		if (record.size() != recordLen) {
+			ok = false;
+			break;
+		}
+
+		SOCKET s = WSASocketW(FROM_PROTOCOL_INFO, FROM_PROTOCOL_INFO, FROM_PROTOCOL_INFO,
+			&info, 0, WSA_FLAG_OVERLAPPED);
+		if (s == INVALID_SOCKET) {
+			Logger::Error("[Upgrade] WSASocketW (sesión) falló: {}\n", WSAGetLastError());
+			ok = false;
+			break;
+		}
+
+		auto session = std::make_unique<Session>();
+		session->sock = s;
+		session->state = SessionState::Established;
+
+		Reader reader{ record };
+		std::vector<unsigned char> crypto, tx;
+		uint32_t roomCount = 0;
+		uint32_t state = 0;
+		ok = reader.U64(session->messagesIn) && reader.U64(session->messagesOut) &&
+			reader.Blob(crypto) && reader.Blob(session->rx) && reader.Blob(tx) &&
+			reader.U32(session->userId) && reader.U32(roomCount);
+		for (uint32_t r = 0; ok && r < roomCount; ++r) {
+			uint32_t roomId = 0;
+			ok = reader.U32(roomId);
+			session->rooms.push_back(roomId);
+		}
+		ok = ok && reader.U32(state) && reader.AtEnd() &&
+			state <= static_cast<uint32_t>(SessionState::Established);
+		session->state = static_cast<SessionState>(state);
+		if (ok) {
+			try {
+				std::string peerPem = session->crypto.ImportSessionState(crypto);
+				if (!peerPem.empty()) session->peerPem = std::make_shared<const std::string>(std::move(peerPem));
+			}
+			catch (const std::exception& e) {
+				Logger::Error("[Upgrade] {}\n", e.what());
+				ok = false;
+			}
+		}
+		if (!ok) {
+			m_net.close(s);
+			break;
+		}
+		if (!tx.empty()) {
+			session->txQueue.push_back(std::make_shared<const std::vector<unsigned char>>(std::move(tx)));
+		}
+		out.sessions.push_back(std::move(session));
+	}
+
+	if (ok) {
+		unsigned char count4[4];
+		ok = m_net.ReceiveExact(channel, count4, sizeof(count4));
+		uint32_t roomCount = ok ? GetU32(count4) : 0;
+		ok = ok && roomCount <= kMaxRoomEntries;
+		for (uint32_t i = 0; ok && i < roomCount; ++i) {
+			unsigned char fixed[12];
+			ok = m_net.ReceiveExact(channel, fixed, sizeof(fixed));
+			if (!ok) break;
+			RoomState room;
+			room.roomId = GetU32(fixed);
+			room.epoch = GetU32(fixed + 4);
+			uint32_t memberCount = GetU32(fixed + 8);
+			if (memberCount > kMaxRoomEntries) {
+				ok = false;
+				break;
+			}
+			std::vector<unsigned char> members = m_net.ReceiveDataBinary(channel, static_cast<int>(memberCount * 4));
+			ok = members.size() == memberCount * 4;
+			for (uint32_t m = 0; ok && m < memberCount; ++m) room.members.push_back(GetU32(members.data() + m * 4));
+			out.rooms.push_back(std::move(room));
+		}
+	}
+	if (ok) {
+		unsigned char len4[4];
+		ok = m_net.ReceiveExact(channel, len4, sizeof(len4));
+		uint32_t identityLen = ok ? GetU32(len4) : 0;
+		ok = ok && identityLen <= kMaxIdentitySize;
+		if (ok && identityLen > 0) {
+			out.identity = m_net.ReceiveDataBinary(channel, static_cast<int>(identityLen));
+			ok = out.identity.size() == identityLen;
+		}
+	}
+
+	if (ok) {
+		ok = m_net.SendAll(channel, kAck, sizeof(kAck));
+	}
+	m_net.close(channel);
+
+	if (!ok) {
+		// Sin confirmación el proceso anterior conserva sus sockets: se descartan las copias
+		for (SOCKET s : out.listeners) m_net.close(s);
+		for (auto& session : out.sessions) m_net.close(session->sock);
+		out.listeners.clear();
+		out.sessions.clear();
+		out.rooms.clear();
+		OPENSSL_cleanse(out.identity.data(), out.identity.size());
+		out.identity.clear();
+		Logger::Error("[Upgrade] Traspaso incompleto.\n");
+	}
+	return ok;
+}
@@ -0,0 +1,754 @@
+/**
+ * @file LoadGenerator.cpp
+ * @brief Implementación del generador de carga: handshakes, envío programado y medición.
+ *
+ * @details
+ * Cada hilo lleva sus sesiones de principio a fin: las abre en serie (el
+ * ritmo de handshakes crece con los hilos), espera a los demás en una
+ * barrera y luego alterna envíos vencidos y WSAPoll hasta el fin común. Tras
+ * el último envío sigue leyendo un margen para recoger las respuestas en vuelo.
+ *
+ * La tormenta de handshakes no bloquea en ninguna fase: cada hueco es una
+ * pequeña máquina de estados (connect, PEM del servidor, primera respuesta)
+ * sobre sockets no bloqueantes, de modo que un hilo sostiene miles a la vez.
+ *
+ * La reproducción usa los mismos hilos que la carga normal; solo cambia el
+ * calendario: cada sesión envía los frames de su guion a su hora y termina
+ * cuando lo agota, en lugar de sortear intervalos hasta un fin común.
+ */
+
+#include "LoadGenerator.h"
+#include "Heartbeat.h"
+#include <algorithm>
+#include <fstream>
+#include <random>
+
+namespace {
+	/// Fin del PEM de una clave pública RSA (delimita el primer bloque del handshake).
+	const char kPemEnd[] = "-----END RSA PUBLIC KEY-----\n";
+	/// Margen tras el último envío para recoger respuestas en vuelo.
+	const std::chrono::milliseconds kDrainTime(1000);
+	/// Espera máxima de WSAPoll: acota el retraso al revisar envíos y el fin.
+	const int kMaxPollMs = 50;
+	/// Envíos atrasados de una sesión por vuelta: un atraso no deja sin leer al resto.
+	const int kMaxCatchUp = 64;
+	/// Bytes leídos por llamada a recv.
+	const size_t kReadChunk = 64 * 1024;
+	/// Tope de un handshake de la tormenta antes de darlo por perdido.
+	const std::chrono::seconds kHandshakeTimeout(10);
+	/// Un connect más lento perdió al menos un SYN: la cola de accept estaba llena.
+	const std::chrono::seconds kSynRetransmit(1);
+	/// Pausa entre niveles de la tormenta para que el servidor libere las sesiones cortadas.
+	const std::chrono::seconds kStormPause(1);
+	/// Tamaño máximo de la PEM del servidor.
+	const size_t kMaxPemSize = 4096;
+
+	using Clock = std::chrono::steady_clock;
+
+	/// Sesión del generador: socket, clave AES y calendario de envíos.
+	struct LoadSession {
+		NetworkHelper net;                   ///< Dueño del socket.
+		SOCKET sock = INVALID_SOCKET;
+		CryptoHelper crypto;                 ///< Clave AES propia y PEM del servidor.
+		uint32_t userId = 0;                 ///< Con relay: id registrado.
+		uint32_t peerId = 0;                 ///< Con relay: destino de sus mensajes.
+		std::vector<unsigned char> rx;       ///< Bytes recibidos sin procesar.
+		Clock::time_point nextSend;          ///< Próximo envío programado.
+		size_t burstLeft = 0;                ///< Mensajes pendientes de la ráfaga en curso.
+		uint32_t sequence = 0;               ///< Último número de secuencia sellado.
+		const std::vector<CapturedFrame>* script = nullptr; ///< Reproducción: frames a enviar.
+		size_t cursor = 0;                   ///< Reproducción: próximo frame del guion.
+	};
+
+	uint64_t Micros(Clock::duration duration) {
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+	}
+
+	/// Fase de un hueco de la tormenta.
+	enum class StormState {
+		Idle,                                ///< Sin conexión: se relanza en la siguiente vuelta.
+		Connecting,                          ///< connect no bloqueante en curso.
+		AwaitingServerPem,                   ///< Esperando la PEM del servidor.
+		AwaitingReply                        ///< Clave enviada: esperando el eco o el registro.
+	};
+
+	/// Hueco de la tormenta: un handshake en vuelo que, al terminar, deja paso a otro.
+	struct StormSlot {
+		SOCKET sock = INVALID_SOCKET;
+		StormState state = StormState::Idle;
+		Clock::time_point start;             ///< Inicio del handshake en curso.
+		uint32_t userId = 0;                 ///< Con relay: id que registrará.
+		std::vector<unsigned char> rx;       ///< Bytes recibidos sin procesar.
+		CryptoHelper crypto;                 ///< PEM del servidor y clave AES del intento.
+	};
+
+	/// Mismo handshake que Client::ExchangeKeys + SendAESKeyEncrypted (+ RegisterUser con relay).
+	bool Handshake(LoadSession& session, const LoadOptions& options, const std::string& pem) {
+		if (!session.net.ConnectToServer(options.host, options.port)) return false;
+		session.sock = session.net.m_serverSocket;
+		// Mensajes pequeños y seguidos: sin Nagle la latencia medida es la del servidor
+		int on = 1;
+		setsockopt(session.sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+
+		std::string serverPem = session.net.ReceiveUntil(session.sock, kPemEnd);
+		if (!CryptoHelper::IsValidPublicKey(serverPem)) return false;
+		session.crypto.LoadPeerPublicKey(serverPem);
+		session.crypto.GenerateAESKey();
+		if (!session.net.SendData(session.sock, pem)) return false;
+		if (!session.net.SendData(session.sock, session.crypto.EncryptAESKeyWithPeer())) return false;
+		if (session.userId == 0) return true;
+
+		std::vector<unsigned char> id(4);
+		Frame::PutU32(id.data(), session.userId);
+		if (!session.net.SendFrame(session.sock, Frame::Control(Frame::Register, std::move(id)))) return false;
+		Frame reply;
+		return session.net.ReceiveFrame(session.sock, reply) && reply.IsControl() &&
+			reply.Type() == Frame::Registered && reply.payload.size() == 4 &&
+			Frame::GetU32(reply.payload.data()) == session.userId;
+	}
+
+	/// Acuse de un mensaje de otra sesión: secuencia e instante de envío originales.
+	bool SendReceipt(LoadSession& session, const FrameHeader& header) {
+		std::vector<unsigned char> stamp(Frame::kStampSize);
+		Frame::PutU32(stamp.data(), header.sequence);
+		Frame::PutU64(stamp.data() + 4, header.sentAtUs);
+		Frame receipt = Frame::Control(Frame::Receipt, std::move(stamp));
+		receipt.flags |= Frame::kRoutedFlag;
+		receipt.dst = header.src;
+		return session.net.SendFrame(session.sock, receipt);
+	}
+}
+
+LoadGenerator::LoadGenerator(const LoadOptions& options)
+	: m_options(options) {
+	m_identity.GenerateRSAKeys();
+	m_identityPem = m_identity.GetPublicKeyString();
+}
+
+bool
+LoadGenerator::ParsePattern(const std::string& name, LoadPattern& pattern) {
+	if (name == "fixed") pattern = LoadPattern::Fixed;
+	else if (name == "bursty") pattern = LoadPattern::Bursty;
+	else if (name == "poisson") pattern = LoadPattern::Poisson;
+	else return false;
+	return true;
+}
+
+bool
+LoadGenerator::CheckHost() const {
+	// La memoria compartida y la del proceso no son sockets: WSAPoll no las vigila
+	if (m_options.host.compare(0, 4, "shm:") == 0 || m_options.host.compare(0, 4, "mem:") == 0) {
+		Logger::Error("[Load] El generador de carga solo admite TCP y unix:<ruta>.\n");
+		return false;
+	}
+	return true;
+}
+
+size_t
+LoadGenerator::WorkerCount() const {
+	size_t threads = m_options.threads ? m_options.threads : std::max(1u, std::thread::hardware_concurrency());
+	return std::min(threads, m_options.connections);
+}
+
+bool
+LoadGenerator::Run() {
+	if (!CheckHost() || m_options.connections == 0) return false;
+	Logger::Info("[Load] {} sesiones contra {}:{} con {} hilos, {} msg/s durante {} s.\n",
+		m_options.connections, m_options.host, m_options.port, WorkerCount(),
+		m_options.rate, static_cast<int64_t>(m_options.duration.count()));
+	return RunSessions();
+}
+
+bool
+LoadGenerator::RunReplay() {
+	if (!CheckHost()) return false;
+	TrafficCapture capture;
+	if (!TrafficCapture::Load(m_options.replay, capture)) {
+		Logger::Error("[Replay] No se pudo leer la captura {}.\n", m_options.replay);
+		return false;
+	}
+
+	// Guion de cada sesión: lo que el cliente envió al servidor
+	m_scripts.assign(capture.sessions, ReplayScript());
+	uint64_t replayed = 0, skipped = 0, heartbeats = 0, last = 0;
+	size_t largest = 0;
+	bool routed = false;
+	for (const CapturedFrame& frame : capture.frames) {
+		if (!capture.ToServer(frame)) continue;
+		ReplayScript& script = m_scripts[frame.session];
+		if (frame.flags & Frame::kControlFlag) {
+			if (frame.type == Frame::Register && script.userId == 0 && frame.userId != 0) script.userId = frame.userId;
+			else if (frame.type == Frame::Ping || frame.type == Frame::Pong) heartbeats++;
+			else skipped++;
+			continue;
+		}
+		if (replayed++ == 0) m_replayBase = frame.atUs;
+		last = frame.atUs;
+		routed = routed || (frame.flags & Frame::kRoutedFlag) != 0;
+		largest = std::max<size_t>(largest, frame.length);
+		script.frames.push_back(frame);
+	}
+	if (m_scripts.empty()) {
+		Logger::Error("[Replay] La captura {} no contiene sesiones.\n", m_options.replay);
+		return false;
+	}
+	m_options.connections = m_scripts.size();
+	m_options.relay = routed;
+	m_options.minSize = 0;
+	m_options.maxSize = largest;
+
+	std::ostringstream pace;
+	if (m_options.speed > 0) pace << "a " << m_options.speed << "x";
+	else pace << "sin esperas";
+	Logger::Info("[Replay] {}: {} sesiones y {} mensajes en {} s de captura, {}, contra {}:{} con {} hilos.\n",
+		m_options.replay, m_scripts.size(), replayed, (last - m_replayBase) / 1e6, pace.str(),
+		m_options.host, m_options.port, WorkerCount());
+	if (skipped > 0) Logger::Info("[Replay] Se omiten {} frames de control que dependen de claves no capturadas.\n", skipped);
+	// Los Pong los vuelve a generar el latido del servidor contra las sesiones reproducidas
+	if (heartbeats > 0) Logger::Info("[Replay] Se omiten {} latidos (Ping/Pong): los regenera el latido de cada sesión.\n", heartbeats);
+	return RunSessions();
+}
+
+bool
+LoadGenerator::RunSessions() {
+	size_t threads = WorkerCount();
+	m_pendingWorkers = threads;
+
+	std::vector<std::unique_ptr<WorkerStats>> stats;
+	std::vector<std::thread> workers;
+	auto start = Clock::now();
+	size_t first = 0;
+	for (size_t worker = 0; worker < threads; ++worker) {
+		// Reparto equitativo: los primeros hilos absorben el resto
+		size_t count = m_options.connections / threads + (worker < m_options.connections % threads ? 1 : 0);
+		stats.push_back(std::make_unique<WorkerStats>());
+		WorkerStats& own = *stats.back();
+		workers.emplace_back([this, worker, first, count, &own]() { RunWorker(worker, first, count, own); });
+		first += count;
+	}
+	for (auto& worker : workers) worker.join();
+
+	WorkerStats total;
+	for (const auto& own : stats) {
+		total.established += own->established;
+		total.failed += own->failed;
+		total.sent += own->sent;
+		total.received += own->received;
+		total.bytesSent += own->bytesSent;
+		total.disconnected += own->disconnected;
+		total.handshake.Add(own->handshake);
+		total.roundTrip.Add(own->roundTrip);
+		total.oneWay.Add(own->oneWay);
+		total.lastSend = std::max(total.lastSend, own->lastSend);
+	}
+	// La reproducción no tiene un fin común: el envío acaba con el último frame
+	Clock::time_point sendEnd = m_scripts.empty() ? m_sendEnd : std::max(total.lastSend, m_sendStart);
+	Report(total, m_sendStart - start, sendEnd - m_sendStart);
+	return total.established > 0;
+}
+
+bool
+LoadGenerator::RunStorm() {
+	// Las colas de accept y los SYN perdidos solo existen en TCP
+	if (NetworkHelper::IsLocalAddress(m_options.host)) {
+		Logger::Error("[Storm] La tormenta de handshakes solo admite TCP.\n");
+		return false;
+	}
+	std::vector<AddressResolver::Endpoint> endpoints =
+		AddressResolver::Instance().Resolve(m_options.host, m_options.port, std::chrono::seconds(5));
+	if (endpoints.empty()) {
+		Logger::Error("[Storm] No se pudo resolver {}.\n", m_options.host);
+		return false;
+	}
+	m_endpoint = endpoints.front();
+	m_nextUser = m_options.userBase;
+
+	size_t configured = m_options.threads ? m_options.threads : std::max(1u, std::thread::hardware_concurrency());
+	bool any = false;
+	for (size_t i = 0; i < m_options.storm.size(); ++i) {
+		size_t level = m_options.storm[i];
+		if (level == 0) continue;
+		if (i > 0) std::this_thread::sleep_for(kStormPause);
+
+		size_t threads = std::min(configured, level);
+		m_stormCompleted = 0;
+		m_stormWaveUs = -1;
+		Logger::Info("[Storm] Concurrencia {} contra {}:{} con {} hilos durante {} s.\n", level,
+			m_options.host, m_options.port, threads, static_cast<int64_t>(m_options.duration.count()));
+
+		std::vector<std::unique_ptr<StormStats>> stats;
+		std::vector<std::thread> workers;
+		auto start = Clock::now();
+		auto end = start + m_options.duration;
+		for (size_t worker = 0; worker < threads; ++worker) {
+			size_t count = level / threads + (worker < level % threads ? 1 : 0);
+			stats.push_back(std::make_unique<StormStats>());
+			StormStats& own = *stats.back();
+			workers.emplace_back([this, count, level, end, &own]() { RunStormWorker(count, level, end, own); });
+		}
+		for (auto& worker : workers) worker.join();
+
+		StormStats total;
+		for (const auto& own : stats) {
+			total.completed += own->completed;
+			total.refused += own->refused;
+			total.reset += own->reset;
+			total.rejected += own->rejected;
+			total.timedOut += own->timedOut;
+			total.slowConnects += own->slowConnects;
+			total.connect.Add(own->connect);
+			total.handshake.Add(own->handshake);
+		}
+		ReportStorm(level, total, Clock::now() - start);
+		any = any || total.completed > 0;
+	}
+	return any;
+}
+
+void
+LoadGenerator::WaitForHandshakes() {
+	std::unique_lock<std::mutex> lock(m_barrierMutex);
+	if (--m_pendingWorkers == 0) {
+		// El último en llegar fija la ventana de envío común
+		m_sendStart = Clock::now();
+		m_sendEnd = m_sendStart + m_options.duration;
+		m_barrier.notify_all();
+		return;
+	}
+	m_barrier.wait(lock, [this]() { return m_pendingWorkers == 0; });
+}
+
+void
+LoadGenerator::RunWorker(size_t worker, size_t first, size_t count, WorkerStats& stats) {
+	const LoadOptions& options = m_options;
+	const bool replay = !m_scripts.empty();
+	std::mt19937_64 rng(worker + 1);
+
+	// 1. Handshakes en serie
+	std::vector<std::unique_ptr<LoadSession>> sessions;
+	for (size_t index = first; index < first + count; ++index) {
+		auto session = std::make_unique<LoadSession>();
+		if (replay) {
+			session->script = &m_scripts[index].frames;
+			session->userId = m_scripts[index].userId;
+		}
+		else if (options.relay) {
+			session->userId = options.userBase + static_cast<uint32_t>(index);
+			session->peerId = options.userBase + static_cast<uint32_t>((index + 1) % options.connections);
+		}
+		auto begin = Clock::now();
+		bool ok = false;
+		try {
+			ok = Handshake(*session, options, m_identityPem);
+		}
+		catch (const std::exception& e) {
+			Logger::Debug("[Load] Handshake fallido: {}\n", e.what());
+		}
+		if (!ok) {
+			stats.failed++;
+			continue;
+		}
+		stats.handshake.Record(Micros(Clock::now() - begin));
+		stats.established++;
+		sessions.push_back(std::move(session));
+	}
+	WaitForHandshakes();
+
+	// 2. Calendario: ritmo por sesión y desfase inicial al azar para no enviar todas a la vez
+	double perSession = options.rate / options.connections;
+	if (perSession <= 0) perSession = 1e-9;
+	auto seconds = [](double s) {
+		return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(s));
+	};
+	std::exponential_distribution<double> exponential(perSession);
+	std::uniform_real_distribution<double> unit(0.0, 1.0);
+	std::uniform_int_distribution<size_t> sizes(options.minSize, std::max(options.minSize, options.maxSize));
+	// Reproducción: cada frame a su instante de la captura, escalado por la velocidad
+	size_t pending = 0; // sesiones de este hilo con frames por enviar
+	auto replayAt = [&](const CapturedFrame& frame) {
+		if (options.speed <= 0) return m_sendStart;
+		return m_sendStart + seconds((frame.atUs - m_replayBase) / 1e6 / options.speed);
+	};
+	auto gap = [&](LoadSession& session) -> Clock::duration {
+		if (replay) {
+			// Al agotar el guion la sesión solo lee
+			if (++session.cursor < session.script->size()) return replayAt((*session.script)[session.cursor]) - session.nextSend;
+			pending--;
+			return Clock::time_point::max() - session.nextSend;
+		}
+		switch (options.pattern) {
+		case LoadPattern::Poisson:
+			return seconds(exponential(rng));
+		case LoadPattern::Bursty:
+			if (session.burstLeft > 1) {
+				session.burstLeft--;
+				return Clock::duration::zero();
+			}
+			session.burstLeft = std::max<size_t>(options.burst, 1);
+			return seconds(session.burstLeft / perSession);
+		default:
+			return seconds(1.0 / perSession);
+		}
+	};
+	for (auto& session : sessions) {
+		if (replay) {
+			if (session->script->empty()) {
+				session->nextSend = Clock::time_point::max();
+				continue;
+			}
+			session->nextSend = replayAt(session->script->front());
+			pending++;
+			continue;
+		}
+		session->burstLeft = std::max<size_t>(options.burst, 1);
+		double mean = (options.pattern == LoadPattern::Bursty ? session->burstLeft : 1) / perSession;
+		session->nextSend = m_sendStart + seconds(unit(rng) * mean);
+	}
+
+	// Texto plano compartido: cada mensaje toma un prefijo del tamaño sorteado
+	std::string text(std::max(options.minSize, options.maxSize), '\0');
+	for (char& c : text) c = static_cast<char>('a' + rng() % 26);
+	std::vector<unsigned char> buffer(kReadChunk);
+	std::vector<WSAPOLLFD> fds;
+	bool rebuild = true;
+
+	auto send = [&](LoadSession& session) {
+		Frame frame;
+		size_t size;
+		if (replay) {
+			const CapturedFrame& step = (*session.script)[session.cursor];
+			frame.flags = Frame::kStampedFlag | (step.flags & Frame::kRoutedFlag);
+			frame.dst = step.dst;
+			// AES-CBC con PKCS#7 añade de 1 a 16 bytes: 16 menos da el mismo tamaño cifrado
+			size = step.length >= 16 ? step.length - 16 : 0;
+		}
+		else {
+			frame.flags = Frame::kStampedFlag | (options.relay ? Frame::kRoutedFlag : 0);
+			frame.dst = session.peerId;
+			size = sizes(rng);
+		}
+		frame.sequence = ++session.sequence;
+		frame.sentAtUs = Frame::NowMicros();
+		frame.payload = session.crypto.AESEncrypt(text.substr(0, size), frame.iv);
+		if (!session.net.SendFrame(session.sock, frame)) return false;
+		if (replay) stats.lastSend = Clock::now();
+		stats.sent++;
+		stats.bytesSent += size;
+		return true;
+	};
+
+	// Un frame completo recibido: eco, mensaje de otra sesión, acuse o latido del servidor
+	auto handle = [&](LoadSession& session, const unsigned char* frame, const FrameHeader& header) {
+		const unsigned char* payload = frame + header.headerSize;
+		uint64_t now = Frame::NowMicros();
+		if (header.flags & Frame::kControlFlag) {
+			if (frame[0] == Frame::Ping && !(header.flags & Frame::kRoutedFlag) && header.length == Heartbeat::kPayloadSize) {
+				session.net.SendFrame(session.sock, Frame::Control(Frame::Pong,
+					std::vector<unsigned char>(payload, payload + header.length)));
+			}
+			else if (frame[0] == Frame::Receipt && header.length == Frame::kStampSize) {
+				uint64_t sentAt = Frame::GetU64(payload + 4);
+				stats.received++;
+				if (sentAt <= now) stats.roundTrip.Record(now - sentAt);
+			}
+			return;
+		}
+		if (!(header.flags & Frame::kStampedFlag)) return;
+		stats.received++;
+		if (!(header.flags & Frame::kRoutedFlag)) {
+			if (header.sentAtUs <= now) stats.roundTrip.Record(now - header.sentAtUs);
+			return;
+		}
+		if (header.sentAtUs <= now) stats.oneWay.Record(now - header.sentAtUs);
+		if (options.echo) SendReceipt(session, header);
+	};
+
+	// 3. Envíos vencidos y lecturas hasta el fin común, más el margen de respuestas.
+	// Con relay se apura siempre el margen: otras sesiones pueden seguir escribiendo a las de este hilo
+	bool awaitReplies = !options.relay;
+	Clock::time_point sendEnd = replay ? Clock::time_point::max() : m_sendEnd;
+	while (!sessions.empty()) {
+		auto now = Clock::now();
+		if (replay && pending == 0 && sendEnd == Clock::time_point::max()) sendEnd = now;
+		bool sending = now < sendEnd;
+		if (!sending && (now >= sendEnd + kDrainTime || (awaitReplies && stats.roundTrip.Count() >= stats.sent))) break;
+
+		auto wake = now + std::chrono::milliseconds(kMaxPollMs);
+		for (size_t i = 0; sending && i < sessions.size(); ++i) {
+			LoadSession& session = *sessions[i];
+			for (int n = 0; n < kMaxCatchUp && session.nextSend <= now && session.nextSend < sendEnd; ++n) {
+				if (!send(session)) break;
+				session.nextSend += gap(session);
+			}
+			wake = std::min(wake, session.nextSend);
+		}
+
+		if (rebuild) {
+			fds.assign(sessions.size(), WSAPOLLFD{});
+			for (size_t i = 0; i < sessions.size(); ++i) {
+				fds[i].fd = sessions[i]->sock;
+				fds[i].events = POLLRDNORM;
+			}
+			rebuild = false;
+		}
+		int timeout = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(wake - Clock::now()).count());
+		int ready = WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), std::max(0, std::min(timeout, kMaxPollMs)));
+		if (ready <= 0) continue;
+
+		for (size_t i = sessions.size(); i-- > 0;) {
+			if (!fds[i].revents) continue;
+			LoadSession& session = *sessions[i];
+			int n = recv(session.sock, reinterpret_cast<char*>(buffer.data()), static_cast<int>(buffer.size()), 0);
+			if (n <= 0) {
+				// El servidor cerró la sesión (o falló el socket): se retira
+				stats.disconnected++;
+				if (replay && session.cursor < session.script->size()) pending--;
+				sessions.erase(sessions.begin() + i);
+				rebuild = true;
+				continue;
+			}
+			session.rx.insert(session.rx.end(), buffer.begin(), buffer.begin() + n);
+			size_t offset = 0;
+			FrameHeader header;
+			while (Frame::ParseHeader(session.rx.data() + offset, session.rx.size() - offset, header) &&
+				session.rx.size() - offset >= header.totalSize) {
+				handle(session, session.rx.data() + offset, header);
+				offset += header.totalSize;
+			}
+			session.rx.erase(session.rx.begin(), session.rx.begin() + offset);
+		}
+	}
+}
+
+void
+LoadGenerator::RunStormWorker(size_t count, size_t level, Clock::time_point end, StormStats& stats) {
+	const LoadOptions& options = m_options;
+	NetworkHelper net;
+	Clock::time_point start = end - options.duration;
+	std::vector<std::unique_ptr<StormSlot>> slots;
+	for (size_t i = 0; i < count; ++i) slots.push_back(std::make_unique<StormSlot>());
+	std::vector<WSAPOLLFD> fds(count);
+	std::vector<unsigned char> buffer(kReadChunk);
+
+	auto close = [](StormSlot& slot) {
+		if (slot.sock != INVALID_SOCKET) closesocket(slot.sock);
+		slot.sock = INVALID_SOCKET;
+		slot.state = StormState::Idle;
+	};
+	auto fail = [&](StormSlot& slot, uint64_t& counter) {
+		counter++;
+		close(slot);
+	};
+	auto launch = [&](StormSlot& slot) {
+		slot.rx.clear();
+		slot.start = Clock::now();
+		slot.sock = socket(m_endpoint.family, SOCK_STREAM, IPPROTO_TCP);
+		if (slot.sock == INVALID_SOCKET) {
+			stats.refused++;
+			return;
+		}
+		net.SetNonBlocking(slot.sock, true);
+		// Cierre con RST: miles de handshakes por segundo agotarían los puertos efímeros en TIME_WAIT
+		linger hardClose{};
+		hardClose.l_onoff = 1;
+		hardClose.l_linger = 0;
+		setsockopt(slot.sock, SOL_SOCKET, SO_LINGER, (const char*)&hardClose, sizeof(hardClose));
+		int on = 1;
+		setsockopt(slot.sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+		if (connect(slot.sock, (const sockaddr*)&m_endpoint.addr, m_endpoint.addrLen) == SOCKET_ERROR) {
+			int err = WSAGetLastError();
+			if (err != WSAEWOULDBLOCK && err != WSAEINPROGRESS) {
+				fail(slot, stats.refused);
+				return;
+			}
+		}
+		slot.state = StormState::Connecting;
+	};
+	auto complete = [&](StormSlot& slot) {
+		stats.handshake.Record(Micros(Clock::now() - slot.start));
+		stats.completed++;
+		// Quien completa la oleada inicial fija su duración
+		if (m_stormCompleted.fetch_add(1, std::memory_order_relaxed) + 1 == level) {
+			m_stormWaveUs = static_cast<int64_t>(Micros(Clock::now() - start));
+		}
+		close(slot);
+	};
+
+	// PEM del servidor completa: misma respuesta que el cliente, más la primera petición
+	// (eco o registro) cuya respuesta confirma que el servidor ya descifró la clave AES
+	auto answer = [&](StormSlot& slot) {
+		auto it = std::search(slot.rx.begin(), slot.rx.end(), kPemEnd, kPemEnd + sizeof(kPemEnd) - 1);
+		if (it == slot.rx.end()) {
+			if (slot.rx.size() > kMaxPemSize) fail(slot, stats.rejected);
+			return;
+		}
+		std::string serverPem(slot.rx.begin(), it + (sizeof(kPemEnd) - 1));
+		slot.rx.erase(slot.rx.begin(), it + (sizeof(kPemEnd) - 1));
+		if (!CryptoHelper::IsValidPublicKey(serverPem)) {
+			fail(slot, stats.rejected);
+			return;
+		}
+		slot.crypto.LoadPeerPublicKey(serverPem);
+		slot.crypto.GenerateAESKey();
+
+		Frame request;
+		if (options.relay) {
+			slot.userId = m_nextUser.fetch_add(1, std::memory_order_relaxed);
+			std::vector<unsigned char> id(4);
+			Frame::PutU32(id.data(), slot.userId);
+			request = Frame::Control(Frame::Register, std::move(id));
+		}
+		else {
+			request.payload = slot.crypto.AESEncrypt("storm", request.iv);
+		}
+		std::vector<unsigned char> out(m_identityPem.begin(), m_identityPem.end());
+		std::vector<unsigned char> wrapped = slot.crypto.EncryptAESKeyWithPeer();
+		std::vector<unsigned char> frame = request.Encode();
+		out.insert(out.end(), wrapped.begin(), wrapped.end());
+		out.insert(out.end(), frame.begin(), frame.end());
+		// Un socket recién abierto admite estos pocos cientos de bytes sin bloquear
+		int sent = send(slot.sock, reinterpret_cast<const char*>(out.data()), static_cast<int>(out.size()), 0);
+		if (sent != static_cast<int>(out.size())) {
+			fail(slot, stats.reset);
+			return;
+		}
+		slot.state = StormState::AwaitingReply;
+	};
+	auto reply = [&](StormSlot& slot) {
+		FrameHeader header;
+		size_t offset = 0;
+		while (Frame::ParseHeader(slot.rx.data() + offset, slot.rx.size() - offset, header) &&
+			slot.rx.size() - offset >= header.totalSize) {
+			const unsigned char* frame = slot.rx.data() + offset;
+			offset += header.totalSize;
+			bool control = (header.flags & Frame::kControlFlag) != 0;
+			if (options.relay && control && frame[0] == Frame::Registered) {
+				if (header.length == 4 && Frame::GetU32(frame + header.headerSize) == slot.userId) complete(slot);
+				else fail(slot, stats.rejected);
+				return;
+			}
+			if (!options.relay && !control) {
+				complete(slot);
+				return;
+			}
+		}
+		slot.rx.erase(slot.rx.begin(), slot.rx.begin() + offset);
+	};
+
+	while (true) {
+		auto now = Clock::now();
+		if (now >= end) break;
+		for (size_t i = 0; i < count; ++i) {
+			StormSlot& slot = *slots[i];
+			if (slot.state != StormState::Idle && now - slot.start >= kHandshakeTimeout) fail(slot, stats.timedOut);
+			if (slot.state == StormState::Idle) launch(slot);
+			fds[i].fd = slot.sock;
+			fds[i].events = (slot.state == StormState::Connecting) ? POLLWRNORM : POLLRDNORM;
+			fds[i].revents = 0;
+		}
+		int timeout = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(end - now).count());
+		int ready = WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), std::max(0, std::min(timeout, kMaxPollMs)));
+		if (ready <= 0) continue;
+
+		for (size_t i = 0; i < count; ++i) {
+			StormSlot& slot = *slots[i];
+			if (!fds[i].revents) continue;
+			if (slot.state == StormState::Connecting) {
+				int soError = 0;
+				socklen_t optLen = sizeof(soError);
+				getsockopt(slot.sock, SOL_SOCKET, SO_ERROR, (char*)&soError, &optLen);
+				if (soError != 0 || !(fds[i].revents & POLLWRNORM)) {
+					fail(slot, stats.refused);
+					continue;
+				}
+				auto elapsed = Clock::now() - slot.start;
+				stats.connect.Record(Micros(elapsed));
+				if (elapsed >= kSynRetransmit) stats.slowConnects++;
+				slot.state = StormState::AwaitingServerPem;
+				continue;
+			}
+			int n = recv(slot.sock, reinterpret_cast<char*>(buffer.data()), static_cast<int>(buffer.size()), 0);
+			if (n <= 0) {
+				fail(slot, stats.reset);
+				continue;
+			}
+			slot.rx.insert(slot.rx.end(), buffer.begin(), buffer.begin() + n);
+			if (slot.state == StormState::AwaitingServerPem) answer(slot);
+			if (slot.state == StormState::AwaitingReply) reply(slot);
+		}
+	}
+	// Los handshakes aún en vuelo al terminar no cuentan ni como completos ni como fallidos
+	for (auto& slot : slots) close(*slot);
+}
+
+void
+LoadGenerator::Report(const WorkerStats& total, std::chrono::duration<double> handshakeTime,
+	std::chrono::duration<double> sendTime) {
+	auto ms = [](uint64_t us) { return us / 1000.0; };
+	double handshakeSeconds = std::max(handshakeTime.count(), 1e-9);
+	double sendSeconds = std::max(sendTime.count(), 1e-9);
+
+	Logger::Info("[Load] Handshakes: {}/{} en {} s ({} por segundo), p50 {} ms, p99 {} ms, máx {} ms.\n",
+		total.established, total.established + total.failed, handshakeSeconds,
+		total.established / handshakeSeconds, ms(total.handshake.ValueAtPercentile(50)),
+		ms(total.handshake.ValueAtPercentile(99)), ms(total.handshake.Max()));
+	Logger::Info("[Load] Enviados {} mensajes en {} s: {} msg/s, {} MiB/s de texto plano. Recibidos {}, desconexiones {}.\n",
+		total.sent, sendSeconds, total.sent / sendSeconds,
+		total.bytesSent / sendSeconds / (1 << 20), total.received, total.disconnected);
+
+	const std::pair<const char*, const HdrHistogram*> histograms[] = {
+		{ "Ida y vuelta", &total.roundTrip }, { "Un sentido", &total.oneWay } };
+	for (const auto& entry : histograms) {
+		const HdrHistogram& h = *entry.second;
+		if (h.Count() == 0) continue;
+		Logger::Info("[Load] {}: {} muestras, p50 {} ms, p99 {} ms, p99.9 {} ms, máx {} ms.\n", entry.first, h.Count(),
+			ms(h.ValueAtPercentile(50)), ms(h.ValueAtPercentile(99)),
+			ms(h.ValueAtPercentile(99.9)), ms(h.Max()));
+	}
+
+	if (m_options.histogramPrefix.empty()) return;
+	const std::pair<const char*, const HdrHistogram*> files[] = {
+		{ "-handshake.hgrm", &total.handshake }, { "-rtt.hgrm", &total.roundTrip }, { "-oneway.hgrm", &total.oneWay } };
+	for (const auto& entry : files) {
+		if (entry.second->Count() == 0) continue;
+		std::ofstream out(m_options.histogramPrefix + entry.first);
+		if (!out) {
+			Logger::Warn("[Load] No se pudo escribir {}{}.\n", m_options.histogramPrefix, entry.first);
+			continue;
+		}
+		entry.second->WritePercentiles(out, 1000.0);
+	}
+	Logger::Info("[Load] Distribuciones (ms) en {}-*.hgrm.\n", m_options.histogramPrefix);
+}
+
+void
+LoadGenerator::ReportStorm(size_t level, const StormStats& total, std::chrono::duration<double> elapsed) {
+	auto ms = [](uint64_t us) { return us / 1000.0; };
+	double seconds = std::max(elapsed.count(), 1e-9);
+	size_t cores = m_options.serverCores ? m_options.serverCores : std::max(1u, std::thread::hardware_concurrency());
+	double rate = total.completed / seconds;
+
+	Logger::Info("[Storm] Concurrencia {}: {} handshakes en {} s, {} por segundo ({} por núcleo del servidor).\n",
+		level, total.completed, seconds, rate, rate / cores);
+	int64_t wave = m_stormWaveUs.load();
+	if (wave >= 0) Logger::Info("[Storm]   Primera oleada de {} sesiones completa en {} ms.\n", level, ms(static_cast<uint64_t>(wave)));
+	else Logger::Info("[Storm]   La primera oleada de {} sesiones no llegó a completarse.\n", level);
+	Logger::Info("[Storm]   Handshake: p50 {} ms, p99 {} ms, p99.9 {} ms, máx {} ms. Connect: p50 {} ms, p99 {} ms.\n",
+		ms(total.handshake.ValueAtPercentile(50)), ms(total.handshake.ValueAtPercentile(99)),
+		ms(total.handshake.ValueAtPercentile(99.9)), ms(total.handshake.Max()),
+		ms(total.connect.ValueAtPercentile(50)), ms(total.connect.ValueAtPercentile(99)));
+	Logger::Info("[Storm]   Rechazadas {}, cortadas {}, inválidas {}, vencidas {}; connects con SYN reintentado {}.\n",
+		total.refused, total.reset, total.rejected, total.timedOut, total.slowConnects);
+	if (total.refused + total.slowConnects > 0) {
+		Logger::Warn("[Storm]   Síntomas de cola de accept desbordada con {} conexiones simultáneas.\n", level);
+	}
+
+	if (m_options.histogramPrefix.empty() || total.handshake.Count() == 0) return;
+	std::string path = m_options.histogramPrefix + "-storm-" + std::to_string(level) + ".hgrm";
+	std::ofstream out(path);
+	if (!out) {
+		Logger::Warn("[Storm] No se pudo escribir {}.\n", path);
+		return;
+	}
+	total.handshake.WritePercentiles(out, 1000.0);
+}
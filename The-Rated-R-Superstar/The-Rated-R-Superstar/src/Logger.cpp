@@ -0,0 +1,333 @@
+/**
+ * @file Logger.cpp
+ * @brief Implementación de los anillos por hilo y del hilo que formatea los registros.
+ */
+
+#include "Logger.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+	/// Marca de relleno en el campo de tamaño: el resto del búfer se salta.
+	const uint32_t kPaddingFlag = 0x80000000u;
+	/// Espera máxima del hilo del logger sin avisos (acota un aviso perdido).
+	const std::chrono::milliseconds kIdleWait(10);
+
+	const char* LevelName(uint8_t level) {
+		switch (static_cast<LogLevel>(level)) {
+		case LogLevel::Debug: return "DEBUG";
+		case LogLevel::Info: return "INFO";
+		case LogLevel::Warn: return "WARN";
+		default: return "ERROR";
+		}
+	}
+
+	/// Anillo del hilo; al terminar el hilo se marca para que el logger lo retire.
+	struct ThreadRingHolder {
+		std::shared_ptr<LogRing> ring;
+		~ThreadRingHolder() {
+			if (ring) ring->Retire();
+		}
+	};
+
+	thread_local ThreadRingHolder t_ring;
+}
+
+unsigned char*
+LogRing::Reserve(size_t size) {
+	size_t head = m_head.load(std::memory_order_relaxed);
+	size_t tail = m_tail.load(std::memory_order_acquire);
+	size_t offset = head & (kCapacity - 1);
+	// No cabe hasta el final: se rellena el hueco y se empieza desde el principio
+	size_t padding = (kCapacity - offset < size) ? kCapacity - offset : 0;
+	if (head + padding + size - tail > kCapacity) return nullptr;
+	if (padding > 0) {
+		uint32_t marker = kPaddingFlag | static_cast<uint32_t>(padding);
+		std::memcpy(m_data + offset, &marker, sizeof(marker));
+		offset = 0;
+	}
+	m_reservedHead = head + padding + size;
+	return m_data + offset;
+}
+
+const unsigned char*
+LogRing::Peek() {
+	size_t tail = m_tail.load(std::memory_order_relaxed);
+	while (tail != m_head.load(std::memory_order_acquire)) {
+		const unsigned char* record = m_data + (tail & (kCapacity - 1));
+		uint32_t size;
+		std::memcpy(&size, record, sizeof(size));
+		if (!(size & kPaddingFlag)) return record;
+		tail += size & ~kPaddingFlag;
+		m_tail.store(tail, std::memory_order_release);
+	}
+	return nullptr;
+}
+
+Logger&
+Logger::Instance() {
+	static Logger logger;
+	return logger;
+}
+
+Logger::~Logger() {
+	Stop();
+}
+
+bool
+Logger::ParseLevel(const std::string& name, LogLevel& level) {
+	if (name == "debug") level = LogLevel::Debug;
+	else if (name == "info") level = LogLevel::Info;
+	else if (name == "warn") level = LogLevel::Warn;
+	else if (name == "error") level = LogLevel::Error;
+	else if (name == "off") level = LogLevel::Off;
+	else return false;
+	return true;
+}
+
+bool
+Logger::OpenFile(const std::string& path) {
+	std::lock_guard<std::mutex> lock(m_sinkMutex);
+	m_file.open(path, std::ios::out | std::ios::app | std::ios::binary);
+	return m_file.is_open();
+}
+
+void
+Logger::Stop() {
+	{
+		std::lock_guard<std::mutex> lock(m_ringsMutex);
+		m_stopped.store(true, std::memory_order_release);
+		m_running = false;
+	}
+	m_wakeCv.notify_one();
+	if (m_thread.joinable()) m_thread.join();
+	{
+		std::lock_guard<std::mutex> lock(m_consoleMutex);
+		m_consoleStopping = true;
+	}
+	m_consoleCv.notify_one();
+	if (m_consoleThread.joinable()) m_consoleThread.join();
+	std::lock_guard<std::mutex> lock(m_sinkMutex);
+	if (m_file.is_open()) m_file.flush();
+	std::cout.flush();
+}
+
+uint64_t
+Logger::GetDroppedCount() {
+	std::lock_guard<std::mutex> lock(m_ringsMutex);
+	uint64_t dropped = 0;
+	for (const auto& ring : m_rings) dropped += ring->GetDroppedCount();
+	return dropped;
+}
+
+LogRing*
+Logger::ThreadRing() {
+	if (!t_ring.ring) {
+		auto ring = std::make_shared<LogRing>();
+		std::lock_guard<std::mutex> lock(m_ringsMutex);
+		ring->ordinal = m_nextOrdinal++;
+		m_rings.push_back(ring);
+		t_ring.ring = ring;
+		if (!m_running && !m_stopped) {
+			m_running = true;
+			m_thread = std::thread([this]() { Run(); });
+		}
+	}
+	return t_ring.ring.get();
+}
+
+void
+Logger::Wake() {
+	// seq_cst con el de Run(): o el hilo ve el registro al revisar, o aquí se ve que espera
+	if (m_idle.load()) m_wakeCv.notify_one();
+}
+
+void
+Logger::Run() {
+	while (true) {
+		if (Drain()) continue;
+
+		// Sin pendientes: se vuelca el destino una vez por ráfaga, no por registro
+		{
+			std::lock_guard<std::mutex> lock(m_sinkMutex);
+			if (m_file.is_open()) m_file.flush();
+			else std::cout.flush();
+		}
+		if (!m_running) {
+			if (Drain()) continue;
+			break;
+		}
+
+		std::unique_lock<std::mutex> lock(m_wakeMutex);
+		m_idle.store(true);
+		bool pending = false;
+		{
+			std::lock_guard<std::mutex> ringsLock(m_ringsMutex);
+			for (const auto& ring : m_rings) pending = pending || !ring->IsEmpty();
+		}
+		if (!pending && m_running) m_wakeCv.wait_for(lock, kIdleWait);
+		m_idle.store(false);
+	}
+}
+
+bool
+Logger::Drain() {
+	std::vector<std::shared_ptr<LogRing>> rings;
+	uint64_t dropped = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_ringsMutex);
+		// Los hilos terminados se retiran cuando ya no queda nada suyo
+		m_rings.erase(std::remove_if(m_rings.begin(), m_rings.end(),
+			[](const std::shared_ptr<LogRing>& ring) { return ring->IsRetired() && ring->IsEmpty(); }),
+			m_rings.end());
+		rings = m_rings;
+		for (const auto& ring : m_rings) dropped += ring->GetDroppedCount();
+	}
+
+	bool any = false;
+	for (const auto& ring : rings) {
+		// Tope por anillo y pasada: un hilo muy activo no deja sin turno a los demás
+		for (int i = 0; i < 256; ++i) {
+			const unsigned char* record = ring->Peek();
+			if (!record) break;
+			LogRecordHeader header;
+			std::memcpy(&header, record, sizeof(header));
+			Emit(header, ring->ordinal, Format(header, record + sizeof(header)));
+			ring->Release(header.size);
+			any = true;
+		}
+	}
+
+	if (dropped > m_reportedDrops) {
+		LogRecordHeader header{};
+		header.level = static_cast<uint8_t>(LogLevel::Warn);
+		header.timeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+		Emit(header, 0, "[Log] " + std::to_string(dropped - m_reportedDrops) + " registros descartados (anillo lleno).\n");
+		m_reportedDrops = dropped;
+	}
+	return any;
+}
+
+void
+Logger::WriteDirect(const unsigned char* record) {
+	LogRecordHeader header;
+	std::memcpy(&header, record, sizeof(header));
+	Emit(header, 0, Format(header, record + sizeof(header)));
+	std::lock_guard<std::mutex> lock(m_sinkMutex);
+	if (m_file.is_open()) m_file.flush();
+	else std::cout.flush();
+}
+
+void
+Logger::EnqueueConsole(std::string text) {
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lock(m_consoleMutex);
+		if (!m_consoleStopping) {
+			m_consoleQueue.push_back(std::move(text));
+			if (!m_consoleThread.joinable()) m_consoleThread = std::thread([this]() { RunConsole(); });
+			queued = true;
+		}
+	}
+	// Tras Stop() no hay hilo de consola: se escribe en el momento
+	if (queued) m_consoleCv.notify_one();
+	else WriteConsole(text);
+}
+
+void
+Logger::RunConsole() {
+	std::unique_lock<std::mutex> lock(m_consoleMutex);
+	while (true) {
+		m_consoleCv.wait(lock, [this]() { return m_consoleStopping || !m_consoleQueue.empty(); });
+		if (m_consoleQueue.empty()) break;
+		std::vector<std::string> batch;
+		batch.swap(m_consoleQueue);
+		lock.unlock();
+		// Una escritura y un vaciado por tanda: una terminal lenta solo retrasa a este hilo
+		std::string text;
+		for (const std::string& part : batch) text += part;
+		WriteConsole(text);
+		lock.lock();
+	}
+}
+
+void
+Logger::WriteConsole(const std::string& text) {
+	// Mismo mutex que el destino: no se intercala a mitad de un registro de consola
+	std::lock_guard<std::mutex> lock(m_sinkMutex);
+	std::cout << text;
+	std::cout.flush();
+}
+
+std::string
+Logger::Format(const LogRecordHeader& header, const unsigned char* args) {
+	std::string text;
+	const char* format = header.format;
+	for (uint8_t i = 0; i < header.argCount; ++i) {
+		const char* slot = std::strstr(format, "{}");
+		if (!slot) break;
+		text.append(format, slot);
+		format = slot + 2;
+
+		char number[32];
+		switch (*args) {
+		case LogDetail::kSigned: {
+			int64_t value;
+			std::memcpy(&value, args + 1, 8);
+			text += std::to_string(value);
+			args += 9;
+			break;
+		}
+		case LogDetail::kUnsigned: {
+			uint64_t value;
+			std::memcpy(&value, args + 1, 8);
+			text += std::to_string(value);
+			args += 9;
+			break;
+		}
+		case LogDetail::kReal: {
+			double value;
+			std::memcpy(&value, args + 1, 8);
+			std::snprintf(number, sizeof(number), "%g", value);
+			text += number;
+			args += 9;
+			break;
+		}
+		default: {
+			uint32_t length;
+			std::memcpy(&length, args + 1, 4);
+			text.append(reinterpret_cast<const char*>(args + 5), length);
+			args += 5 + length;
+			break;
+		}
+		}
+	}
+	text += format;
+	return text;
+}
+
+void
+Logger::Emit(const LogRecordHeader& header, uint32_t thread, const std::string& text) {
+	std::lock_guard<std::mutex> lock(m_sinkMutex);
+	if (!m_file.is_open()) {
+		// Consola: el texto tal cual; avisos y errores por la salida de error
+		if (header.level >= static_cast<uint8_t>(LogLevel::Warn)) std::cerr << text;
+		else std::cout << text;
+		return;
+	}
+
+	// Archivo: una línea por registro, sin los saltos de línea de los extremos
+	size_t begin = text.find_first_not_of('\n');
+	if (begin == std::string::npos) return;
+	size_t end = text.find_last_not_of('\n');
+	char stamp[32];
+	std::snprintf(stamp, sizeof(stamp), "%lld.%06lld",
+		static_cast<long long>(header.timeUs / 1000000), static_cast<long long>(header.timeUs % 1000000));
+	m_file << stamp << ' ' << LevelName(header.level) << " t" << thread << ' ';
+	for (size_t i = begin; i <= end; ++i) {
+		if (text[i] == '\n') m_file << "\\n";
+		else m_file << text[i];
+	}
+	m_file << '\n';
+}
@@ -0,0 +1,172 @@
+/**
+ * @file MemoryTransport.cpp
+ * @brief Implementación de las tuberías en memoria y del registro de nombres.
+ *
+ * @details
+ * Cada tubería es un anillo de capacidad fija: el emisor bloquea mientras está
+ * lleno y el receptor mientras está vacío. El cierre de cualquiera de los dos
+ * extremos marca ambas tuberías: el lector agota lo pendiente y ve fin de
+ * flujo, y el emisor recibe error en lugar de quedarse esperando espacio.
+ */
+
+#include "MemoryTransport.h"
+#include <algorithm>
+
+namespace {
+	/// Listeners publicados, por nombre.
+	std::mutex g_listenerMutex;
+	std::unordered_map<std::string, std::weak_ptr<MemoryListener>> g_listeners;
+}
+
+struct MemoryTransport::Pipe {
+	explicit Pipe(size_t capacity) : data(capacity) {}
+
+	std::mutex mutex;                    ///< Protege el anillo y el cierre.
+	std::condition_variable changed;     ///< Avisa de datos, espacio o cierre.
+	std::vector<unsigned char> data;     ///< Almacenamiento circular.
+	size_t head = 0;                     ///< Posición del próximo byte a leer.
+	size_t size = 0;                     ///< Bytes pendientes de leer.
+	bool closed = false;                 ///< Algún extremo cerró la conexión.
+};
+
+std::pair<std::shared_ptr<MemoryTransport>, std::shared_ptr<MemoryTransport>>
+MemoryTransport::CreatePair(size_t capacity) {
+	auto forward = std::make_shared<Pipe>(std::max<size_t>(capacity, 1));
+	auto backward = std::make_shared<Pipe>(std::max<size_t>(capacity, 1));
+	std::shared_ptr<MemoryTransport> a(new MemoryTransport(forward, backward));
+	std::shared_ptr<MemoryTransport> b(new MemoryTransport(backward, forward));
+	return { a, b };
+}
+
+std::shared_ptr<MemoryTransport>
+MemoryTransport::Connect(const std::string& name) {
+	std::shared_ptr<MemoryListener> listener;
+	{
+		std::lock_guard<std::mutex> lock(g_listenerMutex);
+		auto it = g_listeners.find(name);
+		if (it != g_listeners.end()) listener = it->second.lock();
+	}
+	if (!listener) return nullptr;
+
+	auto pair = CreatePair();
+	if (!listener->Enqueue(pair.second)) return nullptr;
+	return pair.first;
+}
+
+MemoryTransport::MemoryTransport(std::shared_ptr<Pipe> tx, std::shared_ptr<Pipe> rx)
+	: m_tx(std::move(tx)), m_rx(std::move(rx)) {
+}
+
+MemoryTransport::~MemoryTransport() {
+	Close();
+}
+
+int
+MemoryTransport::Send(const unsigned char* data, int len) {
+	if (len <= 0) return 0;
+	Pipe& pipe = *m_tx;
+	std::unique_lock<std::mutex> lock(pipe.mutex);
+	pipe.changed.wait(lock, [&pipe]() { return pipe.closed || pipe.size < pipe.data.size(); });
+	if (pipe.closed) return -1;
+
+	// Copia en dos tramos si el hueco libre da la vuelta al anillo
+	size_t capacity = pipe.data.size();
+	size_t n = std::min(static_cast<size_t>(len), capacity - pipe.size);
+	size_t tail = (pipe.head + pipe.size) % capacity;
+	size_t first = std::min(n, capacity - tail);
+	std::copy(data, data + first, pipe.data.begin() + tail);
+	std::copy(data + first, data + n, pipe.data.begin());
+	pipe.size += n;
+	pipe.changed.notify_all();
+	return static_cast<int>(n);
+}
+
+int
+MemoryTransport::Receive(unsigned char* out, int len) {
+	if (len <= 0) return 0;
+	Pipe& pipe = *m_rx;
+	std::unique_lock<std::mutex> lock(pipe.mutex);
+	pipe.changed.wait(lock, [&pipe]() { return pipe.closed || pipe.size > 0; });
+	if (pipe.size == 0) return 0; // cerrado y sin nada pendiente
+
+	size_t capacity = pipe.data.size();
+	size_t n = std::min(static_cast<size_t>(len), pipe.size);
+	size_t first = std::min(n, capacity - pipe.head);
+	std::copy(pipe.data.begin() + pipe.head, pipe.data.begin() + pipe.head + first, out);
+	std::copy(pipe.data.begin(), pipe.data.begin() + (n - first), out + first);
+	pipe.head = (pipe.head + n) % capacity;
+	pipe.size -= n;
+	pipe.changed.notify_all();
+	return static_cast<int>(n);
+}
+
+void
+MemoryTransport::Close() {
+	for (Pipe* pipe : { m_tx.get(), m_rx.get() }) {
+		std::lock_guard<std::mutex> lock(pipe->mutex);
+		pipe->closed = true;
+		pipe->changed.notify_all();
+	}
+}
+
+MemoryListener::MemoryListener(const std::string& name) : m_name(name) {}
+
+MemoryListener::~MemoryListener() {
+	Close();
+}
+
+std::shared_ptr<MemoryListener>
+MemoryListener::Create(const std::string& name) {
+	std::shared_ptr<MemoryListener> listener(new MemoryListener(name));
+	std::lock_guard<std::mutex> lock(g_listenerMutex);
+	auto it = g_listeners.find(name);
+	if (it != g_listeners.end() && !it->second.expired()) {
+		std::cerr << "Memory endpoint busy: " << name << std::endl;
+		return nullptr;
+	}
+	g_listeners[name] = listener;
+	return listener;
+}
+
+std::shared_ptr<MemoryTransport>
+MemoryListener::Accept() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_ready.wait(lock, [this]() { return m_closed || !m_pending.empty(); });
+	if (m_pending.empty()) return nullptr;
+	std::shared_ptr<MemoryTransport> server = std::move(m_pending.front());
+	m_pending.pop_front();
+	return server;
+}
+
+void
+MemoryListener::Close() {
+	{
+		std::lock_guard<std::mutex> lock(g_listenerMutex);
+		auto it = g_listeners.find(m_name);
+		// Solo se retira si sigue siendo este listener (o ya no vive ninguno)
+		if (it != g_listeners.end()) {
+			auto current = it->second.lock();
+			if (!current || current.get() == this) g_listeners.erase(it);
+		}
+	}
+	std::deque<std::shared_ptr<MemoryTransport>> pending;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_closed = true;
+		pending.swap(m_pending);
+	}
+	m_ready.notify_all();
+	// Los clientes sin aceptar ven fin de flujo
+	for (auto& server : pending) server->Close();
+}
+
+bool
+MemoryListener::Enqueue(std::shared_ptr<MemoryTransport> server) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_closed) return false;
+		m_pending.push_back(std::move(server));
+	}
+	m_ready.notify_one();
+	return true;
+}
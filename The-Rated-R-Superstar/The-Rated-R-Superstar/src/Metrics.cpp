@@ -0,0 +1,61 @@
+/**
+ * @file Metrics.cpp
+ * @brief Implementación de los histogramas por hilo y del formato de texto de Prometheus.
+ */
+
+#include "Metrics.h"
+
+void
+LatencyHistogram::Observe(std::chrono::nanoseconds duration) {
+	uint64_t ns = duration.count() > 0 ? static_cast<uint64_t>(duration.count()) : 0;
+	// Microsegundos redondeados hacia arriba: la cubeta i admite hasta 2^i µs
+	uint64_t us = (ns + 999) / 1000;
+	size_t index = 0;
+	while (index < kBuckets - 1 && (1ull << index) < us) {
+		++index;
+	}
+	m_buckets[index].store(m_buckets[index].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	m_sumNs.store(m_sumNs.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+}
+
+double
+LatencyHistogram::UpperBound(size_t index) {
+	if (index >= kBuckets - 1) return std::numeric_limits<double>::infinity();
+	return static_cast<double>(1ull << index) / 1e6;
+}
+
+void
+PrometheusText::Family(const char* name, const char* type, const char* help) {
+	m_out << "# HELP " << name << " " << help << "\n"
+		<< "# TYPE " << name << " " << type << "\n";
+}
+
+void
+PrometheusText::Sample(const char* name, const std::string& labels, uint64_t value) {
+	m_out << name;
+	if (!labels.empty()) m_out << "{" << labels << "}";
+	m_out << " " << value << "\n";
+}
+
+void
+PrometheusText::Sample(const char* name, const std::string& labels, double value) {
+	m_out << name;
+	if (!labels.empty()) m_out << "{" << labels << "}";
+	m_out << " " << value << "\n";
+}
+
+void
+PrometheusText::Histogram(const char* name, const std::string& labels, const LatencyHistogram& histogram) {
+	std::string prefix = labels.empty() ? "" : labels + ",";
+	uint64_t cumulative = 0;
+	for (size_t i = 0; i < LatencyHistogram::kBuckets; ++i) {
+		cumulative += histogram.Bucket(i);
+		m_out << name << "_bucket{" << prefix << "le=\"";
+		if (i == LatencyHistogram::kBuckets - 1) m_out << "+Inf";
+		else m_out << LatencyHistogram::UpperBound(i);
+		m_out << "\"} " << cumulative << "\n";
+	}
+	std::string braces = labels.empty() ? "" : "{" + labels + "}";
+	m_out << name << "_sum" << braces << " " << histogram.SumNanoseconds() / 1e9 << "\n"
+		<< name << "_count" << braces << " " << cumulative << "\n";
+}
@@ -1,20 +1,74 @@
 /**
  * @file NetworkHelper.cpp
- * @brief Implementacin de utilidades de red para cliente y servidor TCP.
+ * @brief Implementación de utilidades de red para cliente y servidor TCP.
  *
  * @details
- * Este mdulo gestiona:
- *  - Inicializacin y limpieza de Winsock.
- *  - Creacin de sockets TCP para servidor y cliente.
- *  - Inicio de servidor y aceptacin de conexiones entrantes.
- *  - Conexin a un servidor remoto.
- *  - Envo y recepcin de datos en formato texto y binario.
- *  - Funciones auxiliares para enviar y recibir tamaos exactos.
+ * Este módulo gestiona:
+ *  - Inicialización y limpieza de Winsock.
+ *  - Creación de sockets TCP para servidor y cliente.
+ *  - Inicio de servidor y aceptación de conexiones entrantes.
+ *  - Conexión a un servidor remoto (nombres, IPv4/IPv6 y Happy Eyeballs).
+ *  - Envío y recepción de datos en formato texto y binario.
+ *  - Funciones auxiliares para enviar y recibir tamaños exactos.
  *
- * @note Diseado para funcionar en Windows con la API de Winsock2.
+ * @note Diseñado para funcionar en Windows con la API de Winsock2.
  */
 
 #include "NetworkHelper.h"
+#include "Logger.h"
+#include "SharedMemoryTransport.h"
+#include "MemoryTransport.h"
+
+namespace {
+  /// Transportes no-socket indexados por su handle.
+  std::mutex g_transportMutex;
+  std::unordered_map<SOCKET, std::shared_ptr<Transport>> g_transports;
+  /// Permite saltarse el lock cuando no hay transportes registrados.
+  std::atomic<size_t> g_transportCount{ 0 };
+
+  const char kUnixScheme[] = "unix:";
+  const char kShmScheme[] = "shm:";
+  const char kMemScheme[] = "mem:";
+
+  /// Retardo entre intentos de conexión escalonados (RFC 8305).
+  const std::chrono::milliseconds kConnectStagger(250);
+  /// Espera máxima del intento con TCP Fast Open cuando hay otras direcciones de reserva.
+  const std::chrono::milliseconds kFastOpenBudget(1000);
+  /// Valor de TCP_FASTOPEN en el listener: booleano en Windows, longitud de cola en Linux.
+  const DWORD kFastOpenQueue = 256;
+
+  /// Orden RFC 8305: alternar familias empezando por IPv6.
+  std::vector<const AddressResolver::Endpoint*>
+  OrderEndpoints(const std::vector<AddressResolver::Endpoint>& endpoints) {
+    std::vector<const AddressResolver::Endpoint*> v6, v4, order;
+    for (const auto& ep : endpoints) (ep.family == AF_INET6 ? v6 : v4).push_back(&ep);
+    for (size_t i = 0; i < v6.size() || i < v4.size(); ++i) {
+      if (i < v6.size()) order.push_back(v6[i]);
+      if (i < v4.size()) order.push_back(v4[i]);
+    }
+    return order;
+  }
+
+  bool HasScheme(const std::string& address, const char* scheme) {
+    return address.compare(0, std::strlen(scheme), scheme) == 0;
+  }
+
+  /// send() o el transporte asociado al handle.
+  int RawSend(SOCKET s, const char* data, int len) {
+    if (auto t = NetworkHelper::FindTransport(s)) {
+      return t->Send(reinterpret_cast<const unsigned char*>(data), len);
+    }
+    return send(s, data, len, 0);
+  }
+
+  /// recv() o el transporte asociado al handle.
+  int RawRecv(SOCKET s, char* out, int len) {
+    if (auto t = NetworkHelper::FindTransport(s)) {
+      return t->Receive(reinterpret_cast<unsigned char*>(out), len);
+    }
+    return recv(s, out, len, 0);
+  }
+}
 
 NetworkHelper::NetworkHelper() : m_serverSocket(INVALID_SOCKET), m_initialized(false) {
   WSADATA wsaData;
@@ -29,7 +83,13 @@ NetworkHelper::NetworkHelper() : m_serverSocket(INVALID_SOCKET), m_initialized(f
 
 NetworkHelper::~NetworkHelper() {
   if (m_serverSocket != INVALID_SOCKET) {
-    closesocket(m_serverSocket);
+    close(m_serverSocket);
+  }
+  if (m_shmListener) {
+    m_shmListener->Close();
+  }
+  if (m_memListener) {
+    m_memListener->Close();
   }
 
   if (m_initialized) {
@@ -38,22 +98,62 @@ NetworkHelper::~NetworkHelper() {
 }
 
 bool 
-NetworkHelper::StartServer(int port) {
-  // Crea el socket TCP
-	m_serverSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+NetworkHelper::StartServer(int port, bool reusePort) {
+  // Crea el socket TCP: doble pila (IPv6 + IPv4 mapeado) si el sistema lo permite
+  bool dualStack = true;
+	m_serverSocket = socket(AF_INET6, SOCK_STREAM, IPPROTO_TCP);
+  if (m_serverSocket != INVALID_SOCKET) {
+    int off = 0;
+    if (setsockopt(m_serverSocket, IPPROTO_IPV6, IPV6_V6ONLY, (const char*)&off, sizeof(off)) == SOCKET_ERROR) {
+      closesocket(m_serverSocket);
+      m_serverSocket = INVALID_SOCKET;
+    }
+  }
+  if (m_serverSocket == INVALID_SOCKET) {
+    dualStack = false;
+    m_serverSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  }
   if (m_serverSocket == INVALID_SOCKET) {
     std::cerr << "Error creating socket: " << WSAGetLastError() << std::endl;
     return false;
 	}
 
-  // Configura la direccin del servidor (IPv4, cualquier IP local, puerto dado)
-  sockaddr_in serverAddress{};
-	serverAddress.sin_family = AF_INET;
-	serverAddress.sin_port = htons(port);
-	serverAddress.sin_addr.s_addr = INADDR_ANY;
+#ifdef SO_REUSEPORT
+  // Cada shard abre su propio listener; el kernel reparte las conexiones entre ellos
+  if (reusePort) {
+    int on = 1;
+    setsockopt(m_serverSocket, SOL_SOCKET, SO_REUSEPORT, (const char*)&on, sizeof(on));
+  }
+#else
+  (void)reusePort;
+#endif
 
-	// Asocia el socket a la direccin y puerto
-  if (bind(m_serverSocket, (sockaddr*)&serverAddress, sizeof(serverAddress)) == SOCKET_ERROR) {
+  // TCP Fast Open: acepta datos en el SYN de clientes con cookie válida
+  if (m_fastOpen &&
+      setsockopt(m_serverSocket, IPPROTO_TCP, TCP_FASTOPEN, (const char*)&kFastOpenQueue, sizeof(kFastOpenQueue)) == SOCKET_ERROR) {
+    std::cerr << "TCP Fast Open not available on listener: " << WSAGetLastError() << std::endl;
+  }
+
+  // Configura la dirección del servidor (cualquier IP local, puerto dado)
+  sockaddr_storage serverAddress{};
+  int addressLen = 0;
+  if (dualStack) {
+    sockaddr_in6* addr6 = (sockaddr_in6*)&serverAddress;
+    addr6->sin6_family = AF_INET6;
+    addr6->sin6_port = htons(port);
+    addr6->sin6_addr = in6addr_any;
+    addressLen = sizeof(sockaddr_in6);
+  }
+  else {
+    sockaddr_in* addr4 = (sockaddr_in*)&serverAddress;
+    addr4->sin_family = AF_INET;
+    addr4->sin_port = htons(port);
+    addr4->sin_addr.s_addr = INADDR_ANY;
+    addressLen = sizeof(sockaddr_in);
+  }
+
+	// Asocia el socket a la dirección y puerto
+  if (bind(m_serverSocket, (sockaddr*)&serverAddress, addressLen) == SOCKET_ERROR) {
     std::cerr << "Error binding socket: " << WSAGetLastError() << std::endl;
     closesocket(m_serverSocket);
     m_serverSocket = INVALID_SOCKET;
@@ -72,8 +172,67 @@ NetworkHelper::StartServer(int port) {
   return true;
 }
 
-SOCKET 
+bool
+NetworkHelper::SupportsReusePort() {
+#ifdef SO_REUSEPORT
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool
+NetworkHelper::StartServer(const std::string& address) {
+  if (HasScheme(address, kUnixScheme)) {
+    m_serverSocket = ListenUnix(address.substr(std::strlen(kUnixScheme)));
+    if (m_serverSocket == INVALID_SOCKET) return false;
+    std::cout << "Server started on " << address << std::endl;
+    return true;
+  }
+  if (HasScheme(address, kShmScheme)) {
+    m_shmListener = SharedMemoryTransport::Create(address.substr(std::strlen(kShmScheme)));
+    if (!m_shmListener) return false;
+    std::cout << "Server started on " << address << std::endl;
+    return true;
+  }
+  if (HasScheme(address, kMemScheme)) {
+    m_memListener = MemoryListener::Create(address.substr(std::strlen(kMemScheme)));
+    if (!m_memListener) return false;
+    std::cout << "Server started on " << address << std::endl;
+    return true;
+  }
+  return StartServer(std::stoi(address));
+}
+
+bool
+NetworkHelper::IsLocalAddress(const std::string& address) {
+  return HasScheme(address, kUnixScheme) || HasScheme(address, kShmScheme) || HasScheme(address, kMemScheme);
+}
+
+SOCKET
 NetworkHelper::AcceptClient() {
+  SOCKET s = AcceptDirect();
+  if (s == INVALID_SOCKET || !m_conditions.Active()) return s;
+  return Shape(s, m_conditions);
+}
+
+SOCKET
+NetworkHelper::AcceptDirect() {
+  // Memoria compartida: una única conexión por región
+  if (m_shmListener) {
+    std::shared_ptr<SharedMemoryTransport> listener = std::move(m_shmListener);
+    if (!listener->WaitForPeer()) return INVALID_SOCKET;
+    std::cout << "Client connected." << std::endl;
+    return RegisterTransport(listener);
+  }
+  // Memoria del proceso: el listener sigue publicado para los siguientes clientes
+  if (m_memListener) {
+    std::shared_ptr<MemoryTransport> transport = m_memListener->Accept();
+    if (!transport) return INVALID_SOCKET;
+    std::cout << "Client connected." << std::endl;
+    return RegisterTransport(transport);
+  }
+
 	SOCKET clientSocket = accept(m_serverSocket, nullptr, nullptr);
 	if (clientSocket == INVALID_SOCKET) {
 		std::cerr << "Error accepting client: " << WSAGetLastError() << std::endl;
@@ -85,33 +244,262 @@ NetworkHelper::AcceptClient() {
 
 bool 
 NetworkHelper::ConnectToServer(const std::string& ip, int port) {
-  // Crea el socket TCP
-	m_serverSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-  if (m_serverSocket == INVALID_SOCKET) {
-    std::cerr << "Error creating socket: " << WSAGetLastError() << std::endl;
+  return ConnectToServer(ip, port, {});
+}
+
+bool
+NetworkHelper::ConnectToServer(const std::string& ip, int port, const std::vector<unsigned char>& earlyData) {
+  if (!m_conditions.Active()) return ConnectDirect(ip, port, earlyData);
+  // Enlace emulado: los datos iniciales también pasan por él (sin TCP Fast Open)
+  if (!ConnectDirect(ip, port, {})) return false;
+  m_serverSocket = Shape(m_serverSocket, m_conditions);
+  if (m_serverSocket == INVALID_SOCKET) return false;
+  return earlyData.empty() || SendData(m_serverSocket, earlyData);
+}
+
+bool
+NetworkHelper::ConnectDirect(const std::string& ip, int port, const std::vector<unsigned char>& earlyData) {
+  // Transportes locales seleccionados por esquema
+  if (HasScheme(ip, kUnixScheme)) {
+    m_serverSocket = ConnectUnix(ip.substr(std::strlen(kUnixScheme)));
+    if (m_serverSocket == INVALID_SOCKET) return false;
+    Logger::Debug("Connected to server at {}\n", ip);
+    return earlyData.empty() || SendData(m_serverSocket, earlyData);
+  }
+  if (HasScheme(ip, kShmScheme)) {
+    auto transport = SharedMemoryTransport::Open(ip.substr(std::strlen(kShmScheme)));
+    if (!transport) return false;
+    m_serverSocket = RegisterTransport(transport);
+    if (m_serverSocket == INVALID_SOCKET) return false;
+    Logger::Debug("Connected to server at {}\n", ip);
+    return earlyData.empty() || SendData(m_serverSocket, earlyData);
+  }
+  if (HasScheme(ip, kMemScheme)) {
+    auto transport = MemoryTransport::Connect(ip.substr(std::strlen(kMemScheme)));
+    if (!transport) {
+      std::cerr << "No in-process server at " << ip << std::endl;
+      return false;
+    }
+    m_serverSocket = RegisterTransport(transport);
+    if (m_serverSocket == INVALID_SOCKET) return false;
+    Logger::Debug("Connected to server at {}\n", ip);
+    return earlyData.empty() || SendData(m_serverSocket, earlyData);
+  }
+
+  // Resolución fuera de este hilo (nombres, IPv4 e IPv6), con caché y tope de espera
+  auto deadline = std::chrono::steady_clock::now() + m_connectTimeout;
+  std::vector<AddressResolver::Endpoint> endpoints =
+    AddressResolver::Instance().Resolve(ip, port, m_connectTimeout);
+  if (endpoints.empty()) {
+    std::cerr << "Could not resolve server address: " << ip << std::endl;
     return false;
   }
-	
-  // Configura la direccin del servidor (IPv4, IP dada, puerto dado)
-	sockaddr_in serverAddress{};
-	serverAddress.sin_family = AF_INET;
-	serverAddress.sin_port = htons(port);
-	inet_pton(AF_INET, ip.c_str(), &serverAddress.sin_addr);
-	
-  // Conecta al servidor
-  if (connect(m_serverSocket, (sockaddr*)&serverAddress, sizeof(serverAddress)) == SOCKET_ERROR) {
-    std::cerr << "Error connecting to server: " << WSAGetLastError() << std::endl;
-    closesocket(m_serverSocket);
-    m_serverSocket = INVALID_SOCKET;
+
+  // TCP Fast Open: los primeros datos viajan en el SYN hacia la dirección preferida
+  if (m_fastOpen && !earlyData.empty()) {
+    auto budget = (std::min)(deadline, std::chrono::steady_clock::now() + kFastOpenBudget);
+    m_serverSocket = ConnectFastOpen(*OrderEndpoints(endpoints).front(), earlyData,
+                                     endpoints.size() == 1 ? deadline : budget);
+    if (m_serverSocket != INVALID_SOCKET) {
+      Logger::Debug("Connected to server at {}:{} (TCP Fast Open)\n", ip, port);
+      return true;
+    }
+    std::cerr << "TCP Fast Open failed, falling back to regular connect" << std::endl;
+  }
+
+  // Conecta al servidor probando las direcciones en paralelo escalonado
+  m_serverSocket = ConnectHappyEyeballs(endpoints, deadline);
+  if (m_serverSocket == INVALID_SOCKET) {
+    std::cerr << "Error connecting to server " << ip << ":" << port << std::endl;
     return false;
   }
-	std::cout << "Connected to server at " << ip << ":" << port << std::endl;
-	return true;
+	Logger::Debug("Connected to server at {}:{}\n", ip, port);
+  return earlyData.empty() || SendData(m_serverSocket, earlyData);
+}
+
+void
+NetworkHelper::EnableFastOpen(bool enabled) {
+  m_fastOpen = enabled;
+}
+
+SOCKET
+NetworkHelper::ConnectFastOpen(const AddressResolver::Endpoint& endpoint,
+                               const std::vector<unsigned char>& earlyData,
+                               std::chrono::steady_clock::time_point deadline) {
+  SOCKET s = socket(endpoint.family, SOCK_STREAM, IPPROTO_TCP);
+  if (s == INVALID_SOCKET) return INVALID_SOCKET;
+
+  // TFO se activa antes de conectar; falla en sistemas sin soporte
+  DWORD on = 1;
+  if (setsockopt(s, IPPROTO_TCP, TCP_FASTOPEN, (const char*)&on, sizeof(on)) == SOCKET_ERROR) {
+    closesocket(s);
+    return INVALID_SOCKET;
+  }
+
+  // ConnectEx exige un socket asociado a una dirección local
+  sockaddr_storage local{};
+  local.ss_family = static_cast<decltype(local.ss_family)>(endpoint.family);
+  int localLen = endpoint.family == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+  LPFN_CONNECTEX connectEx = nullptr;
+  GUID guid = WSAID_CONNECTEX;
+  DWORD bytes = 0;
+  if (bind(s, (sockaddr*)&local, localLen) == SOCKET_ERROR ||
+      WSAIoctl(s, SIO_GET_EXTENSION_FUNCTION_POINTER, &guid, sizeof(guid),
+               &connectEx, sizeof(connectEx), &bytes, nullptr, nullptr) == SOCKET_ERROR) {
+    closesocket(s);
+    return INVALID_SOCKET;
+  }
+
+  // Sin cookie, el sistema completa el handshake normal y envía los datos después
+  OVERLAPPED overlapped{};
+  overlapped.hEvent = WSACreateEvent();
+  DWORD sent = 0;
+  BOOL ok = connectEx(s, (const sockaddr*)&endpoint.addr, endpoint.addrLen,
+                      (void*)earlyData.data(), static_cast<DWORD>(earlyData.size()), &sent, &overlapped);
+  if (!ok && WSAGetLastError() == WSA_IO_PENDING) {
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+      deadline - std::chrono::steady_clock::now()).count();
+    DWORD flags = 0;
+    if (WSAWaitForMultipleEvents(1, &overlapped.hEvent, TRUE,
+                                 static_cast<DWORD>(remaining > 0 ? remaining : 0), FALSE) == WSA_WAIT_TIMEOUT) {
+      // Cancelar y esperar a que la operación suelte el OVERLAPPED
+      CancelIoEx((HANDLE)s, &overlapped);
+      WSAGetOverlappedResult(s, &overlapped, &sent, TRUE, &flags);
+      ok = FALSE;
+    }
+    else {
+      ok = WSAGetOverlappedResult(s, &overlapped, &sent, FALSE, &flags);
+    }
+  }
+  WSACloseEvent(overlapped.hEvent);
+
+  if (!ok || setsockopt(s, SOL_SOCKET, SO_UPDATE_CONNECT_CONTEXT, nullptr, 0) == SOCKET_ERROR) {
+    closesocket(s);
+    return INVALID_SOCKET;
+  }
+
+  // ConnectEx puede enviar solo una parte del buffer inicial
+  if (sent < earlyData.size() &&
+      !SendAll(s, earlyData.data() + sent, static_cast<int>(earlyData.size() - sent))) {
+    closesocket(s);
+    return INVALID_SOCKET;
+  }
+  return s;
+}
+
+void
+NetworkHelper::SetConnectTimeout(std::chrono::milliseconds timeout) {
+  m_connectTimeout = timeout;
+}
+
+void
+NetworkHelper::SetNetworkConditions(const NetworkConditions& conditions) {
+  m_conditions = conditions;
+}
+
+bool
+NetworkHelper::StartCapture(const std::string& path, TrafficCapture::Role role) {
+  m_capture = TrafficRecorder::Create(path, role);
+  return m_capture != nullptr;
+}
+
+void
+NetworkHelper::StopCapture() {
+  m_capture.reset();
+}
+
+SOCKET
+NetworkHelper::ConnectHappyEyeballs(const std::vector<AddressResolver::Endpoint>& endpoints,
+                                    std::chrono::steady_clock::time_point deadline) {
+  std::vector<const AddressResolver::Endpoint*> order = OrderEndpoints(endpoints);
+
+  std::vector<SOCKET> pending;
+  auto closePending = [&pending](SOCKET keep) {
+    for (SOCKET s : pending) if (s != keep) closesocket(s);
+    pending.clear();
+  };
+
+  size_t next = 0;
+  auto nextStart = std::chrono::steady_clock::now();
+  while (true) {
+    auto now = std::chrono::steady_clock::now();
+    if (now >= deadline) {
+      std::cerr << "Connect timeout" << std::endl;
+      closePending(INVALID_SOCKET);
+      return INVALID_SOCKET;
+    }
+
+    // 1) Lanzar el siguiente intento si no hay ninguno vivo o venció el escalonado
+    if (next < order.size() && (pending.empty() || now >= nextStart)) {
+      const AddressResolver::Endpoint* ep = order[next++];
+      nextStart = now + kConnectStagger;
+
+      SOCKET s = socket(ep->family, SOCK_STREAM, IPPROTO_TCP);
+      if (s == INVALID_SOCKET) continue;
+      SetNonBlocking(s, true);
+      if (connect(s, (const sockaddr*)&ep->addr, ep->addrLen) == 0) {
+        closePending(INVALID_SOCKET);
+        SetNonBlocking(s, false);
+        return s;
+      }
+      int err = WSAGetLastError();
+      if (err != WSAEWOULDBLOCK && err != WSAEINPROGRESS) {
+        closesocket(s);
+        nextStart = now; // fallo inmediato: no esperar al escalonado
+        continue;
+      }
+      pending.push_back(s);
+      continue;
+    }
+    if (pending.empty()) {
+      // Todas las direcciones fallaron
+      return INVALID_SOCKET;
+    }
+
+    // 2) Esperar a que algún intento termine (o al siguiente escalonado)
+    auto wakeAt = (next < order.size()) ? (std::min)(nextStart, deadline) : deadline;
+    auto waitUs = std::chrono::duration_cast<std::chrono::microseconds>(wakeAt - now).count();
+    timeval tv{};
+    tv.tv_sec = static_cast<long>(waitUs / 1000000);
+    tv.tv_usec = static_cast<long>(waitUs % 1000000);
+
+    fd_set writable, failed;
+    FD_ZERO(&writable);
+    FD_ZERO(&failed);
+    SOCKET maxFd = 0;
+    for (SOCKET s : pending) {
+      FD_SET(s, &writable);
+      FD_SET(s, &failed);
+      maxFd = (std::max)(maxFd, s);
+    }
+    if (select(static_cast<int>(maxFd + 1), nullptr, &writable, &failed, &tv) == SOCKET_ERROR) {
+      closePending(INVALID_SOCKET);
+      return INVALID_SOCKET;
+    }
+
+    // 3) Gana el primero en completar; los fallidos adelantan el siguiente intento
+    for (size_t i = 0; i < pending.size();) {
+      SOCKET s = pending[i];
+      if (!FD_ISSET(s, &writable) && !FD_ISSET(s, &failed)) { ++i; continue; }
+
+      int soError = 0;
+      socklen_t optLen = sizeof(soError);
+      getsockopt(s, SOL_SOCKET, SO_ERROR, (char*)&soError, &optLen);
+      if (soError == 0 && FD_ISSET(s, &writable)) {
+        closePending(s);
+        SetNonBlocking(s, false);
+        return s;
+      }
+      closesocket(s);
+      pending.erase(pending.begin() + i);
+      nextStart = std::chrono::steady_clock::now();
+    }
+  }
 }
 
 bool 
 NetworkHelper::SendData(SOCKET socket, const std::string& data) {
-  return send(socket, data.c_str(), static_cast<int>(data.size()), 0) != SOCKET_ERROR;
+  return SendAll(socket, reinterpret_cast<const unsigned char*>(data.data()), static_cast<int>(data.size()));
 }
 
 bool 
@@ -122,7 +510,8 @@ NetworkHelper::SendData(SOCKET socket, const std::vector<unsigned char>& data) {
 std::string
 NetworkHelper::ReceiveData(SOCKET socket) {
 	char buffer[4096] = {};
-	int len = recv(socket, buffer, sizeof(buffer), 0);
+	int len = RawRecv(socket, buffer, sizeof(buffer));
+  if (len <= 0) return {};
 
   return std::string(buffer, len);
 }
@@ -134,16 +523,94 @@ NetworkHelper::ReceiveDataBinary(SOCKET socket, int size) {
   return buf;
 }
 
+bool
+NetworkHelper::SendFrame(SOCKET socket, const Frame& frame) {
+  std::vector<unsigned char> bytes = frame.Encode();
+  if (!SendAll(socket, bytes.data(), static_cast<int>(bytes.size()))) return false;
+  FrameHeader header;
+  if (m_capture && Frame::ParseHeader(bytes.data(), bytes.size(), header)) {
+    m_capture->Record(socket, false, header, bytes[0], bytes.data() + header.headerSize);
+  }
+  return true;
+}
+
+bool
+NetworkHelper::ReceiveFrame(SOCKET socket, Frame& out) {
+  unsigned char header[Frame::kMaxHeaderSize];
+  if (!ReceiveExact(socket, header, Frame::kHeaderSize)) return false;
+
+  // Frame enrutado o sellado: faltan la ruta y/o el sello
+  size_t headerSize = Frame::HeaderSize(Frame::GetU32(header + Frame::kIvSize));
+  if (headerSize > Frame::kHeaderSize &&
+      !ReceiveExact(socket, header + Frame::kHeaderSize, static_cast<int>(headerSize - Frame::kHeaderSize))) {
+    return false;
+  }
+  FrameHeader parsed;
+  if (!Frame::ParseHeader(header, headerSize, parsed)) return false;
+  if (parsed.length > Frame::kMaxPayload) {
+    Logger::Warn("Frame too large: {}\n", parsed.length);
+    return false;
+  }
+
+  out.iv.assign(header, header + Frame::kIvSize);
+  out.flags = parsed.flags;
+  out.dst = parsed.dst;
+  out.src = parsed.src;
+  out.sequence = parsed.sequence;
+  out.sentAtUs = parsed.sentAtUs;
+  out.payload.resize(parsed.length);
+  if (parsed.length > 0 && !ReceiveExact(socket, out.payload.data(), static_cast<int>(parsed.length))) return false;
+  if (m_capture) m_capture->Record(socket, true, parsed, header[0], out.payload.data());
+  return true;
+}
+
+std::string
+NetworkHelper::ReceiveUntil(SOCKET socket, const std::string& delimiter, size_t maxLen) {
+  std::string out;
+  bool isTransport = FindTransport(socket) != nullptr;
+  char buffer[4096];
+  while (out.size() < maxLen) {
+    // Sockets: mirar sin consumir; transportes: byte a byte (no admiten MSG_PEEK)
+    int want = static_cast<int>((std::min)(sizeof(buffer), maxLen - out.size()));
+    int n = isTransport ? RawRecv(socket, buffer, 1) : recv(socket, buffer, want, MSG_PEEK);
+    if (n <= 0) return {};
+
+    // El delimitador puede empezar en lo ya acumulado
+    size_t from = out.size() >= delimiter.size() ? out.size() - delimiter.size() + 1 : 0;
+    std::string view = out + std::string(buffer, n);
+    size_t pos = view.find(delimiter, from);
+    size_t take = (pos == std::string::npos) ? n : pos + delimiter.size() - out.size();
+
+    if (!isTransport && !ReceiveExact(socket, (unsigned char*)buffer, static_cast<int>(take))) return {};
+    out.append(buffer, take);
+    if (pos != std::string::npos) return out;
+  }
+  return {};
+}
+
 void 
 NetworkHelper::close(SOCKET socket) {
+  if (m_capture) m_capture->Forget(socket);
+  if (auto t = UnregisterTransport(socket)) {
+    t->Close();
+  }
 	closesocket(socket);
 }
 
+void
+NetworkHelper::Shutdown(SOCKET socket) {
+  if (auto t = FindTransport(socket)) {
+    t->Close();
+    return;
+  }
+  shutdown(socket, SD_BOTH);
+}
+
 bool 
 NetworkHelper::SendAll(SOCKET s, const unsigned char* data, int len) {
   int sent = 0;
   while (sent < len) {
-    int n = send(s, (const char*)data + sent, len - sent, 0);
+    int n = RawSend(s, (const char*)data + sent, len - sent);
     if (n == SOCKET_ERROR) return false;
     sent += n;
   }
@@ -154,9 +621,156 @@ bool
 NetworkHelper::ReceiveExact(SOCKET s, unsigned char* out, int len) {
   int recvd = 0;
   while (recvd < len) {
-    int n = recv(s, (char*)out + recvd, len - recvd, 0);
+    int n = RawRecv(s, (char*)out + recvd, len - recvd);
     if (n <= 0) return false;
     recvd += n;
   }
   return true;
 }
+
+bool
+NetworkHelper::SetNonBlocking(SOCKET s, bool enabled) {
+  u_long mode = enabled ? 1 : 0;
+  return ioctlsocket(s, FIONBIO, &mode) == 0;
+}
+
+bool
+NetworkHelper::CreateSocketPair(SOCKET& a, SOCKET& b) {
+  a = b = INVALID_SOCKET;
+
+  // Listener efímero en loopback (puerto asignado por el sistema)
+  SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (listener == INVALID_SOCKET) return false;
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  socklen_t addrLen = sizeof(addr);
+  if (bind(listener, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+      getsockname(listener, (sockaddr*)&addr, &addrLen) == SOCKET_ERROR ||
+      listen(listener, 1) == SOCKET_ERROR) {
+    closesocket(listener);
+    return false;
+  }
+
+  a = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (a == INVALID_SOCKET ||
+      connect(a, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+    if (a != INVALID_SOCKET) closesocket(a);
+    a = INVALID_SOCKET;
+    closesocket(listener);
+    return false;
+  }
+
+  b = accept(listener, nullptr, nullptr);
+  closesocket(listener);
+  if (b == INVALID_SOCKET) {
+    closesocket(a);
+    a = INVALID_SOCKET;
+    return false;
+  }
+
+  // Los mensajes de despertar son de 1 byte: sin Nagle
+  int on = 1;
+  setsockopt(a, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+  setsockopt(b, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+  return true;
+}
+
+SOCKET
+NetworkHelper::ListenUnix(const std::string& path) {
+  sockaddr_un addr{};
+  if (path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "Unix socket path too long: " << path << std::endl;
+    return INVALID_SOCKET;
+  }
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, path.c_str(), path.size());
+
+  SOCKET s = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (s == INVALID_SOCKET) {
+    std::cerr << "Error creating unix socket: " << WSAGetLastError() << std::endl;
+    return INVALID_SOCKET;
+  }
+
+  // Un socket anterior con la misma ruta impediría el bind
+  std::remove(path.c_str());
+  if (bind(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+      listen(s, SOMAXCONN) == SOCKET_ERROR) {
+    std::cerr << "Error listening on unix socket " << path << ": " << WSAGetLastError() << std::endl;
+    closesocket(s);
+    return INVALID_SOCKET;
+  }
+  return s;
+}
+
+SOCKET
+NetworkHelper::ConnectUnix(const std::string& path) {
+  sockaddr_un addr{};
+  if (path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "Unix socket path too long: " << path << std::endl;
+    return INVALID_SOCKET;
+  }
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, path.c_str(), path.size());
+
+  SOCKET s = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (s == INVALID_SOCKET) {
+    std::cerr << "Error creating unix socket: " << WSAGetLastError() << std::endl;
+    return INVALID_SOCKET;
+  }
+  if (connect(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+    std::cerr << "Error connecting to unix socket " << path << ": " << WSAGetLastError() << std::endl;
+    closesocket(s);
+    return INVALID_SOCKET;
+  }
+  return s;
+}
+
+SOCKET
+NetworkHelper::RegisterTransport(std::shared_ptr<Transport> transport) {
+  // El socket sin conectar solo reserva un valor de handle único
+  SOCKET handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (handle == INVALID_SOCKET) {
+    std::cerr << "Error reserving transport handle: " << WSAGetLastError() << std::endl;
+    return INVALID_SOCKET;
+  }
+  std::lock_guard<std::mutex> lock(g_transportMutex);
+  g_transports[handle] = std::move(transport);
+  g_transportCount.store(g_transports.size(), std::memory_order_release);
+  return handle;
+}
+
+std::shared_ptr<Transport>
+NetworkHelper::FindTransport(SOCKET s) {
+  if (g_transportCount.load(std::memory_order_acquire) == 0) return nullptr;
+  std::lock_guard<std::mutex> lock(g_transportMutex);
+  auto it = g_transports.find(s);
+  return it != g_transports.end() ? it->second : nullptr;
+}
+
+SOCKET
+NetworkHelper::Shape(SOCKET s, const NetworkConditions& conditions) {
+  std::shared_ptr<Transport> shaped;
+  if (auto inner = UnregisterTransport(s)) {
+    closesocket(s); // el handle reservado deja paso al nuevo
+    shaped = std::make_shared<ShapedTransport>(inner, conditions);
+  }
+  else {
+    shaped = ShapedTransport::ForSocket(s, conditions);
+  }
+  return RegisterTransport(shaped);
+}
+
+std::shared_ptr<Transport>
+NetworkHelper::UnregisterTransport(SOCKET s) {
+  if (g_transportCount.load(std::memory_order_acquire) == 0) return nullptr;
+  std::lock_guard<std::mutex> lock(g_transportMutex);
+  auto it = g_transports.find(s);
+  if (it == g_transports.end()) return nullptr;
+  std::shared_ptr<Transport> t = std::move(it->second);
+  g_transports.erase(it);
+  g_transportCount.store(g_transports.size(), std::memory_order_release);
+  return t;
+}
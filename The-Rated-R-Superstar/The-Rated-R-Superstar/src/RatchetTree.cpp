@@ -0,0 +1,465 @@
+/**
+ * @file RatchetTree.cpp
+ * @brief Implementación del árbol de claves de grupo.
+ *
+ * @details
+ * Formatos (enteros en big-endian, blobs con tamaño de 4 bytes):
+ *
+ * Commit: época base (4) | hoja del emisor (4) | hojas (4) |
+ * nBajas (4) x hoja (4) | nAltas (4) x [hoja (4) | usuario (4) | blob clave] |
+ * nCamino (4) x blob clave (hoja del emisor y sus padres, de abajo arriba) |
+ * por cada padre: nSellados (4) x [nodo (4) | blob sellado].
+ *
+ * Welcome: época (4) | hojas (4) | por nodo: blob clave (vacío si en blanco)
+ * y, en las hojas, usuario (4) | ancestro común (4) | blob sellado.
+ *
+ * Derivaciones (HKDF-SHA256): secreto del padre = D(secreto, "path"),
+ * clave privada del nodo = D(secreto, "node"), clave de época =
+ * D(secreto de la raíz, "epoch <n>").
+ */
+
+#include "RatchetTree.h"
+#include "CryptoHelper.h"
+#include "openssl/rand.h"
+#include "openssl/crypto.h"
+
+namespace {
+	/// Tamaño de los secretos de camino y de hoja.
+	const size_t kSecretSize = 32;
+	/// Límite de hojas aceptado de un mensaje remoto.
+	const uint32_t kMaxLeaves = 1u << 20;
+	/// Índice de nodo inexistente.
+	const uint32_t kNoNode = 0xFFFFFFFFu;
+
+	void PutU32(std::vector<unsigned char>& out, uint32_t v) {
+		for (int shift = 24; shift >= 0; shift -= 8) out.push_back(static_cast<unsigned char>(v >> shift));
+	}
+
+	void PutBlob(std::vector<unsigned char>& out, const std::vector<unsigned char>& data) {
+		PutU32(out, static_cast<uint32_t>(data.size()));
+		out.insert(out.end(), data.begin(), data.end());
+	}
+
+	uint32_t GetU32(const unsigned char* p) {
+		return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+	}
+
+	/// Lector secuencial con comprobación de límites.
+	struct Reader {
+		const std::vector<unsigned char>& buf;
+		size_t pos = 0;
+
+		bool U32(uint32_t& v) {
+			if (buf.size() - pos < 4) return false;
+			v = GetU32(buf.data() + pos);
+			pos += 4;
+			return true;
+		}
+
+		bool AtEnd() const { return pos == buf.size(); }
+
+		bool Blob(std::vector<unsigned char>& out) {
+			if (buf.size() - pos < 4) return false;
+			uint32_t len = GetU32(buf.data() + pos);
+			pos += 4;
+			if (buf.size() - pos < len) return false;
+			out.assign(buf.begin() + pos, buf.begin() + pos + len);
+			pos += len;
+			return true;
+		}
+	};
+
+	bool IsPowerOfTwo(uint32_t v) {
+		return v != 0 && (v & (v - 1)) == 0;
+	}
+}
+
+std::vector<unsigned char>
+RatchetTree::NewLeafSecret() {
+	std::vector<unsigned char> secret(kSecretSize);
+	if (RAND_bytes(secret.data(), static_cast<int>(secret.size())) != 1) {
+		throw std::runtime_error("Failed to generate leaf secret.");
+	}
+	return secret;
+}
+
+void
+RatchetTree::Create(uint32_t userId, const std::vector<unsigned char>& leafSecret) {
+	m_nodes.assign(1, Node{});
+	m_leafCount = 1;
+	m_userId = userId;
+	m_epoch = 0;
+	m_nodes[0].userId = userId;
+	m_nodes[0].secret = leafSecret;
+	m_nodes[0].publicKey = CryptoHelper::NodePublicKey(leafSecret);
+	// La hoja es la raíz: un secreto de camino aleatorio da la clave de la época 0
+	m_nodes[0].pathSecret = NewLeafSecret();
+	FinishEpoch();
+}
+
+uint32_t
+RatchetTree::Level(uint32_t node) {
+	uint32_t level = 0;
+	while (node & 1) {
+		node >>= 1;
+		level++;
+	}
+	return level;
+}
+
+uint32_t
+RatchetTree::Parent(uint32_t node) const {
+	uint32_t level = Level(node);
+	uint32_t bit = (node >> (level + 1)) & 1;
+	return (node | (1u << level)) ^ (bit << (level + 1));
+}
+
+uint32_t
+RatchetTree::Left(uint32_t node) {
+	return node ^ (1u << (Level(node) - 1));
+}
+
+uint32_t
+RatchetTree::Right(uint32_t node) {
+	return node ^ (3u << (Level(node) - 1));
+}
+
+uint32_t
+RatchetTree::Sibling(uint32_t node) const {
+	uint32_t parent = Parent(node);
+	return node < parent ? Right(parent) : Left(parent);
+}
+
+bool
+RatchetTree::InSubtree(uint32_t node, uint32_t leafNode) {
+	uint32_t span = (1u << Level(node)) - 1;
+	return leafNode + span >= node && leafNode <= node + span;
+}
+
+std::vector<uint32_t>
+RatchetTree::DirectPath(uint32_t leafNode) const {
+	std::vector<uint32_t> path;
+	for (uint32_t node = leafNode; node != Root(); ) {
+		node = Parent(node);
+		path.push_back(node);
+	}
+	return path;
+}
+
+void
+RatchetTree::Resolution(uint32_t node, std::vector<uint32_t>& out) const {
+	if (!m_nodes[node].publicKey.empty()) {
+		out.push_back(node);
+		return;
+	}
+	if (Level(node) == 0) return;
+	Resolution(Left(node), out);
+	Resolution(Right(node), out);
+}
+
+uint32_t
+RatchetTree::FindLeaf(uint32_t userId) const {
+	if (userId == 0) return kNoNode;
+	for (uint32_t leaf = 0; leaf < m_nodes.size(); leaf += 2) {
+		if (m_nodes[leaf].userId == userId) return leaf;
+	}
+	return kNoNode;
+}
+
+bool
+RatchetTree::Contains(uint32_t userId) const {
+	return FindLeaf(userId) != kNoNode;
+}
+
+size_t
+RatchetTree::MemberCount() const {
+	size_t count = 0;
+	for (uint32_t leaf = 0; leaf < m_nodes.size(); leaf += 2) {
+		if (m_nodes[leaf].userId != 0) count++;
+	}
+	return count;
+}
+
+uint32_t
+RatchetTree::CommitEpoch(const std::vector<unsigned char>& commit) {
+	return commit.size() < 4 ? 0 : GetU32(commit.data());
+}
+
+void
+RatchetTree::BlankPath(uint32_t leafNode) {
+	m_nodes[leafNode] = Node{};
+	for (uint32_t node : DirectPath(leafNode)) {
+		m_nodes[node] = Node{};
+	}
+}
+
+void
+RatchetTree::Extend(uint32_t leafCount) {
+	// Índices MLS: duplicar las hojas conserva la posición de los nodos existentes
+	while (m_leafCount < leafCount) {
+		m_leafCount *= 2;
+		m_nodes.resize(2 * static_cast<size_t>(m_leafCount) - 1);
+	}
+}
+
+bool
+RatchetTree::SetPathSecret(uint32_t node, const std::vector<unsigned char>& pathSecret) {
+	std::vector<unsigned char> secret = CryptoHelper::DeriveSecret(pathSecret, "node");
+	std::vector<unsigned char> publicKey = CryptoHelper::NodePublicKey(secret);
+	Node& target = m_nodes[node];
+	if (!target.publicKey.empty() && target.publicKey != publicKey) {
+		OPENSSL_cleanse(secret.data(), secret.size());
+		return false;
+	}
+	target.publicKey = std::move(publicKey);
+	target.secret = std::move(secret);
+	target.pathSecret = pathSecret;
+	return true;
+}
+
+bool
+RatchetTree::DeriveUp(uint32_t node, std::vector<unsigned char> pathSecret) {
+	for (;;) {
+		if (!SetPathSecret(node, pathSecret)) return false;
+		if (node == Root()) return true;
+		pathSecret = CryptoHelper::DeriveSecret(pathSecret, "path");
+		node = Parent(node);
+	}
+}
+
+void
+RatchetTree::FinishEpoch() {
+	m_groupKey = CryptoHelper::DeriveSecret(m_nodes[Root()].pathSecret, "epoch " + std::to_string(m_epoch));
+}
+
+std::vector<unsigned char>
+RatchetTree::Commit(const std::vector<Addition>& adds, const std::vector<uint32_t>& removes) {
+	const uint32_t baseEpoch = m_epoch;
+	const uint32_t ownLeaf = FindLeaf(m_userId);
+	if (ownLeaf == kNoNode) {
+		throw std::runtime_error("Commit from a member outside the tree.");
+	}
+
+	// 1) Bajas: hoja y camino en blanco
+	std::vector<uint32_t> removedLeaves;
+	for (uint32_t userId : removes) {
+		uint32_t leaf = FindLeaf(userId);
+		if (leaf == kNoNode || leaf == ownLeaf) continue;
+		BlankPath(leaf);
+		removedLeaves.push_back(leaf);
+	}
+
+	// 2) Altas: primera hoja libre, duplicando el árbol si no queda ninguna
+	std::vector<std::pair<uint32_t, const Addition*>> added;
+	for (const Addition& add : adds) {
+		if (add.userId == 0 || Contains(add.userId)) continue;
+		uint32_t leaf = 0;
+		while (leaf < m_nodes.size() && (m_nodes[leaf].userId != 0 || !m_nodes[leaf].publicKey.empty())) leaf += 2;
+		if (leaf >= m_nodes.size()) Extend(m_leafCount * 2);
+		BlankPath(leaf);
+		m_nodes[leaf].publicKey = add.leafKey;
+		m_nodes[leaf].userId = add.userId;
+		added.emplace_back(leaf, &add);
+	}
+
+	// 3) Camino propio nuevo: hoja y padres derivados de un secreto fresco
+	std::vector<uint32_t> path = DirectPath(ownLeaf);
+	std::vector<unsigned char> pathSecret = NewLeafSecret();
+	m_nodes[ownLeaf] = Node{ {}, {}, {}, m_userId };
+	SetPathSecret(ownLeaf, pathSecret);
+	for (uint32_t node : path) {
+		pathSecret = CryptoHelper::DeriveSecret(pathSecret, "path");
+		m_nodes[node] = Node{};
+		SetPathSecret(node, pathSecret);
+	}
+
+	std::vector<unsigned char> out;
+	PutU32(out, baseEpoch);
+	PutU32(out, ownLeaf);
+	PutU32(out, m_leafCount);
+	PutU32(out, static_cast<uint32_t>(removedLeaves.size()));
+	for (uint32_t leaf : removedLeaves) PutU32(out, leaf);
+	PutU32(out, static_cast<uint32_t>(added.size()));
+	for (const auto& entry : added) {
+		PutU32(out, entry.first);
+		PutU32(out, entry.second->userId);
+		PutBlob(out, entry.second->leafKey);
+	}
+	PutU32(out, static_cast<uint32_t>(path.size() + 1));
+	PutBlob(out, m_nodes[ownLeaf].publicKey);
+	for (uint32_t node : path) PutBlob(out, m_nodes[node].publicKey);
+
+	// 4) Secreto de cada padre sellado para la resolución del hermano del hijo.
+	//    Las hojas recién añadidas lo recibirán en el Welcome.
+	m_lastSeals = 0;
+	uint32_t child = ownLeaf;
+	for (uint32_t node : path) {
+		std::vector<uint32_t> targets;
+		Resolution(Sibling(child), targets);
+		std::vector<std::pair<uint32_t, std::vector<unsigned char>>> sealed;
+		for (uint32_t target : targets) {
+			bool isNew = false;
+			for (const auto& entry : added) isNew = isNew || entry.first == target;
+			if (isNew) continue;
+			sealed.emplace_back(target, CryptoHelper::SealToNode(m_nodes[target].publicKey, m_nodes[node].pathSecret));
+		}
+		PutU32(out, static_cast<uint32_t>(sealed.size()));
+		for (const auto& entry : sealed) {
+			PutU32(out, entry.first);
+			PutBlob(out, entry.second);
+		}
+		m_lastSeals += sealed.size();
+		child = node;
+	}
+
+	m_epoch = baseEpoch + 1;
+	FinishEpoch();
+	return out;
+}
+
+bool
+RatchetTree::ApplyCommit(const std::vector<unsigned char>& commit) {
+	Reader reader{ commit };
+	uint32_t baseEpoch = 0, committer = 0, leafCount = 0, count = 0;
+	if (!reader.U32(baseEpoch) || baseEpoch != m_epoch ||
+		!reader.U32(committer) || !reader.U32(leafCount) ||
+		!IsPowerOfTwo(leafCount) || leafCount > kMaxLeaves || leafCount < m_leafCount ||
+		committer % 2 != 0 || committer >= 2 * leafCount - 1) {
+		return false;
+	}
+
+	// Se trabaja sobre una copia: un commit inválido deja el árbol intacto
+	RatchetTree next(*this);
+	next.Extend(leafCount);
+
+	if (!reader.U32(count)) return false;
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t leaf = 0;
+		if (!reader.U32(leaf) || leaf % 2 != 0 || leaf >= next.m_nodes.size()) return false;
+		next.BlankPath(leaf);
+	}
+	if (!reader.U32(count)) return false;
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t leaf = 0, userId = 0;
+		std::vector<unsigned char> leafKey;
+		if (!reader.U32(leaf) || !reader.U32(userId) || !reader.Blob(leafKey) ||
+			leaf % 2 != 0 || leaf >= next.m_nodes.size()) {
+			return false;
+		}
+		next.BlankPath(leaf);
+		next.m_nodes[leaf].publicKey = std::move(leafKey);
+		next.m_nodes[leaf].userId = userId;
+	}
+
+	const uint32_t ownLeaf = next.FindLeaf(m_userId);
+	if (ownLeaf == kNoNode) {
+		// Baja propia: se conserva el árbol sin hoja para que Contains() lo refleje
+		*this = std::move(next);
+		m_groupKey.clear();
+		return true;
+	}
+
+	// Claves públicas del camino del emisor
+	std::vector<uint32_t> path = next.DirectPath(committer);
+	if (!reader.U32(count) || count != path.size() + 1) return false;
+	std::vector<unsigned char> publicKey;
+	if (!reader.Blob(publicKey)) return false;
+	next.m_nodes[committer].publicKey = std::move(publicKey);
+	next.m_nodes[committer].secret.clear();
+	next.m_nodes[committer].pathSecret.clear();
+	for (uint32_t node : path) {
+		if (!reader.Blob(publicKey)) return false;
+		next.m_nodes[node] = Node{};
+		next.m_nodes[node].publicKey = std::move(publicKey);
+	}
+
+	// El primer padre cuyo hermano contiene la hoja propia trae el secreto a abrir
+	uint32_t child = committer;
+	bool opened = false;
+	for (uint32_t node : path) {
+		if (!reader.U32(count)) return false;
+		bool mine = InSubtree(next.Sibling(child), ownLeaf);
+		for (uint32_t i = 0; i < count; ++i) {
+			uint32_t target = 0;
+			std::vector<unsigned char> sealed;
+			if (!reader.U32(target) || !reader.Blob(sealed)) return false;
+			if (!mine || opened || target >= next.m_nodes.size() || next.m_nodes[target].secret.empty()) {
+				continue;
+			}
+			std::vector<unsigned char> pathSecret = CryptoHelper::OpenFromNode(next.m_nodes[target].secret, sealed);
+			if (pathSecret.size() != kSecretSize || !next.DeriveUp(node, std::move(pathSecret))) return false;
+			opened = true;
+		}
+		child = node;
+	}
+	if (!opened || !reader.AtEnd()) return false;
+
+	next.m_epoch = baseEpoch + 1;
+	next.FinishEpoch();
+	*this = std::move(next);
+	return true;
+}
+
+std::vector<unsigned char>
+RatchetTree::Welcome(uint32_t userId) const {
+	const uint32_t joiner = FindLeaf(userId);
+	const uint32_t ownLeaf = FindLeaf(m_userId);
+	if (joiner == kNoNode || ownLeaf == kNoNode || joiner == ownLeaf) return {};
+
+	// Ancestro común más bajo: primer nodo del camino propio que cubre al nuevo
+	uint32_t ancestor = kNoNode;
+	for (uint32_t node : DirectPath(ownLeaf)) {
+		if (InSubtree(node, joiner)) {
+			ancestor = node;
+			break;
+		}
+	}
+	if (ancestor == kNoNode || m_nodes[ancestor].pathSecret.empty()) return {};
+
+	std::vector<unsigned char> out;
+	PutU32(out, m_epoch);
+	PutU32(out, m_leafCount);
+	for (uint32_t node = 0; node < m_nodes.size(); ++node) {
+		PutBlob(out, m_nodes[node].publicKey);
+		if (node % 2 == 0) PutU32(out, m_nodes[node].userId);
+	}
+	PutU32(out, ancestor);
+	PutBlob(out, CryptoHelper::SealToNode(m_nodes[joiner].publicKey, m_nodes[ancestor].pathSecret));
+	return out;
+}
+
+bool
+RatchetTree::ApplyWelcome(const std::vector<unsigned char>& welcome, uint32_t userId,
+	const std::vector<unsigned char>& leafSecret) {
+	Reader reader{ welcome };
+	RatchetTree next;
+	if (!reader.U32(next.m_epoch) || !reader.U32(next.m_leafCount) ||
+		!IsPowerOfTwo(next.m_leafCount) || next.m_leafCount > kMaxLeaves) {
+		return false;
+	}
+	next.m_userId = userId;
+	next.m_nodes.resize(2 * static_cast<size_t>(next.m_leafCount) - 1);
+	for (uint32_t node = 0; node < next.m_nodes.size(); ++node) {
+		if (!reader.Blob(next.m_nodes[node].publicKey)) return false;
+		if (node % 2 == 0 && !reader.U32(next.m_nodes[node].userId)) return false;
+	}
+
+	uint32_t ancestor = 0;
+	std::vector<unsigned char> sealed;
+	if (!reader.U32(ancestor) || !reader.Blob(sealed) || !reader.AtEnd()) return false;
+
+	// La hoja anunciada debe ser la nuestra
+	const uint32_t ownLeaf = next.FindLeaf(userId);
+	if (ownLeaf == kNoNode || ancestor >= next.m_nodes.size() || !InSubtree(ancestor, ownLeaf) ||
+		next.m_nodes[ownLeaf].publicKey != CryptoHelper::NodePublicKey(leafSecret)) {
+		return false;
+	}
+	next.m_nodes[ownLeaf].secret = leafSecret;
+
+	std::vector<unsigned char> pathSecret = CryptoHelper::OpenFromNode(leafSecret, sealed);
+	if (pathSecret.size() != kSecretSize || !next.DeriveUp(ancestor, std::move(pathSecret))) return false;
+
+	next.FinishEpoch();
+	*this = std::move(next);
+	return true;
+}
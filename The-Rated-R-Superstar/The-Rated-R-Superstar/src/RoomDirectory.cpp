@@ -0,0 +1,132 @@
+/**
+ * @file RoomDirectory.cpp
+ * @brief Implementación del registro de salas del relay.
+ */
+
+#include "RoomDirectory.h"
+#include <algorithm>
+
+bool
+RoomDirectory::Join(uint32_t roomId, const RoomMember& member) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Room& room = m_rooms[roomId];
+	if (!room.index.emplace(member.userId, room.members.size()).second) {
+		return false;
+	}
+	room.members.push_back(member);
+	room.members.back().since = room.joins++;
+	room.snapshot.reset();
+	return true;
+}
+
+bool
+RoomDirectory::Leave(uint32_t roomId, uint32_t userId) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_rooms.find(roomId);
+	if (it == m_rooms.end()) return false;
+	Room& room = it->second;
+	auto pos = room.index.find(userId);
+	if (pos == room.index.end()) return false;
+
+	// Baja en O(1): el último miembro ocupa el hueco
+	size_t slot = pos->second;
+	room.index.erase(pos);
+	if (slot != room.members.size() - 1) {
+		room.members[slot] = room.members.back();
+		room.index[room.members[slot].userId] = slot;
+	}
+	room.members.pop_back();
+	room.snapshot.reset();
+
+	if (room.members.empty()) m_rooms.erase(it);
+	return true;
+}
+
+RoomSnapshot
+RoomDirectory::Members(uint32_t roomId) const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_rooms.find(roomId);
+	if (it == m_rooms.end()) return nullptr;
+	const Room& room = it->second;
+	if (!room.snapshot) {
+		room.snapshot = std::make_shared<const std::vector<RoomMember>>(room.members);
+	}
+	return room.snapshot;
+}
+
+uint32_t
+RoomDirectory::Sponsor(uint32_t roomId, uint32_t exceptUser) const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_rooms.find(roomId);
+	if (it == m_rooms.end()) return 0;
+	const RoomMember* oldest = Oldest(it->second, exceptUser);
+	return oldest ? oldest->userId : 0;
+}
+
+bool
+RoomDirectory::AdvanceEpoch(uint32_t roomId, uint32_t committer, uint32_t epoch) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_rooms.find(roomId);
+	if (it == m_rooms.end()) return false;
+	Room& room = it->second;
+	// Época exacta: una época futura dejaría la sala inservible para el resto.
+	// Solo el responsable cambia el árbol, como anuncian los avisos de alta y baja
+	const RoomMember* sponsor = Oldest(room, 0);
+	if (epoch != room.epoch || !sponsor || sponsor->userId != committer) return false;
+	room.epoch++;
+	return true;
+}
+
+std::vector<RoomState>
+RoomDirectory::Export() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::vector<RoomState> out;
+	out.reserve(m_rooms.size());
+	for (const auto& entry : m_rooms) {
+		std::vector<const RoomMember*> order;
+		for (const RoomMember& member : entry.second.members) order.push_back(&member);
+		std::sort(order.begin(), order.end(),
+			[](const RoomMember* a, const RoomMember* b) { return a->since < b->since; });
+		RoomState state;
+		state.roomId = entry.first;
+		state.epoch = entry.second.epoch;
+		for (const RoomMember* member : order) state.members.push_back(member->userId);
+		out.push_back(std::move(state));
+	}
+	return out;
+}
+
+void
+RoomDirectory::Restore(const RoomState& state) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_rooms.find(state.roomId);
+	if (it == m_rooms.end()) return;
+	Room& room = it->second;
+	room.epoch = state.epoch;
+	// Antigüedad original; quien no figuraba (se unió durante el traspaso) queda detrás
+	uint64_t known = state.members.size();
+	for (RoomMember& member : room.members) {
+		auto pos = std::find(state.members.begin(), state.members.end(), member.userId);
+		member.since = (pos != state.members.end()) ? static_cast<uint64_t>(pos - state.members.begin())
+			: known + member.since;
+	}
+	room.joins += known;
+	room.snapshot.reset();
+}
+
+const RoomMember*
+RoomDirectory::Oldest(const Room& room, uint32_t exceptUser) {
+	// Recorrido lineal: solo en altas, bajas y commits, que ya reparten a toda la sala
+	const RoomMember* oldest = nullptr;
+	for (const RoomMember& member : room.members) {
+		if (member.userId == exceptUser) continue;
+		if (!oldest || member.since < oldest->since) oldest = &member;
+	}
+	return oldest;
+}
+
+size_t
+RoomDirectory::Size() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_rooms.size();
+}
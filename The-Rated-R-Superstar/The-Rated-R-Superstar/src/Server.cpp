@@ -1,27 +1,53 @@
 /**
  * @file Server.cpp
- * @brief Implementacin del servidor TCP con cifrado hbrido RSA/AES.
+ * @brief Implementación del servidor TCP con cifrado híbrido RSA/AES.
  *
  * @details
- * Este mdulo se encarga de:
+ * Este módulo se encarga de:
  *  - Iniciar un servidor TCP y aceptar clientes.
- *  - Intercambiar claves pblicas RSA con el cliente.
+ *  - Intercambiar claves públicas RSA con el cliente.
  *  - Recibir y descifrar la clave AES cifrada con RSA.
  *  - Enviar y recibir mensajes cifrados con AES-256-CBC.
- *  - Gestionar un bucle de chat con hilos para envo y recepcin simultnea.
+ *  - Gestionar un bucle de chat con hilos para envío y recepción simultánea.
  *
- * @note Usa NetworkHelper para la comunicacin y CryptoHelper para la criptografa.
+ * @note Usa NetworkHelper para la comunicación y CryptoHelper para la criptografía.
  */
 
 #include "Server.h"
+#include "openssl/crypto.h"
+#include <algorithm>
 
-Server::Server(int port) : m_port(port), m_clientSock(-1) {
-	// Generar claves RSA al construir
-	m_crypto.GenerateRSAKeys();
+namespace {
+	/// Fin del PEM de una clave pública RSA (delimita el primer bloque del cliente).
+	const char kPemEnd[] = "-----END RSA PUBLIC KEY-----\n";
+	/// Margen que Windows concede antes de terminar el proceso al cerrar la consola o apagar.
+	const std::chrono::milliseconds kCloseGrace(4500);
+	/// Espera tras un intento fallido de traspaso; se duplica hasta el máximo.
+	const std::chrono::milliseconds kUpgradeRetryMin(100);
+	const std::chrono::milliseconds kUpgradeRetryMax(2000);
+	/// Intervalo con que se reintenta cancelar la lectura bloqueada de la consola.
+	const std::chrono::milliseconds kConsoleCancelPoll(50);
+
+	/// Servidor en modo daemon al que van las señales de consola.
+	std::mutex g_daemonMutex;
+	Server* g_daemon = nullptr;
+	/// RunDaemon() ya detuvo los shards.
+	std::atomic<bool> g_daemonStopped{ false };
+}
+
+Server::Server(int port)
+	: m_port(port), m_clientSock(-1), m_identity(std::make_shared<const ServerIdentity>()) {
+	// El par RSA se genera al construir y lo comparten todas las sesiones
+}
+
+Server::Server(const std::string& address)
+	: m_port(0), m_address(address), m_clientSock(-1), m_identity(std::make_shared<const ServerIdentity>()) {
 }
 
 Server::~Server() {
-	// Cerrar conexin con el cliente si an est activa
+	StopSharded();
+
+	// Cerrar conexión con el cliente si aún está activa
 	if (m_clientSock != -1) {
 		m_net.close(m_clientSock);
 	}
@@ -29,40 +55,107 @@ Server::~Server() {
 
 
 bool Server::Start() {
-	std::cout << "[Server] Iniciando servidor en el puerto " << m_port << "...\n";
+	if (!m_address.empty()) {
+		Logger::Info("[Server] Iniciando servidor en {}...\n", m_address);
+		return m_net.StartServer(m_address);
+	}
+	Logger::Info("[Server] Iniciando servidor en el puerto {}...\n", m_port);
+	m_net.EnableFastOpen(m_fastOpen);
 	return m_net.StartServer(m_port);
 }
 
+void
+Server::EnableFastOpen(bool enabled) {
+	m_fastOpen = enabled;
+}
+
+void
+Server::EnableRelayOnly(bool enabled) {
+	m_relayOnly = enabled;
+}
+
+void
+Server::SetHibernateAfter(std::chrono::milliseconds idle) {
+	m_hibernateAfter = idle;
+}
+
+void
+Server::SetHeartbeat(std::chrono::milliseconds interval, uint32_t maxMissed) {
+	m_heartbeatInterval = interval;
+	m_maxMissedPings = maxMissed;
+}
+
+bool
+Server::EnableCapture(const std::string& path) {
+	m_capture = TrafficRecorder::Create(path, TrafficCapture::Role::Server);
+	if (!m_capture) return false;
+	Logger::Info("[Server] Capturando el tráfico recibido en {}\n", path);
+	return true;
+}
+
 
 void Server::WaitForClient() {
-	std::cout << "[Server] Esperando conexin de un cliente...\n";
+	Logger::Info("[Server] Esperando conexión de un cliente...\n");
 
-	// Aceptar conexin entrante
-	m_clientSock = m_net.AcceptClient();
+	// Aceptar conexión entrante (el span incluye la espera hasta que llega el cliente)
+	uint64_t trace = Tracer::Instance().BeginTrace();
+	{
+		TraceSpan accept(trace, "accept");
+		m_clientSock = m_net.AcceptClient();
+	}
 	if (m_clientSock == INVALID_SOCKET) {
-		std::cerr << "[Server] No se pudo aceptar cliente.\n";
+		Logger::Warn("[Server] No se pudo aceptar cliente.\n");
 		return;
 	}
-	std::cout << "[Server] Cliente conectado.\n";
+	Logger::Info("[Server] Cliente conectado.\n");
+	TraceSpan handshake(trace, "handshake");
 
-	// 1. Enviar clave pblica del servidor al cliente
-	std::string serverPubKey = m_crypto.GetPublicKeyString();
-	m_net.SendData(m_clientSock, serverPubKey);
+	// 1. Enviar clave pública del servidor al cliente (la PEM ya está serializada en la identidad)
+	{
+		TraceSpan send(trace, "send_server_pem");
+		m_net.SendData(m_clientSock, m_identity->GetPublicKeyString());
+	}
 
-	// 2. Recibir clave pblica del cliente
-	std::string clientPubKey = m_net.ReceiveData(m_clientSock);
-	m_crypto.LoadPeerPublicKey(clientPubKey);
+	// 2. Recibir clave pública del cliente (puede haber llegado ya en el SYN)
+	std::string clientPubKey;
+	{
+		TraceSpan wait(trace, "recv_client_pem");
+		clientPubKey = m_net.ReceiveUntil(m_clientSock, kPemEnd);
+	}
+	bool validKey;
+	{
+		TraceSpan parse(trace, "parse_client_pem");
+		validKey = CryptoHelper::IsValidPublicKey(clientPubKey);
+	}
+	if (!validKey) {
+		Logger::Warn("[Server] Clave pública del cliente inválida.\n");
+		return;
+	}
 
-	// 3. Recibir clave AES cifrada con la pblica del servidor
-	std::vector<unsigned char> encryptedAESKey = m_net.ReceiveDataBinary(m_clientSock, 256);
-	m_crypto.DecryptAESKey(encryptedAESKey);
+	// 3. Recibir clave AES cifrada con la pública del servidor
+	std::vector<unsigned char> encryptedAESKey;
+	{
+		TraceSpan wait(trace, "recv_aes_key");
+		encryptedAESKey = m_net.ReceiveDataBinary(m_clientSock, 256);
+	}
+	std::vector<unsigned char> aesKey;
+	{
+		TraceSpan unwrap(trace, "rsa_unwrap_aes_key");
+		aesKey = m_identity->UnwrapAESKey(encryptedAESKey);
+	}
+	if (aesKey.empty()) {
+		Logger::Warn("[Server] Clave AES inválida.\n");
+		return;
+	}
+	m_crypto.SetAESKey(aesKey);
+	OPENSSL_cleanse(aesKey.data(), aesKey.size());
 
-	std::cout << "[Server] Clave AES intercambiada exitosamente.\n";
+	Logger::Info("[Server] Clave AES intercambiada exitosamente.\n");
 }
 
 
 void Server::ReceiveEncryptedMessage() {
-	// 1. Recibir el IV (vector de inicializacin)
+	// 1. Recibir el IV (vector de inicialización)
 	std::vector<unsigned char> iv = m_net.ReceiveDataBinary(m_clientSock, 16);
 
 	// 2. Recibir el mensaje cifrado
@@ -72,39 +165,28 @@ void Server::ReceiveEncryptedMessage() {
 	std::string msg = m_crypto.AESDecrypt(encryptedMsg, iv);
 
 	// 4. Mostrar mensaje
-	std::cout << "[Server] Mensaje recibido: " << msg << "\n";
+	Logger::Print("[Server] Mensaje recibido: {}\n", msg);
 }
 
 void Server::StartReceiveLoop() {
 	while (true) {
-		// 1) IV (16)
-		auto iv = m_net.ReceiveDataBinary(m_clientSock, 16);
-		if (iv.empty()) {
-			std::cout << "\n[Server] Conexin cerrada por el cliente.\n";
-			break;
-		}
-
-		// 2) Tamao (4 bytes network/big-endian)
-		auto len4 = m_net.ReceiveDataBinary(m_clientSock, 4);
-		if (len4.size() != 4) {
-			std::cout << "[Server] Error al recibir tamao.\n";
+		// IV (16) | tamaño (4 bytes network/big-endian) | ciphertext
+		Frame frame;
+		if (!m_net.ReceiveFrame(m_clientSock, frame)) {
+			Logger::Print("\n[Server] Conexión cerrada por el cliente.\n");
 			break;
 		}
-		uint32_t nlen = 0;
-		std::memcpy(&nlen, len4.data(), 4);
-		uint32_t clen = ntohl(nlen);   // <- convierte de network a host
-
-		// 3) Ciphertext (clen bytes)
-		auto cipher = m_net.ReceiveDataBinary(m_clientSock, static_cast<int>(clen));
-		if (cipher.empty()) {
-			std::cout << "[Server] Error al recibir datos.\n";
-			break;
+		// El modo interactivo no enruta ni atiende control (ver modo sharded), salvo el latido
+		if (frame.IsControl() && !frame.IsRouted() && frame.Type() == Frame::Ping) {
+			std::lock_guard<std::mutex> lock(m_sendMutex);
+			m_net.SendFrame(m_clientSock, Frame::Control(Frame::Pong, frame.payload));
+			continue;
 		}
+		if (frame.IsControl() || frame.IsRouted()) continue;
 
-		// 4) Descifrar y mostrar
-		std::string plain = m_crypto.AESDecrypt(cipher, iv);
-		std::cout << "\n[Cliente]: " << plain << "\nServidor: ";
-		std::cout.flush();
+		// Descifrar y mostrar
+		std::string plain = m_crypto.AESDecrypt(frame.payload, frame.iv);
+		Logger::Print("\n[Cliente]: {}\nServidor: ", plain);
 	}
 }
 
@@ -113,29 +195,17 @@ void Server::StartReceiveLoop() {
 void Server::SendEncryptedMessageLoop() {
 	std::string msg;
 	while (true) {
-		std::cout << "Servidor: ";
+		Logger::Print("Servidor: ");
 		std::getline(std::cin, msg);
 		if (msg == "/exit") break;
 
-		std::vector<unsigned char> iv;
-		auto cipher = m_crypto.AESEncrypt(msg, iv);
-
-		// 1) IV (16)
-		m_net.SendData(m_clientSock, iv);
-
-		// 2) Tamao en network order (htonl)
-		uint32_t clen = static_cast<uint32_t>(cipher.size());
-		uint32_t nlen = htonl(clen);
-		std::vector<unsigned char> len4(
-			reinterpret_cast<unsigned char*>(&nlen),
-			reinterpret_cast<unsigned char*>(&nlen) + 4
-		);
-		m_net.SendData(m_clientSock, len4);
-
-		// 3) Ciphertext
-		m_net.SendData(m_clientSock, cipher);
+		// IV (16) | tamaño en network order | ciphertext
+		Frame frame;
+		frame.payload = m_crypto.AESEncrypt(msg, frame.iv);
+		std::lock_guard<std::mutex> lock(m_sendMutex);
+		m_net.SendFrame(m_clientSock, frame);
 	}
-	std::cout << "[Server] Saliendo del chat.\n";
+	Logger::Info("[Server] Saliendo del chat.\n");
 }
 
 void 
@@ -149,3 +219,373 @@ Server::StartChatLoop() {
 	if (recvThread.joinable())
 		recvThread.join();
 }
+
+bool
+Server::StartSharded(int shards, const std::string& takeoverPath) {
+	if (shards <= 0) {
+		shards = static_cast<int>(std::thread::hardware_concurrency());
+		if (shards <= 0) shards = 1;
+	}
+	if (!m_address.empty() && m_address.compare(0, 5, "unix:") != 0) {
+		Logger::Error("[Server] El modo sharded solo escucha en TCP o unix:<ruta>, no en {}.\n", m_address);
+		return false;
+	}
+	if (m_address.empty()) Logger::Info("[Server] Iniciando {} shards en el puerto {}...\n", shards, m_port);
+	else Logger::Info("[Server] Iniciando {} shards en {}...\n", shards, m_address);
+
+	LiveUpgrade::Handoff handoff;
+	if (!takeoverPath.empty()) {
+		Logger::Info("[Server] Heredando sockets desde {}...\n", takeoverPath);
+		if (!m_upgrade.ReceiveHandoff(takeoverPath, handoff)) {
+			return false;
+		}
+		Logger::Info("[Server] Heredados {} listeners y {} sesiones.\n", handoff.listeners.size(), handoff.sessions.size());
+		// Los clientes a medio handshake ya tienen la PEM del proceso anterior
+		if (!handoff.identity.empty()) {
+			try {
+				m_identity = std::make_shared<const ServerIdentity>(handoff.identity);
+			}
+			catch (const std::exception& e) {
+				Logger::Warn("[Server] Identidad heredada inválida ({}); los handshakes pendientes fallarán.\n", e.what());
+			}
+			OPENSSL_cleanse(handoff.identity.data(), handoff.identity.size());
+		}
+	}
+
+	// Todos los shards comparten el mismo par RSA (el heredado, si lo hubo)
+	for (int i = 0; i < shards; ++i) {
+		m_shards.push_back(std::make_unique<ServerShard>(i, m_port, m_identity));
+		m_shards.back()->SetDirectory(&m_directory);
+		m_shards.back()->SetRooms(&m_rooms);
+		m_shards.back()->SetRelayOnly(m_relayOnly);
+		m_shards.back()->SetHibernateAfter(m_hibernateAfter);
+		m_shards.back()->SetHeartbeat(m_heartbeatInterval, m_maxMissedPings);
+		m_shards.back()->SetCapture(m_capture);
+	}
+
+	// AF_UNIX no admite SO_REUSEPORT: un solo listener compartido
+	bool reusePort = m_address.empty() && NetworkHelper::SupportsReusePort();
+	for (int i = 0; i < shards; ++i) {
+		ServerShard& shard = *m_shards[i];
+		if (i < static_cast<int>(handoff.listeners.size())) {
+			shard.AdoptListener(handoff.listeners[i]);
+		}
+		else if (reusePort || i == 0) {
+			if (!(m_address.empty() ? shard.Listen(m_fastOpen) : shard.ListenLocal(m_address))) {
+				Logger::Warn("[Server] El shard {} no pudo abrir su listener.\n", i);
+				m_shards.clear();
+				return false;
+			}
+		}
+		else {
+			shard.ShareListener(m_shards[0]->GetListener());
+		}
+		shard.SetPeers(&m_shards);
+	}
+	// Listeners sobrantes (el proceso anterior tenía más shards)
+	for (size_t i = shards; i < handoff.listeners.size(); ++i) {
+		m_net.close(handoff.listeners[i]);
+	}
+	for (size_t i = 0; i < handoff.sessions.size(); ++i) {
+		m_shards[i % shards]->AdoptSession(std::move(handoff.sessions[i]));
+	}
+	for (const RoomState& room : handoff.rooms) {
+		m_rooms.Restore(room);
+	}
+
+	m_running = true;
+	LaunchShardThreads();
+	Logger::Info("[Server] Shards activos ({}).\n", (reusePort ? "SO_REUSEPORT" : "listener compartido"));
+	return true;
+}
+
+bool
+Server::EnableLiveUpgrade(const std::string& path) {
+	if (!m_upgrade.Listen(path)) {
+		return false;
+	}
+	m_upgradeThread = std::thread([this]() {
+		std::chrono::milliseconds backoff = kUpgradeRetryMin;
+		while (m_running) {
+			DWORD pid = 0;
+			SOCKET channel = m_upgrade.WaitForSuccessor(pid);
+			if (channel == INVALID_SOCKET) {
+				// Socket cerrado por la parada, o un sucesor inválido: espera creciente
+				std::unique_lock<std::mutex> lock(m_stateMutex);
+				if (m_stateCv.wait_for(lock, backoff, [this]() { return !m_running; })) break;
+				backoff = std::min(backoff * 2, kUpgradeRetryMax);
+				continue;
+			}
+			backoff = kUpgradeRetryMin;
+			bool done = HandOff(channel, pid);
+			m_net.close(channel);
+			if (done) {
+				RequestStop();
+				break;
+			}
+		}
+		});
+	Logger::Info("[Server] Actualización en caliente disponible en {}\n", path);
+	return true;
+}
+
+bool
+Server::EnableAdmin(const std::string& address) {
+	if (!m_admin.Start(address, [this]() { return RenderMetrics(); })) {
+		return false;
+	}
+	Logger::Info("[Server] Métricas disponibles en {} (GET /metrics)\n", address);
+	return true;
+}
+
+bool
+Server::HandOff(SOCKET channel, DWORD pid) {
+	std::lock_guard<std::mutex> lock(m_shardsMutex);
+	Logger::Info("[Server] Sucesor conectado (pid {}); transfiriendo sesiones...\n", pid);
+
+	// 1. Pausar los shards: a partir de aquí el estado de las sesiones no cambia
+	for (auto& shard : m_shards) {
+		shard->Stop();
+	}
+	for (auto& t : m_shardThreads) {
+		if (t.joinable()) t.join();
+	}
+	m_shardThreads.clear();
+
+	// 2. Recolectar listeners propios, sesiones y salas
+	//    (antes de extraer: al salir las sesiones las salas se vacían)
+	std::vector<RoomState> rooms = m_rooms.Export();
+	std::vector<SOCKET> listeners;
+	std::vector<std::unique_ptr<Session>> sessions;
+	for (auto& shard : m_shards) {
+		if (shard->OwnsListener()) listeners.push_back(shard->GetListener());
+		shard->ExtractSessions(sessions);
+	}
+
+	// 3. Enviar; si falla, el servicio continúa en este proceso
+	std::vector<unsigned char> identity = m_identity->ExportPrivateKey();
+	bool sent = m_upgrade.SendHandoff(channel, pid, listeners, sessions, rooms, identity);
+	OPENSSL_cleanse(identity.data(), identity.size());
+	if (!sent) {
+		Logger::Warn("[Server] Traspaso fallido; se reanuda el servicio.\n");
+		for (size_t i = 0; i < sessions.size(); ++i) {
+			m_shards[i % m_shards.size()]->AdoptSession(std::move(sessions[i]));
+		}
+		for (const RoomState& room : rooms) {
+			m_rooms.Restore(room);
+		}
+		for (auto& shard : m_shards) {
+			shard->Resume();
+		}
+		LaunchShardThreads();
+		return false;
+	}
+
+	// El sucesor tiene sus propias copias: se cierran las de este proceso
+	for (auto& session : sessions) {
+		m_net.close(session->sock);
+	}
+	Logger::Info("[Server] Traspasadas {} sesiones; finalizando.\n", sessions.size());
+	return true;
+}
+
+void
+Server::LaunchShardThreads() {
+	for (auto& shard : m_shards) {
+		ServerShard* raw = shard.get();
+		m_shardThreads.emplace_back([raw]() {
+			raw->Run();
+			});
+	}
+}
+
+void
+Server::RequestStop() {
+	{
+		std::lock_guard<std::mutex> lock(m_stateMutex);
+		m_running = false;
+	}
+	m_stateCv.notify_all();
+}
+
+void
+Server::RunSharded() {
+	// La consola va en su propio hilo: un traspaso también puede terminar el servidor
+	std::atomic<bool> consoleDone{ false };
+	std::thread console([this, &consoleDone]() {
+		std::string cmd;
+		while (m_running && std::getline(std::cin, cmd)) {
+			if (cmd == "/exit") break;
+			if (cmd == "/stats") PrintShardStats();
+		}
+		RequestStop();
+		consoleDone = true;
+		});
+
+	WaitForStop();
+
+	// getline no tiene plazo: se cancela la lectura pendiente hasta que el hilo salga
+	while (!consoleDone) {
+		CancelSynchronousIo(console.native_handle());
+		std::this_thread::sleep_for(kConsoleCancelPoll);
+	}
+	console.join();
+}
+
+void
+Server::RunDaemon() {
+	g_daemonStopped = false;
+	{
+		std::lock_guard<std::mutex> lock(g_daemonMutex);
+		g_daemon = this;
+	}
+	SetConsoleCtrlHandler(&Server::OnConsoleSignal, TRUE);
+	Logger::Info("[Server] Modo daemon: Ctrl+C, Ctrl+Break o el apagado del sistema detienen el servidor.\n");
+
+	WaitForStop();
+
+	{
+		std::lock_guard<std::mutex> lock(g_daemonMutex);
+		g_daemon = nullptr;
+	}
+	SetConsoleCtrlHandler(&Server::OnConsoleSignal, FALSE);
+	g_daemonStopped = true;
+}
+
+BOOL WINAPI
+Server::OnConsoleSignal(DWORD signal) {
+	// Windows no cierra sesiones de servicio por un logoff ajeno: se ignora
+	if (signal == CTRL_LOGOFF_EVENT) return TRUE;
+	{
+		std::lock_guard<std::mutex> lock(g_daemonMutex);
+		// Segunda señal con la parada en curso: el manejador por defecto termina el proceso
+		if (!g_daemon || !g_daemon->m_running) return FALSE;
+		Logger::Warn("[Server] Señal de consola {} recibida; deteniendo shards...\n", signal);
+		g_daemon->RequestStop();
+	}
+	// Al volver de estos eventos Windows termina el proceso: se espera a la parada ordenada
+	if (signal == CTRL_CLOSE_EVENT || signal == CTRL_SHUTDOWN_EVENT) {
+		auto deadline = std::chrono::steady_clock::now() + kCloseGrace;
+		while (!g_daemonStopped && std::chrono::steady_clock::now() < deadline) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+	}
+	return TRUE;
+}
+
+void
+Server::WaitForStop() {
+	{
+		std::unique_lock<std::mutex> lock(m_stateMutex);
+		m_stateCv.wait(lock, [this]() { return !m_running; });
+	}
+	StopSharded();
+	Logger::Info("[Server] Shards detenidos.\n");
+}
+
+void
+Server::StopSharded() {
+	RequestStop();
+	m_admin.Stop();
+	m_upgrade.Close();
+	if (m_upgradeThread.joinable() && m_upgradeThread.get_id() != std::this_thread::get_id()) {
+		m_upgradeThread.join();
+	}
+
+	std::lock_guard<std::mutex> lock(m_shardsMutex);
+	for (auto& shard : m_shards) {
+		shard->Stop();
+	}
+	for (auto& t : m_shardThreads) {
+		if (t.joinable()) t.join();
+	}
+	m_shardThreads.clear();
+	// El shard 0 es dueño del listener compartido: se destruye al final
+	while (!m_shards.empty()) {
+		m_shards.pop_back();
+	}
+}
+
+void
+Server::PrintShardStats() {
+	std::lock_guard<std::mutex> lock(m_shardsMutex);
+	for (const auto& shard : m_shards) {
+		Logger::Info("[Shard {}] sesiones={} hibernadas={} aceptadas={} mensajes={} enrutados={} entregas a salas={} sobres={} commits={} rtt={}ms jitter={}ms ({} sesiones) caídas={}\n",
+			shard->GetIndex(), shard->GetSessionCount(), shard->GetHibernatedCount(), shard->GetAcceptedCount(),
+			shard->GetMessageCount(), shard->GetRoutedCount(), shard->GetFanOutCount(), shard->GetEnvelopeCount(),
+			shard->GetCommitCount(), shard->GetMeanRtt().count() / 1000.0, shard->GetMeanJitter().count() / 1000.0,
+			shard->GetRttSessionCount(), shard->GetReapedCount());
+	}
+	Logger::Info("[Server] usuarios registrados={} salas={}\n", m_directory.Size(), m_rooms.Size());
+}
+
+std::string
+Server::RenderMetrics() {
+	PrometheusText text;
+	std::lock_guard<std::mutex> lock(m_shardsMutex);
+
+	// Una familia cada vez, con una muestra por shard
+	auto perShard = [&](const char* name, const char* type, const char* help, auto value) {
+		text.Family(name, type, help);
+		for (const auto& shard : m_shards) {
+			text.Sample(name, "shard=\"" + std::to_string(shard->GetIndex()) + "\"", value(*shard));
+		}
+	};
+	auto perShardHistogram = [&](const char* name, const char* help, auto histogram) {
+		text.Family(name, "histogram", help);
+		for (const auto& shard : m_shards) {
+			text.Histogram(name, "shard=\"" + std::to_string(shard->GetIndex()) + "\"", histogram(*shard));
+		}
+	};
+	auto gauge = [](int64_t value) { return static_cast<uint64_t>(std::max<int64_t>(value, 0)); };
+	auto seconds = [](std::chrono::microseconds value) { return value.count() / 1e6; };
+
+	perShard("e2ee_connections_accepted_total", "counter", "Conexiones TCP aceptadas.",
+		[](const ServerShard& s) { return s.GetAcceptedCount(); });
+	perShard("e2ee_handshakes_total", "counter", "Handshakes RSA/AES completados.",
+		[](const ServerShard& s) { return s.GetMetrics().handshakes.Value(); });
+	perShardHistogram("e2ee_handshake_duration_seconds", "Desde el accept hasta el canal AES listo.",
+		[](const ServerShard& s) -> const LatencyHistogram& { return s.GetMetrics().handshakeLatency; });
+	perShard("e2ee_messages_received_total", "counter", "Frames recibidos de clientes.",
+		[](const ServerShard& s) { return s.GetMessageCount(); });
+	perShard("e2ee_messages_sent_total", "counter", "Mensajes encolados hacia clientes.",
+		[](const ServerShard& s) { return s.GetMetrics().messagesOut.Value(); });
+	perShard("e2ee_bytes_received_total", "counter", "Bytes recibidos de los sockets de clientes.",
+		[](const ServerShard& s) { return s.GetMetrics().bytesIn.Value(); });
+	perShard("e2ee_bytes_sent_total", "counter", "Bytes escritos en los sockets de clientes.",
+		[](const ServerShard& s) { return s.GetMetrics().bytesOut.Value(); });
+	perShard("e2ee_routed_frames_total", "counter", "Frames reenviados sin descifrar.",
+		[](const ServerShard& s) { return s.GetRoutedCount(); });
+	perShard("e2ee_room_deliveries_total", "counter", "Entregas a miembros de salas.",
+		[](const ServerShard& s) { return s.GetFanOutCount(); });
+	perShard("e2ee_envelope_deliveries_total", "counter", "Entregas de sobres (una por destinatario).",
+		[](const ServerShard& s) { return s.GetEnvelopeCount(); });
+	perShard("e2ee_room_commits_total", "counter", "Commits de claves de sala admitidos.",
+		[](const ServerShard& s) { return s.GetCommitCount(); });
+	perShardHistogram("e2ee_aes_encrypt_duration_seconds", "Tiempo de cada cifrado AES del eco.",
+		[](const ServerShard& s) -> const LatencyHistogram& { return s.GetMetrics().encryptTime; });
+	perShardHistogram("e2ee_aes_decrypt_duration_seconds", "Tiempo de cada descifrado AES.",
+		[](const ServerShard& s) -> const LatencyHistogram& { return s.GetMetrics().decryptTime; });
+	perShardHistogram("e2ee_client_to_shard_latency_seconds", "Desde el sello de envio del cliente hasta la lectura en el shard (relojes de pared).",
+		[](const ServerShard& s) -> const LatencyHistogram& { return s.GetMetrics().clientToShard; });
+	perShard("e2ee_sessions", "gauge", "Sesiones abiertas (incluidas las hibernadas).",
+		[](const ServerShard& s) { return s.GetSessionCount(); });
+	perShard("e2ee_sessions_hibernated", "gauge", "Sesiones hibernadas.",
+		[](const ServerShard& s) { return s.GetHibernatedCount(); });
+	perShard("e2ee_send_queue_entries", "gauge", "Buffers pendientes de enviar a clientes.",
+		[gauge](const ServerShard& s) { return gauge(s.GetMetrics().queuedEntries.Value()); });
+	perShard("e2ee_send_queue_bytes", "gauge", "Bytes pendientes de enviar a clientes.",
+		[gauge](const ServerShard& s) { return gauge(s.GetMetrics().queuedBytes.Value()); });
+	perShard("e2ee_rtt_seconds", "gauge", "Media del RTT suavizado del latido.",
+		[seconds](const ServerShard& s) { return seconds(s.GetMeanRtt()); });
+	perShard("e2ee_rtt_jitter_seconds", "gauge", "Media del jitter del latido.",
+		[seconds](const ServerShard& s) { return seconds(s.GetMeanJitter()); });
+	perShard("e2ee_heartbeat_reaped_total", "counter", "Sesiones cerradas por no responder al latido.",
+		[](const ServerShard& s) { return s.GetReapedCount(); });
+
+	text.Family("e2ee_users_registered", "gauge", "Usuarios registrados en el relay.");
+	text.Sample("e2ee_users_registered", "", static_cast<uint64_t>(m_directory.Size()));
+	text.Family("e2ee_rooms", "gauge", "Salas con miembros.");
+	text.Sample("e2ee_rooms", "", static_cast<uint64_t>(m_rooms.Size()));
+	return text.Str();
+}
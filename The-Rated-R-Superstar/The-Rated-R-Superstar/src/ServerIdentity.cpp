@@ -0,0 +1,104 @@
+/**
+ * @file ServerIdentity.cpp
+ * @brief Implementación de la identidad RSA compartida del servidor.
+ *
+ * @details
+ * OpenSSL calcula de forma perezosa (bajo su propio lock) los contextos de
+ * Montgomery de n, p y q y el blinding de la clave privada. Una vuelta
+ * completa envolver/desenvolver en el constructor los deja listos, así que
+ * los shards nunca compiten por inicializarlos en pleno handshake.
+ */
+
+#include "ServerIdentity.h"
+#include "openssl/pem.h"
+#include "openssl/rand.h"
+#include "openssl/err.h"
+#include "openssl/crypto.h"
+
+namespace {
+	/// Tamaño de la clave AES-256 que envuelven los clientes.
+	const size_t kAESKeySize = 32;
+}
+
+ServerIdentity::ServerIdentity() {
+	BIGNUM* bn = BN_new();
+	BN_set_word(bn, RSA_F4);
+	m_keyPair = RSA_new();
+	int generated = RSA_generate_key_ex(m_keyPair, 2048, bn, nullptr);
+	BN_free(bn);
+	if (generated != 1) {
+		RSA_free(m_keyPair);
+		throw std::runtime_error("Failed to generate server identity: "
+			+ std::string(ERR_error_string(ERR_get_error(), nullptr)));
+	}
+	Prepare();
+}
+
+ServerIdentity::ServerIdentity(const std::vector<unsigned char>& privateKeyDer) {
+	const unsigned char* p = privateKeyDer.data();
+	m_keyPair = d2i_RSAPrivateKey(nullptr, &p, static_cast<long>(privateKeyDer.size()));
+	if (!m_keyPair || p != privateKeyDer.data() + privateKeyDer.size()) {
+		if (m_keyPair) RSA_free(m_keyPair);
+		throw std::runtime_error("Invalid server identity.");
+	}
+	Prepare();
+}
+
+void
+ServerIdentity::Prepare() {
+	BIO* bio = BIO_new(BIO_s_mem());
+	PEM_write_bio_RSAPublicKey(bio, m_keyPair);
+	char* buffer = nullptr;
+	size_t length = BIO_get_mem_data(bio, &buffer);
+	m_publicPem.assign(buffer, length);
+	BIO_free(bio);
+
+	// Operación privada de prueba: precalcula Montgomery y blinding y valida el par
+	unsigned char probe[kAESKeySize];
+	RAND_bytes(probe, sizeof(probe));
+	std::vector<unsigned char> wrapped(RSA_size(m_keyPair));
+	int result = RSA_public_encrypt(sizeof(probe), probe, wrapped.data(), m_keyPair, RSA_PKCS1_OAEP_PADDING);
+	std::vector<unsigned char> unwrapped;
+	if (result > 0) {
+		wrapped.resize(result);
+		unwrapped = UnwrapAESKey(wrapped);
+	}
+	if (unwrapped.size() != sizeof(probe) || std::memcmp(unwrapped.data(), probe, sizeof(probe)) != 0) {
+		RSA_free(m_keyPair);
+		throw std::runtime_error("Server identity self-test failed.");
+	}
+	OPENSSL_cleanse(probe, sizeof(probe));
+}
+
+ServerIdentity::~ServerIdentity() {
+	if (m_keyPair) {
+		RSA_free(m_keyPair);
+	}
+}
+
+std::vector<unsigned char>
+ServerIdentity::UnwrapAESKey(const std::vector<unsigned char>& encryptedKey) const {
+	// RSA_private_decrypt necesita un buffer del tamaño del módulo
+	std::vector<unsigned char> key(RSA_size(m_keyPair));
+	int result = RSA_private_decrypt(static_cast<int>(encryptedKey.size()),
+		encryptedKey.data(),
+		key.data(),
+		m_keyPair,
+		RSA_PKCS1_OAEP_PADDING);
+	if (result != static_cast<int>(kAESKeySize)) {
+		OPENSSL_cleanse(key.data(), key.size());
+		return {};
+	}
+	key.resize(result);
+	return key;
+}
+
+std::vector<unsigned char>
+ServerIdentity::ExportPrivateKey() const {
+	int length = i2d_RSAPrivateKey(m_keyPair, nullptr);
+	if (length <= 0) return {};
+	std::vector<unsigned char> der(length);
+	unsigned char* p = der.data();
+	i2d_RSAPrivateKey(m_keyPair, &p);
+	return der;
+}
@@ -0,0 +1,1139 @@
+/**
+ * @file ServerShard.cpp
+ * @brief Implementación del reactor por núcleo del servidor en modo sharded.
+ *
+ * @details
+ * Este módulo se encarga de:
+ *  - Aceptar conexiones del listener propio (o compartido) sin bloquear.
+ *  - Ejecutar el handshake RSA/AES de cada sesión como máquina de estados.
+ *  - Extraer frames IV/len/cipher, descifrarlos y responder con eco cifrado.
+ *  - Reenviar frames enrutados al shard y sesión del destino sin descifrarlos.
+ *  - Repartir los frames de sala serializados una sola vez (fan-out por puntero).
+ *  - Repartir sobres: una envoltura por destinatario y un único cuerpo compartido.
+ *  - Vaciar colas de envío respetando la contrapresión del socket.
+ *  - Hibernar las sesiones sin tráfico y reconstruirlas cuando vuelve a haberlo.
+ *  - Cerrar las conexiones que no completan el handshake a tiempo (rueda de temporizadores).
+ *  - Latido: Ping a las sesiones calladas, RTT suavizado y cierre de las que no responden.
+ *
+ * @note Todo el estado de las sesiones es local al hilo del shard.
+ */
+
+#include "ServerShard.h"
+#include <algorithm>
+
+namespace {
+	/// Marca final de la clave pública PEM enviada por el cliente.
+	const char kPemEnd[] = "-----END RSA PUBLIC KEY-----";
+	/// Tamaño de la clave AES cifrada con RSA-2048.
+	const size_t kWrappedKeySize = 256;
+	/// Límite de PEM sin terminar antes de descartar la conexión.
+	const size_t kMaxPemSize = 8192;
+	/// Plazo para completar el handshake; después la conexión se cierra.
+	const std::chrono::milliseconds kHandshakeTimeout(10000);
+	/// Lectura de una sesión hibernada: cabe una ráfaga de latidos, no un mensaje.
+	const size_t kHibernatedReadSize = 256;
+	/// Tamaño de un Ping o un Pong serializado.
+	const size_t kHeartbeatFrameSize = Frame::kHeaderSize + Heartbeat::kPayloadSize;
+	/// Reintento de un Ping que no cupo en el socket de una sesión hibernada.
+	const std::chrono::milliseconds kHeartbeatRetry(100);
+
+	/// Resultado de enviar un latido sin cola.
+	enum class HeartbeatSend {
+		Sent,                                        ///< Salió entero.
+		Blocked,                                     ///< Socket lleno (WSAEWOULDBLOCK): no salió nada.
+		Failed                                       ///< Socket roto.
+	};
+
+	/// Envía un latido directamente al socket de una sesión hibernada (su cola está vacía).
+	HeartbeatSend SendHeartbeat(SOCKET sock, const Frame& frame) {
+		std::vector<unsigned char> bytes = frame.Encode();
+		int n = send(sock, (const char*)bytes.data(), static_cast<int>(bytes.size()), 0);
+		// Sin datos por delante en el socket salen los 28 bytes enteros; lo demás es un socket roto
+		if (n == SOCKET_ERROR) return WSAGetLastError() == WSAEWOULDBLOCK ? HeartbeatSend::Blocked : HeartbeatSend::Failed;
+		return n == static_cast<int>(bytes.size()) ? HeartbeatSend::Sent : HeartbeatSend::Failed;
+	}
+}
+
+ServerShard::ServerShard(int index, int port, std::shared_ptr<const ServerIdentity> identity)
+	: m_index(index), m_port(port), m_identity(std::move(identity)),
+	  m_now(std::chrono::steady_clock::now()), m_timers(std::chrono::milliseconds(10), m_now),
+	  m_nextSessionId((static_cast<uint64_t>(index) << 48) + 1) {
+	// La PEM se envía a cada cliente: un buffer por shard, compartido por todas sus colas
+	const std::string& pem = m_identity->GetPublicKeyString();
+	m_identityPem = std::make_shared<const std::vector<unsigned char>>(pem.begin(), pem.end());
+
+	// Par de sockets para despertar WSAPoll desde Stop()
+	if (m_net.CreateSocketPair(m_wakeSend, m_wakeRecv)) {
+		m_net.SetNonBlocking(m_wakeRecv);
+	}
+	else {
+		Logger::Error("[Shard {}] No se pudo crear el socket de despertar.\n", m_index);
+	}
+	m_running = true;
+}
+
+ServerShard::~ServerShard() {
+	for (auto& entry : m_sessions) {
+		m_net.close(entry.second->sock);
+	}
+	m_sessions.clear();
+	for (auto& entry : m_hibernated) {
+		m_net.close(entry.second.sock);
+	}
+	m_hibernated.clear();
+	if (m_wakeSend != INVALID_SOCKET) m_net.close(m_wakeSend);
+	if (m_wakeRecv != INVALID_SOCKET) m_net.close(m_wakeRecv);
+}
+
+bool
+ServerShard::Listen(bool fastOpen) {
+	m_net.EnableFastOpen(fastOpen);
+	if (!m_net.StartServer(m_port, true)) {
+		return false;
+	}
+	m_listenSock = m_net.m_serverSocket;
+	m_net.SetNonBlocking(m_listenSock);
+	return true;
+}
+
+bool
+ServerShard::ListenLocal(const std::string& address) {
+	if (address.compare(0, 5, "unix:") != 0 || !m_net.StartServer(address)) {
+		return false;
+	}
+	m_listenSock = m_net.m_serverSocket;
+	m_net.SetNonBlocking(m_listenSock);
+	return true;
+}
+
+void
+ServerShard::ShareListener(SOCKET listener) {
+	// El socket pertenece al shard que lo creó; aquí solo se vigila
+	m_listenSock = listener;
+}
+
+void
+ServerShard::AdoptListener(SOCKET listener) {
+	// El NetworkHelper del shard cierra el listener al destruirse
+	m_net.m_serverSocket = listener;
+	m_listenSock = listener;
+	m_net.SetNonBlocking(m_listenSock);
+}
+
+void
+ServerShard::AdoptSession(std::unique_ptr<Session> session) {
+	Session& ref = AddSession(std::move(session));
+	for (const FrameBuffer& frame : ref.txQueue) {
+		m_metrics.queuedEntries.Add(1);
+		m_metrics.queuedBytes.Add(static_cast<int64_t>(frame->size()));
+	}
+
+	// Handshake a medias: sigue con la identidad heredada y un plazo nuevo
+	if (ref.state != SessionState::Established) {
+		ref.acceptedAt = m_now;
+		m_timers.Schedule(kHandshakeTimeout, ref.id, HandshakeTimer);
+		// Lo ya recibido no volverá a señalizar lectura
+		if (!ref.rx.empty()) ProcessHandshake(ref);
+		if (ref.state == SessionState::Closing) CloseSession(ref.id);
+		return;
+	}
+
+	// El id de sesión cambia al heredarla: se vuelve a registrar el usuario
+	if (ref.userId != 0 && m_directory) {
+		UserRoute route;
+		route.shard = m_index;
+		route.sessionId = ref.id;
+		route.publicKey = ref.peerPem;
+		if (!m_directory->Register(ref.userId, route)) ref.userId = 0;
+	}
+
+	// Las salas se reconstruyen en silencio: para los demás miembros nada cambió
+	std::vector<uint32_t> rooms;
+	rooms.swap(ref.rooms);
+	if (ref.userId != 0 && m_rooms) {
+		for (uint32_t roomId : rooms) {
+			if (m_rooms->Join(roomId, RoomMember{ ref.userId, m_index, ref.id })) ref.rooms.push_back(roomId);
+		}
+	}
+	ArmIdleTimer(ref, m_hibernateAfter);
+	ArmHeartbeat(ref.id, m_heartbeatInterval);
+}
+
+void
+ServerShard::ExtractSessions(std::vector<std::unique_ptr<Session>>& out) {
+	// Frames ya enrutados hacia este shard viajan en la cola de envío de su sesión
+	DrainInbox();
+	// Las hibernadas se reconstruyen: el traspaso serializa sesiones completas
+	while (!m_hibernated.empty()) {
+		Wake(m_hibernated.begin()->first);
+	}
+	for (auto& entry : m_sessions) {
+		// Sin avisos: el sucesor vuelve a registrar usuario y salas
+		std::vector<uint32_t> rooms = entry.second->rooms;
+		Unregister(*entry.second, false);
+		ForgetRtt(entry.second->heartbeat);
+		ForgetQueue(*entry.second);
+		entry.second->rooms = std::move(rooms);
+		// Las que están en handshake también: el sucesor hereda la identidad RSA
+		if (entry.second->state != SessionState::Closing) {
+			out.push_back(std::move(entry.second));
+		}
+		else {
+			m_net.close(entry.second->sock);
+		}
+	}
+	m_sessions.clear();
+	m_sessionCount = 0;
+}
+
+void
+ServerShard::Stop() {
+	m_running = false;
+	if (m_wakeSend != INVALID_SOCKET) {
+		const char b = 1;
+		send(m_wakeSend, &b, 1, 0);
+	}
+}
+
+void
+ServerShard::Run() {
+	std::vector<WSAPOLLFD> fds;
+	std::vector<uint64_t> ids;
+
+	while (m_running.load()) {
+		fds.clear();
+		ids.clear();
+
+		// 0) Socket de despertar
+		WSAPOLLFD wake{};
+		wake.fd = m_wakeRecv;
+		wake.events = POLLRDNORM;
+		fds.push_back(wake);
+
+		// 1) Listener, salvo que otro shard esté menos cargado
+		bool acceptSlot = m_listenSock != INVALID_SOCKET && !ShouldYieldAccept();
+		if (acceptSlot) {
+			WSAPOLLFD lfd{};
+			lfd.fd = m_listenSock;
+			lfd.events = POLLRDNORM;
+			fds.push_back(lfd);
+		}
+
+		// 2) Sesiones: lectura siempre, escritura solo con cola pendiente
+		for (auto& entry : m_sessions) {
+			WSAPOLLFD sfd{};
+			sfd.fd = entry.second->sock;
+			sfd.events = POLLRDNORM;
+			if (!entry.second->txQueue.empty()) sfd.events |= POLLWRNORM;
+			fds.push_back(sfd);
+			ids.push_back(entry.first);
+		}
+		// 3) Hibernadas: solo lectura, su cola está vacía
+		for (auto& entry : m_hibernated) {
+			WSAPOLLFD sfd{};
+			sfd.fd = entry.second.sock;
+			sfd.events = POLLRDNORM;
+			fds.push_back(sfd);
+			ids.push_back(entry.first);
+		}
+
+		// La espera termina como tarde en el próximo tick con temporizadores
+		std::chrono::milliseconds limit(acceptSlot ? 1000 : 50);
+		int timeout = static_cast<int>(m_timers.NextTimeout(std::chrono::steady_clock::now(), limit).count());
+		int ready = WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), timeout);
+		if (ready == SOCKET_ERROR) {
+			Logger::Error("[Shard {}] Error en WSAPoll: {}\n", m_index, WSAGetLastError());
+			break;
+		}
+		m_now = std::chrono::steady_clock::now();
+		m_expired.clear();
+		m_timers.Advance(m_now, m_expired);
+		for (const TimerWheel::Expired& timer : m_expired) {
+			OnTimer(timer);
+		}
+		if (ready == 0) continue;
+
+		size_t base = 1;
+		if (fds[0].revents) {
+			char drain[64];
+			while (recv(m_wakeRecv, drain, sizeof(drain), 0) > 0) {}
+			DrainInbox();
+		}
+		if (acceptSlot) {
+			if (fds[1].revents & POLLRDNORM) AcceptPending();
+			base = 2;
+		}
+
+		for (size_t i = 0; i < ids.size(); ++i) {
+			short revents = fds[base + i].revents;
+			if (!revents) continue;
+
+			// Sesión hibernada: los latidos se atienden sin reconstruirla; el resto la despierta
+			auto it = m_sessions.find(ids[i]);
+			Session* active = (it != m_sessions.end()) ? it->second.get() : ReadHibernated(ids[i]);
+			if (!active) continue;
+			Session& session = *active;
+
+			if (revents & POLLNVAL) {
+				session.state = SessionState::Closing;
+			}
+			if (revents & (POLLRDNORM | POLLHUP | POLLERR)) {
+				OnReadable(session);
+			}
+			if (session.state != SessionState::Closing && (revents & POLLWRNORM)) {
+				OnWritable(session);
+			}
+			if (session.state == SessionState::Closing) {
+				CloseSession(session.id);
+			}
+		}
+	}
+}
+
+bool
+ServerShard::ShouldYieldAccept() const {
+	// Con SO_REUSEPORT el kernel ya reparte; con listener compartido se equilibra aquí
+	if (!m_peers || NetworkHelper::SupportsReusePort()) return false;
+
+	size_t mine = GetSessionCount();
+	for (const auto& peer : *m_peers) {
+		if (peer.get() != this && peer->GetSessionCount() + 1 < mine) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void
+ServerShard::AcceptPending() {
+	while (true) {
+		SOCKET clientSock = accept(m_listenSock, nullptr, nullptr);
+		if (clientSock == INVALID_SOCKET) {
+			int err = WSAGetLastError();
+			if (err != WSAEWOULDBLOCK) {
+				Logger::Warn("[Shard {}] Error aceptando cliente: {}\n", m_index, err);
+			}
+			break;
+		}
+		auto session = std::make_unique<Session>();
+		session->sock = clientSock;
+		session->acceptedAt = m_now;
+		session->traceId = Tracer::Instance().BeginTrace();
+		Session& ref = AddSession(std::move(session));
+		m_accepted.fetch_add(1, std::memory_order_relaxed);
+		m_timers.Schedule(kHandshakeTimeout, ref.id, HandshakeTimer);
+
+		// 1. Enviar clave pública del shard (mismo paso que Server::WaitForClient)
+		Queue(ref, m_identityPem);
+		if (ref.state == SessionState::Closing) {
+			CloseSession(ref.id);
+		}
+
+		if (ShouldYieldAccept()) break;
+	}
+}
+
+void
+ServerShard::OnReadable(Session& session) {
+	unsigned char buffer[16384];
+	// Lecturas acotadas por evento para no acaparar el bucle con un solo cliente
+	for (int i = 0; i < 4; ++i) {
+		int n = recv(session.sock, (char*)buffer, sizeof(buffer), 0);
+		if (n > 0) {
+			m_metrics.bytesIn.Add(n);
+			session.heartbeat.OnHeard(m_now);
+			session.rx.insert(session.rx.end(), buffer, buffer + n);
+			if (n < static_cast<int>(sizeof(buffer))) break;
+			continue;
+		}
+		if (n == 0) {
+			session.state = SessionState::Closing;
+			return;
+		}
+		if (WSAGetLastError() == WSAEWOULDBLOCK) break;
+		session.state = SessionState::Closing;
+		return;
+	}
+
+	if (session.state != SessionState::Established) {
+		ProcessHandshake(session);
+	}
+	if (session.state == SessionState::Established) {
+		ProcessFrames(session);
+	}
+}
+
+void
+ServerShard::ProcessHandshake(Session& session) {
+	// 2. Recibir clave pública del cliente (PEM sin framing)
+	if (session.state == SessionState::AwaitingPeerKey) {
+		auto it = std::search(session.rx.begin(), session.rx.end(),
+			kPemEnd, kPemEnd + sizeof(kPemEnd) - 1);
+		if (it == session.rx.end()) {
+			if (session.rx.size() > kMaxPemSize) session.state = SessionState::Closing;
+			return;
+		}
+		auto end = it + (sizeof(kPemEnd) - 1);
+		if (end == session.rx.end()) return; // falta el salto de línea final
+		if (*end == '\n') ++end;
+
+		std::string pem(session.rx.begin(), end);
+		session.rx.erase(session.rx.begin(), end);
+		// Solo se valida: la sesión guarda la PEM (para el directorio), no un RSA* propio
+		bool validKey;
+		{
+			TraceSpan parse(session.traceId, "parse_client_pem");
+			validKey = CryptoHelper::IsValidPublicKey(pem);
+		}
+		if (!validKey) {
+			Logger::Warn("[Shard {}] Clave pública del cliente inválida.\n", m_index);
+			session.state = SessionState::Closing;
+			return;
+		}
+		session.peerPem = std::make_shared<const std::string>(std::move(pem));
+		session.state = SessionState::AwaitingAESKey;
+	}
+
+	// 3. Recibir clave AES cifrada con la pública del shard
+	if (session.state == SessionState::AwaitingAESKey) {
+		if (session.rx.size() < kWrappedKeySize) return;
+
+		std::vector<unsigned char> wrapped(session.rx.begin(), session.rx.begin() + kWrappedKeySize);
+		session.rx.erase(session.rx.begin(), session.rx.begin() + kWrappedKeySize);
+
+		std::vector<unsigned char> key;
+		{
+			TraceSpan unwrap(session.traceId, "rsa_unwrap_aes_key");
+			key = m_identity->UnwrapAESKey(wrapped);
+		}
+		if (key.empty()) {
+			Logger::Warn("[Shard {}] Clave AES inválida.\n", m_index);
+			session.state = SessionState::Closing;
+			return;
+		}
+		session.crypto.SetAESKey(key);
+		session.state = SessionState::Established;
+		session.lastActivity = m_now;
+		// Reloj real: el descifrado RSA de esta misma iteración forma parte de la latencia
+		m_metrics.handshakes.Add();
+		auto established = std::chrono::steady_clock::now();
+		m_metrics.handshakeLatency.Observe(established - session.acceptedAt);
+		if (session.traceId) {
+			// Fase completa, del accept al canal AES: abarca varias vueltas del bucle
+			Tracer& tracer = Tracer::Instance();
+			TraceEvent event;
+			event.name = "handshake";
+			event.traceId = session.traceId;
+			event.startUs = tracer.ToMicros(session.acceptedAt);
+			event.durationUs = tracer.ToMicros(established) - event.startUs;
+			event.thread = Tracer::ThreadOrdinal();
+			tracer.Record(event);
+		}
+		ArmIdleTimer(session, m_hibernateAfter);
+		ArmHeartbeat(session.id, m_heartbeatInterval);
+	}
+}
+
+void
+ServerShard::ProcessFrames(Session& session) {
+	size_t offset = 0;
+	FrameHeader header;
+	while (Frame::ParseHeader(session.rx.data() + offset, session.rx.size() - offset, header)) {
+		if (header.length > Frame::kMaxPayload) {
+			Logger::Warn("[Shard {}] Frame demasiado grande: {}\n", m_index, header.length);
+			session.state = SessionState::Closing;
+			break;
+		}
+		if (session.rx.size() - offset < header.totalSize) break;
+
+		const unsigned char* frame = session.rx.data() + offset;
+		offset += header.totalSize;
+		session.messagesIn++;
+		if (m_capture) m_capture->Record(session.id, true, header, frame[0], frame + header.headerSize);
+		m_messages.fetch_add(1, std::memory_order_relaxed);
+		if (header.flags & Frame::kStampedFlag) {
+			// Reloj de pared del cliente contra el nuestro: solo vale con relojes sincronizados
+			uint64_t now = Frame::NowMicros();
+			if (header.sentAtUs <= now) {
+				m_metrics.clientToShard.Observe(std::chrono::microseconds(now - header.sentAtUs));
+			}
+		}
+		// Los latidos no cuentan como actividad: no deben impedir la hibernación
+		if (header.flags != Frame::kControlFlag || (frame[0] != Frame::Ping && frame[0] != Frame::Pong)) {
+			session.lastActivity = m_now;
+		}
+
+		// Enrutado: el servidor solo mira la cabecera (también KeyWrap, commits y Welcome)
+		if (header.flags & Frame::kRoutedFlag) {
+			RouteFrame(session, frame, header);
+			continue;
+		}
+		if (header.flags & Frame::kControlFlag) {
+			HandleControl(session, frame, header);
+			continue;
+		}
+		// En modo relay el servidor no participa en el cifrado
+		if (m_relayOnly) continue;
+
+		std::vector<unsigned char> iv(frame, frame + Frame::kIvSize);
+		std::vector<unsigned char> cipher(frame + header.headerSize, frame + header.totalSize);
+		auto start = std::chrono::steady_clock::now();
+		std::string plain = session.crypto.AESDecrypt(cipher, iv);
+		m_metrics.decryptTime.Observe(std::chrono::steady_clock::now() - start);
+		QueueEncrypted(session, plain, header);
+	}
+	session.rx.erase(session.rx.begin(), session.rx.begin() + offset);
+}
+
+void
+ServerShard::RouteFrame(Session& session, const unsigned char* frame, const FrameHeader& header) {
+	if (header.dst & Frame::kRoomAddress) {
+		RouteToRoom(session, frame, header);
+		return;
+	}
+
+	UserRoute route;
+	if (session.userId == 0 || !m_directory || !m_directory->Lookup(header.dst, route)) {
+		return; // origen sin registrar o destino desconectado: se descarta
+	}
+
+	// Una sola copia del frame; el origen lo fija el servidor, no el cliente
+	auto copy = std::make_shared<std::vector<unsigned char>>(frame, frame + header.totalSize);
+	Frame::PutU32(copy->data() + Frame::kHeaderSize + 4, session.userId);
+	m_routed.fetch_add(1, std::memory_order_relaxed);
+
+	if (route.shard == m_index) {
+		DeliverLocal(route.sessionId, std::move(copy));
+	}
+	else if (m_peers && route.shard >= 0 && route.shard < static_cast<int>(m_peers->size())) {
+		(*m_peers)[route.shard]->Deliver(route.sessionId, std::move(copy));
+	}
+}
+
+void
+ServerShard::RouteToRoom(Session& session, const unsigned char* frame, const FrameHeader& header) {
+	uint32_t roomId = header.dst & ~Frame::kRoomAddress;
+	// Solo los miembros escriben en la sala
+	if (session.userId == 0 || !m_rooms ||
+		std::find(session.rooms.begin(), session.rooms.end(), roomId) == session.rooms.end()) {
+		return;
+	}
+	RoomSnapshot members = m_rooms->Members(roomId);
+	if (!members) return;
+
+	// Commit del árbol de claves: solo el del responsable sobre la época vigente; su emisor recibe el eco
+	uint32_t exceptUser = session.userId;
+	if ((header.flags & Frame::kControlFlag) && frame[0] == Frame::RoomCommit) {
+		if (header.length < 4 ||
+			!m_rooms->AdvanceEpoch(roomId, session.userId, Frame::GetU32(frame + header.headerSize))) {
+			return;
+		}
+		m_commits.fetch_add(1, std::memory_order_relaxed);
+		exceptUser = 0;
+	}
+
+	// Serialización única: todos los miembros comparten el mismo buffer
+	auto copy = std::make_shared<std::vector<unsigned char>>(frame, frame + header.totalSize);
+	Frame::PutU32(copy->data() + Frame::kHeaderSize + 4, session.userId);
+	m_routed.fetch_add(1, std::memory_order_relaxed);
+	FanOut(*members, std::move(copy), exceptUser);
+}
+
+void
+ServerShard::FanOut(const std::vector<RoomMember>& members, const FrameBuffer& frame, uint32_t exceptUser) {
+	// Un lote por shard remoto: un bloqueo y un despertar por shard, no por miembro
+	std::vector<std::vector<uint64_t>> remote(m_peers ? m_peers->size() : 0);
+	uint64_t delivered = 0;
+	for (const RoomMember& member : members) {
+		if (member.userId == exceptUser) continue;
+		if (member.shard == m_index) {
+			DeliverLocal(member.sessionId, frame);
+		}
+		else if (member.shard >= 0 && member.shard < static_cast<int>(remote.size())) {
+			remote[member.shard].push_back(member.sessionId);
+		}
+		else {
+			continue;
+		}
+		delivered++;
+	}
+	for (size_t shard = 0; shard < remote.size(); ++shard) {
+		if (!remote[shard].empty()) (*m_peers)[shard]->DeliverBatch(std::move(remote[shard]), frame);
+	}
+	m_fanOut.fetch_add(delivered, std::memory_order_relaxed);
+}
+
+void
+ServerShard::HandleControl(Session& session, const unsigned char* frame, const FrameHeader& header) {
+	const unsigned char* payload = frame + header.headerSize;
+	Frame::ControlType type = static_cast<Frame::ControlType>(frame[0]);
+
+	if (type == Frame::Register && header.length == 4) {
+		uint32_t userId = Frame::GetU32(payload);
+		if (session.userId == 0 && m_directory) {
+			UserRoute route;
+			route.shard = m_index;
+			route.sessionId = session.id;
+			route.publicKey = session.peerPem;
+			if (m_directory->Register(userId, route)) session.userId = userId;
+		}
+		std::vector<unsigned char> reply(4);
+		Frame::PutU32(reply.data(), session.userId == userId ? userId : 0);
+		QueueFrame(session, Frame::Control(Frame::Registered, std::move(reply)));
+	}
+	else if (type == Frame::Lookup && header.length == 4) {
+		uint32_t userId = Frame::GetU32(payload);
+		std::vector<unsigned char> reply(4);
+		Frame::PutU32(reply.data(), userId);
+		UserRoute route;
+		if (m_directory && m_directory->Lookup(userId, route) && route.publicKey) {
+			reply.insert(reply.end(), route.publicKey->begin(), route.publicKey->end());
+		}
+		QueueFrame(session, Frame::Control(Frame::PeerKey, std::move(reply)));
+	}
+	else if (type == Frame::JoinRoom && header.length >= 4) {
+		JoinRoom(session, Frame::GetU32(payload), payload + 4, header.length - 4);
+	}
+	else if (type == Frame::LeaveRoom && header.length == 4) {
+		LeaveRoom(session, Frame::GetU32(payload), true);
+	}
+	else if (type == Frame::Envelope) {
+		RouteEnvelope(session, payload, header);
+	}
+	else if (type == Frame::Ping && header.length == Heartbeat::kPayloadSize) {
+		// Eco del payload: el cliente mide el RTT con su propio reloj
+		QueueHeartbeat(session, Frame::Control(Frame::Pong,
+			std::vector<unsigned char>(payload, payload + header.length)));
+	}
+	else if (type == Frame::Pong) {
+		SampleRtt(session.heartbeat, payload, header.length);
+	}
+}
+
+void
+ServerShard::RouteEnvelope(Session& session, const unsigned char* payload, const FrameHeader& header) {
+	// iv (16) | n (2) | n x [dst (4) | len (2) | envoltura] | cuerpo
+	uint32_t length = header.length;
+	if (session.userId == 0 || !m_directory || length < Frame::kIvSize + 2) return;
+	const unsigned char* end = payload + length;
+	const unsigned char* iv = payload;
+	size_t count = (size_t(payload[Frame::kIvSize]) << 8) | payload[Frame::kIvSize + 1];
+
+	struct Wrap { uint32_t dst; const unsigned char* data; size_t size; };
+	std::vector<Wrap> wraps;
+	wraps.reserve(count);
+	const unsigned char* p = payload + Frame::kIvSize + 2;
+	for (size_t i = 0; i < count; ++i) {
+		if (end - p < 6) return;
+		Wrap wrap{ Frame::GetU32(p), p + 6, (size_t(p[4]) << 8) | p[5] };
+		if (static_cast<size_t>(end - wrap.data) < wrap.size) return; // sobre malformado: se descarta entero
+		p = wrap.data + wrap.size;
+		wraps.push_back(wrap);
+	}
+
+	// Cuerpo: una copia compartida por todos los destinatarios
+	FrameBuffer body = std::make_shared<const std::vector<unsigned char>>(p, end);
+	m_routed.fetch_add(1, std::memory_order_relaxed);
+
+	uint64_t delivered = 0;
+	for (const Wrap& wrap : wraps) {
+		UserRoute route;
+		if (!m_directory->Lookup(wrap.dst, route)) continue;
+
+		// Cabecera por destinatario: | tipo | flags+len | dst | src | [sello] | iv | len | envoltura |
+		uint32_t flags = Frame::kControlFlag | Frame::kRoutedFlag | (header.flags & Frame::kStampedFlag);
+		size_t headerSize = Frame::HeaderSize(flags);
+		auto head = std::make_shared<std::vector<unsigned char>>(
+			headerSize + Frame::kIvSize + 2 + wrap.size);
+		unsigned char* out = head->data();
+		out[0] = Frame::Envelope;
+		uint32_t total = static_cast<uint32_t>(Frame::kIvSize + 2 + wrap.size + body->size());
+		Frame::PutU32(out + Frame::kIvSize, flags | total);
+		Frame::PutU32(out + Frame::kHeaderSize, wrap.dst);
+		Frame::PutU32(out + Frame::kHeaderSize + 4, session.userId);
+		if (flags & Frame::kStampedFlag) {
+			Frame::PutU32(out + Frame::kHeaderSize + Frame::kRouteSize, header.sequence);
+			Frame::PutU64(out + Frame::kHeaderSize + Frame::kRouteSize + 4, header.sentAtUs);
+		}
+		out += headerSize;
+		std::memcpy(out, iv, Frame::kIvSize);
+		out[Frame::kIvSize] = static_cast<unsigned char>(wrap.size >> 8);
+		out[Frame::kIvSize + 1] = static_cast<unsigned char>(wrap.size);
+		std::memcpy(out + Frame::kIvSize + 2, wrap.data, wrap.size);
+
+		if (route.shard == m_index) {
+			DeliverLocal(route.sessionId, std::move(head), body);
+		}
+		else if (m_peers && route.shard >= 0 && route.shard < static_cast<int>(m_peers->size())) {
+			(*m_peers)[route.shard]->Deliver(route.sessionId, std::move(head), body);
+		}
+		else {
+			continue;
+		}
+		delivered++;
+	}
+	m_envelopes.fetch_add(delivered, std::memory_order_relaxed);
+}
+
+void
+ServerShard::JoinRoom(Session& session, uint32_t roomId, const unsigned char* leafKey, size_t leafKeySize) {
+	if (session.userId == 0 || !m_rooms) return;
+	if (m_rooms->Join(roomId, RoomMember{ session.userId, m_index, session.id })) {
+		session.rooms.push_back(roomId);
+		NotifyRoom(roomId, session.userId, true, leafKey, leafKeySize);
+	}
+
+	// Lista de miembros para el que entra (también si ya estaba)
+	std::vector<unsigned char> reply(4);
+	Frame::PutU32(reply.data(), roomId);
+	if (RoomSnapshot members = m_rooms->Members(roomId)) {
+		reply.reserve(4 + members->size() * 4);
+		for (const RoomMember& member : *members) {
+			if (member.userId == session.userId) continue;
+			unsigned char id[4];
+			Frame::PutU32(id, member.userId);
+			reply.insert(reply.end(), id, id + 4);
+		}
+	}
+	QueueFrame(session, Frame::Control(Frame::RoomMembers, std::move(reply)));
+}
+
+void
+ServerShard::LeaveRoom(Session& session, uint32_t roomId, bool notify) {
+	auto it = std::find(session.rooms.begin(), session.rooms.end(), roomId);
+	if (it == session.rooms.end()) return;
+	session.rooms.erase(it);
+	if (m_rooms && m_rooms->Leave(roomId, session.userId) && notify) {
+		NotifyRoom(roomId, session.userId, false);
+	}
+}
+
+void
+ServerShard::NotifyRoom(uint32_t roomId, uint32_t userId, bool joined,
+	const unsigned char* leafKey, size_t leafKeySize) {
+	RoomSnapshot members = m_rooms->Members(roomId);
+	if (!members) return;
+	std::vector<unsigned char> payload(13);
+	Frame::PutU32(payload.data(), roomId);
+	Frame::PutU32(payload.data() + 4, userId);
+	payload[8] = joined ? 1 : 0;
+	Frame::PutU32(payload.data() + 9, m_rooms->Sponsor(roomId, userId));
+	if (leafKey) payload.insert(payload.end(), leafKey, leafKey + leafKeySize);
+	FrameBuffer frame = std::make_shared<const std::vector<unsigned char>>(
+		Frame::Control(Frame::RoomEvent, std::move(payload)).Encode());
+	FanOut(*members, frame, userId);
+}
+
+void
+ServerShard::Unregister(Session& session, bool notify) {
+	while (!session.rooms.empty()) {
+		LeaveRoom(session, session.rooms.back(), notify);
+	}
+	if (session.userId != 0 && m_directory) {
+		m_directory->Unregister(session.userId, session.id);
+	}
+}
+
+void
+ServerShard::Deliver(uint64_t sessionId, FrameBuffer frame, FrameBuffer tail) {
+	DeliverBatch(std::vector<uint64_t>{ sessionId }, std::move(frame), std::move(tail));
+}
+
+void
+ServerShard::DeliverBatch(std::vector<uint64_t> sessionIds, FrameBuffer frame, FrameBuffer tail) {
+	bool wasEmpty = false;
+	{
+		std::lock_guard<std::mutex> lock(m_inboxMutex);
+		wasEmpty = m_inbox.empty();
+		m_inbox.push_back(InboxBatch{ std::move(sessionIds), std::move(frame), std::move(tail) });
+	}
+	// Un solo byte de despertar por lote: el bucle vacía el buzón completo
+	if (wasEmpty && m_wakeSend != INVALID_SOCKET) {
+		const char b = 1;
+		send(m_wakeSend, &b, 1, 0);
+	}
+}
+
+void
+ServerShard::DrainInbox() {
+	std::vector<InboxBatch> batches;
+	{
+		std::lock_guard<std::mutex> lock(m_inboxMutex);
+		batches.swap(m_inbox);
+	}
+	for (const InboxBatch& batch : batches) {
+		for (uint64_t sessionId : batch.sessionIds) {
+			DeliverLocal(sessionId, batch.frame, batch.tail);
+		}
+	}
+}
+
+void
+ServerShard::DeliverLocal(uint64_t sessionId, FrameBuffer frame, FrameBuffer tail) {
+	auto it = m_sessions.find(sessionId);
+	Session* active = (it != m_sessions.end()) ? it->second.get() : Wake(sessionId);
+	if (!active) return;
+	Session& target = *active;
+	if (target.state != SessionState::Established) return;
+	// Si el envío falla, WSAPoll reportará el error y el bucle cerrará la sesión
+	target.messagesOut++;
+	m_metrics.messagesOut.Add();
+	Queue(target, std::move(frame), std::move(tail));
+}
+
+void
+ServerShard::QueueFrame(Session& session, const Frame& frame) {
+	Queue(session, std::make_shared<const std::vector<unsigned char>>(frame.Encode()));
+}
+
+void
+ServerShard::QueueHeartbeat(Session& session, const Frame& frame) {
+	// Como Queue() pero sin tocar lastActivity
+	bool wasEmpty = session.txQueue.empty();
+	session.txQueue.push_back(std::make_shared<const std::vector<unsigned char>>(frame.Encode()));
+	m_metrics.queuedEntries.Add(1);
+	m_metrics.queuedBytes.Add(static_cast<int64_t>(session.txQueue.back()->size()));
+	if (wasEmpty) OnWritable(session);
+}
+
+void
+ServerShard::QueueEncrypted(Session& session, const std::string& plaintext, const FrameHeader& request) {
+	std::vector<unsigned char> iv;
+	auto start = std::chrono::steady_clock::now();
+	auto cipher = session.crypto.AESEncrypt(plaintext, iv);
+	m_metrics.encryptTime.Observe(std::chrono::steady_clock::now() - start);
+
+	// El eco devuelve el sello tal cual: el cliente mide la ida y vuelta con su reloj
+	uint32_t flags = request.flags & Frame::kStampedFlag;
+	size_t headerSize = Frame::HeaderSize(flags);
+	auto frame = std::make_shared<std::vector<unsigned char>>(headerSize + cipher.size());
+	unsigned char* out = frame->data();
+	std::memcpy(out, iv.data(), Frame::kIvSize);
+	Frame::PutU32(out + Frame::kIvSize, flags | static_cast<uint32_t>(cipher.size()));
+	if (flags) {
+		Frame::PutU32(out + Frame::kHeaderSize, request.sequence);
+		Frame::PutU64(out + Frame::kHeaderSize + 4, request.sentAtUs);
+	}
+	std::memcpy(out + headerSize, cipher.data(), cipher.size());
+
+	session.messagesOut++;
+	m_metrics.messagesOut.Add();
+	Queue(session, std::move(frame));
+}
+
+void
+ServerShard::Queue(Session& session, FrameBuffer frame, FrameBuffer tail) {
+	bool wasEmpty = session.txQueue.empty();
+	session.lastActivity = m_now;
+	m_metrics.queuedEntries.Add(tail ? 2 : 1);
+	m_metrics.queuedBytes.Add(static_cast<int64_t>(frame->size() + (tail ? tail->size() : 0)));
+	session.txQueue.push_back(std::move(frame));
+	// Cabecera y resto van seguidos en la cola: el flujo TCP los une sin copiar
+	if (tail) session.txQueue.push_back(std::move(tail));
+	// Escritura directa si no había nada pendiente: evita esperar a WSAPoll
+	if (wasEmpty) OnWritable(session);
+}
+
+void
+ServerShard::OnWritable(Session& session) {
+	while (!session.txQueue.empty()) {
+		const std::vector<unsigned char>& frame = *session.txQueue.front();
+		int n = send(session.sock,
+			(const char*)frame.data() + session.txOffset,
+			static_cast<int>(frame.size() - session.txOffset), 0);
+		if (n == SOCKET_ERROR) {
+			if (WSAGetLastError() != WSAEWOULDBLOCK) session.state = SessionState::Closing;
+			return;
+		}
+		session.txOffset += n;
+		m_metrics.bytesOut.Add(n);
+		if (session.txOffset == frame.size()) {
+			m_metrics.queuedEntries.Add(-1);
+			m_metrics.queuedBytes.Add(-static_cast<int64_t>(frame.size()));
+			session.txQueue.pop_front();
+			session.txOffset = 0;
+		}
+	}
+}
+
+Session&
+ServerShard::AddSession(std::unique_ptr<Session> session) {
+	m_net.SetNonBlocking(session->sock);
+	int on = 1;
+	setsockopt(session->sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+
+	session->id = m_nextSessionId++;
+	Session& ref = *session;
+	m_sessions.emplace(ref.id, std::move(session));
+	m_sessionCount.fetch_add(1, std::memory_order_relaxed);
+	return ref;
+}
+
+void
+ServerShard::CloseSession(uint64_t id) {
+	auto it = m_sessions.find(id);
+	if (it == m_sessions.end()) return;
+	// Fuera del mapa antes de avisar: el aviso puede despertar sesiones hibernadas
+	std::unique_ptr<Session> session = std::move(it->second);
+	m_sessions.erase(it);
+	Unregister(*session, true);
+	ForgetRtt(session->heartbeat);
+	ForgetQueue(*session);
+	if (m_capture) m_capture->Forget(session->id);
+	m_net.close(session->sock);
+	m_sessionCount.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void
+ServerShard::ForgetQueue(const Session& session) {
+	int64_t bytes = 0;
+	for (const FrameBuffer& frame : session.txQueue) {
+		bytes += static_cast<int64_t>(frame->size());
+	}
+	m_metrics.queuedEntries.Add(-static_cast<int64_t>(session.txQueue.size()));
+	m_metrics.queuedBytes.Add(-bytes);
+}
+
+void
+ServerShard::OnTimer(const TimerWheel::Expired& timer) {
+	if (timer.kind == HeartbeatTimer) {
+		OnHeartbeat(timer.owner);
+		return;
+	}
+	auto it = m_sessions.find(timer.owner);
+	if (it == m_sessions.end()) return; // cerrada o hibernada
+	Session& session = *it->second;
+
+	if (timer.kind == HandshakeTimer) {
+		// Cliente medio abierto o que no envía sus claves: no retiene la sesión
+		if (session.state != SessionState::Established) CloseSession(session.id);
+		return;
+	}
+	if (timer.kind == IdleTimer && session.state == SessionState::Established) {
+		// Plazo perezoso: la actividad solo actualiza lastActivity y aquí se recalcula
+		auto idle = std::chrono::duration_cast<std::chrono::milliseconds>(m_now - session.lastActivity);
+		if (idle < m_hibernateAfter) {
+			ArmIdleTimer(session, m_hibernateAfter - idle);
+		}
+		else if (!session.rx.empty() || !session.txQueue.empty()) {
+			ArmIdleTimer(session, m_hibernateAfter); // envío bloqueado: se reintenta más tarde
+		}
+		else {
+			std::unique_ptr<Session> owned = std::move(it->second);
+			m_sessions.erase(it);
+			Hibernate(std::move(owned));
+		}
+	}
+}
+
+void
+ServerShard::ArmIdleTimer(const Session& session, std::chrono::milliseconds delay) {
+	if (m_hibernateAfter.count() > 0) m_timers.Schedule(delay, session.id, IdleTimer);
+}
+
+void
+ServerShard::ArmHeartbeat(uint64_t id, std::chrono::milliseconds delay) {
+	if (m_heartbeatInterval.count() > 0) m_timers.Schedule(delay, id, HeartbeatTimer);
+}
+
+void
+ServerShard::OnHeartbeat(uint64_t id) {
+	// Un único temporizador por sesión, también mientras hiberna
+	auto active = m_sessions.find(id);
+	Session* session = (active != m_sessions.end()) ? active->second.get() : nullptr;
+	HibernatedSession* record = nullptr;
+	if (!session) {
+		auto it = m_hibernated.find(id);
+		if (it == m_hibernated.end()) return; // cerrada: la cadena termina aquí
+		record = &it->second;
+	}
+	else if (session->state != SessionState::Established) {
+		return;
+	}
+	Heartbeat& heartbeat = session ? session->heartbeat : record->heartbeat;
+
+	// Hubo tráfico dentro del intervalo: se revisa cuando se cumpla
+	std::chrono::milliseconds silence = heartbeat.Silence(m_now);
+	if (silence < m_heartbeatInterval) {
+		ArmHeartbeat(id, m_heartbeatInterval - silence);
+		return;
+	}
+
+	bool alive = heartbeat.Missed() < m_maxMissedPings;
+	if (alive) {
+		Frame ping = Frame::Control(Frame::Ping, Heartbeat::PingPayload(m_now));
+		if (session) {
+			heartbeat.OnPingSent();
+			QueueHeartbeat(*session, ping);
+			alive = session->state != SessionState::Closing;
+		}
+		else {
+			HeartbeatSend sent = SendHeartbeat(record->sock, ping);
+			if (sent == HeartbeatSend::Blocked) {
+				// El Ping no salió: ni cuenta como enviado ni suma bytes. Un peer que no lee
+				// acaba igual que uno que no responde, tras el mismo silencio
+				alive = silence < m_heartbeatInterval * (m_maxMissedPings + 1);
+				if (alive) {
+					ArmHeartbeat(id, kHeartbeatRetry);
+					return;
+				}
+			}
+			else {
+				alive = sent == HeartbeatSend::Sent;
+				if (alive) {
+					heartbeat.OnPingSent();
+					m_metrics.bytesOut.Add(kHeartbeatFrameSize);
+				}
+			}
+		}
+	}
+	if (alive) {
+		ArmHeartbeat(id, m_heartbeatInterval);
+		return;
+	}
+
+	// Peer caído: se cierra por el camino normal (socket, buffers, directorio y salas)
+	if (!session) Wake(id);
+	m_reaped.fetch_add(1, std::memory_order_relaxed);
+	CloseSession(id);
+}
+
+void
+ServerShard::SampleRtt(Heartbeat& heartbeat, const unsigned char* payload, size_t size) {
+	bool first = !heartbeat.HasSample();
+	uint64_t rtt = static_cast<uint64_t>(heartbeat.SmoothedRtt().count());
+	uint64_t jitter = static_cast<uint64_t>(heartbeat.Jitter().count());
+	if (!heartbeat.OnPong(payload, size, m_now)) return;
+
+	// Aritmética modular: la diferencia puede ser negativa y la suma sigue siendo exacta
+	m_rttSumUs.fetch_add(static_cast<uint64_t>(heartbeat.SmoothedRtt().count()) - rtt, std::memory_order_relaxed);
+	m_jitterSumUs.fetch_add(static_cast<uint64_t>(heartbeat.Jitter().count()) - jitter, std::memory_order_relaxed);
+	if (first) m_rttSessions.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+ServerShard::ForgetRtt(const Heartbeat& heartbeat) {
+	if (!heartbeat.HasSample()) return;
+	m_rttSessions.fetch_sub(1, std::memory_order_relaxed);
+	m_rttSumUs.fetch_sub(static_cast<uint64_t>(heartbeat.SmoothedRtt().count()), std::memory_order_relaxed);
+	m_jitterSumUs.fetch_sub(static_cast<uint64_t>(heartbeat.Jitter().count()), std::memory_order_relaxed);
+}
+
+std::chrono::microseconds
+ServerShard::GetMeanRtt() const {
+	size_t sessions = m_rttSessions.load(std::memory_order_relaxed);
+	if (sessions == 0) return std::chrono::microseconds(0);
+	return std::chrono::microseconds(m_rttSumUs.load(std::memory_order_relaxed) / sessions);
+}
+
+std::chrono::microseconds
+ServerShard::GetMeanJitter() const {
+	size_t sessions = m_rttSessions.load(std::memory_order_relaxed);
+	if (sessions == 0) return std::chrono::microseconds(0);
+	return std::chrono::microseconds(m_jitterSumUs.load(std::memory_order_relaxed) / sessions);
+}
+
+void
+ServerShard::Hibernate(std::unique_ptr<Session> session) {
+	HibernatedSession record;
+	record.sock = session->sock;
+	record.userId = session->userId;
+	record.messagesIn = session->messagesIn;
+	record.messagesOut = session->messagesOut;
+	std::vector<unsigned char> key = session->crypto.GetAESKey();
+	std::memcpy(record.aesKey, key.data(), std::min(key.size(), sizeof(record.aesKey)));
+	OPENSSL_cleanse(key.data(), key.size());
+
+	record.peerPem = std::move(session->peerPem);
+	record.rooms = std::vector<uint32_t>(session->rooms.begin(), session->rooms.end());
+	record.heartbeat = session->heartbeat;
+
+	m_hibernated.emplace(session->id, std::move(record));
+	m_hibernatedCount.fetch_add(1, std::memory_order_relaxed);
+	// Al salir se liberan el CryptoHelper, el buffer de recepción y la cola
+}
+
+Session*
+ServerShard::Wake(uint64_t id) {
+	auto it = m_hibernated.find(id);
+	if (it == m_hibernated.end()) return nullptr;
+	HibernatedSession& record = it->second;
+
+	auto session = std::make_unique<Session>();
+	session->id = id;
+	session->sock = record.sock;
+	session->state = SessionState::Established;
+	session->crypto.SetAESKey(std::vector<unsigned char>(record.aesKey, record.aesKey + sizeof(record.aesKey)));
+	session->peerPem = std::move(record.peerPem);
+	session->messagesIn = record.messagesIn;
+	session->messagesOut = record.messagesOut;
+	session->userId = record.userId;
+	session->rooms = std::move(record.rooms);
+	session->heartbeat = record.heartbeat;
+	session->lastActivity = m_now;
+	ArmIdleTimer(*session, m_hibernateAfter);
+
+	m_hibernated.erase(it);
+	m_hibernatedCount.fetch_sub(1, std::memory_order_relaxed);
+	Session& ref = *session;
+	m_sessions.emplace(id, std::move(session));
+	return &ref;
+}
+
+Session*
+ServerShard::ReadHibernated(uint64_t id) {
+	auto it = m_hibernated.find(id);
+	if (it == m_hibernated.end()) return nullptr;
+	HibernatedSession& record = it->second;
+
+	unsigned char buffer[kHibernatedReadSize];
+	int n = recv(record.sock, (char*)buffer, sizeof(buffer), 0);
+	if (n == SOCKET_ERROR && WSAGetLastError() == WSAEWOULDBLOCK) return nullptr;
+	if (n <= 0) {
+		// Cierre o error: se reconstruye para cerrarla por el camino normal
+		Session* session = Wake(id);
+		session->state = SessionState::Closing;
+		return session;
+	}
+	m_metrics.bytesIn.Add(n);
+	record.heartbeat.OnHeard(m_now);
+
+	// ¿Solo Ping/Pong completos? Con el buffer lleno puede quedar más en el socket
+	size_t size = static_cast<size_t>(n);
+	size_t offset = 0;
+	FrameHeader header;
+	while (size < sizeof(buffer) && Frame::ParseHeader(buffer + offset, size - offset, header) &&
+		header.flags == Frame::kControlFlag && header.length == Heartbeat::kPayloadSize &&
+		(buffer[offset] == Frame::Ping || buffer[offset] == Frame::Pong) &&
+		size - offset >= header.totalSize) {
+		offset += header.totalSize;
+	}
+
+	if (offset == size) {
+		bool alive = true;
+		for (size_t at = 0; at < size; at += kHeartbeatFrameSize) {
+			const unsigned char* payload = buffer + at + Frame::kHeaderSize;
+			record.messagesIn++;
+			m_messages.fetch_add(1, std::memory_order_relaxed);
+			if (buffer[at] == Frame::Pong) {
+				SampleRtt(record.heartbeat, payload, Heartbeat::kPayloadSize);
+			}
+			else if (alive) {
+				// Socket lleno: el Pong se pierde (el peer volverá a preguntar), pero no se cuenta
+				HeartbeatSend sent = SendHeartbeat(record.sock, Frame::Control(Frame::Pong,
+					std::vector<unsigned char>(payload, payload + Heartbeat::kPayloadSize)));
+				alive = sent != HeartbeatSend::Failed;
+				if (sent == HeartbeatSend::Sent) m_metrics.bytesOut.Add(kHeartbeatFrameSize);
+			}
+		}
+		if (alive) return nullptr;
+		Session* session = Wake(id);
+		session->state = SessionState::Closing;
+		return session;
+	}
+
+	// Tráfico real: se reconstruye y lo leído pasa a su buffer de recepción
+	Session* session = Wake(id);
+	session->rx.assign(buffer, buffer + size);
+	return session;
+}
@@ -0,0 +1,345 @@
+/**
+ * @file ShapedTransport.cpp
+ * @brief Implementación del emulador de condiciones de red.
+ *
+ * @details
+ * Cada sentido es una cola de tramos con su instante de entrega y un hilo que
+ * la atiende:
+ *  - Subida: `Send` encola y vuelve enseguida (el retardo no frena al emisor,
+ *    solo el ancho de banda cuando la cola se llena); el hilo escribe cada
+ *    tramo en el transporte real cuando le toca.
+ *  - Bajada: el hilo lee del transporte real y encola; `Receive` espera a que
+ *    venza el primer tramo. Con la cola llena deja de leer y el control de
+ *    flujo del transporte real frena al peer.
+ */
+
+#include "ShapedTransport.h"
+#include <algorithm>
+
+namespace {
+	/// Bytes en vuelo por sentido antes de bloquear al emisor (o de dejar de leer).
+	const size_t kMaxQueued = 1 << 20;
+	/// Bytes leídos del transporte real por llamada.
+	const size_t kReadChunk = 16 * 1024;
+	/// Espera mínima de una retransmisión (RTO mínimo habitual de TCP).
+	const std::chrono::milliseconds kMinRetransmit(200);
+	/// Plazo de Close() para entregar lo ya encolado (como SO_LINGER); lo que quede se descarta.
+	const std::chrono::seconds kCloseLinger(2);
+
+	/// Transporte sobre un socket conectado, para poder envolverlo.
+	class SocketTransport : public Transport {
+	public:
+		explicit SocketTransport(SOCKET socket) : m_socket(socket) {}
+		~SocketTransport() override { Close(); }
+
+		int Send(const unsigned char* data, int len) override {
+			return send(m_socket, reinterpret_cast<const char*>(data), len, 0);
+		}
+		int Receive(unsigned char* out, int len) override {
+			return recv(m_socket, reinterpret_cast<char*>(out), len, 0);
+		}
+		void Close() override {
+			if (m_closed.exchange(true)) return;
+			// shutdown despierta al recv bloqueado en el hilo de bajada
+			shutdown(m_socket, SD_BOTH);
+			closesocket(m_socket);
+		}
+
+	private:
+		SOCKET m_socket;
+		std::atomic<bool> m_closed{ false };
+	};
+
+	/// Duración con sufijo `us`, `ms` o `s` (sin sufijo: ms).
+	bool ParseDuration(const std::string& text, std::chrono::microseconds& out) {
+		size_t used = 0;
+		double value = std::stod(text, &used);
+		std::string unit = text.substr(used);
+		double scale;
+		if (unit == "us") scale = 1;
+		else if (unit == "ms" || unit.empty()) scale = 1e3;
+		else if (unit == "s") scale = 1e6;
+		else return false;
+		out = std::chrono::microseconds(static_cast<int64_t>(value * scale));
+		return value >= 0;
+	}
+
+	/// Ancho de banda con sufijo `kbit`, `mbit`, `kB` o `MB` (sin sufijo: bytes/s).
+	bool ParseBandwidth(const std::string& text, uint64_t& out) {
+		size_t used = 0;
+		double value = std::stod(text, &used);
+		std::string unit = text.substr(used);
+		double scale;
+		if (unit.empty()) scale = 1;
+		else if (unit == "kbit") scale = 1e3 / 8;
+		else if (unit == "mbit") scale = 1e6 / 8;
+		else if (unit == "kB") scale = 1024;
+		else if (unit == "MB") scale = 1024 * 1024;
+		else return false;
+		out = static_cast<uint64_t>(value * scale);
+		return value >= 0;
+	}
+}
+
+bool
+NetworkConditions::Active() const {
+	return delay.count() > 0 || jitter.count() > 0 || bandwidth > 0 || loss > 0 ||
+		maxWrite > 0 || maxRead > 0 || resetChance > 0 || resetAfter > 0;
+}
+
+bool
+NetworkConditions::Parse(const std::string& spec, NetworkConditions& out) {
+	// Perfiles de enlaces móviles habituales
+	if (spec == "3g") return Parse("delay=100ms,jitter=30ms,bw=1600kbit,loss=0.005", out);
+	if (spec == "edge") return Parse("delay=300ms,jitter=100ms,bw=240kbit,loss=0.02", out);
+
+	std::stringstream items(spec);
+	for (std::string item; std::getline(items, item, ',');) {
+		size_t eq = item.find('=');
+		if (eq == std::string::npos) return false;
+		std::string key = item.substr(0, eq);
+		std::string value = item.substr(eq + 1);
+		try {
+			if (key == "delay") { if (!ParseDuration(value, out.delay)) return false; }
+			else if (key == "jitter") { if (!ParseDuration(value, out.jitter)) return false; }
+			else if (key == "bw") { if (!ParseBandwidth(value, out.bandwidth)) return false; }
+			else if (key == "loss") out.loss = std::stod(value);
+			else if (key == "write") out.maxWrite = static_cast<size_t>(std::stoul(value));
+			else if (key == "read") out.maxRead = static_cast<size_t>(std::stoul(value));
+			else if (key == "reset") out.resetChance = std::stod(value);
+			else if (key == "reset-after") out.resetAfter = std::stoull(value);
+			else if (key == "seed") out.seed = static_cast<uint32_t>(std::stoul(value));
+			else return false;
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+	}
+	return true;
+}
+
+ShapedTransport::ShapedTransport(std::shared_ptr<Transport> inner, const NetworkConditions& conditions)
+	: ShapedTransport(std::move(inner), INVALID_SOCKET, conditions) {
+}
+
+ShapedTransport::ShapedTransport(std::shared_ptr<Transport> inner, SOCKET socket, const NetworkConditions& conditions)
+	: m_inner(std::move(inner)), m_socket(socket), m_conditions(conditions), m_rng(conditions.seed) {
+	m_upPump = std::thread(&ShapedTransport::PumpUp, this);
+	m_downPump = std::thread(&ShapedTransport::PumpDown, this);
+}
+
+std::shared_ptr<ShapedTransport>
+ShapedTransport::ForSocket(SOCKET socket, const NetworkConditions& conditions) {
+	return std::shared_ptr<ShapedTransport>(
+		new ShapedTransport(std::make_shared<SocketTransport>(socket), socket, conditions));
+}
+
+ShapedTransport::~ShapedTransport() {
+	Close();
+	{
+		// Con un peer que no lee, el hilo de subida puede seguir bloqueado en el real
+		// pasado el plazo: cerrarlo lo despierta
+		std::unique_lock<std::mutex> lock(m_up.mutex);
+		m_up.changed.wait_until(lock, m_lingerUntil, [this]() { return m_upDone || m_reset; });
+	}
+	// El hilo de bajada también sale de su Receive
+	m_inner->Close();
+	if (m_upPump.joinable()) m_upPump.join();
+	if (m_downPump.joinable()) m_downPump.join();
+}
+
+double
+ShapedTransport::Chance() {
+	std::lock_guard<std::mutex> lock(m_rngMutex);
+	return std::uniform_real_distribution<double>(0.0, 1.0)(m_rng);
+}
+
+size_t
+ShapedTransport::Limit(size_t limit) {
+	std::lock_guard<std::mutex> lock(m_rngMutex);
+	return std::uniform_int_distribution<size_t>(1, limit)(m_rng);
+}
+
+ShapedTransport::Clock::time_point
+ShapedTransport::Schedule(Direction& direction, size_t bytes) {
+	auto now = Clock::now();
+	// Serialización: el enlace está ocupado hasta que sale el último bit del tramo anterior
+	auto start = std::max(now, direction.linkFree);
+	if (m_conditions.bandwidth > 0) {
+		direction.linkFree = start + std::chrono::microseconds(bytes * 1000000 / m_conditions.bandwidth);
+	}
+	else {
+		direction.linkFree = start;
+	}
+
+	// Propagación con jitter; nunca antes que el tramo anterior (TCP entrega en orden)
+	int64_t jitter = m_conditions.jitter.count();
+	int64_t delay = m_conditions.delay.count();
+	if (jitter > 0) {
+		std::lock_guard<std::mutex> lock(m_rngMutex);
+		delay += std::uniform_int_distribution<int64_t>(-jitter, jitter)(m_rng);
+	}
+	auto release = direction.linkFree + std::chrono::microseconds(std::max<int64_t>(delay, 0));
+	if (m_conditions.loss > 0 && Chance() < m_conditions.loss) {
+		// Pérdida: el tramo espera una retransmisión (al menos un RTT)
+		release += std::max<Clock::duration>(kMinRetransmit, 2 * m_conditions.delay);
+	}
+	release = std::max(release, direction.lastRelease);
+	direction.lastRelease = release;
+	return release;
+}
+
+bool
+ShapedTransport::ShouldReset(size_t bytes) {
+	uint64_t total = m_transferred.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	if (m_conditions.resetAfter > 0 && total >= m_conditions.resetAfter) return true;
+	return m_conditions.resetChance > 0 && Chance() < m_conditions.resetChance;
+}
+
+void
+ShapedTransport::Reset() {
+	if (m_reset.exchange(true)) return;
+	if (m_socket != INVALID_SOCKET) {
+		// Linger a cero: closesocket envía RST en lugar de FIN
+		linger hardClose{};
+		hardClose.l_onoff = 1;
+		hardClose.l_linger = 0;
+		setsockopt(m_socket, SOL_SOCKET, SO_LINGER, (const char*)&hardClose, sizeof(hardClose));
+	}
+	m_inner->Close();
+	for (Direction* direction : { &m_up, &m_down }) {
+		std::lock_guard<std::mutex> lock(direction->mutex);
+		direction->changed.notify_all();
+	}
+}
+
+int
+ShapedTransport::Send(const unsigned char* data, int len) {
+	if (len <= 0) return 0;
+	size_t n = static_cast<size_t>(len);
+	if (m_conditions.maxWrite > 0) n = std::min(n, Limit(m_conditions.maxWrite));
+	if (ShouldReset(n)) Reset();
+
+	std::unique_lock<std::mutex> lock(m_up.mutex);
+	m_up.changed.wait(lock, [this]() { return m_reset || m_closing || m_up.queued < kMaxQueued; });
+	if (m_reset || m_closing) return -1;
+	Chunk chunk;
+	chunk.release = Schedule(m_up, n);
+	chunk.bytes.assign(data, data + n);
+	m_up.queue.push_back(std::move(chunk));
+	m_up.queued += n;
+	m_up.changed.notify_all();
+	return static_cast<int>(n);
+}
+
+int
+ShapedTransport::Receive(unsigned char* out, int len) {
+	if (len <= 0) return 0;
+	std::unique_lock<std::mutex> lock(m_down.mutex);
+	while (true) {
+		if (m_reset || m_closing) return -1;
+		if (m_down.queue.empty()) {
+			m_down.changed.wait(lock);
+			continue;
+		}
+		auto release = m_down.queue.front().release;
+		if (Clock::now() >= release) break;
+		m_down.changed.wait_until(lock, release);
+	}
+
+	Chunk& front = m_down.queue.front();
+	if (front.bytes.empty()) return 0; // fin de flujo: se queda en la cola para las siguientes llamadas
+	size_t n = std::min(static_cast<size_t>(len), front.bytes.size() - m_down.offset);
+	if (m_conditions.maxRead > 0) n = std::min(n, Limit(m_conditions.maxRead));
+	std::copy(front.bytes.begin() + m_down.offset, front.bytes.begin() + m_down.offset + n, out);
+	m_down.offset += n;
+	m_down.queued -= n;
+	if (m_down.offset == front.bytes.size()) {
+		m_down.queue.pop_front();
+		m_down.offset = 0;
+	}
+	m_down.changed.notify_all();
+	return static_cast<int>(n);
+}
+
+void
+ShapedTransport::Close() {
+	// Lo ya aceptado por Send se entrega (como haría TCP antes del FIN) durante
+	// kCloseLinger; el resto falla
+	{
+		std::lock_guard<std::mutex> lock(m_up.mutex);
+		if (!m_closing) m_lingerUntil = Clock::now() + kCloseLinger;
+		m_closing = true;
+	}
+	for (Direction* direction : { &m_up, &m_down }) {
+		std::lock_guard<std::mutex> lock(direction->mutex);
+		direction->changed.notify_all();
+	}
+}
+
+void
+ShapedTransport::PumpUp() {
+	std::unique_lock<std::mutex> lock(m_up.mutex);
+	while (!m_reset) {
+		if (m_closing && (m_up.queue.empty() || Clock::now() >= m_lingerUntil)) break;
+		if (m_up.queue.empty()) {
+			m_up.changed.wait(lock);
+			continue;
+		}
+		auto release = m_up.queue.front().release;
+		if (Clock::now() < release) {
+			m_up.changed.wait_until(lock, m_closing ? std::min(release, m_lingerUntil) : release);
+			continue;
+		}
+		Chunk chunk = std::move(m_up.queue.front());
+		m_up.queue.pop_front();
+		lock.unlock();
+
+		int sent = 0;
+		int size = static_cast<int>(chunk.bytes.size());
+		while (sent < size) {
+			int n = m_inner->Send(chunk.bytes.data() + sent, size - sent);
+			if (n <= 0) break;
+			sent += n;
+		}
+
+		lock.lock();
+		m_up.queued -= chunk.bytes.size();
+		m_up.changed.notify_all();
+		if (sent < size) {
+			lock.unlock();
+			Reset();
+			lock.lock();
+			break;
+		}
+	}
+	// Plazo de cierre vencido o conexión cortada: lo que no salió se descarta
+	m_up.queue.clear();
+	m_up.queued = 0;
+	m_upDone = true;
+	m_up.changed.notify_all();
+}
+
+void
+ShapedTransport::PumpDown() {
+	std::vector<unsigned char> buffer(kReadChunk);
+	while (!m_reset) {
+		int n = m_inner->Receive(buffer.data(), static_cast<int>(buffer.size()));
+		if (n > 0 && ShouldReset(static_cast<size_t>(n))) {
+			Reset();
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(m_down.mutex);
+		m_down.changed.wait(lock, [this]() { return m_reset || m_closing || m_down.queued < kMaxQueued; });
+		if (m_reset || m_closing) return;
+		// El fin de flujo (o el error) también llega con retardo, tras los datos previos
+		Chunk chunk;
+		chunk.release = Schedule(m_down, n > 0 ? static_cast<size_t>(n) : 0);
+		if (n > 0) chunk.bytes.assign(buffer.begin(), buffer.begin() + n);
+		m_down.queued += chunk.bytes.size();
+		m_down.queue.push_back(std::move(chunk));
+		m_down.changed.notify_all();
+		if (n <= 0) return;
+	}
+}
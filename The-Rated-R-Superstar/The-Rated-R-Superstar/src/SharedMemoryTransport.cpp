@@ -0,0 +1,214 @@
+/**
+ * @file SharedMemoryTransport.cpp
+ * @brief Implementación del transporte por anillos SPSC en memoria compartida.
+ *
+ * @details
+ * Sincronización:
+ *  - `head` solo lo escribe el productor y `tail` solo el consumidor.
+ *  - El consumidor marca `readerWaiting` antes de dormir y vuelve a comprobar
+ *    la cabeza; el productor solo llama a `SetEvent` si la marca está activa.
+ *  - Las esperas tienen un tope corto para tolerar cierres abruptos del peer.
+ */
+
+#include "SharedMemoryTransport.h"
+#include <algorithm>
+
+namespace {
+	/// Capacidad de cada anillo (potencia de dos).
+	const uint64_t kRingSize = 1u << 20;
+	/// Iteraciones de espera activa antes de dormir en el evento.
+	const int kSpinLimit = 20000;
+	/// Tope de cada espera en evento (ms).
+	const DWORD kWaitSliceMs = 10;
+	/// Prefijo de los objetos con nombre.
+	const char kPrefix[] = "Local\\e2ee-shm-";
+}
+
+struct SharedMemoryTransport::Ring {
+	alignas(64) std::atomic<uint64_t> head;          ///< Bytes publicados por el productor.
+	alignas(64) std::atomic<uint64_t> tail;          ///< Bytes consumidos por el lector.
+	alignas(64) std::atomic<uint32_t> readerWaiting; ///< El lector duerme en su evento.
+	unsigned char data[kRingSize];                   ///< Almacenamiento circular.
+};
+
+struct SharedMemoryTransport::Layout {
+	alignas(64) std::atomic<uint32_t> state;         ///< 0: esperando cliente, 1: conectado.
+	std::atomic<uint32_t> serverClosed;              ///< El servidor cerró su extremo.
+	std::atomic<uint32_t> clientClosed;              ///< El cliente cerró su extremo.
+	Ring clientToServer;                             ///< Sentido cliente -> servidor.
+	Ring serverToClient;                             ///< Sentido servidor -> cliente.
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Se requieren atómicos sin bloqueo entre procesos");
+
+SharedMemoryTransport::SharedMemoryTransport(bool isServer) : m_isServer(isServer) {}
+
+SharedMemoryTransport::~SharedMemoryTransport() {
+	Close();
+	if (m_layout) UnmapViewOfFile(m_layout);
+	if (m_mapping) CloseHandle(m_mapping);
+	if (m_txEvent) CloseHandle(m_txEvent);
+	if (m_rxEvent) CloseHandle(m_rxEvent);
+}
+
+std::shared_ptr<SharedMemoryTransport>
+SharedMemoryTransport::Create(const std::string& name) {
+	std::shared_ptr<SharedMemoryTransport> t(new SharedMemoryTransport(true));
+	if (!t->Map(name, true)) return nullptr;
+	return t;
+}
+
+std::shared_ptr<SharedMemoryTransport>
+SharedMemoryTransport::Open(const std::string& name) {
+	std::shared_ptr<SharedMemoryTransport> t(new SharedMemoryTransport(false));
+	if (!t->Map(name, false)) return nullptr;
+
+	// Solo un cliente por región
+	uint32_t expected = 0;
+	if (!t->m_layout->state.compare_exchange_strong(expected, 1)) {
+		std::cerr << "Shared memory endpoint busy: " << name << std::endl;
+		return nullptr;
+	}
+	SetEvent(t->m_txEvent); // despierta a WaitForPeer
+	return t;
+}
+
+bool
+SharedMemoryTransport::Map(const std::string& name, bool create) {
+	std::string base = kPrefix + name;
+	if (create) {
+		m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+			0, static_cast<DWORD>(sizeof(Layout)), base.c_str());
+		if (m_mapping && GetLastError() == ERROR_ALREADY_EXISTS) {
+			std::cerr << "Shared memory endpoint already exists: " << name << std::endl;
+			return false;
+		}
+	}
+	else {
+		m_mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, base.c_str());
+	}
+	if (!m_mapping) {
+		std::cerr << "Error mapping shared memory " << name << ": " << GetLastError() << std::endl;
+		return false;
+	}
+
+	m_layout = static_cast<Layout*>(MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Layout)));
+	if (!m_layout) {
+		std::cerr << "Error mapping shared memory view: " << GetLastError() << std::endl;
+		return false;
+	}
+
+	// Eventos de auto-reinicio, uno por sentido (CreateEvent abre el existente)
+	HANDLE c2s = CreateEventA(nullptr, FALSE, FALSE, (base + "-c2s").c_str());
+	HANDLE s2c = CreateEventA(nullptr, FALSE, FALSE, (base + "-s2c").c_str());
+	if (!c2s || !s2c) {
+		if (c2s) CloseHandle(c2s);
+		if (s2c) CloseHandle(s2c);
+		return false;
+	}
+
+	if (m_isServer) {
+		m_tx = &m_layout->serverToClient;
+		m_rx = &m_layout->clientToServer;
+		m_txEvent = s2c;
+		m_rxEvent = c2s;
+	}
+	else {
+		m_tx = &m_layout->clientToServer;
+		m_rx = &m_layout->serverToClient;
+		m_txEvent = c2s;
+		m_rxEvent = s2c;
+	}
+	return true;
+}
+
+bool
+SharedMemoryTransport::WaitForPeer() {
+	while (!m_closed) {
+		if (m_layout->state.load() == 1) return true;
+		WaitForSingleObject(m_rxEvent, kWaitSliceMs);
+	}
+	return false;
+}
+
+bool
+SharedMemoryTransport::PeerClosed() const {
+	return m_isServer ? m_layout->clientClosed.load() != 0 : m_layout->serverClosed.load() != 0;
+}
+
+int
+SharedMemoryTransport::Send(const unsigned char* data, int len) {
+	if (m_closed || len <= 0) return -1;
+
+	uint64_t head = m_tx->head.load(std::memory_order_relaxed);
+	int spins = 0;
+	while (true) {
+		if (m_closed || PeerClosed()) return -1;
+
+		uint64_t tail = m_tx->tail.load(std::memory_order_acquire);
+		uint64_t space = kRingSize - (head - tail);
+		if (space > 0) {
+			uint64_t n = std::min<uint64_t>(space, static_cast<uint64_t>(len));
+			uint64_t pos = head & (kRingSize - 1);
+			uint64_t first = std::min<uint64_t>(n, kRingSize - pos);
+			std::memcpy(m_tx->data + pos, data, static_cast<size_t>(first));
+			std::memcpy(m_tx->data, data + first, static_cast<size_t>(n - first));
+
+			// Publicar y despertar al lector solo si está dormido
+			m_tx->head.store(head + n);
+			if (m_tx->readerWaiting.load()) SetEvent(m_txEvent);
+			return static_cast<int>(n);
+		}
+
+		// Anillo lleno: ceder la CPU hasta que el lector avance
+		if (++spins < kSpinLimit) YieldProcessor();
+		else Sleep(0);
+	}
+}
+
+int
+SharedMemoryTransport::Receive(unsigned char* out, int len) {
+	if (len <= 0) return -1;
+
+	uint64_t tail = m_rx->tail.load(std::memory_order_relaxed);
+	int spins = 0;
+	while (true) {
+		uint64_t head = m_rx->head.load(std::memory_order_acquire);
+		if (head != tail) {
+			uint64_t n = std::min<uint64_t>(head - tail, static_cast<uint64_t>(len));
+			uint64_t pos = tail & (kRingSize - 1);
+			uint64_t first = std::min<uint64_t>(n, kRingSize - pos);
+			std::memcpy(out, m_rx->data + pos, static_cast<size_t>(first));
+			std::memcpy(out + first, m_rx->data, static_cast<size_t>(n - first));
+			m_rx->tail.store(tail + n, std::memory_order_release);
+			return static_cast<int>(n);
+		}
+		if (m_closed) return -1;
+		if (PeerClosed()) {
+			// El peer publica sus últimos bytes antes de marcar el cierre
+			if (m_rx->head.load(std::memory_order_acquire) == tail) return 0;
+			continue;
+		}
+
+		if (++spins < kSpinLimit) {
+			YieldProcessor();
+			continue;
+		}
+		m_rx->readerWaiting.store(1);
+		if (m_rx->head.load() == tail && !PeerClosed() && !m_closed) {
+			WaitForSingleObject(m_rxEvent, kWaitSliceMs);
+		}
+		m_rx->readerWaiting.store(0);
+	}
+}
+
+void
+SharedMemoryTransport::Close() {
+	if (m_closed || !m_layout) return;
+	m_closed = true;
+	if (m_isServer) m_layout->serverClosed.store(1);
+	else m_layout->clientClosed.store(1);
+	// Despierta al lector remoto y a un posible lector local en otro hilo
+	SetEvent(m_txEvent);
+	SetEvent(m_rxEvent);
+}
@@ -0,0 +1,180 @@
+/**
+ * @file TimerWheel.cpp
+ * @brief Implementación de la rueda de temporizadores jerárquica.
+ *
+ * @details
+ * Un temporizador con vencimiento `e` y distancia `d = e - actual` va al
+ * nivel `k` más bajo con `d < 64^(k+1)`, casilla `(e >> 6k) & 63`. Cuando el
+ * nivel 0 da la vuelta se vacía la casilla actual del nivel 1 (y, si este
+ * también da la vuelta, la del 2, etc.) recolocando sus nodos con la nueva
+ * distancia. Sin temporizadores en el nivel 0 el avance salta directamente
+ * a la siguiente vuelta, así que una espera larga no cuesta un paso por tick.
+ */
+
+#include "TimerWheel.h"
+#include <algorithm>
+
+namespace {
+	/// Bits del índice del nodo dentro de un TimerId.
+	const uint64_t kIndexMask = 0xffffffffull;
+}
+
+TimerWheel::TimerWheel(std::chrono::milliseconds tick, Clock::time_point start)
+	: m_tick(tick.count() > 0 ? tick : std::chrono::milliseconds(1)), m_start(start) {
+	std::fill(std::begin(m_heads), std::end(m_heads), kNil);
+}
+
+TimerWheel::TimerId
+TimerWheel::Schedule(std::chrono::milliseconds delay, uint64_t owner, uint32_t kind) {
+	// Redondeo hacia arriba y al menos un tick: nunca vence en el Advance en curso
+	uint64_t ticks = delay.count() > 0 ? (delay.count() + m_tick.count() - 1) / m_tick.count() : 1;
+
+	uint32_t index;
+	if (m_free != kNil) {
+		index = m_free;
+		m_free = m_nodes[index].next;
+	}
+	else {
+		index = static_cast<uint32_t>(m_nodes.size());
+		m_nodes.emplace_back();
+	}
+	Node& node = m_nodes[index];
+	node.expires = m_current + ticks;
+	node.owner = owner;
+	node.kind = kind;
+	Place(index);
+	m_size++;
+	return (static_cast<uint64_t>(node.generation) << 32) | (index + 1);
+}
+
+bool
+TimerWheel::Cancel(TimerId id) {
+	if (id == kNone) return false;
+	uint64_t index = (id & kIndexMask) - 1;
+	if (index >= m_nodes.size()) return false;
+	Node& node = m_nodes[index];
+	if (node.slot == kNil || node.generation != static_cast<uint32_t>(id >> 32)) return false;
+
+	Unlink(static_cast<uint32_t>(index));
+	node.generation++;
+	node.next = m_free;
+	m_free = static_cast<uint32_t>(index);
+	m_size--;
+	return true;
+}
+
+void
+TimerWheel::Advance(Clock::time_point now, std::vector<Expired>& out) {
+	if (now <= m_start) return;
+	uint64_t target = static_cast<uint64_t>(
+		std::chrono::duration_cast<std::chrono::milliseconds>(now - m_start).count() / m_tick.count());
+	if (m_size == 0) {
+		m_current = std::max(m_current, target);
+		return;
+	}
+
+	while (m_current < target) {
+		// Nivel 0 vacío: salto hasta el tick anterior a la próxima vuelta
+		if (m_level0Mask == 0) {
+			uint64_t wrap = (m_current | (kSlots - 1)) + 1;
+			if (target < wrap) {
+				m_current = target;
+				break;
+			}
+			m_current = wrap - 1;
+		}
+
+		m_current++;
+		if ((m_current & (kSlots - 1)) == 0) {
+			for (int level = 1; level < kLevels; ++level) {
+				Cascade(level);
+				if (((m_current >> (kSlotBits * level)) & (kSlots - 1)) != 0) break;
+			}
+		}
+
+		uint32_t slot = static_cast<uint32_t>(m_current & (kSlots - 1));
+		while (m_heads[slot] != kNil) {
+			uint32_t index = m_heads[slot];
+			Node& node = m_nodes[index];
+			out.push_back(Expired{ node.owner, node.kind });
+			Unlink(index);
+			node.generation++;
+			node.next = m_free;
+			m_free = index;
+			m_size--;
+		}
+		if (m_size == 0) {
+			m_current = target;
+			break;
+		}
+	}
+}
+
+std::chrono::milliseconds
+TimerWheel::NextTimeout(Clock::time_point now, std::chrono::milliseconds limit) const {
+	if (m_size == 0) return limit;
+
+	// Próxima casilla ocupada del nivel 0 o, como tarde, la próxima vuelta (redistribución)
+	uint64_t cur = m_current & (kSlots - 1);
+	uint64_t ticks = kSlots - cur;
+	for (uint64_t k = 1; k < ticks; ++k) {
+		if (m_level0Mask & (1ull << ((cur + k) & (kSlots - 1)))) {
+			ticks = k;
+			break;
+		}
+	}
+
+	Clock::time_point due = m_start + m_tick * static_cast<int64_t>(m_current + ticks);
+	if (due <= now) return std::chrono::milliseconds(0);
+	auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(due - now) + std::chrono::milliseconds(1);
+	return std::min(wait, limit);
+}
+
+void
+TimerWheel::Place(uint32_t index) {
+	Node& node = m_nodes[index];
+	uint64_t delta = node.expires > m_current ? node.expires - m_current : 0;
+
+	int level = 0;
+	while (level < kLevels - 1 && delta >= (1ull << (kSlotBits * (level + 1)))) {
+		level++;
+	}
+	// Más allá del último nivel: ocupa la casilla del máximo representable y, al
+	// vaciarse esta, se recoloca con su vencimiento real (que no se toca)
+	uint64_t maxDelta = (1ull << (kSlotBits * kLevels)) - 1;
+	uint64_t due = delta > maxDelta ? m_current + maxDelta : node.expires;
+
+	uint32_t slot = static_cast<uint32_t>(level) * kSlots +
+		static_cast<uint32_t>((due >> (kSlotBits * level)) & (kSlots - 1));
+	node.slot = slot;
+	node.prev = kNil;
+	node.next = m_heads[slot];
+	if (node.next != kNil) m_nodes[node.next].prev = index;
+	m_heads[slot] = index;
+	if (level == 0) m_level0Mask |= 1ull << slot;
+}
+
+void
+TimerWheel::Unlink(uint32_t index) {
+	Node& node = m_nodes[index];
+	if (node.prev != kNil) m_nodes[node.prev].next = node.next;
+	else m_heads[node.slot] = node.next;
+	if (node.next != kNil) m_nodes[node.next].prev = node.prev;
+	if (node.slot < kSlots && m_heads[node.slot] == kNil) m_level0Mask &= ~(1ull << node.slot);
+	node.slot = kNil;
+	node.prev = kNil;
+	node.next = kNil;
+}
+
+void
+TimerWheel::Cascade(int level) {
+	uint32_t slot = static_cast<uint32_t>(level) * kSlots +
+		static_cast<uint32_t>((m_current >> (kSlotBits * level)) & (kSlots - 1));
+	uint32_t index = m_heads[slot];
+	m_heads[slot] = kNil;
+	while (index != kNil) {
+		uint32_t next = m_nodes[index].next;
+		Place(index);
+		index = next;
+	}
+}
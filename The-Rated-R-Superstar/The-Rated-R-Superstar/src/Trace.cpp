@@ -0,0 +1,105 @@
+/**
+ * @file Trace.cpp
+ * @brief Implementación del anillo de trazas y su exportación a JSON de Chrome.
+ */
+
+#include "Trace.h"
+#include <fstream>
+
+namespace {
+	/// Ordinales de hilo (0 queda libre para los metadatos del proceso).
+	std::atomic<uint32_t> g_nextThread{ 1 };
+}
+
+Tracer&
+Tracer::Instance() {
+	static Tracer tracer;
+	return tracer;
+}
+
+Tracer::Tracer()
+	: m_epoch(std::chrono::steady_clock::now()) {
+}
+
+void
+Tracer::Enable(const std::string& processName, uint32_t sampleEvery) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_processName = processName;
+		if (m_ring.empty()) m_ring.resize(kCapacity);
+	}
+	m_sampleEvery.store(sampleEvery, std::memory_order_release);
+}
+
+uint64_t
+Tracer::BeginTrace() {
+	uint32_t every = m_sampleEvery.load(std::memory_order_acquire);
+	if (every == 0) return 0;
+	uint64_t connection = m_connections.fetch_add(1, std::memory_order_relaxed) + 1;
+	return (connection % every == 0) ? connection : 0;
+}
+
+void
+Tracer::Record(const TraceEvent& event) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_ring.empty()) return;
+	m_ring[m_recorded % kCapacity] = event;
+	m_recorded++;
+}
+
+uint64_t
+Tracer::ToMicros(std::chrono::steady_clock::time_point time) const {
+	if (time < m_epoch) return 0;
+	return std::chrono::duration_cast<std::chrono::microseconds>(time - m_epoch).count();
+}
+
+uint32_t
+Tracer::ThreadOrdinal() {
+	thread_local uint32_t ordinal = g_nextThread.fetch_add(1, std::memory_order_relaxed);
+	return ordinal;
+}
+
+bool
+Tracer::Dump(const std::string& path) {
+	std::ofstream out(path, std::ios::out | std::ios::trunc);
+	if (!out) return false;
+	WriteChromeJson(out);
+	return static_cast<bool>(out);
+}
+
+void
+Tracer::WriteChromeJson(std::ostream& out) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	// Los nombres de fase son literales ASCII sin comillas: no hace falta escaparlos
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"" << m_processName << "\"}}";
+
+	// Del más antiguo al más reciente que sigue en el anillo
+	uint64_t first = (m_recorded > kCapacity) ? m_recorded - kCapacity : 0;
+	for (uint64_t i = first; i < m_recorded; ++i) {
+		const TraceEvent& event = m_ring[i % kCapacity];
+		out << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"handshake\",\"ph\":\"X\""
+			<< ",\"ts\":" << event.startUs << ",\"dur\":" << event.durationUs
+			<< ",\"pid\":1,\"tid\":" << event.thread
+			<< ",\"args\":{\"connection\":" << event.traceId << "}}";
+	}
+	out << "\n]}\n";
+}
+
+TraceSpan::TraceSpan(uint64_t traceId, const char* name)
+	: m_traceId(traceId), m_name(name) {
+	if (m_traceId) m_start = std::chrono::steady_clock::now();
+}
+
+TraceSpan::~TraceSpan() {
+	if (!m_traceId) return;
+	auto end = std::chrono::steady_clock::now();
+	Tracer& tracer = Tracer::Instance();
+	TraceEvent event;
+	event.name = m_name;
+	event.traceId = m_traceId;
+	event.startUs = tracer.ToMicros(m_start);
+	event.durationUs = std::chrono::duration_cast<std::chrono::microseconds>(end - m_start).count();
+	event.thread = Tracer::ThreadOrdinal();
+	tracer.Record(event);
+}
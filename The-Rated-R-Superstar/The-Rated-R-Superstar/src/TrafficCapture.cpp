@@ -0,0 +1,261 @@
+/**
+ * @file TrafficCapture.cpp
+ * @brief Escritura y lectura del formato de captura.
+ *
+ * @details
+ * Registrar un frame copia unos pocos campos en el buffer del hilo llamante
+ * bajo su propio mutex, sin llamadas al sistema. El hilo del grabador
+ * recoge los buffers, los mezcla por instante (los deltas y la numeración de
+ * sesiones son globales), escribe y vacía el archivo.
+ */
+
+#include "TrafficCapture.h"
+#include "Logger.h"
+#include <algorithm>
+
+namespace {
+	/// Firma del archivo.
+	const char kMagic[] = { 'E', '2', 'C', 'A', 'P' };
+	/// Bits del byte de tipo.
+	const unsigned char kIncomingBit = 0x80;
+	const unsigned char kControlBit = 0x40;
+	const unsigned char kStampedBit = 0x20;
+	const unsigned char kRoutedBit = 0x10;
+	const unsigned char kTypeMask = 0x0F;
+	/// Intervalo entre volcados: lo que se pierde como mucho si el proceso muere.
+	const std::chrono::milliseconds kFlushInterval(1000);
+	/// Registros de un buffer que adelantan el volcado.
+	const size_t kFlushRecords = 64 * 1024;
+
+	/// Identificadores de grabador: un hilo puede sobrevivir a uno y usar otro.
+	std::atomic<uint64_t> g_nextRecorder{ 1 };
+
+	/// Lee un varint; false si el archivo termina antes.
+	bool GetVarint(std::istream& in, uint64_t& value) {
+		value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			int byte = in.get();
+			if (byte == EOF) return false;
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) return true;
+		}
+		return false;
+	}
+}
+
+bool
+TrafficCapture::Load(const std::string& path, TrafficCapture& out) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in) return false;
+	char magic[sizeof(kMagic)];
+	if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) return false;
+	int version = in.get();
+	int role = in.get();
+	if (version != TrafficRecorder::kVersion || (role != 0 && role != 1)) return false;
+
+	out = TrafficCapture();
+	out.role = static_cast<Role>(role);
+	uint64_t at = 0;
+	for (;;) {
+		uint64_t delta, session, length;
+		if (!GetVarint(in, delta)) break; // fin limpio
+		int type = EOF;
+		bool complete = GetVarint(in, session) && (type = in.get()) != EOF && GetVarint(in, length);
+
+		CapturedFrame frame;
+		at += delta;
+		frame.atUs = at;
+		frame.session = static_cast<uint32_t>(session);
+		frame.incoming = (type & kIncomingBit) != 0;
+		if (type & kControlBit) frame.flags |= Frame::kControlFlag;
+		if (type & kStampedBit) frame.flags |= Frame::kStampedFlag;
+		if (type & kRoutedBit) frame.flags |= Frame::kRoutedFlag;
+		frame.type = static_cast<unsigned char>(type & kTypeMask);
+		frame.length = static_cast<uint32_t>(length);
+		if (complete && (frame.flags & Frame::kRoutedFlag)) {
+			unsigned char dst[4];
+			complete = static_cast<bool>(in.read(reinterpret_cast<char*>(dst), sizeof(dst)));
+			frame.dst = Frame::GetU32(dst);
+		}
+		if (complete && (frame.flags & Frame::kControlFlag) && frame.type == Frame::Register && frame.length == 4) {
+			uint64_t id;
+			complete = GetVarint(in, id);
+			frame.userId = static_cast<uint32_t>(id);
+		}
+		if (!complete) {
+			Logger::Warn("[Capture] {}: último registro incompleto, descartado.\n", path);
+			break;
+		}
+		out.sessions = std::max<size_t>(out.sessions, frame.session + 1);
+		out.frames.push_back(frame);
+	}
+	return true;
+}
+
+std::shared_ptr<TrafficRecorder>
+TrafficRecorder::Create(const std::string& path, TrafficCapture::Role role) {
+	std::shared_ptr<TrafficRecorder> recorder(new TrafficRecorder());
+	recorder->m_id = g_nextRecorder.fetch_add(1, std::memory_order_relaxed);
+	recorder->m_out.open(path, std::ios::binary | std::ios::trunc);
+	if (!recorder->m_out) {
+		Logger::Error("[Capture] No se pudo crear {}.\n", path);
+		return nullptr;
+	}
+	recorder->m_out.write(kMagic, sizeof(kMagic));
+	recorder->m_out.put(static_cast<char>(kVersion));
+	recorder->m_out.put(static_cast<char>(role));
+	if (!recorder->m_out.flush()) {
+		Logger::Error("[Capture] No se pudo escribir {}.\n", path);
+		return nullptr;
+	}
+	TrafficRecorder* raw = recorder.get();
+	recorder->m_thread = std::thread([raw]() { raw->Run(); });
+	return recorder;
+}
+
+TrafficRecorder::~TrafficRecorder() {
+	{
+		std::lock_guard<std::mutex> lock(m_wakeMutex);
+		m_stopping = true;
+	}
+	m_wakeCv.notify_one();
+	if (m_thread.joinable()) m_thread.join();
+	Flush();
+}
+
+void
+TrafficRecorder::Record(uint64_t session, bool incoming, const FrameHeader& header,
+	unsigned char type, const unsigned char* payload) {
+	bool control = (header.flags & Frame::kControlFlag) != 0;
+	bool routed = (header.flags & Frame::kRoutedFlag) != 0;
+	Pending record;
+	record.at = Clock::now();
+	record.session = session;
+	record.length = header.length;
+	record.dst = routed ? header.dst : 0;
+	record.bits = (incoming ? kIncomingBit : 0) | (control ? kControlBit : 0) |
+		((header.flags & Frame::kStampedFlag) ? kStampedBit : 0) | (routed ? kRoutedBit : 0) |
+		(control ? (type & kTypeMask) : 0);
+	record.registers = control && type == Frame::Register && header.length == 4;
+	if (record.registers) record.userId = Frame::GetU32(payload);
+	Append(record);
+}
+
+void
+TrafficRecorder::Forget(uint64_t session) {
+	// En orden con los frames: el identificador puede reutilizarse enseguida
+	Pending record;
+	record.at = Clock::now();
+	record.session = session;
+	record.forget = true;
+	Append(record);
+}
+
+TrafficRecorder::Buffer&
+TrafficRecorder::ThreadBuffer() {
+	thread_local std::unordered_map<uint64_t, std::weak_ptr<Buffer>> t_buffers;
+	auto it = t_buffers.find(m_id);
+	if (it != t_buffers.end()) {
+		if (std::shared_ptr<Buffer> buffer = it->second.lock()) return *buffer;
+	}
+	auto buffer = std::make_shared<Buffer>();
+	{
+		std::lock_guard<std::mutex> lock(m_buffersMutex);
+		m_buffers.push_back(buffer);
+	}
+	t_buffers[m_id] = buffer;
+	// El grabador conserva el buffer: la referencia sigue válida mientras viva
+	return *buffer;
+}
+
+void
+TrafficRecorder::Append(const Pending& record) {
+	Buffer& buffer = ThreadBuffer();
+	size_t size;
+	{
+		std::lock_guard<std::mutex> lock(buffer.mutex);
+		buffer.records.push_back(record);
+		size = buffer.records.size();
+	}
+	if (size == kFlushRecords) m_wakeCv.notify_one();
+}
+
+void
+TrafficRecorder::Run() {
+	std::unique_lock<std::mutex> lock(m_wakeMutex);
+	while (!m_stopping) {
+		m_wakeCv.wait_for(lock, kFlushInterval);
+		if (m_stopping) break;
+		lock.unlock();
+		Flush();
+		lock.lock();
+	}
+}
+
+void
+TrafficRecorder::Flush() {
+	std::lock_guard<std::mutex> write(m_writeMutex);
+	std::vector<std::shared_ptr<Buffer>> buffers;
+	{
+		std::lock_guard<std::mutex> lock(m_buffersMutex);
+		buffers = m_buffers;
+	}
+	std::vector<Pending> merged;
+	for (const auto& buffer : buffers) {
+		std::vector<Pending> records;
+		{
+			std::lock_guard<std::mutex> lock(buffer->mutex);
+			records.swap(buffer->records);
+		}
+		merged.insert(merged.end(), records.begin(), records.end());
+	}
+	if (merged.empty() || m_failed) return;
+
+	// Cada buffer ya está en orden: la mezcla estable conserva el de cada hilo
+	std::stable_sort(merged.begin(), merged.end(),
+		[](const Pending& a, const Pending& b) { return a.at < b.at; });
+	for (const Pending& record : merged) {
+		Write(record);
+	}
+	if (!m_out.flush()) {
+		Logger::Error("[Capture] Error al escribir la captura; se detiene la grabación.\n");
+		m_failed = true;
+	}
+}
+
+void
+TrafficRecorder::Write(const Pending& record) {
+	if (record.forget) {
+		m_sessions.erase(record.session);
+		return;
+	}
+	// Un registro tardío de un volcado anterior no retrocede el reloj
+	uint64_t delta = 0;
+	if (m_started && record.at > m_last) {
+		delta = std::chrono::duration_cast<std::chrono::microseconds>(record.at - m_last).count();
+	}
+	if (!m_started || record.at > m_last) m_last = record.at;
+	m_started = true;
+	auto it = m_sessions.emplace(record.session, m_nextSession).first;
+	if (it->second == m_nextSession) m_nextSession++;
+
+	PutVarint(delta);
+	PutVarint(it->second);
+	m_out.put(static_cast<char>(record.bits));
+	PutVarint(record.length);
+	if (record.bits & kRoutedBit) {
+		unsigned char dst[4];
+		Frame::PutU32(dst, record.dst);
+		m_out.write(reinterpret_cast<const char*>(dst), sizeof(dst));
+	}
+	if (record.registers) PutVarint(record.userId);
+}
+
+void
+TrafficRecorder::PutVarint(uint64_t value) {
+	while (value >= 0x80) {
+		m_out.put(static_cast<char>((value & 0x7F) | 0x80));
+		value >>= 7;
+	}
+	m_out.put(static_cast<char>(value));
+}
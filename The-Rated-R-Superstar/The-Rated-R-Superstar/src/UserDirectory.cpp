@@ -0,0 +1,304 @@
+/**
+ * @file UserDirectory.cpp
+ * @brief Implementación del directorio de usuarios del relay.
+ *
+ * @details
+ * Lectura: el hilo anuncia la época global en su ranura, recorre la lista del
+ * bucket con cargas acquire y copia la ruta. Escritura: con el mutex de la
+ * tabla se publica un nodo nuevo (store release) o se desenlaza uno; lo
+ * desenlazado se acumula en la tabla y, cada @ref kRetireBatch nodos, el lote
+ * se retira con la época siguiente (ya fuera del mutex) y se libera cuando
+ * ninguna ranura anuncia una época anterior. Los hilos sin ranura libre (más
+ * de @ref kMaxReaders) leen con el mutex de la tabla.
+ */
+
+#include "UserDirectory.h"
+#include <algorithm>
+#include <functional>
+
+namespace {
+	/// Hilos lectores con ranura propia.
+	const size_t kMaxReaders = 256;
+	/// Buckets iniciales por tabla.
+	const size_t kInitialBuckets = 16;
+	/// Ranura sin lectura en curso.
+	const uint64_t kQuiescent = ~0ull;
+	/// Nodos desenlazados que una tabla acumula antes de retirarlos juntos.
+	const size_t kRetireBatch = 32;
+
+	/**
+	 * @brief Reclamación por épocas compartida por todos los directorios.
+	 * @details Cada lector ocupa una ranura alineada a su línea de caché; un
+	 *          objeto retirado en la época `t` se libera cuando todas las ranuras
+	 *          activas anuncian una época >= `t`.
+	 */
+	class EpochDomain {
+	public:
+		struct alignas(64) Slot {
+			std::atomic<uint64_t> epoch{ kQuiescent };
+			std::atomic<bool> owned{ false };
+		};
+
+		/// Ranura del hilo actual (nullptr si no quedan libres).
+		Slot* LocalSlot() {
+			thread_local SlotOwner owner(*this);
+			return owner.slot;
+		}
+
+		/// Retira un objeto desenlazado; se libera tras el periodo de gracia.
+		void Retire(std::function<void()> release) {
+			uint64_t epoch = m_epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+			std::lock_guard<std::mutex> lock(m_retiredMutex);
+			m_retired.push_back(Retired{ epoch, std::move(release) });
+			Collect();
+		}
+
+		uint64_t Current() const { return m_epoch.load(std::memory_order_acquire); }
+
+		~EpochDomain() {
+			for (auto& retired : m_retired) retired.release();
+		}
+
+	private:
+		struct Retired {
+			uint64_t epoch;
+			std::function<void()> release;
+		};
+
+		/// Dueño de la ranura de un hilo: la devuelve al terminar el hilo.
+		struct SlotOwner {
+			Slot* slot = nullptr;
+			explicit SlotOwner(EpochDomain& domain) {
+				for (Slot& candidate : domain.m_slots) {
+					bool expected = false;
+					if (candidate.owned.compare_exchange_strong(expected, true)) {
+						slot = &candidate;
+						break;
+					}
+				}
+			}
+			~SlotOwner() {
+				if (slot) slot->owned.store(false, std::memory_order_release);
+			}
+		};
+
+		/// Libera lo retirado antes de la época mínima anunciada. @pre m_retiredMutex tomado.
+		void Collect() {
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			uint64_t oldest = kQuiescent;
+			for (const Slot& slot : m_slots) {
+				oldest = std::min(oldest, slot.epoch.load(std::memory_order_relaxed));
+			}
+			auto keep = std::partition(m_retired.begin(), m_retired.end(),
+				[&](const Retired& retired) { return retired.epoch > oldest; });
+			for (auto it = keep; it != m_retired.end(); ++it) it->release();
+			m_retired.erase(keep, m_retired.end());
+		}
+
+		std::atomic<uint64_t> m_epoch{ 1 };
+		Slot m_slots[kMaxReaders];
+		std::mutex m_retiredMutex;
+		std::vector<Retired> m_retired;
+	};
+
+	EpochDomain& Domain() {
+		static EpochDomain domain;
+		return domain;
+	}
+
+	/// Mezcla de bits para repartir ids consecutivos entre tablas y buckets.
+	uint32_t Hash(uint32_t userId) {
+		userId ^= userId >> 16;
+		userId *= 0x7feb352dU;
+		userId ^= userId >> 15;
+		userId *= 0x846ca68bU;
+		userId ^= userId >> 16;
+		return userId;
+	}
+}
+
+/// @brief Entrada inmutable salvo el enlace al siguiente.
+struct UserDirectory::Node {
+	uint32_t userId = 0;
+	UserRoute route;
+	std::atomic<Node*> next{ nullptr };
+};
+
+/// @brief Array de buckets; se sustituye entero al crecer.
+struct UserDirectory::Table {
+	explicit Table(size_t size) : buckets(size), mask(size - 1) {}
+	std::vector<std::atomic<Node*>> buckets;
+	size_t mask;
+};
+
+/// @brief Tabla independiente con su propio mutex de escritura.
+struct alignas(64) UserDirectory::Shard {
+	std::atomic<Table*> table{ nullptr };
+	std::mutex writeMutex;
+	size_t count = 0;
+	std::vector<Node*> unlinked;                     ///< Desenlazados aún sin época (con writeMutex).
+};
+
+/// @brief Lote a retirar; se declara antes del lock_guard y se retira al salir, ya sin el mutex.
+struct UserDirectory::Batch {
+	std::vector<Node*> nodes;
+	std::vector<Table*> tables;
+
+	/// Recoge los desenlazados de @p shard si completan un lote (o siempre con @p force).
+	void Take(Shard& shard, bool force = false) {
+		if (!force && shard.unlinked.size() < kRetireBatch) return;
+		nodes.insert(nodes.end(), shard.unlinked.begin(), shard.unlinked.end());
+		shard.unlinked.clear();
+	}
+
+	~Batch() {
+		if (nodes.empty() && tables.empty()) return;
+		// Una época y una reserva por lote, no por nodo
+		Domain().Retire([nodes = std::move(nodes), tables = std::move(tables)]() {
+			for (Node* node : nodes) delete node;
+			for (Table* table : tables) delete table;
+		});
+	}
+};
+
+UserDirectory::UserDirectory() : m_shards(new Shard[kShardCount]) {
+	for (size_t i = 0; i < kShardCount; ++i) {
+		m_shards[i].table.store(new Table(kInitialBuckets), std::memory_order_release);
+	}
+}
+
+UserDirectory::~UserDirectory() {
+	// Sin lectores posibles: se libera directamente lo que sigue publicado
+	for (size_t i = 0; i < kShardCount; ++i) {
+		Table* table = m_shards[i].table.load(std::memory_order_acquire);
+		for (auto& bucket : table->buckets) {
+			for (Node* node = bucket.load(std::memory_order_relaxed); node;) {
+				Node* next = node->next.load(std::memory_order_relaxed);
+				delete node;
+				node = next;
+			}
+		}
+		delete table;
+		for (Node* node : m_shards[i].unlinked) delete node;
+	}
+}
+
+UserDirectory::Shard&
+UserDirectory::ShardFor(uint32_t userId) const {
+	return m_shards[Hash(userId) & (kShardCount - 1)];
+}
+
+void
+UserDirectory::Grow(Shard& shard, Batch& batch) {
+	// Tabla nueva con copias de los nodos: los lectores de la anterior siguen viendo listas intactas
+	Table* old = shard.table.load(std::memory_order_relaxed);
+	Table* grown = new Table(old->buckets.size() * 2);
+	std::vector<Node*>& retired = batch.nodes;
+	for (auto& bucket : old->buckets) {
+		for (Node* node = bucket.load(std::memory_order_relaxed); node; node = node->next.load(std::memory_order_relaxed)) {
+			Node* copy = new Node;
+			copy->userId = node->userId;
+			copy->route = node->route;
+			auto& target = grown->buckets[(Hash(node->userId) / kShardCount) & grown->mask];
+			copy->next.store(target.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			target.store(copy, std::memory_order_relaxed);
+			retired.push_back(node);
+		}
+	}
+	shard.table.store(grown, std::memory_order_release);
+	batch.tables.push_back(old);
+	batch.Take(shard, true);
+}
+
+bool
+UserDirectory::Register(uint32_t userId, const UserRoute& route) {
+	if (userId == 0) return false;
+	Shard& shard = ShardFor(userId);
+	Batch batch;
+	std::lock_guard<std::mutex> lock(shard.writeMutex);
+	Table* table = shard.table.load(std::memory_order_relaxed);
+	auto& bucket = table->buckets[(Hash(userId) / kShardCount) & table->mask];
+
+	std::atomic<Node*>* link = &bucket;
+	for (Node* node = link->load(std::memory_order_relaxed); node; node = link->load(std::memory_order_relaxed)) {
+		if (node->userId == userId) {
+			if (node->route.sessionId != route.sessionId) return false;
+			// Misma sesión (traspaso o reintento): se sustituye el nodo, nunca se modifica
+			Node* replacement = new Node;
+			replacement->userId = userId;
+			replacement->route = route;
+			replacement->next.store(node->next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			link->store(replacement, std::memory_order_release);
+			shard.unlinked.push_back(node);
+			batch.Take(shard);
+			return true;
+		}
+		link = &node->next;
+	}
+
+	Node* node = new Node;
+	node->userId = userId;
+	node->route = route;
+	node->next.store(bucket.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	bucket.store(node, std::memory_order_release);
+	m_size.fetch_add(1, std::memory_order_relaxed);
+	if (++shard.count > table->buckets.size() * 2) Grow(shard, batch);
+	return true;
+}
+
+void
+UserDirectory::Unregister(uint32_t userId, uint64_t sessionId) {
+	Shard& shard = ShardFor(userId);
+	Batch batch;
+	std::lock_guard<std::mutex> lock(shard.writeMutex);
+	Table* table = shard.table.load(std::memory_order_relaxed);
+	std::atomic<Node*>* link = &table->buckets[(Hash(userId) / kShardCount) & table->mask];
+	for (Node* node = link->load(std::memory_order_relaxed); node; node = link->load(std::memory_order_relaxed)) {
+		if (node->userId == userId) {
+			if (node->route.sessionId != sessionId) return;
+			// El nodo desenlazado conserva su `next`: un lector que esté en él sigue la lista
+			link->store(node->next.load(std::memory_order_relaxed), std::memory_order_release);
+			shard.count--;
+			m_size.fetch_sub(1, std::memory_order_relaxed);
+			shard.unlinked.push_back(node);
+			batch.Take(shard);
+			return;
+		}
+		link = &node->next;
+	}
+}
+
+bool
+UserDirectory::Lookup(uint32_t userId, UserRoute& out) const {
+	Shard& shard = ShardFor(userId);
+	EpochDomain& domain = Domain();
+	EpochDomain::Slot* slot = domain.LocalSlot();
+	std::unique_lock<std::mutex> fallback;
+	if (slot) {
+		// La barrera ordena el anuncio antes de las cargas de la lista (par de la de Collect)
+		slot->epoch.store(domain.Current(), std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+	else {
+		fallback = std::unique_lock<std::mutex>(shard.writeMutex);
+	}
+
+	bool found = false;
+	Table* table = shard.table.load(std::memory_order_acquire);
+	const auto& bucket = table->buckets[(Hash(userId) / kShardCount) & table->mask];
+	for (Node* node = bucket.load(std::memory_order_acquire); node; node = node->next.load(std::memory_order_acquire)) {
+		if (node->userId == userId) {
+			out = node->route;
+			found = true;
+			break;
+		}
+	}
+
+	if (slot) slot->epoch.store(kQuiescent, std::memory_order_release);
+	return found;
+}
+
+size_t
+UserDirectory::Size() const {
+	return m_size.load(std::memory_order_relaxed);
+}